@@ -44,6 +44,7 @@
 #include <atheme/linker.h>
 #include <atheme/match.h>
 #include <atheme/memory.h>
+#include <atheme/metrics.h>
 #include <atheme/module.h>
 #include <atheme/object.h>
 #include <atheme/pbkdf2.h>
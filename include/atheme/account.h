@@ -63,6 +63,37 @@ struct svsignore
 	char *                  reason;
 };
 
+/* position of an account, nick or channel in the expiry queue */
+struct expiry_node
+{
+	time_t          due;    // earliest time expire_check() must look at the owner
+	size_t          slot;   // 1-based index into the queue, 0 if not queued
+	void *          owner;
+	unsigned int    type;   // EXPIRY_*
+};
+
+#define EXPIRY_ACCOUNT  1U
+#define EXPIRY_NICK     2U
+#define EXPIRY_CHANNEL  3U
+
+/* position of an account in the secondary indexes (libathemecore/accountindex.c) */
+struct myuser_index_entry
+{
+	mowgli_node_t   email;          // in the list for its canonical email address
+	mowgli_node_t   registered;     // in the list ordered by registration time
+	mowgli_node_t   lastlogin;      // in the list ordered by last login time
+	time_t          registered_ts;  // registration time it was filed under
+	time_t          lastlogin_ts;   // last login time it was filed under
+};
+
+enum myuser_index_order
+{
+	MYUSER_INDEX_REGISTERED = 0,
+	MYUSER_INDEX_LASTLOGIN  = 1,
+};
+
+#define MYUSER_INDEX_ORDER_COUNT 2U
+
 /* services accounts */
 struct myuser
 {
@@ -84,6 +115,10 @@ struct myuser
 	mowgli_list_t           nicks;                  // registered nicks, must include mu->name if nonempty
 	struct language *       language;
 	mowgli_list_t           cert_fingerprints;
+	struct expiry_node      expiry;
+	struct myuser_index_entry index;
+	mowgli_node_t           dbnode;                 // for myuser_dblist
+	unsigned int            db_gen;                 // the last save that has this account written out
 };
 
 /* Keep this synchronized with mu_flags in libathemecore/flags.c */
@@ -119,6 +154,7 @@ struct mynick
 	time_t                  registered;
 	time_t                  lastseen;
 	mowgli_node_t           node;   // for struct myuser -> nicks
+	struct expiry_node      expiry;
 };
 
 /* record about a name that used to exist */
@@ -148,6 +184,9 @@ struct mychan
 	unsigned int            mlock_limit;
 	char *                  mlock_key;
 	unsigned int            flags;
+	struct expiry_node      expiry;
+	mowgli_node_t           dbnode;                 // for mychan_dblist
+	unsigned int            db_gen;                 // the last save that has this channel written out
 };
 
 /* Keep this synchronized with mc_flags in libathemecore/flags.c */
@@ -245,11 +284,13 @@ struct chanacs
 
 struct mygroup
 {
-	struct myentity ent;
-	mowgli_list_t   acs;
-	time_t          regtime;
-	unsigned int    flags;
-	bool            visited;
+	struct myentity     ent;
+	mowgli_list_t       acs;
+	time_t              regtime;
+	unsigned int        flags;
+	bool                visited;
+	bool                members_stale;      // members needs to be rebuilt before it is used
+	mowgli_patricia_t * members;            // entity ID -> flags of all direct and nested members
 };
 
 #define MG_REGNOLIMIT		0x00000001U
@@ -309,6 +350,8 @@ enum db_save_strategy
 
 extern void (*db_save)(void *arg, enum db_save_strategy strategy);
 extern void (*db_load)(const char *arg);
+extern void (*db_modify)(struct myuser *mu, struct mychan *mc);
+extern unsigned int db_save_gen;
 
 /* function.c */
 bool is_founder(struct mychan *mychan, struct myentity *myuser);
@@ -349,8 +392,11 @@ void qline_expire(void *arg);
 extern mowgli_patricia_t *nicklist;
 extern mowgli_patricia_t *oldnameslist;
 extern mowgli_patricia_t *mclist;
+extern mowgli_list_t myuser_dblist;
+extern mowgli_list_t mychan_dblist;
 
 void init_accounts(void);
+void db_modifying(void *target);
 
 struct myuser *myuser_add(const char *name, const char *pass, const char *email, unsigned int flags);
 struct myuser *myuser_add_id(const char *id, const char *name, const char *pass, const char *email, unsigned int flags);
@@ -414,6 +460,15 @@ bool chanacs_change(struct mychan *mychan, struct myentity *mt, const char *host
 bool chanacs_change_simple(struct mychan *mychan, struct myentity *mt, const char *hostmask, unsigned int addflags, unsigned int removeflags, struct myentity *setter);
 
 void expire_check(void *arg);
+void expire_check_slice(void *arg);
+void expire_queue_rebuild(void);
+
+/* accountindex.c */
+const mowgli_list_t *myuser_index_email(const char *email_canonical);
+size_t myuser_index_count_before(enum myuser_index_order order, time_t before, size_t limit);
+void myuser_index_foreach_before(enum myuser_index_order order, time_t before, int (*cb)(struct myuser *mu, void *privdata), void *privdata);
+void myuser_index_update(struct myuser *mu);
+void myuser_index_rebuild(void);
 /* Check the database for (version) problems common to all backends */
 void db_check(void);
 
@@ -14,10 +14,38 @@
 #include <atheme/stdheaders.h>
 #include <atheme/structures.h>
 
+/* An in-flight asynchronous password verification. The callback is invoked
+ * exactly once when the verdict is known, unless the source user quits or the
+ * account is dropped first, in which case the request is silently cancelled
+ * (so the private data passed along must not own anything). A module that
+ * submits requests must cancel its own with auth_cancel_callback() when it is
+ * unloaded.
+ */
+struct auth_request;
+
+/* UNAVAILABLE: the password could not be checked right now (e.g. the auth
+ *              module was unloaded); it says nothing about the password
+ */
+enum auth_verdict
+{
+	AUTH_VERDICT_REJECTED,
+	AUTH_VERDICT_VERIFIED,
+	AUTH_VERDICT_UNAVAILABLE
+};
+
+typedef void (*auth_verify_fn)(struct sourceinfo *si, struct myuser *mu, enum auth_verdict verdict, void *priv);
+
+void auth_init(void);
 void set_password(struct myuser *mu, const char *newpassword);
 bool verify_password(struct myuser *mu, const char *password) ATHEME_FATTR_WUR;
+void verify_password_async(struct sourceinfo *si, struct myuser *mu, const char *password, auth_verify_fn cb,
+                           void *priv);
+bool auth_request_pending(const struct user *u) ATHEME_FATTR_WUR;
+void auth_cancel_callback(auth_verify_fn cb);
+void auth_request_complete(struct auth_request *req, enum auth_verdict verdict);
 
 extern bool auth_module_loaded;
 extern bool (*auth_user_custom)(struct myuser *mu, const char *password) ATHEME_FATTR_WUR;
+extern void (*auth_user_custom_async)(struct auth_request *req, struct myuser *mu, const char *password);
 
 #endif /* !ATHEME_INC_AUTH_H */
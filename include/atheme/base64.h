@@ -40,6 +40,24 @@
 #define BASE64_SIZE_RAW(len)    ((((len) + 2U) / 3U) * 4U)
 #define BASE64_SIZE_STR(len)    (BASE64_SIZE_RAW(len) + 1U)
 
+/* Vectorised codec kernels. The best one the CPU supports is picked on first use; the portable
+ * code is always available. base64_use_kernel() returns false if the kernel is not compiled in
+ * or not supported by this CPU.
+ */
+enum base64_kernel
+{
+	BASE64_KERNEL_PORTABLE  = 0,    // Plain C; always available
+	BASE64_KERNEL_SSSE3     = 1,    // x86 SSSE3, 16 characters per step
+	BASE64_KERNEL_AVX2      = 2,    // x86 AVX2, 32 characters per step
+	BASE64_KERNEL_NEON      = 3,    // AArch64 Advanced SIMD, 64 characters per step
+};
+
+#define BASE64_KERNEL_COUNT     4U
+
+enum base64_kernel base64_get_kernel(void);
+const char *base64_kernel_name(enum base64_kernel) ATHEME_FATTR_RETURNS_NONNULL;
+bool base64_use_kernel(enum base64_kernel);
+
 size_t base64_decode(const char *, void *, size_t) ATHEME_FATTR_WUR;
 size_t base64_decode_table(const char *, void *, size_t, const char alphabet[static 65]) ATHEME_FATTR_WUR;
 
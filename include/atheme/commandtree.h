@@ -14,6 +14,36 @@
 #include <atheme/stdheaders.h>
 #include <atheme/structures.h>
 
+#define COMMAND_LATENCY_BUCKETS         24U
+#define COMMAND_STATS_WORST_WINDOW      SECONDS_PER_HOUR
+#define COMMAND_STATS_WORST_SLOTS       6U
+#define COMMAND_STATS_WORST_SLOT_LEN    (COMMAND_STATS_WORST_WINDOW / COMMAND_STATS_WORST_SLOTS)
+
+// the slowest run in one slice of COMMAND_STATS_WORST_WINDOW
+struct command_stats_worst
+{
+	unsigned long long      usec;
+	time_t                  time;
+	char                    source[128];
+};
+
+/* Filled in by command_exec(); bucket i counts runs that took less than
+ * 2^(i+1) microseconds (and at least 2^i, except for bucket 0), the last
+ * one everything slower. worst[] holds the slowest run of each of the last
+ * COMMAND_STATS_WORST_SLOTS slices of COMMAND_STATS_WORST_SLOT_LEN seconds.
+ */
+struct command_stats
+{
+	mowgli_node_t           node;           // in the list of commands that have run
+	char                    service[32];    // internal name of the service it first ran under
+	char                    name[64];       // as first run, e.g. "ACCESS ADD" for a subcommand
+	unsigned long long      calls;
+	unsigned long long      usec_total;
+	unsigned long long      usec_max;
+	unsigned int            buckets[COMMAND_LATENCY_BUCKETS];
+	struct command_stats_worst worst[COMMAND_STATS_WORST_SLOTS];
+};
+
 struct command
 {
 	const char *            name;
@@ -25,6 +55,7 @@ struct command
 		const char *    path;
 		void          (*func)(struct sourceinfo *, const char *subcmd);
 	}                       help;
+	struct command_stats    stats;
 };
 
 /* commandtree.c */
@@ -36,6 +67,9 @@ void command_exec(struct service *, struct sourceinfo *, struct command *, int,
 void command_exec_split(struct service *, struct sourceinfo *, const char *, char *, mowgli_patricia_t *);
 void subcommand_dispatch_simple(struct service *, struct sourceinfo *, int, char **, mowgli_patricia_t *, const char *);
 extern bool (*command_authorize)(struct service *, struct sourceinfo *, struct command *c, const char *userlevel);
+void command_stats_foreach(int (*cb)(struct command *c, void *privdata), void *privdata);
+unsigned long long command_stats_percentile(const struct command_stats *stats, unsigned int permille);
+const struct command_stats_worst *command_stats_worst(const struct command_stats *stats);
 
 /* logger.c */
 void logaudit_denycmd(struct sourceinfo *si, struct command *cmd, const char *userlevel);
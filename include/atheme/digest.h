@@ -58,6 +58,10 @@ bool digest_oneshot_hkdf(enum digest_algorithm, const void *, size_t, const void
 bool digest_oneshot_pbkdf2(enum digest_algorithm, const void *, size_t, const void *, size_t, size_t, void *, size_t)
     ATHEME_FATTR_WUR;
 
+size_t digest_pbkdf2_batch_lanes(enum digest_algorithm);
+bool digest_oneshot_pbkdf2_batch(enum digest_algorithm, size_t, const struct digest_pbkdf2_job *, size_t)
+    ATHEME_FATTR_WUR;
+
 bool digest_testsuite_run(void) ATHEME_FATTR_WUR;
 const char *digest_get_frontend_info(void);
 
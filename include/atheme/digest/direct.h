@@ -31,6 +31,54 @@
 #define DIGEST_BKLEN_MAX        DIGEST_BKLEN_SHA2_512
 #define DIGEST_MDLEN_MAX        DIGEST_MDLEN_SHA2_512
 
+/* Hardware block transforms that can be compiled in; which one (if any) is
+ * used is decided at runtime by the internal digest frontend.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ >= 5)))
+#  define DIGEST_DIRECT_HAVE_X86_SHA        1
+#  define DIGEST_DIRECT_X86_SHA_TARGET      __attribute__((target("sha,sse4.1")))
+#endif
+
+#if defined(__aarch64__) && defined(__linux__)
+#  if defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2)
+#    define DIGEST_DIRECT_HAVE_ARMV8_SHA    1
+#    define DIGEST_DIRECT_ARMV8_SHA_TARGET  /* nothing */
+#  elif defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 8)
+#    define DIGEST_DIRECT_HAVE_ARMV8_SHA    1
+#    define DIGEST_DIRECT_ARMV8_SHA_TARGET  __attribute__((target("+crypto")))
+#  endif
+#endif
+
+/* Multi-lane block transforms, used by the batched PBKDF2 implementation.
+ * Every lane of a vector is an independent digest state or message word;
+ * the message words are in host byte order.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#  define DIGEST_DIRECT_LANES_32            8U
+#  define DIGEST_DIRECT_LANES_64            4U
+typedef uint32_t digest_direct_lane32 __attribute__((vector_size(DIGEST_DIRECT_LANES_32 * sizeof(uint32_t))));
+typedef uint64_t digest_direct_lane64 __attribute__((vector_size(DIGEST_DIRECT_LANES_64 * sizeof(uint64_t))));
+#else
+#  define DIGEST_DIRECT_LANES_32            1U
+#  define DIGEST_DIRECT_LANES_64            1U
+typedef uint32_t digest_direct_lane32;
+typedef uint64_t digest_direct_lane64;
+#endif
+
+// Where the toolchain supports ifunc dispatch, also build AVX2 versions of the multi-lane transforms
+#if defined(__x86_64__) && defined(__GLIBC__) && defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 6)
+#  define DIGEST_DIRECT_LANES_TARGET        __attribute__((target_clones("avx2", "default")))
+#else
+#  define DIGEST_DIRECT_LANES_TARGET        /* nothing */
+#endif
+
+enum digest_direct_kernel
+{
+	DIGEST_DIRECT_KERNEL_PORTABLE   = 0,    // Plain C; always available
+	DIGEST_DIRECT_KERNEL_X86_SHA    = 1,    // Intel SHA Extensions (SHA-NI)
+	DIGEST_DIRECT_KERNEL_ARMV8_SHA  = 2,    // ARMv8 Cryptography Extensions
+};
+
 struct digest_direct_ctx_md5
 {
 	uint32_t        count[0x02U];
@@ -82,4 +130,11 @@ void digest_direct_final_sha1(union digest_direct_ctx *, void *);
 void digest_direct_final_sha2_256(union digest_direct_ctx *, void *);
 void digest_direct_final_sha2_512(union digest_direct_ctx *, void *);
 
+bool digest_direct_use_kernel_sha1(enum digest_direct_kernel);
+bool digest_direct_use_kernel_sha2_256(enum digest_direct_kernel);
+
+void digest_direct_lanes_sha1(digest_direct_lane32 *, digest_direct_lane32 *);
+void digest_direct_lanes_sha2_256(digest_direct_lane32 *, digest_direct_lane32 *);
+void digest_direct_lanes_sha2_512(digest_direct_lane64 *, digest_direct_lane64 *);
+
 #endif /* !ATHEME_INC_DIGEST_DIRECT_H */
@@ -44,6 +44,7 @@ void init_entities(void);
 void myentity_set_last_uid(const char *last_uid);
 const char *myentity_get_last_uid(void);
 const char *myentity_alloc_uid(void);
+bool myentity_uid_after(const char *a, const char *b);
 
 void myentity_put(struct myentity *me);
 void myentity_del(struct myentity *me);
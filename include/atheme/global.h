@@ -28,6 +28,7 @@ struct me
 	char *          adminname;              // SRA's name (for ADMIN)
 	char *          adminemail;             // SRA's email (for ADMIN)
 	char *          mta;                    // path to mta program
+	bool            mta_smtp;               // speak SMTP to it ("-bs") instead of "-t" per message
 	char *          numeric;                // server numeric
 	int             maxfd;                  // how many fds do we have?
 	unsigned int    mdlimit;                // metadata entry limit
@@ -96,6 +97,7 @@ struct ConfOption
 	unsigned int    immune_level;           // what flag is required for kick immunity
 	bool            show_entity_id;         // do not require user:auspex to see entity IDs
 	bool            load_database_mdeps;    // for core module deps listed in DB, whether to load them or abort
+	unsigned int    slow_operation_threshold;   // log timers, hook handlers and event loop iterations slower than this (ms)
 };
 
 extern struct ConfOption config_options;
@@ -166,6 +166,12 @@ struct hook_server_delete
 	/* space for reason etc here */
 };
 
+struct hook_stats_req
+{
+	struct user *   u;              // User that sent the STATS request
+	char            req;            // The requested STATS letter
+};
+
 struct hook_user_delete_info
 {
 	struct user * const u;
@@ -234,6 +240,8 @@ void hook_del_hook(const char *, hook_fn);
 void hook_add_hook(const char *, hook_fn);
 void hook_add_hook_first(const char *, hook_fn);
 void hook_call_event(const char *, void *);
+size_t hook_get_handlers(const char *event, hook_fn *handlers, size_t max);
+void hook_call_handler(const char *event, hook_fn handler, void *dptr);
 
 void hook_stop(void);
 void hook_continue(void *newptr);
@@ -13,24 +13,48 @@
 #include <atheme/stdheaders.h>
 #include <atheme/structures.h>
 
+// Registered with httpd_path_handler_add(), exported by misc/httpd
 struct path_handler
 {
 	const char *    path;
 	void          (*handler)(struct connection *, void *);
+	bool            allow_get;      // GET requests reach handler, with an empty body
 };
 
 struct httpddata
 {
-	char            method[64];
-	char            filename[256];
-	char *          requestbuf;
-	char *          replybuf;
-	int             length;
-	int             lengthdone;
-	bool            connection_close;
-	bool            correct_content_type;
-	bool            expect_100_continue;
-	bool            sent_reply;
+	char                    method[64];
+	char                    filename[256];
+	char *                  requestbuf;
+	char *                  replybuf;
+	int                     length;
+	int                     lengthdone;
+	bool                    connection_close;
+	bool                    correct_content_type;
+	bool                    expect_100_continue;
+	bool                    sent_reply;
+	bool                    http10;         // request is HTTP/1.0 ...
+	bool                    keep_alive;     // ... and asked to keep the connection open
+	bool                    paused;         // further requests wait until the reply has been sent
+	size_t                  header_bytes;   // size of the current request's headers so far
+	int                     file_fd;        // file being sent with sendfile(2), or -1
+	off_t                   file_offset;
+	off_t                   file_remaining;
 };
 
+/* The Connection: header, if any, that a reply to the current request
+ * should carry.
+ */
+static inline const char *
+httpd_connection_header(const struct httpddata *const restrict hd)
+{
+	if (hd->connection_close)
+		return "Connection: close\r\n";
+
+	if (hd->keep_alive)
+		return "Connection: keep-alive\r\n";
+
+	return "";
+}
+
 #endif /* !ATHEME_INC_HTTPD_H */
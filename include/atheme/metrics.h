@@ -0,0 +1,70 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Runtime metrics (counters, gauges, histograms).
+ */
+
+#ifndef ATHEME_INC_METRICS_H
+#define ATHEME_INC_METRICS_H 1
+
+#include <atheme/attributes.h>
+#include <atheme/stdheaders.h>
+#include <atheme/structures.h>
+
+enum metric_type
+{
+	METRIC_COUNTER          = 0,
+	METRIC_GAUGE            = 1,
+	METRIC_HISTOGRAM        = 2,
+};
+
+/* One set of label values of a metric, e.g. service="nickserv",command="INFO"
+ * (an empty string for a metric without labels). Callers on a hot path may
+ * look a series up once and keep the pointer until the metric is destroyed.
+ */
+struct metric_series
+{
+	mowgli_node_t           node;
+	struct metric *         metric;
+	char *                  labels;
+	double                  value;          // counters and gauges
+	unsigned long long *    buckets;        // histograms: observations <= bounds[i], not cumulative
+	unsigned long long      count;          // histograms: all observations
+	double                  sum;            // histograms: sum of all observations
+};
+
+struct metric
+{
+	mowgli_node_t           node;
+	char *                  name;
+	char *                  help;
+	enum metric_type        type;
+	double *                bounds;         // histograms: upper bounds of the buckets, ascending
+	size_t                  nbounds;
+	void                  (*collect)(struct metric *, void *);
+	void *                  privdata;
+	mowgli_patricia_t *     series_index;
+	mowgli_list_t           series;
+};
+
+struct metric *metric_create(const char *name, const char *help, enum metric_type type);
+struct metric *metric_histogram_create(const char *name, const char *help, const double *bounds, size_t nbounds);
+void metric_set_collector(struct metric *m, void (*collect)(struct metric *, void *), void *privdata);
+void metric_destroy(struct metric *m);
+
+struct metric_series *metric_series_get(struct metric *m, const char *labels);
+void metric_series_add(struct metric_series *s, double value);
+void metric_series_set(struct metric_series *s, double value);
+void metric_series_observe(struct metric_series *s, double value);
+
+void metric_add(struct metric *m, const char *labels, double value);
+void metric_set(struct metric *m, const char *labels, double value);
+void metric_observe(struct metric *m, const char *labels, double value);
+
+size_t metric_labels(char *buf, size_t bufsize, ...);
+void metrics_render(void (*emit)(const char *, size_t, void *), void *privdata);
+
+#endif /* !ATHEME_INC_METRICS_H */
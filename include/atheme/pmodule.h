@@ -30,7 +30,7 @@ struct proto_cmd
 #define MAXPARC		35 /* max # params to protocol command */
 
 /* pmodule.c */
-extern mowgli_heap_t *pcommand_heap;
+extern struct sharedheap *pcommand_heap;
 extern mowgli_heap_t *messagetree_heap;
 extern mowgli_patricia_t *pcommands;
 
@@ -35,6 +35,7 @@
 #define ASASL_SFLAG_NONE                0x00000000U // Nothing special
 #define ASASL_SFLAG_MARKED_FOR_DELETION 0x00000001U // See sasl_delete_stale() in modules/saslserv/main.c
 #define ASASL_SFLAG_CLIENT_USING_TLS    0x00000002U // The client is connected to the network via TLS
+#define ASASL_SFLAG_OUTCOME_COUNTED     0x00000004U // The session outcome has been added to the mechanism statistics
 
 // Flags for sasl_input_buf->flags
 #define ASASL_INFLAG_NONE               0x00000000U // Nothing special
@@ -14,15 +14,26 @@
 #include <atheme/object.h>
 #include <atheme/stdheaders.h>
 
+/* Heaps are shared between callers that ask for the same object size and
+ * tag. The tag names what is kept in the heap ("user", "chanacs", ...) so
+ * that memory use can be broken down by it in /STATS B and the metrics.
+ */
 struct sharedheap
 {
 	struct atheme_object    parent;
 	mowgli_node_t           node;
 	mowgli_heap_t *         heap;
 	size_t                  size;
+	char *                  tag;
+	size_t                  objects;        // allocated and not yet freed
+	size_t                  objects_peak;
+	unsigned long long      allocs;
 };
 
-mowgli_heap_t *sharedheap_get(size_t size);
-void sharedheap_unref(mowgli_heap_t *heap);
+struct sharedheap *sharedheap_get(const char *tag, size_t size);
+void sharedheap_unref(struct sharedheap *s);
+void *sharedheap_alloc(struct sharedheap *s);
+void sharedheap_free(struct sharedheap *s, void *ptr);
+void sharedheap_foreach(int (*cb)(const struct sharedheap *s, void *privdata), void *privdata);
 
 #endif /* !ATHEME_INC_SHAREDHEAP_H */
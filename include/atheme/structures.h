@@ -69,6 +69,10 @@ struct path_handler;
 // Defined in atheme/match.h
 struct atheme_regex;
 
+// Defined in atheme/metrics.h
+struct metric;
+struct metric_series;
+
 // Defined in atheme/module.h
 struct module;
 struct module_dependency;
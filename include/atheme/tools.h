@@ -131,6 +131,7 @@ void canonicalize_email_case(char email[static (EMAILLEN + 1)], void *user_data)
 void register_email_canonicalizer(email_canonicalizer_fn func, void *user_data);
 void unregister_email_canonicalizer(email_canonicalizer_fn func, void *user_data);
 bool email_within_limits(const char *email);
+bool email_pattern_is_literal(const char *pattern);
 bool validhostmask(const char *host);
 char *pretty_mask(char *mask);
 bool validtopic(const char *topic);
@@ -147,6 +148,7 @@ int srename(const char *old_fn, const char *new_fn);
 void s_time(struct timeval *sttime);
 void e_time(struct timeval sttime, struct timeval *ttime);
 int tv2ms(struct timeval *tv);
+unsigned long long tv2us(const struct timeval *tv);
 #endif
 char *time_ago(time_t event);
 char *timediff(time_t seconds);
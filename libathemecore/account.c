@@ -19,15 +19,22 @@
 mowgli_patricia_t *nicklist;
 mowgli_patricia_t *oldnameslist;
 mowgli_patricia_t *mclist;
+mowgli_list_t myuser_dblist;
+mowgli_list_t mychan_dblist;
 
 static mowgli_patricia_t *certfplist;
 
-static mowgli_heap_t *myuser_heap;   /* HEAP_USER */
-static mowgli_heap_t *mynick_heap;   /* HEAP_USER */
-static mowgli_heap_t *mycertfp_heap; /* HEAP_USER */
-static mowgli_heap_t *myuser_name_heap;	/* HEAP_USER / 2 */
-static mowgli_heap_t *mychan_heap;	/* HEAP_CHANNEL */
-static mowgli_heap_t *chanacs_heap;	/* HEAP_CHANACS */
+static struct sharedheap *myuser_heap;   /* HEAP_USER */
+static struct sharedheap *mynick_heap;   /* HEAP_USER */
+static struct sharedheap *mycertfp_heap; /* HEAP_USER */
+static struct sharedheap *myuser_name_heap;	/* HEAP_USER / 2 */
+static struct sharedheap *mychan_heap;	/* HEAP_CHANNEL */
+static struct sharedheap *chanacs_heap;	/* HEAP_CHANACS */
+
+static void expire_queue_init(struct expiry_node *node, unsigned int type, void *owner);
+static void expire_queue_update(struct expiry_node *node);
+static void expire_queue_remove(struct expiry_node *node);
+static void expire_config_ready(void *unused);
 
 /*
  * init_accounts()
@@ -46,12 +53,12 @@ static mowgli_heap_t *chanacs_heap;	/* HEAP_CHANACS */
 void
 init_accounts(void)
 {
-	myuser_heap = sharedheap_get(sizeof(struct myuser));
-	mynick_heap = sharedheap_get(sizeof(struct myuser));
-	myuser_name_heap = sharedheap_get(sizeof(struct myuser_name));
-	mychan_heap = sharedheap_get(sizeof(struct mychan));
-	chanacs_heap = sharedheap_get(sizeof(struct chanacs));
-	mycertfp_heap = sharedheap_get(sizeof(struct mycertfp));
+	myuser_heap = sharedheap_get("myuser", sizeof(struct myuser));
+	mynick_heap = sharedheap_get("mynick", sizeof(struct mynick));
+	myuser_name_heap = sharedheap_get("myuser_name", sizeof(struct myuser_name));
+	mychan_heap = sharedheap_get("mychan", sizeof(struct mychan));
+	chanacs_heap = sharedheap_get("chanacs", sizeof(struct chanacs));
+	mycertfp_heap = sharedheap_get("mycertfp", sizeof(struct mycertfp));
 
 	if (myuser_heap == NULL || mynick_heap == NULL || mychan_heap == NULL
 			|| chanacs_heap == NULL || mycertfp_heap == NULL)
@@ -64,6 +71,10 @@ init_accounts(void)
 	oldnameslist = mowgli_patricia_create(irccasecanon);
 	mclist = mowgli_patricia_create(irccasecanon);
 	certfplist = mowgli_patricia_create(strcasecanon);
+
+	myuser_index_init();
+
+	hook_add_config_ready(expire_config_ready);
 }
 
 /*
@@ -114,7 +125,7 @@ myuser_add_id(const char *id, const char *name, const char *pass, const char *em
 	if (!(runflags & RF_STARTING))
 		slog(LG_DEBUG, "myuser_add(): %s -> %s", name, email);
 
-	mu = mowgli_heap_alloc(myuser_heap);
+	mu = sharedheap_alloc(myuser_heap);
 	atheme_object_init(atheme_object(mu), name, (atheme_object_destructor_fn) myuser_delete);
 
 	entity(mu)->type = ENT_USER;
@@ -162,6 +173,13 @@ myuser_add_id(const char *id, const char *name, const char *pass, const char *em
 
 	myuser_name_restore(entity(mu)->name, mu);
 
+	expire_queue_init(&mu->expiry, EXPIRY_ACCOUNT, mu);
+	myuser_index_add(mu);
+
+	// a save already in progress leaves it out
+	mu->db_gen = db_save_gen;
+	mowgli_node_add(mu, &mu->dbnode, &myuser_dblist);
+
 	cnt.myuser++;
 
 	return mu;
@@ -195,6 +213,8 @@ myuser_delete(struct myuser *mu)
 
 	return_if_fail(mu != NULL);
 
+	db_modifying(mu);
+
 	if (!(runflags & RF_STARTING))
 		slog(LG_DEBUG, "myuser_delete(): %s", entity(mu)->name);
 
@@ -202,6 +222,9 @@ myuser_delete(struct myuser *mu)
 
 	hook_call_myuser_delete(mu);
 
+	expire_queue_remove(&mu->expiry);
+	myuser_index_delete(mu);
+
 	/* log them out */
 	MOWGLI_ITER_FOREACH_SAFE(n, tn, mu->logins.head)
 	{
@@ -209,6 +232,7 @@ myuser_delete(struct myuser *mu)
 		if (!authservice_loaded || !ircd_logout_or_kill(u, entity(mu)->name))
 		{
 			u->myuser = NULL;
+			db_modifying(mu);
 			mowgli_node_delete(n, &mu->logins);
 			mowgli_node_free(n);
 		}
@@ -314,12 +338,13 @@ myuser_delete(struct myuser *mu)
 
 	/* entity(mu)->name is the index for this dtree */
 	myentity_del(entity(mu));
+	mowgli_node_delete(&mu->dbnode, &myuser_dblist);
 
 	strshare_unref(mu->email);
 	strshare_unref(mu->email_canonical);
 	strshare_unref(entity(mu)->name);
 
-	mowgli_heap_free(myuser_heap, mu);
+	sharedheap_free(myuser_heap, mu);
 
 	cnt.myuser--;
 }
@@ -354,6 +379,8 @@ myuser_rename(struct myuser *mu, const char *name)
 	return_if_fail(name != NULL);
 	return_if_fail(strlen(name) < sizeof nb);
 
+	db_modifying(mu);
+
 	mowgli_strlcpy(nb, entity(mu)->name, sizeof nb);
 	newname = strshare_get(name);
 
@@ -380,6 +407,10 @@ myuser_rename(struct myuser *mu, const char *name)
 		}
 	}
 
+	/* the main nick never expires on its own; the old one now can */
+	MOWGLI_ITER_FOREACH(n, mu->nicks.head)
+		expire_queue_update(&((struct mynick *) n->data)->expiry);
+
 	data.mu = mu;
 	data.oldname = nb;
 	hook_call_user_rename(&data);
@@ -406,11 +437,17 @@ myuser_set_email(struct myuser *mu, const char *newemail)
 	return_if_fail(mu != NULL);
 	return_if_fail(newemail != NULL);
 
+	db_modifying(mu);
+
+	myuser_index_email_delete(mu);
+
 	strshare_unref(mu->email);
 	strshare_unref(mu->email_canonical);
 
 	mu->email = strshare_get(newemail);
 	mu->email_canonical = canonicalize_email(newemail);
+
+	myuser_index_email_add(mu);
 }
 
 /*
@@ -572,6 +609,8 @@ myuser_access_add(struct myuser *mu, const char *mask)
 		return false;
 	}
 
+	db_modifying(mu);
+
 	msk = sstrdup(mask);
 	n = mowgli_node_create();
 	mowgli_node_add(msk, n, &mu->access_list);
@@ -637,6 +676,8 @@ myuser_access_delete(struct myuser *mu, const char *mask)
 
 		if (!strcasecmp(entry, mask))
 		{
+			db_modifying(mu);
+
 			mowgli_node_delete(n, &mu->access_list);
 			mowgli_node_free(n);
 			sfree(entry);
@@ -680,7 +721,9 @@ mynick_add(struct myuser *mu, const char *name)
 	if (!(runflags & RF_STARTING))
 		slog(LG_DEBUG, "mynick_add(): %s -> %s", name, entity(mu)->name);
 
-	mn = mowgli_heap_alloc(mynick_heap);
+	db_modifying(mu);
+
+	mn = sharedheap_alloc(mynick_heap);
 	atheme_object_init(atheme_object(mn), name, (atheme_object_destructor_fn) mynick_delete);
 
 	mowgli_strlcpy(mn->nick, name, sizeof mn->nick);
@@ -692,6 +735,8 @@ mynick_add(struct myuser *mu, const char *name)
 
 	myuser_name_restore(mn->nick, mu);
 
+	expire_queue_init(&mn->expiry, EXPIRY_NICK, mn);
+
 	cnt.mynick++;
 
 	return mn;
@@ -719,12 +764,16 @@ mynick_delete(struct mynick *mn)
 	if (!(runflags & RF_STARTING))
 		slog(LG_DEBUG, "mynick_delete(): %s", mn->nick);
 
+	db_modifying(mn->owner);
+
 	myuser_name_remember(mn->nick, mn->owner);
 
+	expire_queue_remove(&mn->expiry);
+
 	mowgli_patricia_delete(nicklist, mn->nick);
 	mowgli_node_delete(&mn->node, &mn->owner->nicks);
 
-	mowgli_heap_free(mynick_heap, mn);
+	sharedheap_free(mynick_heap, mn);
 
 	cnt.mynick--;
 }
@@ -760,7 +809,7 @@ myuser_name_add(const char *name)
 	if (!(runflags & RF_STARTING))
 		slog(LG_DEBUG, "myuser_name_add(): %s", name);
 
-	mun = mowgli_heap_alloc(myuser_name_heap);
+	mun = sharedheap_alloc(myuser_name_heap);
 	atheme_object_init(atheme_object(mun), name, (atheme_object_destructor_fn) myuser_name_delete);
 
 	mowgli_strlcpy(mun->name, name, sizeof mun->name);
@@ -798,7 +847,7 @@ myuser_name_delete(struct myuser_name *mun)
 
 	metadata_delete_all(mun);
 
-	mowgli_heap_free(myuser_name_heap, mun);
+	sharedheap_free(myuser_name_heap, mun);
 
 	cnt.myuser_name--;
 }
@@ -928,7 +977,9 @@ mycertfp_add(struct myuser *mu, const char *certfp)
 	return_val_if_fail(mu != NULL, NULL);
 	return_val_if_fail(certfp != NULL, NULL);
 
-	mcfp = mowgli_heap_alloc(mycertfp_heap);
+	db_modifying(mu);
+
+	mcfp = sharedheap_alloc(mycertfp_heap);
 	mcfp->mu = mu;
 	mcfp->certfp = sstrdup(certfp);
 
@@ -945,11 +996,13 @@ mycertfp_delete(struct mycertfp *mcfp)
 	return_if_fail(mcfp->mu != NULL);
 	return_if_fail(mcfp->certfp != NULL);
 
+	db_modifying(mcfp->mu);
+
 	mowgli_node_delete(&mcfp->node, &mcfp->mu->cert_fingerprints);
 	mowgli_patricia_delete(certfplist, mcfp->certfp);
 
 	sfree(mcfp->certfp);
-	mowgli_heap_free(mycertfp_heap, mcfp);
+	sharedheap_free(mycertfp_heap, mcfp);
 }
 
 struct mycertfp *
@@ -972,6 +1025,8 @@ mychan_delete(struct mychan *mc)
 
 	return_if_fail(mc != NULL);
 
+	db_modifying(mc);
+
 	if (!(runflags & RF_STARTING))
 		slog(LG_DEBUG, "mychan_delete(): %s", mc->name);
 
@@ -984,11 +1039,14 @@ mychan_delete(struct mychan *mc)
 
 	metadata_delete_all(mc);
 
+	expire_queue_remove(&mc->expiry);
+
 	mowgli_patricia_delete(mclist, mc->name);
+	mowgli_node_delete(&mc->dbnode, &mychan_dblist);
 
 	strshare_unref(mc->name);
 
-	mowgli_heap_free(mychan_heap, mc);
+	sharedheap_free(mychan_heap, mc);
 
 	cnt.mychan--;
 }
@@ -1004,7 +1062,7 @@ mychan_add(char *name)
 	if (!(runflags & RF_STARTING))
 		slog(LG_DEBUG, "mychan_add(): %s", name);
 
-	mc = mowgli_heap_alloc(mychan_heap);
+	mc = sharedheap_alloc(mychan_heap);
 
 	atheme_object_init(atheme_object(mc), name, (atheme_object_destructor_fn) mychan_delete);
 	mc->name = strshare_get(name);
@@ -1016,6 +1074,12 @@ mychan_add(char *name)
 
 	mowgli_patricia_add(mclist, mc->name, mc);
 
+	// a save already in progress leaves it out
+	mc->db_gen = db_save_gen;
+	mowgli_node_add(mc, &mc->dbnode, &mychan_dblist);
+
+	expire_queue_init(&mc->expiry, EXPIRY_CHANNEL, mc);
+
 	cnt.mychan++;
 
 	return mc;
@@ -1380,6 +1444,8 @@ chanacs_delete(struct chanacs *ca)
 	return_if_fail(ca != NULL);
 	return_if_fail(ca->mychan != NULL);
 
+	db_modifying(ca->mychan);
+
 	if (!(runflags & RF_STARTING))
 		slog(LG_DEBUG, "chanacs_delete(): %s -> %s [%s]", ca->mychan->name,
 			ca->entity != NULL ? entity(ca->entity)->name : ca->host,
@@ -1398,7 +1464,7 @@ chanacs_delete(struct chanacs *ca)
 
 	sfree(ca->host);
 
-	mowgli_heap_free(chanacs_heap, ca);
+	sharedheap_free(chanacs_heap, ca);
 
 	cnt.chanacs--;
 }
@@ -1436,7 +1502,9 @@ chanacs_add(struct mychan *mychan, struct myentity *mt, unsigned int level, time
 	if (!(runflags & RF_STARTING))
 		slog(LG_DEBUG, "chanacs_add(): %s -> %s", mychan->name, mt->name);
 
-	ca = mowgli_heap_alloc(chanacs_heap);
+	db_modifying(mychan);
+
+	ca = sharedheap_alloc(chanacs_heap);
 
 	atheme_object_init(atheme_object(ca), mt->name, (atheme_object_destructor_fn) chanacs_delete);
 	ca->mychan = mychan;
@@ -1491,7 +1559,9 @@ chanacs_add_host(struct mychan *mychan, const char *host, unsigned int level, ti
 	if (!(runflags & RF_STARTING))
 		slog(LG_DEBUG, "chanacs_add_host(): %s -> %s", mychan->name, host);
 
-	ca = mowgli_heap_alloc(chanacs_heap);
+	db_modifying(mychan);
+
+	ca = sharedheap_alloc(chanacs_heap);
 
 	atheme_object_init(atheme_object(ca), host, (atheme_object_destructor_fn) chanacs_delete);
 	ca->mychan = mychan;
@@ -1880,6 +1950,7 @@ chanacs_modify(struct chanacs *ca, unsigned int *addflags, unsigned int *removef
 	/* attempting to manipulate user with more privs? */
 	if (~restrictflags & ca->level)
 		return false;
+	db_modifying(ca->mychan);
 	ca->level = (ca->level | *addflags) & ~*removeflags;
 	ca->tmodified = CURRTIME;
 	if (setter != NULL)
@@ -1949,6 +2020,7 @@ chanacs_change(struct mychan *mychan, struct myentity *mt, const char *hostmask,
 			/* attempting to manipulate user with more privs? */
 			if (~restrictflags & ca->level)
 				return false;
+			db_modifying(mychan);
 			ca->level = (ca->level | *addflags) & ~*removeflags;
 			ca->tmodified = CURRTIME;
 			if (setter != NULL)
@@ -1990,6 +2062,7 @@ chanacs_change(struct mychan *mychan, struct myentity *mt, const char *hostmask,
 			/* attempting to manipulate user with more privs? */
 			if (~restrictflags & ca->level)
 				return false;
+			db_modifying(mychan);
 			ca->level = (ca->level | *addflags) & ~*removeflags;
 			ca->tmodified = CURRTIME;
 			if (setter != NULL)
@@ -2015,151 +2088,470 @@ chanacs_change_simple(struct mychan *mychan, struct myentity *mt, const char *ho
 	return chanacs_change(mychan, mt, hostmask, &a, &r, ca_all, setter);
 }
 
+/***************
+ * E X P I R Y *
+ ***************/
+
+/* Accounts, nicks and channels sit in a binary min-heap ordered by the
+ * earliest time at which they could possibly expire, so expire_check()
+ * only ever looks at objects that are due.
+ *
+ * The deadline is computed from lastlogin/lastseen/used when an object
+ * is (re)queued. Those only move forward at runtime, so a queued deadline
+ * is never later than the real one; an object that turns out not to be
+ * due yet when popped is simply requeued with its new deadline. Loading
+ * the database moves them backwards, hence expire_queue_rebuild().
+ */
+#define EXPIRE_BATCH            256U
+#define EXPIRE_RECHECK          SECONDS_PER_HOUR
+#define EXPIRE_USED_REFRESH     (SECONDS_PER_DAY - SECONDS_PER_HOUR - SECONDS_PER_MINUTE)
+
+static struct expiry_node **expire_queue = NULL;
+static size_t expire_queue_len = 0;
+static size_t expire_queue_size = 0;
+
+static mowgli_eventloop_timer_t *expire_batch_timer = NULL;
+
+static unsigned int expire_nick_expiry = 0;
+static unsigned int expire_chan_expiry = 0;
+
+static inline void
+expire_queue_place(struct expiry_node *const restrict node, const size_t i)
+{
+	expire_queue[i] = node;
+	node->slot = i + 1;
+}
+
+static void
+expire_queue_sift_up(size_t i)
+{
+	struct expiry_node *const node = expire_queue[i];
+
+	while (i > 0)
+	{
+		const size_t parent = (i - 1) / 2;
+
+		if (expire_queue[parent]->due <= node->due)
+			break;
+
+		expire_queue_place(expire_queue[parent], i);
+		i = parent;
+	}
+
+	expire_queue_place(node, i);
+}
+
+static void
+expire_queue_sift_down(size_t i)
+{
+	struct expiry_node *const node = expire_queue[i];
+
+	for (;;)
+	{
+		size_t child = (2 * i) + 1;
+
+		if (child >= expire_queue_len)
+			break;
+
+		if (child + 1 < expire_queue_len && expire_queue[child + 1]->due < expire_queue[child]->due)
+			child++;
+
+		if (node->due <= expire_queue[child]->due)
+			break;
+
+		expire_queue_place(expire_queue[child], i);
+		i = child;
+	}
+
+	expire_queue_place(node, i);
+}
+
+static void
+expire_queue_remove(struct expiry_node *const node)
+{
+	return_if_fail(node != NULL);
+
+	if (! node->slot)
+		return;
+
+	const size_t i = node->slot - 1;
+	struct expiry_node *const last = expire_queue[--expire_queue_len];
+
+	node->slot = 0;
+
+	if (last == node)
+		return;
+
+	expire_queue_place(last, i);
+	expire_queue_sift_up(i);
+	expire_queue_sift_down(last->slot - 1);
+}
+
+static void
+expire_queue_set(struct expiry_node *const node, const time_t due)
+{
+	if (! due)
+	{
+		expire_queue_remove(node);
+		return;
+	}
+
+	if (! node->slot)
+	{
+		if (expire_queue_len == expire_queue_size)
+		{
+			expire_queue_size = expire_queue_size ? (expire_queue_size * 2) : 1024;
+			expire_queue = sreallocarray(expire_queue, expire_queue_size, sizeof *expire_queue);
+		}
+
+		node->due = due;
+		expire_queue_place(node, expire_queue_len++);
+		expire_queue_sift_up(node->slot - 1);
+		return;
+	}
+
+	const time_t olddue = node->due;
+
+	node->due = due;
+
+	if (due < olddue)
+		expire_queue_sift_up(node->slot - 1);
+	else if (due > olddue)
+		expire_queue_sift_down(node->slot - 1);
+}
+
+/* earliest time the owner of the node could need attention, or 0 for never */
+static time_t
+expire_queue_due(const struct expiry_node *const node)
+{
+	time_t due = 0;
+
+	switch (node->type)
+	{
+		case EXPIRY_ACCOUNT:
+		{
+			const struct myuser *const mu = node->owner;
+
+			if (nicksvs.expiry > 0)
+				due = mu->lastlogin + nicksvs.expiry;
+
+			/* MU_WAITAUTH is usually set after myuser_add(), so keep
+			 * young accounts queued whether or not it is set yet */
+			if ((mu->flags & MU_WAITAUTH) || (mu->registered + SECONDS_PER_DAY) > CURRTIME)
+				if (! due || (mu->registered + SECONDS_PER_DAY) < due)
+					due = mu->registered + SECONDS_PER_DAY;
+
+			break;
+		}
+
+		case EXPIRY_NICK:
+		{
+			const struct mynick *const mn = node->owner;
+
+			/* the main nick goes with its account */
+			if (nicksvs.expiry > 0 && irccasecmp(mn->nick, entity(mn->owner)->name))
+				due = mn->lastseen + nicksvs.expiry;
+
+			break;
+		}
+
+		case EXPIRY_CHANNEL:
+		{
+			const struct mychan *const mc = node->owner;
+
+			/* wake up to keep the last used time accurate to within
+			 * a day while that is still possible; a channel that is
+			 * idle by then is next looked at when it would expire
+			 * (joins by users with access update mc->used anyway) */
+			if ((mc->used + EXPIRE_USED_REFRESH) > CURRTIME)
+				due = mc->used + EXPIRE_USED_REFRESH;
+
+			if (chansvs.expiry > 0 && (! due || (mc->used + (time_t) chansvs.expiry) < due))
+				due = mc->used + chansvs.expiry;
+
+			if (! due)
+				due = CURRTIME + EXPIRE_USED_REFRESH;
+
+			break;
+		}
+	}
+
+	return due;
+}
+
+static void
+expire_queue_update(struct expiry_node *const node)
+{
+	return_if_fail(node != NULL);
+
+	expire_queue_set(node, expire_queue_due(node));
+}
+
+/* put an object that was looked at but not expired back into the queue */
+static void
+expire_queue_requeue(struct expiry_node *const node)
+{
+	time_t due = expire_queue_due(node);
+
+	/* kept alive by something other than its timestamps (a hold,
+	 * a check_expire hook, a conf soper, ...); look again later */
+	if (due && due <= CURRTIME)
+		due = CURRTIME + EXPIRE_RECHECK;
+
+	expire_queue_set(node, due);
+}
+
+static void
+expire_queue_init(struct expiry_node *const node, const unsigned int type, void *const owner)
+{
+	node->type = type;
+	node->owner = owner;
+
+	/* the database loader has not filled in the timestamps yet */
+	if (! (runflags & RF_STARTING))
+		expire_queue_update(node);
+}
+
 static int
-expire_myuser_cb(struct myentity *mt, void *unused)
+expire_queue_rebuild_cb(struct myentity *mt, void *unused)
 {
-	struct hook_expiry_req req;
-	struct myuser *mu = user(mt);
+	expire_queue_update(&user(mt)->expiry);
+	return 0;
+}
 
-	return_val_if_fail(isuser(mt), 0);
+void
+expire_queue_rebuild(void)
+{
+	struct mynick *mn;
+	struct mychan *mc;
+	mowgli_patricia_iteration_state_t state;
+
+	myentity_foreach_t(ENT_USER, expire_queue_rebuild_cb, NULL);
+
+	MOWGLI_PATRICIA_FOREACH(mn, &state, nicklist)
+		expire_queue_update(&mn->expiry);
+
+	MOWGLI_PATRICIA_FOREACH(mc, &state, mclist)
+		expire_queue_update(&mc->expiry);
+
+	expire_nick_expiry = nicksvs.expiry;
+	expire_chan_expiry = chansvs.expiry;
+
+	slog(LG_DEBUG, "expire_queue_rebuild(): %zu objects queued", expire_queue_len);
+}
+
+static void
+expire_config_ready(void *unused)
+{
+	if (runflags & RF_STARTING)
+		return;
+
+	if (nicksvs.expiry != expire_nick_expiry || chansvs.expiry != expire_chan_expiry)
+		expire_queue_rebuild();
+}
+
+static void
+expire_myuser(struct myuser *mu)
+{
+	struct hook_expiry_req req;
 
 	/* If they're logged in, update lastlogin time.
-	 * To decrease db traffic, may want to only do
-	 * this if the account would otherwise be
-	 * deleted. -- jilles
+	 * This only happens once the account would otherwise
+	 * be deleted, to keep db traffic down. -- jilles
 	 */
 	if (MOWGLI_LIST_LENGTH(&mu->logins) > 0)
 	{
+		db_modifying(mu);
 		mu->lastlogin = CURRTIME;
-		return 0;
+		expire_queue_requeue(&mu->expiry);
+		return;
 	}
 
 	if (MU_HOLD & mu->flags)
-		return 0;
+	{
+		expire_queue_requeue(&mu->expiry);
+		return;
+	}
 
 	req.data.mu = mu;
 	req.do_expire = 1;
 	hook_call_user_check_expire(&req);
 
-	if (!req.do_expire)
-		return 0;
-
-	if ((nicksvs.expiry > 0 && mu->lastlogin < CURRTIME && (unsigned int)(CURRTIME - mu->lastlogin) >= nicksvs.expiry) ||
-			(mu->flags & MU_WAITAUTH && (CURRTIME - mu->registered) >= SECONDS_PER_DAY))
+	if (req.do_expire &&
+			((nicksvs.expiry > 0 && mu->lastlogin < CURRTIME && (unsigned int)(CURRTIME - mu->lastlogin) >= nicksvs.expiry) ||
+			(mu->flags & MU_WAITAUTH && (CURRTIME - mu->registered) >= SECONDS_PER_DAY)))
 	{
 		/* Don't expire accounts with privs on them in atheme.conf,
 		 * otherwise someone can reregister
 		 * them and take the privs -- jilles */
-		if (is_conf_soper(mu))
-			return 0;
-
-		slog(LG_REGISTER, "EXPIRE: \2%s\2 from \2%s\2 ", entity(mu)->name, mu->email);
-		slog(LG_VERBOSE, "expire_check(): expiring account %s (unused %ds, email %s, nicks %zu, chanacs %zu)",
-				entity(mu)->name, (int)(CURRTIME - mu->lastlogin),
-				mu->email, MOWGLI_LIST_LENGTH(&mu->nicks),
-				MOWGLI_LIST_LENGTH(&entity(mu)->chanacs));
-		atheme_object_dispose(mu);
+		if (!is_conf_soper(mu))
+		{
+			slog(LG_REGISTER, "EXPIRE: \2%s\2 from \2%s\2 ", entity(mu)->name, mu->email);
+			slog(LG_VERBOSE, "expire_check(): expiring account %s (unused %ds, email %s, nicks %zu, chanacs %zu)",
+					entity(mu)->name, (int)(CURRTIME - mu->lastlogin),
+					mu->email, MOWGLI_LIST_LENGTH(&mu->nicks),
+					MOWGLI_LIST_LENGTH(&entity(mu)->chanacs));
+			atheme_object_dispose(mu);
+			return;
+		}
 	}
 
-	return 0;
+	expire_queue_requeue(&mu->expiry);
 }
 
-void
-expire_check(void *arg)
+static void
+expire_mynick(struct mynick *mn)
 {
-	struct mynick *mn;
-	struct mychan *mc;
 	struct user *u;
-	mowgli_patricia_iteration_state_t state;
 	struct hook_expiry_req req;
 
-	/* Let them know about this and the likely subsequent db_save()
-	 * right away -- jilles */
-	if (curr_uplink != NULL && curr_uplink->conn != NULL)
-		sendq_flush(curr_uplink->conn);
+	req.do_expire = 1;
+	req.data.mn = mn;
 
-	myentity_foreach_t(ENT_USER, expire_myuser_cb, NULL);
+	hook_call_nick_check_expire(&req);
 
-	MOWGLI_PATRICIA_FOREACH(mn, &state, nicklist)
+	if (req.do_expire && nicksvs.expiry > 0 && mn->lastseen < CURRTIME &&
+			(unsigned int)(CURRTIME - mn->lastseen) >= nicksvs.expiry &&
+			!(MU_HOLD & mn->owner->flags) &&
+			/* do not drop main nick like this */
+			irccasecmp(mn->nick, entity(mn->owner)->name))
 	{
-		req.do_expire = 1;
-		req.data.mn = mn;
-
-		hook_call_nick_check_expire(&req);
-
-		if (!req.do_expire)
-			continue;
-
-		if (nicksvs.expiry > 0 && mn->lastseen < CURRTIME &&
-				(unsigned int)(CURRTIME - mn->lastseen) >= nicksvs.expiry)
+		u = user_find_named(mn->nick);
+		if (u != NULL && u->myuser == mn->owner)
+		{
+			/* still logged in, bleh */
+			db_modifying(mn->owner);
+			mn->lastseen = CURRTIME;
+			mn->owner->lastlogin = CURRTIME;
+		}
+		else
 		{
-			if (MU_HOLD & mn->owner->flags)
-				continue;
-
-			/* do not drop main nick like this */
-			if (!irccasecmp(mn->nick, entity(mn->owner)->name))
-				continue;
-
-			u = user_find_named(mn->nick);
-			if (u != NULL && u->myuser == mn->owner)
-			{
-				/* still logged in, bleh */
-				mn->lastseen = CURRTIME;
-				mn->owner->lastlogin = CURRTIME;
-				continue;
-			}
-
 			slog(LG_REGISTER, "EXPIRE: \2%s\2 from \2%s\2", mn->nick, entity(mn->owner)->name);
 			slog(LG_VERBOSE, "expire_check(): expiring nick %s (unused %lds, account %s)",
 					mn->nick, (long)(CURRTIME - mn->lastseen),
 					entity(mn->owner)->name);
 			atheme_object_unref(mn);
+			return;
 		}
 	}
 
-	MOWGLI_PATRICIA_FOREACH(mc, &state, mclist)
-	{
-		req.do_expire = 1;
-		req.data.mc = mc;
+	expire_queue_requeue(&mn->expiry);
+}
 
-		hook_call_channel_check_expire(&req);
+static void
+expire_mychan(struct mychan *mc)
+{
+	struct hook_expiry_req req;
 
-		if (!req.do_expire)
-			continue;
+	req.do_expire = 1;
+	req.data.mc = mc;
+
+	hook_call_channel_check_expire(&req);
+
+	if (!req.do_expire)
+	{
+		expire_queue_requeue(&mc->expiry);
+		return;
+	}
 
-		if ((unsigned int) (CURRTIME - mc->used) >= (SECONDS_PER_DAY - SECONDS_PER_HOUR - SECONDS_PER_MINUTE))
+	if ((unsigned int) (CURRTIME - mc->used) >= EXPIRE_USED_REFRESH)
+	{
+		/* keep last used time accurate to
+		 * within a day, making sure an active
+		 * channel will never get "Last used"
+		 * in /cs info -- jilles */
+		if (mychan_isused(mc))
 		{
-			/* keep last used time accurate to
-			 * within a day, making sure an active
-			 * channel will never get "Last used"
-			 * in /cs info -- jilles */
-			if (mychan_isused(mc))
-			{
-				mc->used = CURRTIME;
-				slog(LG_DEBUG, "expire_check(): updating last used time on %s because it appears to be still in use", mc->name);
-				continue;
-			}
+			db_modifying(mc);
+			mc->used = CURRTIME;
+			slog(LG_DEBUG, "expire_check(): updating last used time on %s because it appears to be still in use", mc->name);
+			expire_queue_requeue(&mc->expiry);
+			return;
 		}
+	}
 
-		if (chansvs.expiry > 0 && mc->used < CURRTIME &&
-				(unsigned int)(CURRTIME - mc->used) >= chansvs.expiry)
-		{
-			if (MC_HOLD & mc->flags)
-				continue;
+	if (chansvs.expiry > 0 && mc->used < CURRTIME &&
+			(unsigned int)(CURRTIME - mc->used) >= chansvs.expiry &&
+			!(MC_HOLD & mc->flags))
+	{
+		slog(LG_REGISTER, "EXPIRE: \2%s\2 from \2%s\2", mc->name, mychan_founder_names(mc));
+		slog(LG_VERBOSE, "expire_check(): expiring channel %s (unused %lds, founder %s, chanacs %zu)",
+				mc->name, (long)(CURRTIME - mc->used),
+				mychan_founder_names(mc),
+				MOWGLI_LIST_LENGTH(&mc->chanacs));
 
-			slog(LG_REGISTER, "EXPIRE: \2%s\2 from \2%s\2", mc->name, mychan_founder_names(mc));
-			slog(LG_VERBOSE, "expire_check(): expiring channel %s (unused %lds, founder %s, chanacs %zu)",
-					mc->name, (long)(CURRTIME - mc->used),
-					mychan_founder_names(mc),
-					MOWGLI_LIST_LENGTH(&mc->chanacs));
+		hook_call_channel_drop(mc);
+		if (mc->chan != NULL && !(mc->chan->flags & CHAN_LOG))
+			part(mc->name, chansvs.nick);
 
-			hook_call_channel_drop(mc);
-			if (mc->chan != NULL && !(mc->chan->flags & CHAN_LOG))
-				part(mc->name, chansvs.nick);
+		atheme_object_unref(mc);
+		return;
+	}
 
-			atheme_object_unref(mc);
+	expire_queue_requeue(&mc->expiry);
+}
+
+/* handle at most budget due objects; returns whether more are due */
+static bool
+expire_queue_run(size_t budget)
+{
+	struct expiry_node *node;
+
+	while (expire_queue_len > 0 && expire_queue[0]->due <= CURRTIME)
+	{
+		if (! budget--)
+			return true;
+
+		node = expire_queue[0];
+		expire_queue_remove(node);
+
+		switch (node->type)
+		{
+			case EXPIRY_ACCOUNT:
+				expire_myuser(node->owner);
+				break;
+			case EXPIRY_NICK:
+				expire_mynick(node->owner);
+				break;
+			case EXPIRY_CHANNEL:
+				expire_mychan(node->owner);
+				break;
 		}
 	}
+
+	return false;
+}
+
+/* expire everything that is due right now, e.g. before an UPDATE */
+void
+expire_check(void *arg)
+{
+	/* Let them know about this and the likely subsequent db_save()
+	 * right away -- jilles */
+	if (curr_uplink != NULL && curr_uplink->conn != NULL)
+		sendq_flush(curr_uplink->conn);
+
+	(void) expire_queue_run(SIZE_MAX);
+}
+
+static void
+expire_check_batch(void *arg)
+{
+	expire_batch_timer = NULL;
+
+	if (expire_queue_run(EXPIRE_BATCH))
+		expire_batch_timer = mowgli_timer_add_once(base_eventloop, "expire_check_batch", expire_check_batch, NULL, 0);
+}
+
+/* periodic timer: work through due objects a batch per event loop pass */
+void
+expire_check_slice(void *arg)
+{
+	/* still working through the previous backlog */
+	if (expire_batch_timer != NULL)
+		return;
+
+	expire_check_batch(NULL);
 }
 
 static int
@@ -2211,6 +2603,45 @@ db_check(void)
 	myentity_foreach_t(ENT_USER, check_myuser_cb, NULL);
 }
 
+/*
+ * db_modifying(void *target)
+ *
+ * Call this before changing an account or channel, or anything saved
+ * along with it, so that a save in progress can write out how it was.
+ * Objects are told apart by their destructor; a nick or chanacs stands
+ * for the account or channel it belongs to, and anything else is ignored.
+ * atheme_object_dispose() and the metadata functions call this for every
+ * object they touch.
+ *
+ * Inputs:
+ *      - an account, nick, channel or chanacs, or any other object
+ *
+ * Outputs:
+ *      - nothing
+ *
+ * Side Effects:
+ *      - the database backend may write the account or channel out
+ */
+void
+db_modifying(void *target)
+{
+	atheme_object_destructor_fn destructor;
+
+	if (db_modify == NULL || target == NULL)
+		return;
+
+	destructor = atheme_object(target)->destructor;
+
+	if (destructor == (atheme_object_destructor_fn) myuser_delete)
+		db_modify(target, NULL);
+	else if (destructor == (atheme_object_destructor_fn) mynick_delete)
+		db_modify(((struct mynick *) target)->owner, NULL);
+	else if (destructor == (atheme_object_destructor_fn) mychan_delete)
+		db_modify(NULL, target);
+	else if (destructor == (atheme_object_destructor_fn) chanacs_delete)
+		db_modify(NULL, ((struct chanacs *) target)->mychan);
+}
+
 /* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
  * vim:ts=8
  * vim:sw=8
@@ -0,0 +1,361 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * atheme-services: A collection of minimalist IRC services
+ * accountindex.c: Secondary indexes over accounts
+ *
+ * Accounts are indexed by canonical email address, and kept in two lists
+ * ordered by registration time and by last login time, so that searches
+ * on those (NickServ LIST and LISTMAIL, the per-address registration limit)
+ * do not have to look at every account.
+ *
+ * An account is filed in a time list under the value its timestamp had
+ * when it was filed. Last login times only ever move forward while services
+ * is running, and registration times do not change at all (except through
+ * myuser_index_update()), so the filed value is never later than the real
+ * one. A walk over "everything before T" therefore sees every account it
+ * should, checks the real value, and re-files the accounts that turn out
+ * to have moved; nothing else needs to tell the index about a login.
+ */
+
+#include <atheme.h>
+#include "internal.h"
+
+static mowgli_patricia_t *myuser_email_index = NULL;
+static mowgli_list_t myuser_time_index[MYUSER_INDEX_ORDER_COUNT];
+static bool myuser_time_index_sorted[MYUSER_INDEX_ORDER_COUNT] = { true, true };
+
+static inline mowgli_node_t *
+myuser_index_node(struct myuser *const mu, const enum myuser_index_order order)
+{
+	return (order == MYUSER_INDEX_REGISTERED) ? &mu->index.registered : &mu->index.lastlogin;
+}
+
+static inline time_t
+myuser_index_filed(const struct myuser *const mu, const enum myuser_index_order order)
+{
+	return (order == MYUSER_INDEX_REGISTERED) ? mu->index.registered_ts : mu->index.lastlogin_ts;
+}
+
+static inline time_t
+myuser_index_actual(const struct myuser *const mu, const enum myuser_index_order order)
+{
+	return (order == MYUSER_INDEX_REGISTERED) ? mu->registered : mu->lastlogin;
+}
+
+/* File an account (which must not currently be in the list) under its
+ * current timestamp. New values are nearly always the latest, so look
+ * for the place from the end.
+ */
+static void
+myuser_index_file(struct myuser *const mu, const enum myuser_index_order order)
+{
+	mowgli_list_t *const list = &myuser_time_index[order];
+	mowgli_node_t *const node = myuser_index_node(mu, order);
+	const time_t ts = myuser_index_actual(mu, order);
+	mowgli_node_t *n;
+
+	if (order == MYUSER_INDEX_REGISTERED)
+		mu->index.registered_ts = ts;
+	else
+		mu->index.lastlogin_ts = ts;
+
+	/* the database loader fills in the timestamps after creating the
+	 * account; everything is sorted in one go afterwards */
+	if (runflags & RF_STARTING)
+		myuser_time_index_sorted[order] = false;
+
+	if (! myuser_time_index_sorted[order])
+	{
+		mowgli_node_add(mu, node, list);
+		return;
+	}
+
+	// new accounts have not logged in yet, and go straight to the front
+	if (list->head != NULL && myuser_index_filed(list->head->data, order) >= ts)
+	{
+		mowgli_node_add_head(mu, node, list);
+		return;
+	}
+
+	for (n = list->tail; n != NULL && myuser_index_filed(n->data, order) > ts; n = n->prev)
+		;
+
+	if (n != NULL)
+		mowgli_node_add_after(mu, node, list, n);
+	else
+		mowgli_node_add_head(mu, node, list);
+}
+
+static int
+myuser_index_compare_registered(const void *const a, const void *const b)
+{
+	const time_t ta = (*(struct myuser *const *) a)->index.registered_ts;
+	const time_t tb = (*(struct myuser *const *) b)->index.registered_ts;
+
+	return (ta > tb) - (ta < tb);
+}
+
+static int
+myuser_index_compare_lastlogin(const void *const a, const void *const b)
+{
+	const time_t ta = (*(struct myuser *const *) a)->index.lastlogin_ts;
+	const time_t tb = (*(struct myuser *const *) b)->index.lastlogin_ts;
+
+	return (ta > tb) - (ta < tb);
+}
+
+static void
+myuser_index_sort(const enum myuser_index_order order)
+{
+	mowgli_list_t *const list = &myuser_time_index[order];
+	const size_t count = MOWGLI_LIST_LENGTH(list);
+	mowgli_node_t *n, *tn;
+	size_t i = 0;
+
+	if (! count)
+	{
+		myuser_time_index_sorted[order] = true;
+		return;
+	}
+
+	struct myuser **const accounts = smalloc(count * sizeof *accounts);
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, list->head)
+	{
+		struct myuser *const mu = n->data;
+
+		if (order == MYUSER_INDEX_REGISTERED)
+			mu->index.registered_ts = mu->registered;
+		else
+			mu->index.lastlogin_ts = mu->lastlogin;
+
+		mowgli_node_delete(n, list);
+		accounts[i++] = mu;
+	}
+
+	qsort(accounts, count, sizeof *accounts, (order == MYUSER_INDEX_REGISTERED) ?
+	      &myuser_index_compare_registered : &myuser_index_compare_lastlogin);
+
+	for (i = 0; i < count; i++)
+		mowgli_node_add(accounts[i], myuser_index_node(accounts[i], order), list);
+
+	sfree(accounts);
+
+	myuser_time_index_sorted[order] = true;
+}
+
+void
+myuser_index_init(void)
+{
+	myuser_email_index = mowgli_patricia_create(NULL);
+}
+
+void
+myuser_index_email_add(struct myuser *const mu)
+{
+	mowgli_list_t *accounts;
+
+	if (mu->email_canonical == NULL)
+		return;
+
+	if ((accounts = mowgli_patricia_retrieve(myuser_email_index, mu->email_canonical)) == NULL)
+	{
+		accounts = smalloc(sizeof *accounts);
+		mowgli_patricia_add(myuser_email_index, mu->email_canonical, accounts);
+	}
+
+	mowgli_node_add(mu, &mu->index.email, accounts);
+}
+
+void
+myuser_index_email_delete(struct myuser *const mu)
+{
+	mowgli_list_t *accounts;
+
+	if (mu->email_canonical == NULL)
+		return;
+
+	if ((accounts = mowgli_patricia_retrieve(myuser_email_index, mu->email_canonical)) == NULL)
+		return;
+
+	mowgli_node_delete(&mu->index.email, accounts);
+
+	if (MOWGLI_LIST_LENGTH(accounts) == 0)
+	{
+		mowgli_patricia_delete(myuser_email_index, mu->email_canonical);
+		sfree(accounts);
+	}
+}
+
+void
+myuser_index_add(struct myuser *const mu)
+{
+	myuser_index_email_add(mu);
+	myuser_index_file(mu, MYUSER_INDEX_REGISTERED);
+	myuser_index_file(mu, MYUSER_INDEX_LASTLOGIN);
+}
+
+void
+myuser_index_delete(struct myuser *const mu)
+{
+	myuser_index_email_delete(mu);
+	mowgli_node_delete(&mu->index.registered, &myuser_time_index[MYUSER_INDEX_REGISTERED]);
+	mowgli_node_delete(&mu->index.lastlogin, &myuser_time_index[MYUSER_INDEX_LASTLOGIN]);
+}
+
+/*
+ * myuser_index_update(struct myuser *mu)
+ *
+ * Re-files an account in the time indexes. This only needs to be called
+ * after setting the registration time of an existing account, or moving
+ * its last login time backwards.
+ *
+ * Inputs:
+ *      - account whose timestamps have changed
+ *
+ * Outputs:
+ *      - nothing
+ *
+ * Side Effects:
+ *      - the account is moved within the time indexes
+ */
+void
+myuser_index_update(struct myuser *const mu)
+{
+	return_if_fail(mu != NULL);
+
+	for (unsigned int i = 0; i < MYUSER_INDEX_ORDER_COUNT; i++)
+	{
+		const enum myuser_index_order order = (enum myuser_index_order) i;
+
+		if (myuser_index_filed(mu, order) == myuser_index_actual(mu, order))
+			continue;
+
+		mowgli_node_delete(myuser_index_node(mu, order), &myuser_time_index[order]);
+		myuser_index_file(mu, order);
+	}
+}
+
+/*
+ * myuser_index_rebuild()
+ *
+ * Sorts the time indexes from scratch. Called once after the database has
+ * been loaded.
+ */
+void
+myuser_index_rebuild(void)
+{
+	myuser_index_sort(MYUSER_INDEX_REGISTERED);
+	myuser_index_sort(MYUSER_INDEX_LASTLOGIN);
+}
+
+/*
+ * myuser_index_email(stringref email_canonical)
+ *
+ * Finds the accounts with a given canonical email address.
+ *
+ * Inputs:
+ *      - canonical email address, as returned by canonicalize_email()
+ *
+ * Outputs:
+ *      - list of struct myuser (node->data), or NULL if there are none;
+ *        it must not be modified
+ */
+const mowgli_list_t *
+myuser_index_email(const char *const email_canonical)
+{
+	return_val_if_fail(email_canonical != NULL, NULL);
+
+	return mowgli_patricia_retrieve(myuser_email_index, email_canonical);
+}
+
+/*
+ * myuser_index_count_before(enum myuser_index_order order, time_t before, size_t limit)
+ *
+ * Estimates how many accounts have a registration or last login time
+ * before a given time, without looking at more than limit of them. This
+ * can overestimate (for accounts that have logged in since they were last
+ * looked at), never underestimate.
+ *
+ * Outputs:
+ *      - the estimate, or limit if there are at least that many
+ */
+size_t
+myuser_index_count_before(const enum myuser_index_order order, const time_t before, const size_t limit)
+{
+	mowgli_node_t *n;
+	size_t count = 0;
+
+	if (! myuser_time_index_sorted[order])
+		myuser_index_sort(order);
+
+	MOWGLI_ITER_FOREACH(n, myuser_time_index[order].head)
+	{
+		if (count >= limit || myuser_index_filed(n->data, order) >= before)
+			break;
+
+		count++;
+	}
+
+	return count;
+}
+
+/*
+ * myuser_index_foreach_before(enum myuser_index_order order, time_t before,
+ *     int (*cb)(struct myuser *mu, void *privdata), void *privdata)
+ *
+ * Calls a function for every account with a registration or last login
+ * time before a given time, earliest first. Iteration stops early if the
+ * function returns nonzero. The function must not delete accounts.
+ *
+ * Outputs:
+ *      - nothing
+ *
+ * Side Effects:
+ *      - accounts that have logged in since they were last looked at are
+ *        re-filed under their current last login time
+ */
+void
+myuser_index_foreach_before(const enum myuser_index_order order, const time_t before,
+                            int (*const cb)(struct myuser *mu, void *privdata), void *const privdata)
+{
+	mowgli_list_t *const list = &myuser_time_index[order];
+	mowgli_list_t moved = { NULL, NULL, 0 };
+	mowgli_node_t *n, *tn;
+
+	return_if_fail(cb != NULL);
+
+	if (! myuser_time_index_sorted[order])
+		myuser_index_sort(order);
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, list->head)
+	{
+		struct myuser *const mu = n->data;
+
+		if (myuser_index_filed(mu, order) >= before)
+			break;
+
+		if (myuser_index_actual(mu, order) >= before)
+		{
+			/* re-filed below, after the walk, so it is not seen twice */
+			mowgli_node_delete(n, list);
+			mowgli_node_add(mu, n, &moved);
+			continue;
+		}
+
+		if (cb(mu, privdata) != 0)
+			break;
+	}
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, moved.head)
+	{
+		struct myuser *const mu = n->data;
+
+		mowgli_node_delete(n, &moved);
+		myuser_index_file(mu, order);
+	}
+}
@@ -60,6 +60,8 @@ bool database_create = false;
 
 void (*db_save) (void *arg, enum db_save_strategy strategy) = NULL;
 void (*db_load) (const char *name) = NULL;
+void (*db_modify) (struct myuser *mu, struct mychan *mc) = NULL;
+unsigned int db_save_gen = 0;
 
 /* *INDENT-OFF* */
 static void
@@ -315,6 +317,8 @@ atheme_setup(void)
 	init_confprocess();
 	init_newconf();
 	servtree_init();
+	metrics_init();
+	loopstats_init();
 
 	register_email_canonicalizer(canonicalize_email_case, NULL);
 
@@ -322,6 +326,7 @@ atheme_setup(void)
 	pcommand_init();
 
 	authcookie_init();
+	auth_init();
 	common_ctcp_init();
 }
 
@@ -488,6 +493,8 @@ atheme_main(int argc, char *argv[])
 		exit(EXIT_FAILURE);
 	}
 	db_check();
+	expire_queue_rebuild();
+	myuser_index_rebuild();
 
 	if (db_save && database_create)
 	{
@@ -529,8 +536,8 @@ atheme_main(int argc, char *argv[])
 	if (db_save && !readonly)
 		mowgli_timer_add(base_eventloop, "db_save", db_save_periodic, NULL, config_options.commit_interval);
 
-	/* check expires every hour */
-	mowgli_timer_add(base_eventloop, "expire_check", expire_check, NULL, SECONDS_PER_HOUR);
+	/* check account, nick and channel expires every minute */
+	mowgli_timer_add(base_eventloop, "expire_check", expire_check_slice, NULL, SECONDS_PER_MINUTE);
 
 	/* check k/x/q line expires every minute */
 	mowgli_timer_add(base_eventloop, "kline_expire", kline_expire, NULL, SECONDS_PER_MINUTE);
@@ -540,6 +547,9 @@ atheme_main(int argc, char *argv[])
 	/* check authcookie expires every ten minutes */
 	mowgli_timer_add(base_eventloop, "authcookie_expire", authcookie_expire, NULL, 10 * SECONDS_PER_MINUTE);
 
+	/* deliver any mail left in the spool by a previous run */
+	mailqueue_init();
+
 	me.connected = false;
 	uplink_connect();
 
@@ -16,8 +16,56 @@
 #include <atheme.h>
 #include "internal.h"
 
+struct auth_request
+{
+	mowgli_node_t           node;
+	struct sourceinfo *     si;
+	struct myuser *         mu;
+	auth_verify_fn          cb;
+	void *                  priv;
+	bool                    cancelled;
+};
+
 bool auth_module_loaded = false;
 bool (*auth_user_custom)(struct myuser *mu, const char *password) ATHEME_FATTR_WUR;
+void (*auth_user_custom_async)(struct auth_request *req, struct myuser *mu, const char *password);
+
+static mowgli_list_t auth_requests;
+
+static void
+auth_cancel_user(struct user *const restrict u)
+{
+	mowgli_node_t *n;
+
+	MOWGLI_ITER_FOREACH(n, auth_requests.head)
+	{
+		struct auth_request *const req = n->data;
+
+		if (req->si->su == u)
+			req->cancelled = true;
+	}
+}
+
+static void
+auth_cancel_myuser(struct myuser *const restrict mu)
+{
+	mowgli_node_t *n;
+
+	MOWGLI_ITER_FOREACH(n, auth_requests.head)
+	{
+		struct auth_request *const req = n->data;
+
+		if (req->mu == mu)
+			req->cancelled = true;
+	}
+}
+
+void
+auth_init(void)
+{
+	(void) hook_add_user_delete(&auth_cancel_user);
+	(void) hook_add_myuser_delete(&auth_cancel_myuser);
+}
 
 void
 set_password(struct myuser *const restrict mu, const char *const restrict password)
@@ -27,6 +75,7 @@ set_password(struct myuser *const restrict mu, const char *const restrict passwo
 
 	const char *const hash = crypt_password(password);
 
+	(void) db_modifying(mu);
 	(void) smemzero(mu->pass, sizeof mu->pass);
 
 	if (hash)
@@ -90,6 +139,7 @@ verify_password(struct myuser *const restrict mu, const char *const restrict pas
 	}
 	else
 	{
+		(void) db_modifying(mu);
 		(void) smemzero(mu->pass, sizeof mu->pass);
 		(void) mowgli_strlcpy(mu->pass, new_hash, sizeof mu->pass);
 	}
@@ -97,3 +147,77 @@ verify_password(struct myuser *const restrict mu, const char *const restrict pas
 	// Verification succeeded and user's password (possibly) re-encrypted
 	return true;
 }
+
+/* Like verify_password(), but lets an auth module that talks to a remote
+ * server answer later from the event loop instead of blocking services.
+ * Without such a module, the callback runs before this function returns.
+ */
+void
+verify_password_async(struct sourceinfo *const restrict si, struct myuser *const restrict mu,
+                      const char *const restrict password, const auth_verify_fn cb, void *const restrict priv)
+{
+	return_if_fail(si != NULL);
+	return_if_fail(mu != NULL);
+	return_if_fail(cb != NULL);
+
+	if (! password || ! auth_module_loaded || ! auth_user_custom_async)
+	{
+		(void) cb(si, mu, verify_password(mu, password) ? AUTH_VERDICT_VERIFIED : AUTH_VERDICT_REJECTED, priv);
+		return;
+	}
+
+	struct auth_request *const req = smalloc(sizeof *req);
+
+	req->si = atheme_object_ref(si);
+	req->mu = mu;
+	req->cb = cb;
+	req->priv = priv;
+
+	(void) mowgli_node_add(req, &req->node, &auth_requests);
+	(void) auth_user_custom_async(req, mu, password);
+}
+
+// Cancels the in-flight requests that would call cb, for a module being unloaded.
+void
+auth_cancel_callback(const auth_verify_fn cb)
+{
+	mowgli_node_t *n;
+
+	MOWGLI_ITER_FOREACH(n, auth_requests.head)
+	{
+		struct auth_request *const req = n->data;
+
+		if (req->cb == cb)
+			req->cancelled = true;
+	}
+}
+
+bool ATHEME_FATTR_WUR
+auth_request_pending(const struct user *const restrict u)
+{
+	mowgli_node_t *n;
+
+	MOWGLI_ITER_FOREACH(n, auth_requests.head)
+	{
+		const struct auth_request *const req = n->data;
+
+		if (req->si->su == u && ! req->cancelled)
+			return true;
+	}
+
+	return false;
+}
+
+void
+auth_request_complete(struct auth_request *const restrict req, const enum auth_verdict verdict)
+{
+	return_if_fail(req != NULL);
+
+	(void) mowgli_node_delete(&req->node, &auth_requests);
+
+	if (! req->cancelled)
+		(void) req->cb(req->si, req->mu, verdict, req->priv);
+
+	(void) atheme_object_unref(req->si);
+	(void) sfree(req);
+}
@@ -17,12 +17,12 @@
 #include "internal.h"
 
 static mowgli_list_t authcookie_list;
-static mowgli_heap_t *authcookie_heap = NULL;
+static struct sharedheap *authcookie_heap = NULL;
 
 void
 authcookie_init(void)
 {
-	authcookie_heap = sharedheap_get(sizeof(struct authcookie));
+	authcookie_heap = sharedheap_get("authcookie", sizeof(struct authcookie));
 
 	if (!authcookie_heap)
 	{
@@ -46,7 +46,7 @@ authcookie_init(void)
 struct authcookie *
 authcookie_create(struct myuser *mu)
 {
-	struct authcookie *const au = mowgli_heap_alloc(authcookie_heap);
+	struct authcookie *const au = sharedheap_alloc(authcookie_heap);
 	au->ticket = random_string(AUTHCOOKIE_LENGTH);
 	au->myuser = mu;
 	au->expire = CURRTIME + SECONDS_PER_HOUR;
@@ -129,9 +129,11 @@ authcookie_destroy(struct authcookie * ac)
 {
 	return_if_fail(ac != NULL);
 
+	hook_call_authcookie_destroy(ac);
+
 	mowgli_node_delete(&ac->node, &authcookie_list);
 	sfree(ac->ticket);
-	mowgli_heap_free(authcookie_heap, ac);
+	sharedheap_free(authcookie_heap, ac);
 }
 
 /*
@@ -29,6 +29,439 @@ static const unsigned char inverse_alphabet_default[] = {
 	0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
 };
 
+/* Vectorised kernels for the bulk of the input. They work with any alphabet (the 64-entry table is
+ * looked up 16 entries at a time) and only ever process whole blocks of plain alphabet characters;
+ * each returns how much input it consumed (a multiple of 3 bytes or 4 characters), and the scalar
+ * code below handles the rest, including whitespace, padding and any invalid input, exactly as before.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ >= 5)))
+#  define BASE64_HAVE_X86_SIMD      1
+#  define BASE64_SSSE3_TARGET       __attribute__((target("ssse3")))
+#  define BASE64_SSSE3_INLINE       __attribute__((always_inline))
+#  define BASE64_AVX2_TARGET        __attribute__((target("avx2")))
+#  include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#  define BASE64_HAVE_NEON          1
+#  include <arm_neon.h>
+#endif
+
+typedef size_t (*base64_encode_kernel_fn)(const unsigned char *restrict, size_t, char *restrict, size_t,
+                                          const char *restrict);
+
+typedef size_t (*base64_decode_kernel_fn)(const char *restrict, size_t, unsigned char *restrict, size_t,
+                                          const unsigned char *restrict);
+
+static enum base64_kernel base64_kernel = BASE64_KERNEL_PORTABLE;
+static base64_encode_kernel_fn base64_encode_kernel = NULL;
+static base64_decode_kernel_fn base64_decode_kernel = NULL;
+static bool base64_kernel_selected = false;
+
+#ifdef BASE64_HAVE_X86_SIMD
+
+/* Spread 12 input bytes (in the low 12 bytes of the register) into 16 6-bit alphabet indices.
+ * Each 32-bit lane receives input bytes [1, 0, 2, 1] and the multiplies move every 6-bit field
+ * into its own byte in output order.
+ */
+static inline __m128i BASE64_SSSE3_TARGET
+base64_ssse3_split(const __m128i in)
+{
+	const __m128i shuf = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+	const __m128i ac = _mm_mulhi_epu16(_mm_and_si128(shuf, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+	const __m128i bd = _mm_mullo_epi16(_mm_and_si128(shuf, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+
+	return _mm_or_si128(ac, bd);
+}
+
+// Look up every byte of idx (which must all be below 16 * n) in an n * 16-entry table
+static inline __m128i BASE64_SSSE3_TARGET
+base64_ssse3_lookup(const __m128i *const restrict tbl, const unsigned int n, const __m128i idx)
+{
+	const __m128i lo = _mm_and_si128(idx, _mm_set1_epi8(0x0F));
+	const __m128i hi = _mm_and_si128(_mm_srli_epi16(idx, 0x04), _mm_set1_epi8(0x0F));
+
+	__m128i res = _mm_setzero_si128();
+
+	for (unsigned int i = 0; i < n; i++)
+	{
+		const __m128i sel = _mm_cmpeq_epi8(hi, _mm_set1_epi8((char) i));
+
+		res = _mm_or_si128(res, _mm_and_si128(sel, _mm_shuffle_epi8(tbl[i], lo)));
+	}
+
+	return res;
+}
+
+/* Pack 16 6-bit values into 12 bytes (in the low 12 bytes of the register). Each 32-bit lane is
+ * merged to a 24-bit big-endian group and then byte-swapped into place.
+ */
+static inline __m128i BASE64_SSSE3_TARGET
+base64_ssse3_pack(const __m128i val)
+{
+	const __m128i pairs = _mm_maddubs_epi16(val, _mm_set1_epi32(0x01400140));
+	const __m128i quads = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+
+	return _mm_shuffle_epi8(quads, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+static inline size_t BASE64_SSSE3_INLINE BASE64_SSSE3_TARGET
+base64_encode_ssse3(const unsigned char *const restrict src, const size_t src_len, char *const restrict dst,
+                    const size_t dst_len, const char *const restrict alphabet)
+{
+	__m128i tbl[4];
+	size_t done = 0;
+	size_t written = 0;
+
+	for (unsigned int i = 0; i < 4; i++)
+		tbl[i] = _mm_loadu_si128((const void *) (alphabet + (i * 16U)));
+
+	// The load reads 16 bytes to use 12 of them
+	while ((src_len - done) >= 16 && (dst_len - written) >= 16)
+	{
+		const __m128i idx = base64_ssse3_split(_mm_loadu_si128((const void *) (src + done)));
+
+		(void) _mm_storeu_si128((void *) (dst + written), base64_ssse3_lookup(tbl, 4, idx));
+
+		done += 12;
+		written += 16;
+	}
+
+	return done;
+}
+
+static inline size_t BASE64_SSSE3_INLINE BASE64_SSSE3_TARGET
+base64_decode_ssse3(const char *const restrict src, const size_t src_len, unsigned char *const restrict dst,
+                    const size_t dst_len, const unsigned char *const restrict inverse_alphabet)
+{
+	__m128i tbl[8];
+	size_t done = 0;
+	size_t written = 0;
+
+	for (unsigned int i = 0; i < 8; i++)
+		tbl[i] = _mm_loadu_si128((const void *) (inverse_alphabet + (i * 16U)));
+
+	while ((src_len - done) >= 16 && (dst_len - written) >= 12)
+	{
+		const __m128i chr = _mm_loadu_si128((const void *) (src + done));
+		const __m128i val = base64_ssse3_lookup(tbl, 8, chr);
+
+		// Non-ASCII input, padding, whitespace and invalid characters all have their high bit set
+		if (_mm_movemask_epi8(_mm_or_si128(chr, val)) != 0)
+			break;
+
+		const __m128i out = base64_ssse3_pack(val);
+		const uint32_t tail = (uint32_t) _mm_cvtsi128_si32(_mm_srli_si128(out, 8));
+
+		(void) _mm_storel_epi64((void *) (dst + written), out);
+		(void) memcpy(dst + written + 8, &tail, sizeof tail);
+
+		done += 16;
+		written += 12;
+	}
+
+	return done;
+}
+
+/* The AVX2 kernels are the SSSE3 ones with a 12-byte (16-character) group in each 128-bit lane.
+ * They finish with the SSSE3 loop, which must be inlined (and so VEX-encoded): calling the legacy
+ * SSE version with the upper halves of the registers dirty costs more than the whole small input.
+ */
+static inline __m256i BASE64_AVX2_TARGET
+base64_avx2_lookup(const __m256i *const restrict tbl, const unsigned int n, const __m256i idx)
+{
+	const __m256i lo = _mm256_and_si256(idx, _mm256_set1_epi8(0x0F));
+	const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(idx, 0x04), _mm256_set1_epi8(0x0F));
+
+	__m256i res = _mm256_setzero_si256();
+
+	for (unsigned int i = 0; i < n; i++)
+	{
+		const __m256i sel = _mm256_cmpeq_epi8(hi, _mm256_set1_epi8((char) i));
+
+		res = _mm256_or_si256(res, _mm256_and_si256(sel, _mm256_shuffle_epi8(tbl[i], lo)));
+	}
+
+	return res;
+}
+
+static size_t BASE64_AVX2_TARGET
+base64_encode_avx2(const unsigned char *const restrict src, const size_t src_len, char *const restrict dst,
+                   const size_t dst_len, const char *const restrict alphabet)
+{
+	__m256i tbl[4];
+	size_t done = 0;
+	size_t written = 0;
+
+	for (unsigned int i = 0; i < 4; i++)
+		tbl[i] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const void *) (alphabet + (i * 16U))));
+
+	// The second load reads 16 bytes at offset 12 to use 12 of them
+	while ((src_len - done) >= 28 && (dst_len - written) >= 32)
+	{
+		const __m128i lo = _mm_loadu_si128((const void *) (src + done));
+		const __m128i hi = _mm_loadu_si128((const void *) (src + done + 12));
+		const __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+		const __m256i shuf = _mm256_shuffle_epi8(in, _mm256_setr_epi8(
+		    1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+		    1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+
+		const __m256i ac = _mm256_mulhi_epu16(_mm256_and_si256(shuf, _mm256_set1_epi32(0x0FC0FC00)),
+		                                      _mm256_set1_epi32(0x04000040));
+		const __m256i bd = _mm256_mullo_epi16(_mm256_and_si256(shuf, _mm256_set1_epi32(0x003F03F0)),
+		                                      _mm256_set1_epi32(0x01000010));
+
+		const __m256i idx = _mm256_or_si256(ac, bd);
+
+		(void) _mm256_storeu_si256((void *) (dst + written), base64_avx2_lookup(tbl, 4, idx));
+
+		done += 24;
+		written += 32;
+	}
+
+	return done + base64_encode_ssse3(src + done, src_len - done, dst + written, dst_len - written, alphabet);
+}
+
+static size_t BASE64_AVX2_TARGET
+base64_decode_avx2(const char *const restrict src, const size_t src_len, unsigned char *const restrict dst,
+                   const size_t dst_len, const unsigned char *const restrict inverse_alphabet)
+{
+	__m256i tbl[8];
+	size_t done = 0;
+	size_t written = 0;
+
+	for (unsigned int i = 0; i < 8; i++)
+		tbl[i] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const void *) (inverse_alphabet + (i * 16U))));
+
+	while ((src_len - done) >= 32 && (dst_len - written) >= 24)
+	{
+		const __m256i chr = _mm256_loadu_si256((const void *) (src + done));
+		const __m256i val = base64_avx2_lookup(tbl, 8, chr);
+
+		if (_mm256_movemask_epi8(_mm256_or_si256(chr, val)) != 0)
+			break;
+
+		const __m256i pairs = _mm256_maddubs_epi16(val, _mm256_set1_epi32(0x01400140));
+		const __m256i quads = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+		const __m256i lanes = _mm256_shuffle_epi8(quads, _mm256_setr_epi8(
+		    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+		    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+		// Close the gap between the two 12-byte halves
+		const __m256i out = _mm256_permutevar8x32_epi32(lanes, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+
+		(void) _mm_storeu_si128((void *) (dst + written), _mm256_castsi256_si128(out));
+		(void) _mm_storel_epi64((void *) (dst + written + 16), _mm256_extracti128_si256(out, 1));
+
+		done += 32;
+		written += 24;
+	}
+
+	return done + base64_decode_ssse3(src + done, src_len - done, dst + written, dst_len - written,
+	                                  inverse_alphabet);
+}
+
+#endif /* BASE64_HAVE_X86_SIMD */
+
+#ifdef BASE64_HAVE_NEON
+
+// AArch64 has 64-entry table lookups and (de)interleaving loads and stores, so these are direct
+static size_t
+base64_encode_neon(const unsigned char *const restrict src, const size_t src_len, char *const restrict dst,
+                   const size_t dst_len, const char *const restrict alphabet)
+{
+	const uint8x16_t mask = vdupq_n_u8(0x3FU);
+
+	uint8x16x4_t tbl;
+	size_t done = 0;
+	size_t written = 0;
+
+	for (unsigned int i = 0; i < 4; i++)
+		tbl.val[i] = vld1q_u8((const uint8_t *) (alphabet + (i * 16U)));
+
+	while ((src_len - done) >= 48 && (dst_len - written) >= 64)
+	{
+		const uint8x16x3_t in = vld3q_u8(src + done);
+		uint8x16x4_t out;
+
+		out.val[0] = vshrq_n_u8(in.val[0], 2);
+		out.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), mask);
+		out.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), mask);
+		out.val[3] = vandq_u8(in.val[2], mask);
+
+		for (unsigned int i = 0; i < 4; i++)
+			out.val[i] = vqtbl4q_u8(tbl, out.val[i]);
+
+		(void) vst4q_u8((uint8_t *) (dst + written), out);
+
+		done += 48;
+		written += 64;
+	}
+
+	return done;
+}
+
+static size_t
+base64_decode_neon(const char *const restrict src, const size_t src_len, unsigned char *const restrict dst,
+                   const size_t dst_len, const unsigned char *const restrict inverse_alphabet)
+{
+	const uint8x16_t ofs = vdupq_n_u8(0x40U);
+
+	uint8x16x4_t tbl_lo;
+	uint8x16x4_t tbl_hi;
+	size_t done = 0;
+	size_t written = 0;
+
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		tbl_lo.val[i] = vld1q_u8(inverse_alphabet + (i * 16U));
+		tbl_hi.val[i] = vld1q_u8(inverse_alphabet + 64U + (i * 16U));
+	}
+
+	while ((src_len - done) >= 64 && (dst_len - written) >= 48)
+	{
+		const uint8x16x4_t chr = vld4q_u8((const uint8_t *) (src + done));
+		uint8x16_t bad = vdupq_n_u8(0x00U);
+		uint8x16x4_t val;
+		uint8x16x3_t out;
+
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			// Characters 0x00-0x3F hit the first table, 0x40-0x7F the second, and 0x80-0xFF neither
+			val.val[i] = vqtbx4q_u8(vqtbl4q_u8(tbl_lo, chr.val[i]), tbl_hi, vsubq_u8(chr.val[i], ofs));
+			bad = vorrq_u8(bad, vorrq_u8(chr.val[i], val.val[i]));
+		}
+
+		if (vmaxvq_u8(bad) >= 0x80U)
+			break;
+
+		out.val[0] = vorrq_u8(vshlq_n_u8(val.val[0], 2), vshrq_n_u8(val.val[1], 4));
+		out.val[1] = vorrq_u8(vshlq_n_u8(val.val[1], 4), vshrq_n_u8(val.val[2], 2));
+		out.val[2] = vorrq_u8(vshlq_n_u8(val.val[2], 6), val.val[3]);
+
+		(void) vst3q_u8(dst + written, out);
+
+		done += 64;
+		written += 48;
+	}
+
+	return done;
+}
+
+#endif /* BASE64_HAVE_NEON */
+
+static bool
+base64_kernel_supported(const enum base64_kernel kernel)
+{
+	switch (kernel)
+	{
+		case BASE64_KERNEL_PORTABLE:
+			return true;
+
+#ifdef BASE64_HAVE_X86_SIMD
+		case BASE64_KERNEL_SSSE3:
+			return __builtin_cpu_supports("ssse3");
+
+		case BASE64_KERNEL_AVX2:
+			return __builtin_cpu_supports("avx2");
+#endif /* BASE64_HAVE_X86_SIMD */
+
+#ifdef BASE64_HAVE_NEON
+		case BASE64_KERNEL_NEON:
+			// Advanced SIMD is a mandatory part of AArch64
+			return true;
+#endif /* BASE64_HAVE_NEON */
+
+		default:
+			return false;
+	}
+}
+
+bool
+base64_use_kernel(const enum base64_kernel kernel)
+{
+	if (! base64_kernel_supported(kernel))
+		return false;
+
+	switch (kernel)
+	{
+#ifdef BASE64_HAVE_X86_SIMD
+		case BASE64_KERNEL_SSSE3:
+			base64_encode_kernel = &base64_encode_ssse3;
+			base64_decode_kernel = &base64_decode_ssse3;
+			break;
+
+		case BASE64_KERNEL_AVX2:
+			base64_encode_kernel = &base64_encode_avx2;
+			base64_decode_kernel = &base64_decode_avx2;
+			break;
+#endif /* BASE64_HAVE_X86_SIMD */
+
+#ifdef BASE64_HAVE_NEON
+		case BASE64_KERNEL_NEON:
+			base64_encode_kernel = &base64_encode_neon;
+			base64_decode_kernel = &base64_decode_neon;
+			break;
+#endif /* BASE64_HAVE_NEON */
+
+		default:
+			base64_encode_kernel = NULL;
+			base64_decode_kernel = NULL;
+			break;
+	}
+
+	base64_kernel = kernel;
+	base64_kernel_selected = true;
+	return true;
+}
+
+static void
+base64_select_kernel(void)
+{
+	static const enum base64_kernel preference[] = {
+
+		BASE64_KERNEL_AVX2,
+		BASE64_KERNEL_NEON,
+		BASE64_KERNEL_SSSE3,
+	};
+
+	if (base64_kernel_selected)
+		return;
+
+	for (size_t i = 0; i < ARRAY_SIZE(preference); i++)
+		if (base64_use_kernel(preference[i]))
+			return;
+
+	(void) base64_use_kernel(BASE64_KERNEL_PORTABLE);
+}
+
+enum base64_kernel
+base64_get_kernel(void)
+{
+	(void) base64_select_kernel();
+
+	return base64_kernel;
+}
+
+const char *
+base64_kernel_name(const enum base64_kernel kernel)
+{
+	switch (kernel)
+	{
+		case BASE64_KERNEL_PORTABLE:
+			return "portable";
+		case BASE64_KERNEL_SSSE3:
+			return "SSSE3";
+		case BASE64_KERNEL_AVX2:
+			return "AVX2";
+		case BASE64_KERNEL_NEON:
+			return "NEON";
+	}
+
+	return "unknown";
+}
+
 static bool ATHEME_FATTR_WUR
 base64_alphabet_invert(const char alphabet[const restrict static 65],
                        unsigned char inverse_alphabet[const restrict static 128])
@@ -80,11 +513,28 @@ base64_decode_run(const char *restrict src, void *const restrict out, const size
 	size_t src_len = strlen(src);
 	size_t written = 0;
 
+	(void) base64_select_kernel();
+
 	while (src_len != 0)
 	{
 		unsigned char och[4];
 		size_t done;
 
+		if (dst != NULL && base64_decode_kernel != NULL)
+		{
+			/* Every previous group was complete (or we would have stopped), so we are on a group
+			 * boundary; this also resumes the vectorised path after a run of whitespace.
+			 */
+			done = base64_decode_kernel(src, src_len, dst + written, dst_len - written, inverse_alphabet);
+
+			src += done;
+			src_len -= done;
+			written += ((done / 4) * 3);
+
+			if (src_len == 0)
+				break;
+		}
+
 		for (done = 0; done < 4; done++)
 		{
 			while (isspace((int) src[done]))
@@ -219,6 +669,17 @@ base64_encode_run(const void *const restrict in, const size_t in_len, char *cons
 		// Definitely not enough room
 		return BASE64_FAIL;
 
+	(void) base64_select_kernel();
+
+	if (dst != NULL && base64_encode_kernel != NULL)
+	{
+		const size_t done = base64_encode_kernel(src, src_len, dst, dst_len, alphabet);
+
+		src += done;
+		src_len -= done;
+		written = ((done / 3) * 4);
+	}
+
 	while (src_len >= 3)
 	{
 		if (dst != NULL)
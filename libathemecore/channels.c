@@ -18,9 +18,9 @@
 
 mowgli_patricia_t *chanlist;
 
-static mowgli_heap_t *chan_heap = NULL;
-static mowgli_heap_t *chanuser_heap = NULL;
-static mowgli_heap_t *chanban_heap = NULL;
+static struct sharedheap *chan_heap = NULL;
+static struct sharedheap *chanuser_heap = NULL;
+static struct sharedheap *chanban_heap = NULL;
 
 /*
  * init_channels()
@@ -39,9 +39,9 @@ static mowgli_heap_t *chanban_heap = NULL;
 void
 init_channels(void)
 {
-	chan_heap = sharedheap_get(sizeof(struct channel));
-	chanuser_heap = sharedheap_get(sizeof(struct chanuser));
-	chanban_heap = sharedheap_get(sizeof(struct chanban));
+	chan_heap = sharedheap_get("channel", sizeof(struct channel));
+	chanuser_heap = sharedheap_get("chanuser", sizeof(struct chanuser));
+	chanban_heap = sharedheap_get("chanban", sizeof(struct chanban));
 
 	if (chan_heap == NULL || chanuser_heap == NULL || chanban_heap == NULL)
 	{
@@ -96,7 +96,7 @@ channel_add(const char *name, time_t ts, struct server *creator)
 
 	slog(LG_DEBUG, "channel_add(): %s by %s", name, creator->name);
 
-	c = mowgli_heap_alloc(chan_heap);
+	c = sharedheap_alloc(chan_heap);
 
 	c->name = sstrdup(name);
 	c->ts = ts;
@@ -166,7 +166,7 @@ channel_delete(struct channel *c)
 		soft_assert(is_internal_client(cu->user) && !me.connected);
 		mowgli_node_delete(&cu->cnode, &c->members);
 		mowgli_node_delete(&cu->unode, &cu->user->channels);
-		mowgli_heap_free(chanuser_heap, cu);
+		sharedheap_free(chanuser_heap, cu);
 		cnt.chanuser--;
 	}
 	c->nummembers = 0;
@@ -187,7 +187,7 @@ channel_delete(struct channel *c)
 	sfree(c->topic);
 	sfree(c->topic_setter);
 
-	mowgli_heap_free(chan_heap, c);
+	sharedheap_free(chan_heap, c);
 
 	cnt.chan--;
 }
@@ -234,7 +234,7 @@ chanban_add(struct channel *chan, const char *mask, int type)
 
 	slog(LG_DEBUG, "chanban_add(): %s +%c %s", chan->name, type, mask);
 
-	c = mowgli_heap_alloc(chanban_heap);
+	c = sharedheap_alloc(chanban_heap);
 
 	c->chan = chan;
 	c->mask = sstrdup(mask);
@@ -267,7 +267,7 @@ chanban_delete(struct chanban * c)
 	mowgli_node_delete(&c->node, &c->chan->bans);
 
 	sfree(c->mask);
-	mowgli_heap_free(chanban_heap, c);
+	sharedheap_free(chanban_heap, c);
 }
 
 /*
@@ -390,7 +390,7 @@ chanuser_add(struct channel *chan, const char *nick)
 
 	slog(LG_DEBUG, "chanuser_add(): %s -> %s", chan->name, u->nick);
 
-	cu = mowgli_heap_alloc(chanuser_heap);
+	cu = sharedheap_alloc(chanuser_heap);
 
 	cu->chan = chan;
 	cu->user = u;
@@ -454,7 +454,7 @@ chanuser_delete(struct channel *chan, struct user *user)
 	mowgli_node_delete(&cu->cnode, &chan->members);
 	mowgli_node_delete(&cu->unode, &user->channels);
 
-	mowgli_heap_free(chanuser_heap, cu);
+	sharedheap_free(chanuser_heap, cu);
 
 	chan->nummembers--;
 	cnt.chanuser--;
@@ -328,6 +328,12 @@ channel_mode(struct user *source, struct channel *chan, int parc, char *parv[])
 
 						hook_call_channel_mode_change(&hookmsg_chg);
 					}
+
+					hook_call_channel_status_change((&(struct hook_channel_mode_change){
+						.cu = cu,
+						.mchar = status_mode_list[i].mode,
+						.mvalue = status_mode_list[i].value,
+					}));
 				}
 				else
 				{
@@ -342,6 +348,12 @@ channel_mode(struct user *source, struct channel *chan, int parc, char *parv[])
 						modestack_mode_param(source->nick, chan, MTYPE_DEL, *pos, CLIENT_NAME(cu->user));
 
 					cu->modes &= ~status_mode_list[i].value;
+
+					hook_call_channel_status_change((&(struct hook_channel_mode_change){
+						.cu = cu,
+						.mchar = status_mode_list[i].mode,
+						.mvalue = status_mode_list[i].value,
+					}));
 				}
 
 				break;
@@ -16,7 +16,24 @@
 #include <atheme.h>
 #include "internal.h"
 
+#ifndef MINIMUM
+#  define MINIMUM(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+
+/* Commands that are running, innermost first. A command can be removed
+ * (and its module unloaded) while it runs; command_delete() marks it here
+ * so that command_exec() does not touch it afterwards.
+ */
+struct command_frame
+{
+	struct command *        cmd;
+	struct command_frame *  prev;
+	bool                    deleted;
+};
+
 static bool permissive_mode_fallback = false;
+static struct command_frame *command_running = NULL;
+static mowgli_list_t command_stats_list = { NULL, NULL, 0 };
 
 static int
 text_to_parv(char *text, int maxparc, char **parv)
@@ -104,6 +121,16 @@ command_delete(struct command *cmd, mowgli_patricia_t *commandtree)
 	return_if_fail(commandtree != NULL);
 
 	mowgli_patricia_delete(commandtree, cmd->name);
+
+	for (struct command_frame *f = command_running; f != NULL; f = f->prev)
+		if (f->cmd == cmd)
+			f->deleted = true;
+
+	if (cmd->stats.calls)
+	{
+		mowgli_node_delete(&cmd->stats.node, &command_stats_list);
+		memset(&cmd->stats, 0x00, sizeof cmd->stats);
+	}
 }
 
 void
@@ -122,6 +149,138 @@ command_find(mowgli_patricia_t *commandtree, const char *command)
 	return mowgli_patricia_retrieve(commandtree, command);
 }
 
+static unsigned int
+command_latency_bucket(unsigned long long usec)
+{
+	unsigned int i = 0;
+
+	while (usec >= 2 && i < COMMAND_LATENCY_BUCKETS - 1)
+	{
+		usec >>= 1;
+		i++;
+	}
+
+	return i;
+}
+
+static void
+command_stats_record(struct service *svs, struct command *c, const struct command *parent, const char *source,
+                     unsigned long long usec)
+{
+	struct command_stats *const stats = &c->stats;
+
+	if (! stats->calls++)
+	{
+		mowgli_node_add(c, &stats->node, &command_stats_list);
+		mowgli_strlcpy(stats->service, svs->internal_name, sizeof stats->service);
+
+		if (parent != NULL)
+			snprintf(stats->name, sizeof stats->name, "%s %s", parent->name, c->name);
+		else
+			mowgli_strlcpy(stats->name, c->name, sizeof stats->name);
+	}
+
+	stats->usec_total += usec;
+	stats->buckets[command_latency_bucket(usec)]++;
+
+	if (usec > stats->usec_max)
+		stats->usec_max = usec;
+
+	const time_t slice = CURRTIME / (time_t) COMMAND_STATS_WORST_SLOT_LEN;
+	struct command_stats_worst *const worst = &stats->worst[slice % COMMAND_STATS_WORST_SLOTS];
+
+	// a slot left over from an earlier round is started afresh
+	if (usec > worst->usec || worst->time / (time_t) COMMAND_STATS_WORST_SLOT_LEN != slice)
+	{
+		worst->usec = usec;
+		worst->time = CURRTIME;
+		mowgli_strlcpy(worst->source, source, sizeof worst->source);
+	}
+}
+
+/*
+ * command_stats_foreach(int (*cb)(struct command *c, void *privdata), void *privdata)
+ *
+ * Calls a function for every command that has run since it was added,
+ * in no particular order. Iteration stops early if the function returns
+ * nonzero.
+ */
+void
+command_stats_foreach(int (*cb)(struct command *c, void *privdata), void *privdata)
+{
+	mowgli_node_t *n, *tn;
+
+	return_if_fail(cb != NULL);
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, command_stats_list.head)
+		if (cb(n->data, privdata) != 0)
+			break;
+}
+
+/*
+ * command_stats_worst(const struct command_stats *stats)
+ *
+ * Finds the slowest recent run of a command, from the slots of the last
+ * COMMAND_STATS_WORST_WINDOW (give or take a slot) that it ran in.
+ *
+ * Outputs:
+ *      - the slowest recent run, or NULL if it has not run recently
+ */
+const struct command_stats_worst *
+command_stats_worst(const struct command_stats *stats)
+{
+	const struct command_stats_worst *worst = NULL;
+
+	return_val_if_fail(stats != NULL, NULL);
+
+	const time_t slice = CURRTIME / (time_t) COMMAND_STATS_WORST_SLOT_LEN;
+
+	for (unsigned int i = 0; i < COMMAND_STATS_WORST_SLOTS; i++)
+	{
+		const struct command_stats_worst *const slot = &stats->worst[i];
+
+		if (! slot->time || slot->time / (time_t) COMMAND_STATS_WORST_SLOT_LEN + (time_t) COMMAND_STATS_WORST_SLOTS <= slice)
+			continue;
+
+		if (worst == NULL || slot->usec > worst->usec)
+			worst = slot;
+	}
+
+	return worst;
+}
+
+/*
+ * command_stats_percentile(const struct command_stats *stats, unsigned int permille)
+ *
+ * Estimates a percentile (given in tenths of a percent, e.g. 990 for
+ * p99) of how long a command takes to run, from its latency histogram.
+ *
+ * Outputs:
+ *      - an upper bound in microseconds, never more than the slowest run
+ */
+unsigned long long
+command_stats_percentile(const struct command_stats *stats, unsigned int permille)
+{
+	unsigned long long seen = 0;
+
+	return_val_if_fail(stats != NULL, 0);
+
+	if (! stats->calls)
+		return 0;
+
+	const unsigned long long want = ((stats->calls * MINIMUM(permille, 1000U)) + 999U) / 1000U;
+
+	for (unsigned int i = 0; i < COMMAND_LATENCY_BUCKETS - 1; i++)
+	{
+		seen += stats->buckets[i];
+
+		if (seen >= want)
+			return MINIMUM(1ULL << (i + 1), stats->usec_max);
+	}
+
+	return stats->usec_max;
+}
+
 void
 command_exec(struct service *svs, struct sourceinfo *si, struct command *c, int parc, char *parv[])
 {
@@ -146,7 +305,28 @@ command_exec(struct service *svs, struct sourceinfo *si, struct command *c, int
 			language_set_active(si->force_language);
 
 		si->command = c;
+
+#ifdef HAVE_GETTIMEOFDAY
+		struct command_frame frame = { .cmd = c, .prev = command_running };
+		char source[sizeof c->stats.worst->source];
+		struct timeval tv_start, tv;
+
+		// whoever ran it may be gone by the time it returns
+		mowgli_strlcpy(source, get_oper_name(si), sizeof source);
+
+		command_running = &frame;
+		s_time(&tv_start);
+		c->cmd(si, parc, parv);
+		e_time(tv_start, &tv);
+		command_running = frame.prev;
+
+		if (! frame.deleted)
+			command_stats_record(svs, c, (frame.prev && ! frame.prev->deleted) ? frame.prev->cmd : NULL,
+			                     source, tv2us(&tv));
+#else
 		c->cmd(si, parc, parv);
+#endif
+
 		language_set_active(NULL);
 		return;
 	}
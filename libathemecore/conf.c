@@ -259,6 +259,7 @@ init_newconf(void)
 	add_dupstr_conf_item("ADMINEMAIL", &conf_si_table, 0, &me.adminemail, NULL);
 	add_dupstr_conf_item("REGISTEREMAIL", &conf_si_table, 0, &me.register_email, NULL);
 	add_dupstr_conf_item("MTA", &conf_si_table, 0, &me.mta, NULL);
+	add_bool_conf_item("MTA_SMTP", &conf_si_table, 0, &me.mta_smtp, false);
 	add_conf_item("LOGLEVEL", &conf_si_table, c_si_loglevel);
 	add_uint_conf_item("MAXLOGINS", &conf_si_table, 0, &me.maxlogins, 3, INT_MAX, 5);
 	add_uint_conf_item("MAXUSERS", &conf_si_table, 0, &me.maxusers, 0, INT_MAX, 0);
@@ -306,6 +307,7 @@ init_newconf(void)
 	add_conf_item("IMMUNE_LEVEL", &conf_gi_table, c_gi_immune_level);
 	add_bool_conf_item("SHOW_ENTITY_ID", &conf_gi_table, 0, &config_options.show_entity_id, false);
 	add_bool_conf_item("LOAD_DATABASE_MDEPS", &conf_gi_table, 0, &config_options.load_database_mdeps, false);
+	add_uint_conf_item("SLOW_OPERATION_THRESHOLD", &conf_gi_table, 0, &config_options.slow_operation_threshold, 0, 60000, 500);
 
 	/* language:: stuff */
 	add_dupstr_conf_item("NAME", &conf_la_table, 0, &me.language_name, NULL);
@@ -877,6 +879,7 @@ copy_me(struct me *src, struct me *dst)
 	dst->adminemail = sstrdup(src->adminemail);
 	dst->register_email = sstrdup(src->register_email);
 	dst->mta = sstrdup(src->mta);
+	dst->mta_smtp = src->mta_smtp;
 	dst->maxlogins = src->maxlogins;
 	dst->maxusers = src->maxusers;
 	dst->emaillimit = src->emaillimit;
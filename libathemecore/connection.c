@@ -66,14 +66,26 @@ connection_trampoline(mowgli_eventloop_t *eventloop, mowgli_eventloop_io_t *io,
 	mowgli_eventloop_io_dir_t dir, void *userdata)
 {
 	struct connection *cptr = userdata;
+#ifdef HAVE_GETTIMEOFDAY
+	struct timeval start, tv;
+
+	s_time(&start);
+#endif
 
 	switch (dir) {
 	case MOWGLI_EVENTLOOP_IO_READ:
-		return cptr->read_handler(cptr);
+		cptr->read_handler(cptr);
+		break;
 	case MOWGLI_EVENTLOOP_IO_WRITE:
 	case MOWGLI_EVENTLOOP_IO_ERROR:
-		return cptr->write_handler(cptr);
+		cptr->write_handler(cptr);
+		break;
 	}
+
+#ifdef HAVE_GETTIMEOFDAY
+	e_time(start, &tv);
+	loopstats_add_busy(tv2us(&tv));
+#endif
 }
 
 /*
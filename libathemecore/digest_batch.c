@@ -0,0 +1,453 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Batched (multi-lane) PBKDF2 for the digest interface.
+ */
+
+#include <atheme.h>
+#include "internal.h"
+
+/*
+ * Every PBKDF2 iteration after the first is exactly 2 block transforms: the
+ * inner HMAC digest starting from the (precomputed) inner key state, and the
+ * outer HMAC digest starting from the (precomputed) outer key state. Both of
+ * them operate on a single block consisting of the previous digest followed
+ * by fixed padding, so the digest never needs to be converted to bytes and
+ * back inside the loop.
+ *
+ * This lets us run up to DIGEST_DIRECT_LANES_* unrelated derivations (or
+ * unrelated T(i) blocks of one derivation) in lock-step, one per vector lane,
+ * using the multi-lane block transforms of the direct digest implementations.
+ */
+
+union digest_batch_lane32
+{
+	digest_direct_lane32    v;
+	uint32_t                w[DIGEST_DIRECT_LANES_32];
+};
+
+union digest_batch_lane64
+{
+	digest_direct_lane64    v;
+	uint64_t                w[DIGEST_DIRECT_LANES_64];
+};
+
+struct digest_batch_item
+{
+	const struct digest_pbkdf2_job *job;
+	uint32_t                        block;
+};
+
+static inline uint32_t
+digest_batch_load32(const unsigned char *const restrict in)
+{
+	return (((uint32_t) in[0x00U]) << 0x18U) | (((uint32_t) in[0x01U]) << 0x10U) |
+	       (((uint32_t) in[0x02U]) << 0x08U) | (((uint32_t) in[0x03U]));
+}
+
+static inline uint64_t
+digest_batch_load64(const unsigned char *const restrict in)
+{
+	return (((uint64_t) digest_batch_load32(in)) << 0x20U) | ((uint64_t) digest_batch_load32(in + 0x04U));
+}
+
+static inline void
+digest_batch_store32(unsigned char *const restrict out, const uint32_t w)
+{
+	out[0x00U] = (unsigned char) ((w >> 0x18U) & 0xFFU);
+	out[0x01U] = (unsigned char) ((w >> 0x10U) & 0xFFU);
+	out[0x02U] = (unsigned char) ((w >> 0x08U) & 0xFFU);
+	out[0x03U] = (unsigned char) ((w) & 0xFFU);
+}
+
+static inline void
+digest_batch_store64(unsigned char *const restrict out, const uint64_t w)
+{
+	(void) digest_batch_store32(out, (uint32_t) (w >> 0x20U));
+	(void) digest_batch_store32(out + 0x04U, (uint32_t) (w & UINT64_C(0xFFFFFFFF)));
+}
+
+static bool
+digest_batch_lane_setup(const enum digest_algorithm alg, const struct digest_batch_item *const restrict item,
+                        union digest_direct_ctx *const restrict ictx, union digest_direct_ctx *const restrict octx,
+                        unsigned char *const restrict u1)
+{
+	unsigned char ikey[DIGEST_BKLEN_MAX];
+	unsigned char okey[DIGEST_BKLEN_MAX];
+	unsigned char hkey[DIGEST_MDLEN_MAX];
+
+	const struct digest_pbkdf2_job *const job = item->job;
+	const uint32_t ibe = htonl(item->block);
+
+	const struct digest_vector vec[] = {
+		{ job->salt,    job->saltLen    },
+		{ &ibe,         sizeof ibe      },
+	};
+
+	const unsigned char *key = job->pass;
+	size_t keyLen = job->passLen;
+	size_t blkLen;
+	bool retval = false;
+
+	void (*init)(union digest_direct_ctx *);
+	void (*update)(union digest_direct_ctx *, const void *, size_t);
+
+	switch (alg)
+	{
+		case DIGALG_SHA1:
+			init = &digest_direct_init_sha1;
+			update = &digest_direct_update_sha1;
+			blkLen = DIGEST_BKLEN_SHA1;
+			break;
+
+		case DIGALG_SHA2_256:
+			init = &digest_direct_init_sha2_256;
+			update = &digest_direct_update_sha2_256;
+			blkLen = DIGEST_BKLEN_SHA2_256;
+			break;
+
+		case DIGALG_SHA2_512:
+			init = &digest_direct_init_sha2_512;
+			update = &digest_direct_update_sha2_512;
+			blkLen = DIGEST_BKLEN_SHA2_512;
+			break;
+
+		default:
+			return false;
+	}
+
+	if (keyLen > blkLen)
+	{
+		if (! digest_oneshot(alg, key, keyLen, hkey, &keyLen))
+			goto end;
+
+		key = hkey;
+	}
+
+	(void) memset(ikey, 0x36U, blkLen);
+	(void) memset(okey, 0x5CU, blkLen);
+
+	for (size_t i = 0; i < keyLen; i++)
+	{
+		ikey[i] ^= key[i];
+		okey[i] ^= key[i];
+	}
+
+	// One whole block is absorbed immediately, leaving the raw chaining state behind
+	(void) init(ictx);
+	(void) update(ictx, ikey, blkLen);
+	(void) init(octx);
+	(void) update(octx, okey, blkLen);
+
+	if (! digest_oneshot_hmac_vector(alg, job->pass, job->passLen, vec, ARRAY_SIZE(vec), u1, NULL))
+		goto end;
+
+	retval = true;
+
+end:
+	(void) smemzero(ikey, sizeof ikey);
+	(void) smemzero(okey, sizeof okey);
+	(void) smemzero(hkey, sizeof hkey);
+	return retval;
+}
+
+static bool
+digest_batch_run_lanes32(const enum digest_algorithm alg, const size_t c,
+                         const struct digest_batch_item *const restrict items, const size_t count)
+{
+	union digest_batch_lane32 ist[DIGEST_IVLEN_SHA2_256];
+	union digest_batch_lane32 ost[DIGEST_IVLEN_SHA2_256];
+	union digest_batch_lane32 st[DIGEST_IVLEN_SHA2_256];
+	union digest_batch_lane32 U[DIGEST_IVLEN_SHA2_256];
+	union digest_batch_lane32 T[DIGEST_IVLEN_SHA2_256];
+	union digest_batch_lane32 W[0x10U];
+	union digest_batch_lane32 pad[0x10U];
+
+	union digest_direct_ctx ictx;
+	union digest_direct_ctx octx;
+	unsigned char u1[DIGEST_MDLEN_MAX];
+
+	void (*const transform)(digest_direct_lane32 *, digest_direct_lane32 *) =
+	    (alg == DIGALG_SHA1) ? &digest_direct_lanes_sha1 : &digest_direct_lanes_sha2_256;
+
+	const size_t bLen = (alg == DIGALG_SHA1) ? DIGEST_BKLEN_SHA1 : DIGEST_BKLEN_SHA2_256;
+	const size_t hLen = digest_size_alg(alg);
+	const size_t hWords = hLen / sizeof(uint32_t);
+	bool retval = false;
+
+	(void) memset(ist, 0x00, sizeof ist);
+	(void) memset(ost, 0x00, sizeof ost);
+	(void) memset(U, 0x00, sizeof U);
+	(void) memset(pad, 0x00, sizeof pad);
+
+	for (size_t l = 0; l < DIGEST_DIRECT_LANES_32; l++)
+	{
+		pad[hWords].w[l] = UINT32_C(0x80000000);
+		pad[0x0FU].w[l] = (uint32_t) ((bLen + hLen) * 0x08U);
+	}
+
+	for (size_t l = 0; l < count; l++)
+	{
+		if (! digest_batch_lane_setup(alg, &items[l], &ictx, &octx, u1))
+			goto end;
+
+		for (size_t x = 0; x < hWords; x++)
+		{
+			ist[x].w[l] = (alg == DIGALG_SHA1) ? ictx.sha1.state[x] : ictx.sha2_256.state[x];
+			ost[x].w[l] = (alg == DIGALG_SHA1) ? octx.sha1.state[x] : octx.sha2_256.state[x];
+			U[x].w[l] = digest_batch_load32(u1 + (x * sizeof(uint32_t)));
+		}
+	}
+
+	(void) memcpy(T, U, sizeof T);
+
+	for (size_t i = 1; i < c; i++)
+	{
+		// Inner digest: H((K ^ ipad) || U)
+		(void) memcpy(W, pad, sizeof W);
+		(void) memcpy(st, ist, sizeof st);
+
+		for (size_t x = 0; x < hWords; x++)
+			W[x].v = U[x].v;
+
+		(void) transform(&st[0].v, &W[0].v);
+
+		// Outer digest: H((K ^ opad) || inner)
+		(void) memcpy(W, pad, sizeof W);
+
+		for (size_t x = 0; x < hWords; x++)
+			W[x].v = st[x].v;
+
+		(void) memcpy(st, ost, sizeof st);
+		(void) transform(&st[0].v, &W[0].v);
+
+		for (size_t x = 0; x < hWords; x++)
+		{
+			U[x].v = st[x].v;
+			T[x].v ^= st[x].v;
+		}
+	}
+
+	for (size_t l = 0; l < count; l++)
+	{
+		const struct digest_pbkdf2_job *const job = items[l].job;
+		const size_t offset = (items[l].block - 1U) * hLen;
+		const size_t cpLen = ((job->dkLen - offset) > hLen) ? hLen : (job->dkLen - offset);
+
+		for (size_t x = 0; x < hWords; x++)
+			(void) digest_batch_store32(u1 + (x * sizeof(uint32_t)), T[x].w[l]);
+
+		(void) memcpy(((unsigned char *) job->dk) + offset, u1, cpLen);
+	}
+
+	retval = true;
+
+end:
+	(void) smemzero(ist, sizeof ist);
+	(void) smemzero(ost, sizeof ost);
+	(void) smemzero(st, sizeof st);
+	(void) smemzero(U, sizeof U);
+	(void) smemzero(T, sizeof T);
+	(void) smemzero(W, sizeof W);
+	(void) smemzero(&ictx, sizeof ictx);
+	(void) smemzero(&octx, sizeof octx);
+	(void) smemzero(u1, sizeof u1);
+	return retval;
+}
+
+static bool
+digest_batch_run_lanes64(const enum digest_algorithm alg, const size_t c,
+                         const struct digest_batch_item *const restrict items, const size_t count)
+{
+	union digest_batch_lane64 ist[DIGEST_IVLEN_SHA2_512];
+	union digest_batch_lane64 ost[DIGEST_IVLEN_SHA2_512];
+	union digest_batch_lane64 st[DIGEST_IVLEN_SHA2_512];
+	union digest_batch_lane64 U[DIGEST_IVLEN_SHA2_512];
+	union digest_batch_lane64 T[DIGEST_IVLEN_SHA2_512];
+	union digest_batch_lane64 W[0x10U];
+	union digest_batch_lane64 pad[0x10U];
+
+	union digest_direct_ctx ictx;
+	union digest_direct_ctx octx;
+	unsigned char u1[DIGEST_MDLEN_MAX];
+
+	const size_t hLen = DIGEST_MDLEN_SHA2_512;
+	const size_t hWords = hLen / sizeof(uint64_t);
+	bool retval = false;
+
+	(void) memset(ist, 0x00, sizeof ist);
+	(void) memset(ost, 0x00, sizeof ost);
+	(void) memset(U, 0x00, sizeof U);
+	(void) memset(pad, 0x00, sizeof pad);
+
+	for (size_t l = 0; l < DIGEST_DIRECT_LANES_64; l++)
+	{
+		pad[hWords].w[l] = UINT64_C(0x8000000000000000);
+		pad[0x0FU].w[l] = (uint64_t) ((DIGEST_BKLEN_SHA2_512 + hLen) * 0x08U);
+	}
+
+	for (size_t l = 0; l < count; l++)
+	{
+		if (! digest_batch_lane_setup(alg, &items[l], &ictx, &octx, u1))
+			goto end;
+
+		for (size_t x = 0; x < hWords; x++)
+		{
+			ist[x].w[l] = ictx.sha2_512.state[x];
+			ost[x].w[l] = octx.sha2_512.state[x];
+			U[x].w[l] = digest_batch_load64(u1 + (x * sizeof(uint64_t)));
+		}
+	}
+
+	(void) memcpy(T, U, sizeof T);
+
+	for (size_t i = 1; i < c; i++)
+	{
+		(void) memcpy(W, pad, sizeof W);
+		(void) memcpy(st, ist, sizeof st);
+
+		for (size_t x = 0; x < hWords; x++)
+			W[x].v = U[x].v;
+
+		(void) digest_direct_lanes_sha2_512(&st[0].v, &W[0].v);
+
+		(void) memcpy(W, pad, sizeof W);
+
+		for (size_t x = 0; x < hWords; x++)
+			W[x].v = st[x].v;
+
+		(void) memcpy(st, ost, sizeof st);
+		(void) digest_direct_lanes_sha2_512(&st[0].v, &W[0].v);
+
+		for (size_t x = 0; x < hWords; x++)
+		{
+			U[x].v = st[x].v;
+			T[x].v ^= st[x].v;
+		}
+	}
+
+	for (size_t l = 0; l < count; l++)
+	{
+		const struct digest_pbkdf2_job *const job = items[l].job;
+		const size_t offset = (items[l].block - 1U) * hLen;
+		const size_t cpLen = ((job->dkLen - offset) > hLen) ? hLen : (job->dkLen - offset);
+
+		for (size_t x = 0; x < hWords; x++)
+			(void) digest_batch_store64(u1 + (x * sizeof(uint64_t)), T[x].w[l]);
+
+		(void) memcpy(((unsigned char *) job->dk) + offset, u1, cpLen);
+	}
+
+	retval = true;
+
+end:
+	(void) smemzero(ist, sizeof ist);
+	(void) smemzero(ost, sizeof ost);
+	(void) smemzero(st, sizeof st);
+	(void) smemzero(U, sizeof U);
+	(void) smemzero(T, sizeof T);
+	(void) smemzero(W, sizeof W);
+	(void) smemzero(&ictx, sizeof ictx);
+	(void) smemzero(&octx, sizeof octx);
+	(void) smemzero(u1, sizeof u1);
+	return retval;
+}
+
+size_t
+digest_pbkdf2_batch_lanes(const enum digest_algorithm alg)
+{
+	switch (alg)
+	{
+		case DIGALG_SHA1:
+			ATHEME_FALLTHROUGH;
+		case DIGALG_SHA2_256:
+			return DIGEST_DIRECT_LANES_32;
+
+		case DIGALG_SHA2_512:
+			return DIGEST_DIRECT_LANES_64;
+
+		default:
+			return 1U;
+	}
+}
+
+bool ATHEME_FATTR_WUR
+digest_oneshot_pbkdf2_batch(const enum digest_algorithm alg, const size_t c,
+                            const struct digest_pbkdf2_job *const restrict jobs, const size_t jobsLen)
+{
+	struct digest_batch_item items[DIGEST_DIRECT_LANES_32];
+
+	const size_t hLen = digest_size_alg(alg);
+	const size_t lanes = digest_pbkdf2_batch_lanes(alg);
+
+	if (! hLen)
+	{
+		(void) slog(LG_ERROR, "%s: called with malformed/uninitialised 'alg' (BUG)", MOWGLI_FUNC_NAME);
+		return false;
+	}
+	if (! c)
+	{
+		(void) slog(LG_ERROR, "%s: called with zero 'c' (BUG)", MOWGLI_FUNC_NAME);
+		return false;
+	}
+	if (! (jobs || ! jobsLen))
+	{
+		(void) slog(LG_ERROR, "%s: called with NULL 'jobs' (BUG)", MOWGLI_FUNC_NAME);
+		return false;
+	}
+
+	for (size_t i = 0; i < jobsLen; i++)
+	{
+		if (! (jobs[i].pass && jobs[i].passLen && jobs[i].salt && jobs[i].saltLen && jobs[i].dk && jobs[i].dkLen))
+		{
+			(void) slog(LG_ERROR, "%s: job %zu is incomplete (BUG)", MOWGLI_FUNC_NAME, i);
+			return false;
+		}
+	}
+
+	if (lanes < 2U)
+	{
+		// No multi-lane transform for this algorithm (or this compiler); derive them one at a time
+		for (size_t i = 0; i < jobsLen; i++)
+			if (! digest_oneshot_pbkdf2(alg, jobs[i].pass, jobs[i].passLen, jobs[i].salt, jobs[i].saltLen, c,
+			                            jobs[i].dk, jobs[i].dkLen))
+				return false;
+
+		return true;
+	}
+
+	size_t count = 0;
+
+	for (size_t i = 0; i < jobsLen; i++)
+	{
+		const size_t blocks = (jobs[i].dkLen + hLen - 1U) / hLen;
+
+		for (size_t b = 1; b <= blocks; b++)
+		{
+			items[count].job = &jobs[i];
+			items[count].block = (uint32_t) b;
+
+			if (++count < lanes)
+				continue;
+
+			if (alg == DIGALG_SHA2_512 && ! digest_batch_run_lanes64(alg, c, items, count))
+				return false;
+
+			if (alg != DIGALG_SHA2_512 && ! digest_batch_run_lanes32(alg, c, items, count))
+				return false;
+
+			count = 0;
+		}
+	}
+
+	if (count && alg == DIGALG_SHA2_512 && ! digest_batch_run_lanes64(alg, c, items, count))
+		return false;
+
+	if (count && alg != DIGALG_SHA2_512 && ! digest_batch_run_lanes32(alg, c, items, count))
+		return false;
+
+	return true;
+}
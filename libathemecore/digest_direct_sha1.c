@@ -35,6 +35,14 @@
 #include <atheme/memory.h>              // smemzero()
 #include <atheme/stdheaders.h>          // size_t, uint32_t, htonl(3), memcpy(3), memset(3)
 
+#ifdef DIGEST_DIRECT_HAVE_X86_SHA
+#  include <immintrin.h>
+#endif
+
+#ifdef DIGEST_DIRECT_HAVE_ARMV8_SHA
+#  include <arm_neon.h>
+#endif
+
 #define SHA1_ROL(value, bits) (((value) << (bits)) | ((value) >> (0x20U - (bits))))
 
 #define SHA1_BLK0_BE(i) block->l[i]
@@ -88,8 +96,8 @@ union SHA1_B64Q16
 };
 
 static void
-digest_transform_block_sha1(union digest_direct_ctx *const restrict state,
-                            const unsigned char *const restrict in)
+digest_transform_block_sha1_portable(union digest_direct_ctx *const restrict state,
+                                     const unsigned char *const restrict in)
 {
 	const bool digest_is_big_endian = (htonl(UINT32_C(0x11223344)) == UINT32_C(0x11223344));
 
@@ -193,6 +201,300 @@ digest_transform_block_sha1(union digest_direct_ctx *const restrict state,
 	(void) smemzero(s, sizeof s);
 }
 
+#ifdef DIGEST_DIRECT_HAVE_X86_SHA
+static void DIGEST_DIRECT_X86_SHA_TARGET
+digest_transform_block_sha1_x86(union digest_direct_ctx *const restrict state,
+                                const unsigned char *const restrict in)
+{
+	const __m128i mask = _mm_set_epi64x(INT64_C(0x0001020304050607), INT64_C(0x08090A0B0C0D0E0F));
+
+	const __m128i abcd_save = _mm_shuffle_epi32(_mm_loadu_si128((const void *) state->sha1.state), 0x1B);
+	const __m128i e0_save = _mm_set_epi32((int) state->sha1.state[0x04U], 0, 0, 0);
+
+	__m128i abcd = abcd_save;
+	__m128i e0 = e0_save;
+	__m128i e1;
+	__m128i msg0, msg1, msg2, msg3;
+
+	/* rounds 0-3 */
+	msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const void *) (in + 0x00U)), mask);
+	e0 = _mm_add_epi32(e0, msg0);
+	e1 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+	/* rounds 4-7 */
+	msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const void *) (in + 0x10U)), mask);
+	e1 = _mm_sha1nexte_epu32(e1, msg1);
+	e0 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+	msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+	/* rounds 8-11 */
+	msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const void *) (in + 0x20U)), mask);
+	e0 = _mm_sha1nexte_epu32(e0, msg2);
+	e1 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+	msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+	msg0 = _mm_xor_si128(msg0, msg2);
+
+	/* rounds 12-15 */
+	msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const void *) (in + 0x30U)), mask);
+	e1 = _mm_sha1nexte_epu32(e1, msg3);
+	e0 = abcd;
+	msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+	msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+	msg1 = _mm_xor_si128(msg1, msg3);
+
+	/* rounds 16-19 */
+	e0 = _mm_sha1nexte_epu32(e0, msg0);
+	e1 = abcd;
+	msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+	msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+	msg2 = _mm_xor_si128(msg2, msg0);
+
+	/* rounds 20-23 */
+	e1 = _mm_sha1nexte_epu32(e1, msg1);
+	e0 = abcd;
+	msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+	msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+	msg3 = _mm_xor_si128(msg3, msg1);
+
+	/* rounds 24-27 */
+	e0 = _mm_sha1nexte_epu32(e0, msg2);
+	e1 = abcd;
+	msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+	msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+	msg0 = _mm_xor_si128(msg0, msg2);
+
+	/* rounds 28-31 */
+	e1 = _mm_sha1nexte_epu32(e1, msg3);
+	e0 = abcd;
+	msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+	msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+	msg1 = _mm_xor_si128(msg1, msg3);
+
+	/* rounds 32-35 */
+	e0 = _mm_sha1nexte_epu32(e0, msg0);
+	e1 = abcd;
+	msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+	msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+	msg2 = _mm_xor_si128(msg2, msg0);
+
+	/* rounds 36-39 */
+	e1 = _mm_sha1nexte_epu32(e1, msg1);
+	e0 = abcd;
+	msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+	msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+	msg3 = _mm_xor_si128(msg3, msg1);
+
+	/* rounds 40-43 */
+	e0 = _mm_sha1nexte_epu32(e0, msg2);
+	e1 = abcd;
+	msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+	msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+	msg0 = _mm_xor_si128(msg0, msg2);
+
+	/* rounds 44-47 */
+	e1 = _mm_sha1nexte_epu32(e1, msg3);
+	e0 = abcd;
+	msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+	msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+	msg1 = _mm_xor_si128(msg1, msg3);
+
+	/* rounds 48-51 */
+	e0 = _mm_sha1nexte_epu32(e0, msg0);
+	e1 = abcd;
+	msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+	msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+	msg2 = _mm_xor_si128(msg2, msg0);
+
+	/* rounds 52-55 */
+	e1 = _mm_sha1nexte_epu32(e1, msg1);
+	e0 = abcd;
+	msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+	msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+	msg3 = _mm_xor_si128(msg3, msg1);
+
+	/* rounds 56-59 */
+	e0 = _mm_sha1nexte_epu32(e0, msg2);
+	e1 = abcd;
+	msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+	msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+	msg0 = _mm_xor_si128(msg0, msg2);
+
+	/* rounds 60-63 */
+	e1 = _mm_sha1nexte_epu32(e1, msg3);
+	e0 = abcd;
+	msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+	msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+	msg1 = _mm_xor_si128(msg1, msg3);
+
+	/* rounds 64-67 */
+	e0 = _mm_sha1nexte_epu32(e0, msg0);
+	e1 = abcd;
+	msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+	msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+	msg2 = _mm_xor_si128(msg2, msg0);
+
+	/* rounds 68-71 */
+	e1 = _mm_sha1nexte_epu32(e1, msg1);
+	e0 = abcd;
+	msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+	msg3 = _mm_xor_si128(msg3, msg1);
+
+	/* rounds 72-75 */
+	e0 = _mm_sha1nexte_epu32(e0, msg2);
+	e1 = abcd;
+	msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+	/* rounds 76-79 */
+	e1 = _mm_sha1nexte_epu32(e1, msg3);
+	e0 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+	e0 = _mm_sha1nexte_epu32(e0, e0_save);
+	abcd = _mm_add_epi32(abcd, abcd_save);
+
+	(void) _mm_storeu_si128((void *) state->sha1.state, _mm_shuffle_epi32(abcd, 0x1B));
+	state->sha1.state[0x04U] = (uint32_t) _mm_extract_epi32(e0, 3);
+}
+#endif /* DIGEST_DIRECT_HAVE_X86_SHA */
+
+#ifdef DIGEST_DIRECT_HAVE_ARMV8_SHA
+#define SHA1_ARMV8_ROUNDS(g, op, k)                                                                                    \
+    do {                                                                                                               \
+        const uint32x4_t wk = vaddq_u32(msg[(g) & 0x03U], vdupq_n_u32(k));                                             \
+        const uint32_t e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));                                                       \
+                                                                                                                       \
+        abcd = op(abcd, e0, wk);                                                                                       \
+        e0 = e1;                                                                                                       \
+                                                                                                                       \
+        if ((g) < 0x10U)                                                                                               \
+            msg[(g) & 0x03U] = vsha1su1q_u32(vsha1su0q_u32(msg[(g) & 0x03U], msg[((g) + 0x01U) & 0x03U],              \
+                                             msg[((g) + 0x02U) & 0x03U]), msg[((g) + 0x03U) & 0x03U]);                \
+    } while (0)
+
+static void DIGEST_DIRECT_ARMV8_SHA_TARGET
+digest_transform_block_sha1_armv8(union digest_direct_ctx *const restrict state,
+                                  const unsigned char *const restrict in)
+{
+	const uint32x4_t abcd_save = vld1q_u32(state->sha1.state);
+	const uint32_t e0_save = state->sha1.state[0x04U];
+
+	uint32x4_t abcd = abcd_save;
+	uint32_t e0 = e0_save;
+	uint32x4_t msg[0x04U];
+
+	for (uint32_t i = 0x00U; i < 0x04U; i++)
+		msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(in + (i * 0x10U))));
+
+	for (uint32_t g = 0x00U; g < 0x05U; g++)
+		SHA1_ARMV8_ROUNDS(g, vsha1cq_u32, UINT32_C(0x5A827999));
+
+	for (uint32_t g = 0x05U; g < 0x0AU; g++)
+		SHA1_ARMV8_ROUNDS(g, vsha1pq_u32, UINT32_C(0x6ED9EBA1));
+
+	for (uint32_t g = 0x0AU; g < 0x0FU; g++)
+		SHA1_ARMV8_ROUNDS(g, vsha1mq_u32, UINT32_C(0x8F1BBCDC));
+
+	for (uint32_t g = 0x0FU; g < 0x14U; g++)
+		SHA1_ARMV8_ROUNDS(g, vsha1pq_u32, UINT32_C(0xCA62C1D6));
+
+	(void) vst1q_u32(state->sha1.state, vaddq_u32(abcd, abcd_save));
+	state->sha1.state[0x04U] = e0 + e0_save;
+}
+#endif /* DIGEST_DIRECT_HAVE_ARMV8_SHA */
+
+static void (*digest_transform_block_sha1)(union digest_direct_ctx *, const unsigned char *) =
+    &digest_transform_block_sha1_portable;
+
+bool
+digest_direct_use_kernel_sha1(const enum digest_direct_kernel kernel)
+{
+	switch (kernel)
+	{
+		case DIGEST_DIRECT_KERNEL_PORTABLE:
+			digest_transform_block_sha1 = &digest_transform_block_sha1_portable;
+			return true;
+
+#ifdef DIGEST_DIRECT_HAVE_X86_SHA
+		case DIGEST_DIRECT_KERNEL_X86_SHA:
+			digest_transform_block_sha1 = &digest_transform_block_sha1_x86;
+			return true;
+#endif
+
+#ifdef DIGEST_DIRECT_HAVE_ARMV8_SHA
+		case DIGEST_DIRECT_KERNEL_ARMV8_SHA:
+			digest_transform_block_sha1 = &digest_transform_block_sha1_armv8;
+			return true;
+#endif
+
+		default:
+			return false;
+	}
+}
+
+void DIGEST_DIRECT_LANES_TARGET
+digest_direct_lanes_sha1(digest_direct_lane32 *const restrict state, digest_direct_lane32 *const restrict W)
+{
+	digest_direct_lane32 a = state[0x00U];
+	digest_direct_lane32 b = state[0x01U];
+	digest_direct_lane32 c = state[0x02U];
+	digest_direct_lane32 d = state[0x03U];
+	digest_direct_lane32 e = state[0x04U];
+	digest_direct_lane32 t;
+
+#define SHA1_LANES_ROUND(f, k)                                                                                         \
+    do {                                                                                                               \
+        if (j >= 0x10U)                                                                                                \
+            W[j & 0x0FU] = SHA1_ROL(W[(j + 0x0DU) & 0x0FU] ^ W[(j + 0x08U) & 0x0FU] ^                                 \
+                                    W[(j + 0x02U) & 0x0FU] ^ W[j & 0x0FU], 0x01U);                                    \
+                                                                                                                       \
+        t = SHA1_ROL(a, 0x05U) + (f) + e + UINT32_C(k) + W[j & 0x0FU];                                                 \
+        e = d;                                                                                                         \
+        d = c;                                                                                                         \
+        c = SHA1_ROL(b, 0x1EU);                                                                                        \
+        b = a;                                                                                                         \
+        a = t;                                                                                                         \
+    } while (0)
+
+	for (uint32_t j = 0x00U; j < 0x14U; j++)
+		SHA1_LANES_ROUND((b & c) | (~b & d), 0x5A827999);
+
+	for (uint32_t j = 0x14U; j < 0x28U; j++)
+		SHA1_LANES_ROUND(b ^ c ^ d, 0x6ED9EBA1);
+
+	for (uint32_t j = 0x28U; j < 0x3CU; j++)
+		SHA1_LANES_ROUND((b & c) | (b & d) | (c & d), 0x8F1BBCDC);
+
+	for (uint32_t j = 0x3CU; j < 0x50U; j++)
+		SHA1_LANES_ROUND(b ^ c ^ d, 0xCA62C1D6);
+
+#undef SHA1_LANES_ROUND
+
+	state[0x00U] += a;
+	state[0x01U] += b;
+	state[0x02U] += c;
+	state[0x03U] += d;
+	state[0x04U] += e;
+}
+
 void
 digest_direct_init_sha1(union digest_direct_ctx *const restrict state)
 {
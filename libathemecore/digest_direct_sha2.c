@@ -47,6 +47,14 @@
 #include <atheme/memory.h>              // smemzero()
 #include <atheme/stdheaders.h>          // size_t, uint32_t, uint64_t, htonl(3), memcpy(3), memset(3)
 
+#ifdef DIGEST_DIRECT_HAVE_X86_SHA
+#  include <immintrin.h>
+#endif
+
+#ifdef DIGEST_DIRECT_HAVE_ARMV8_SHA
+#  include <arm_neon.h>
+#endif
+
 #define DIGEST_SHORT_BKLEN_SHA2_256     (DIGEST_BKLEN_SHA2_256 - 0x08U)
 #define DIGEST_SHORT_BKLEN_SHA2_512     (DIGEST_BKLEN_SHA2_512 - 0x10U)
 
@@ -148,28 +156,30 @@ digest_is_big_endian_sha2(void)
 	return (bool) (htonl(UINT32_C(0x11223344)) == UINT32_C(0x11223344));
 }
 
+static const uint32_t digest_sha2_256_K[] = {
+
+	UINT32_C(0x428A2F98), UINT32_C(0x71374491), UINT32_C(0xB5C0FBCF), UINT32_C(0xE9B5DBA5),
+	UINT32_C(0x3956C25B), UINT32_C(0x59F111F1), UINT32_C(0x923F82A4), UINT32_C(0xAB1C5ED5),
+	UINT32_C(0xD807AA98), UINT32_C(0x12835B01), UINT32_C(0x243185BE), UINT32_C(0x550C7DC3),
+	UINT32_C(0x72BE5D74), UINT32_C(0x80DEB1FE), UINT32_C(0x9BDC06A7), UINT32_C(0xC19BF174),
+	UINT32_C(0xE49B69C1), UINT32_C(0xEFBE4786), UINT32_C(0x0FC19DC6), UINT32_C(0x240CA1CC),
+	UINT32_C(0x2DE92C6F), UINT32_C(0x4A7484AA), UINT32_C(0x5CB0A9DC), UINT32_C(0x76F988DA),
+	UINT32_C(0x983E5152), UINT32_C(0xA831C66D), UINT32_C(0xB00327C8), UINT32_C(0xBF597FC7),
+	UINT32_C(0xC6E00BF3), UINT32_C(0xD5A79147), UINT32_C(0x06CA6351), UINT32_C(0x14292967),
+	UINT32_C(0x27B70A85), UINT32_C(0x2E1B2138), UINT32_C(0x4D2C6DFC), UINT32_C(0x53380D13),
+	UINT32_C(0x650A7354), UINT32_C(0x766A0ABB), UINT32_C(0x81C2C92E), UINT32_C(0x92722C85),
+	UINT32_C(0xA2BFE8A1), UINT32_C(0xA81A664B), UINT32_C(0xC24B8B70), UINT32_C(0xC76C51A3),
+	UINT32_C(0xD192E819), UINT32_C(0xD6990624), UINT32_C(0xF40E3585), UINT32_C(0x106AA070),
+	UINT32_C(0x19A4C116), UINT32_C(0x1E376C08), UINT32_C(0x2748774C), UINT32_C(0x34B0BCB5),
+	UINT32_C(0x391C0CB3), UINT32_C(0x4ED8AA4A), UINT32_C(0x5B9CCA4F), UINT32_C(0x682E6FF3),
+	UINT32_C(0x748F82EE), UINT32_C(0x78A5636F), UINT32_C(0x84C87814), UINT32_C(0x8CC70208),
+	UINT32_C(0x90BEFFFA), UINT32_C(0xA4506CEB), UINT32_C(0xBEF9A3F7), UINT32_C(0xC67178F2),
+};
+
 static void
-digest_transform_block_sha2_256(union digest_direct_ctx *const state, const uint32_t *data)
+digest_transform_block_sha2_256_portable(union digest_direct_ctx *const state, const uint32_t *data)
 {
-	static const uint32_t K[] = {
-
-		UINT32_C(0x428A2F98), UINT32_C(0x71374491), UINT32_C(0xB5C0FBCF), UINT32_C(0xE9B5DBA5),
-		UINT32_C(0x3956C25B), UINT32_C(0x59F111F1), UINT32_C(0x923F82A4), UINT32_C(0xAB1C5ED5),
-		UINT32_C(0xD807AA98), UINT32_C(0x12835B01), UINT32_C(0x243185BE), UINT32_C(0x550C7DC3),
-		UINT32_C(0x72BE5D74), UINT32_C(0x80DEB1FE), UINT32_C(0x9BDC06A7), UINT32_C(0xC19BF174),
-		UINT32_C(0xE49B69C1), UINT32_C(0xEFBE4786), UINT32_C(0x0FC19DC6), UINT32_C(0x240CA1CC),
-		UINT32_C(0x2DE92C6F), UINT32_C(0x4A7484AA), UINT32_C(0x5CB0A9DC), UINT32_C(0x76F988DA),
-		UINT32_C(0x983E5152), UINT32_C(0xA831C66D), UINT32_C(0xB00327C8), UINT32_C(0xBF597FC7),
-		UINT32_C(0xC6E00BF3), UINT32_C(0xD5A79147), UINT32_C(0x06CA6351), UINT32_C(0x14292967),
-		UINT32_C(0x27B70A85), UINT32_C(0x2E1B2138), UINT32_C(0x4D2C6DFC), UINT32_C(0x53380D13),
-		UINT32_C(0x650A7354), UINT32_C(0x766A0ABB), UINT32_C(0x81C2C92E), UINT32_C(0x92722C85),
-		UINT32_C(0xA2BFE8A1), UINT32_C(0xA81A664B), UINT32_C(0xC24B8B70), UINT32_C(0xC76C51A3),
-		UINT32_C(0xD192E819), UINT32_C(0xD6990624), UINT32_C(0xF40E3585), UINT32_C(0x106AA070),
-		UINT32_C(0x19A4C116), UINT32_C(0x1E376C08), UINT32_C(0x2748774C), UINT32_C(0x34B0BCB5),
-		UINT32_C(0x391C0CB3), UINT32_C(0x4ED8AA4A), UINT32_C(0x5B9CCA4F), UINT32_C(0x682E6FF3),
-		UINT32_C(0x748F82EE), UINT32_C(0x78A5636F), UINT32_C(0x84C87814), UINT32_C(0x8CC70208),
-		UINT32_C(0x90BEFFFA), UINT32_C(0xA4506CEB), UINT32_C(0xBEF9A3F7), UINT32_C(0xC67178F2),
-	};
+	const uint32_t *const K = digest_sha2_256_K;
 
 	uint32_t *const W = (uint32_t *) state->sha2_256.buf;
 	uint32_t j = 0x00U;
@@ -208,52 +218,243 @@ digest_transform_block_sha2_256(union digest_direct_ctx *const state, const uint
 	(void) smemzero(s, sizeof s);
 }
 
+#ifdef DIGEST_DIRECT_HAVE_X86_SHA
+static void DIGEST_DIRECT_X86_SHA_TARGET
+digest_transform_block_sha2_256_x86(union digest_direct_ctx *const state, const uint32_t *data)
+{
+	const __m128i mask = _mm_set_epi64x(INT64_C(0x0C0D0E0F08090A0B), INT64_C(0x0405060700010203));
+	const unsigned char *const in = (const void *) data;
+	const uint32_t *const K = digest_sha2_256_K;
+
+	__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const void *) &state->sha2_256.state[0x00U]), 0xB1);
+	__m128i cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const void *) &state->sha2_256.state[0x04U]), 0x1B);
+	__m128i abef = _mm_alignr_epi8(tmp, cdgh, 8);
+
+	cdgh = _mm_blend_epi16(cdgh, tmp, 0xF0);
+
+	const __m128i abef_save = abef;
+	const __m128i cdgh_save = cdgh;
+
+	__m128i msg, msg0, msg1, msg2, msg3;
+
+	/* rounds 0-3 */
+	msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const void *) (in + 0x00U)), mask);
+	msg = _mm_add_epi32(msg0, _mm_loadu_si128((const void *) &K[0x00U]));
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+
+	/* rounds 4-7 */
+	msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const void *) (in + 0x10U)), mask);
+	msg = _mm_add_epi32(msg1, _mm_loadu_si128((const void *) &K[0x04U]));
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+	msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+	/* rounds 8-11 */
+	msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const void *) (in + 0x20U)), mask);
+	msg = _mm_add_epi32(msg2, _mm_loadu_si128((const void *) &K[0x08U]));
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+	msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+	/* rounds 12-15 */
+	msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const void *) (in + 0x30U)), mask);
+	msg = _mm_add_epi32(msg3, _mm_loadu_si128((const void *) &K[0x0CU]));
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+	tmp = _mm_alignr_epi8(msg3, msg2, 4);
+	msg0 = _mm_sha256msg2_epu32(_mm_add_epi32(msg0, tmp), msg3);
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+	msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+	/* rounds 16-19 */
+	msg = _mm_add_epi32(msg0, _mm_loadu_si128((const void *) &K[0x10U]));
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+	tmp = _mm_alignr_epi8(msg0, msg3, 4);
+	msg1 = _mm_sha256msg2_epu32(_mm_add_epi32(msg1, tmp), msg0);
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+	msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+	/* rounds 20-23 */
+	msg = _mm_add_epi32(msg1, _mm_loadu_si128((const void *) &K[0x14U]));
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+	tmp = _mm_alignr_epi8(msg1, msg0, 4);
+	msg2 = _mm_sha256msg2_epu32(_mm_add_epi32(msg2, tmp), msg1);
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+	msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+	/* rounds 24-27 */
+	msg = _mm_add_epi32(msg2, _mm_loadu_si128((const void *) &K[0x18U]));
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+	tmp = _mm_alignr_epi8(msg2, msg1, 4);
+	msg3 = _mm_sha256msg2_epu32(_mm_add_epi32(msg3, tmp), msg2);
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+	msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+	/* rounds 28-31 */
+	msg = _mm_add_epi32(msg3, _mm_loadu_si128((const void *) &K[0x1CU]));
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+	tmp = _mm_alignr_epi8(msg3, msg2, 4);
+	msg0 = _mm_sha256msg2_epu32(_mm_add_epi32(msg0, tmp), msg3);
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+	msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+	/* rounds 32-35 */
+	msg = _mm_add_epi32(msg0, _mm_loadu_si128((const void *) &K[0x20U]));
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+	tmp = _mm_alignr_epi8(msg0, msg3, 4);
+	msg1 = _mm_sha256msg2_epu32(_mm_add_epi32(msg1, tmp), msg0);
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+	msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+	/* rounds 36-39 */
+	msg = _mm_add_epi32(msg1, _mm_loadu_si128((const void *) &K[0x24U]));
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+	tmp = _mm_alignr_epi8(msg1, msg0, 4);
+	msg2 = _mm_sha256msg2_epu32(_mm_add_epi32(msg2, tmp), msg1);
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+	msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+	/* rounds 40-43 */
+	msg = _mm_add_epi32(msg2, _mm_loadu_si128((const void *) &K[0x28U]));
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+	tmp = _mm_alignr_epi8(msg2, msg1, 4);
+	msg3 = _mm_sha256msg2_epu32(_mm_add_epi32(msg3, tmp), msg2);
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+	msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+	/* rounds 44-47 */
+	msg = _mm_add_epi32(msg3, _mm_loadu_si128((const void *) &K[0x2CU]));
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+	tmp = _mm_alignr_epi8(msg3, msg2, 4);
+	msg0 = _mm_sha256msg2_epu32(_mm_add_epi32(msg0, tmp), msg3);
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+	msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+	/* rounds 48-51 */
+	msg = _mm_add_epi32(msg0, _mm_loadu_si128((const void *) &K[0x30U]));
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+	tmp = _mm_alignr_epi8(msg0, msg3, 4);
+	msg1 = _mm_sha256msg2_epu32(_mm_add_epi32(msg1, tmp), msg0);
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+	msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+	/* rounds 52-55 */
+	msg = _mm_add_epi32(msg1, _mm_loadu_si128((const void *) &K[0x34U]));
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+	tmp = _mm_alignr_epi8(msg1, msg0, 4);
+	msg2 = _mm_sha256msg2_epu32(_mm_add_epi32(msg2, tmp), msg1);
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+
+	/* rounds 56-59 */
+	msg = _mm_add_epi32(msg2, _mm_loadu_si128((const void *) &K[0x38U]));
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+	tmp = _mm_alignr_epi8(msg2, msg1, 4);
+	msg3 = _mm_sha256msg2_epu32(_mm_add_epi32(msg3, tmp), msg2);
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+
+	/* rounds 60-63 */
+	msg = _mm_add_epi32(msg3, _mm_loadu_si128((const void *) &K[0x3CU]));
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+
+	abef = _mm_add_epi32(abef, abef_save);
+	cdgh = _mm_add_epi32(cdgh, cdgh_save);
+
+	tmp = _mm_shuffle_epi32(abef, 0x1B);
+	cdgh = _mm_shuffle_epi32(cdgh, 0xB1);
+
+	(void) _mm_storeu_si128((void *) &state->sha2_256.state[0x00U], _mm_blend_epi16(tmp, cdgh, 0xF0));
+	(void) _mm_storeu_si128((void *) &state->sha2_256.state[0x04U], _mm_alignr_epi8(cdgh, tmp, 8));
+}
+#endif /* DIGEST_DIRECT_HAVE_X86_SHA */
+
+#ifdef DIGEST_DIRECT_HAVE_ARMV8_SHA
+static void DIGEST_DIRECT_ARMV8_SHA_TARGET
+digest_transform_block_sha2_256_armv8(union digest_direct_ctx *const state, const uint32_t *data)
+{
+	const unsigned char *const in = (const void *) data;
+
+	const uint32x4_t s0_save = vld1q_u32(&state->sha2_256.state[0x00U]);
+	const uint32x4_t s1_save = vld1q_u32(&state->sha2_256.state[0x04U]);
+
+	uint32x4_t s0 = s0_save;
+	uint32x4_t s1 = s1_save;
+	uint32x4_t msg[0x04U];
+
+	for (uint32_t i = 0x00U; i < 0x04U; i++)
+		msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(in + (i * 0x10U))));
+
+	for (uint32_t g = 0x00U; g < 0x10U; g++)
+	{
+		const uint32x4_t wk = vaddq_u32(msg[g & 0x03U], vld1q_u32(&digest_sha2_256_K[g * 0x04U]));
+		const uint32x4_t t = s0;
+
+		if (g < 0x0CU)
+			msg[g & 0x03U] = vsha256su0q_u32(msg[g & 0x03U], msg[(g + 0x01U) & 0x03U]);
+
+		s0 = vsha256hq_u32(s0, s1, wk);
+		s1 = vsha256h2q_u32(s1, t, wk);
+
+		if (g < 0x0CU)
+			msg[g & 0x03U] = vsha256su1q_u32(msg[g & 0x03U], msg[(g + 0x02U) & 0x03U], msg[(g + 0x03U) & 0x03U]);
+	}
+
+	(void) vst1q_u32(&state->sha2_256.state[0x00U], vaddq_u32(s0, s0_save));
+	(void) vst1q_u32(&state->sha2_256.state[0x04U], vaddq_u32(s1, s1_save));
+}
+#endif /* DIGEST_DIRECT_HAVE_ARMV8_SHA */
+
+static void (*digest_transform_block_sha2_256)(union digest_direct_ctx *, const uint32_t *) =
+    &digest_transform_block_sha2_256_portable;
+
+static const uint64_t digest_sha2_512_K[] = {
+
+	UINT64_C(0x428A2F98D728AE22), UINT64_C(0x7137449123EF65CD),
+	UINT64_C(0xB5C0FBCFEC4D3B2F), UINT64_C(0xE9B5DBA58189DBBC),
+	UINT64_C(0x3956C25BF348B538), UINT64_C(0x59F111F1B605D019),
+	UINT64_C(0x923F82A4AF194F9B), UINT64_C(0xAB1C5ED5DA6D8118),
+	UINT64_C(0xD807AA98A3030242), UINT64_C(0x12835B0145706FBE),
+	UINT64_C(0x243185BE4EE4B28C), UINT64_C(0x550C7DC3D5FFB4E2),
+	UINT64_C(0x72BE5D74F27B896F), UINT64_C(0x80DEB1FE3B1696B1),
+	UINT64_C(0x9BDC06A725C71235), UINT64_C(0xC19BF174CF692694),
+	UINT64_C(0xE49B69C19EF14AD2), UINT64_C(0xEFBE4786384F25E3),
+	UINT64_C(0x0FC19DC68B8CD5B5), UINT64_C(0x240CA1CC77AC9C65),
+	UINT64_C(0x2DE92C6F592B0275), UINT64_C(0x4A7484AA6EA6E483),
+	UINT64_C(0x5CB0A9DCBD41FBD4), UINT64_C(0x76F988DA831153B5),
+	UINT64_C(0x983E5152EE66DFAB), UINT64_C(0xA831C66D2DB43210),
+	UINT64_C(0xB00327C898FB213F), UINT64_C(0xBF597FC7BEEF0EE4),
+	UINT64_C(0xC6E00BF33DA88FC2), UINT64_C(0xD5A79147930AA725),
+	UINT64_C(0x06CA6351E003826F), UINT64_C(0x142929670A0E6E70),
+	UINT64_C(0x27B70A8546D22FFC), UINT64_C(0x2E1B21385C26C926),
+	UINT64_C(0x4D2C6DFC5AC42AED), UINT64_C(0x53380D139D95B3DF),
+	UINT64_C(0x650A73548BAF63DE), UINT64_C(0x766A0ABB3C77B2A8),
+	UINT64_C(0x81C2C92E47EDAEE6), UINT64_C(0x92722C851482353B),
+	UINT64_C(0xA2BFE8A14CF10364), UINT64_C(0xA81A664BBC423001),
+	UINT64_C(0xC24B8B70D0F89791), UINT64_C(0xC76C51A30654BE30),
+	UINT64_C(0xD192E819D6EF5218), UINT64_C(0xD69906245565A910),
+	UINT64_C(0xF40E35855771202A), UINT64_C(0x106AA07032BBD1B8),
+	UINT64_C(0x19A4C116B8D2D0C8), UINT64_C(0x1E376C085141AB53),
+	UINT64_C(0x2748774CDF8EEB99), UINT64_C(0x34B0BCB5E19B48A8),
+	UINT64_C(0x391C0CB3C5C95A63), UINT64_C(0x4ED8AA4AE3418ACB),
+	UINT64_C(0x5B9CCA4F7763E373), UINT64_C(0x682E6FF3D6B2B8A3),
+	UINT64_C(0x748F82EE5DEFB2FC), UINT64_C(0x78A5636F43172F60),
+	UINT64_C(0x84C87814A1F0AB72), UINT64_C(0x8CC702081A6439EC),
+	UINT64_C(0x90BEFFFA23631E28), UINT64_C(0xA4506CEBDE82BDE9),
+	UINT64_C(0xBEF9A3F7B2C67915), UINT64_C(0xC67178F2E372532B),
+	UINT64_C(0xCA273ECEEA26619C), UINT64_C(0xD186B8C721C0C207),
+	UINT64_C(0xEADA7DD6CDE0EB1E), UINT64_C(0xF57D4F7FEE6ED178),
+	UINT64_C(0x06F067AA72176FBA), UINT64_C(0x0A637DC5A2C898A6),
+	UINT64_C(0x113F9804BEF90DAE), UINT64_C(0x1B710B35131C471B),
+	UINT64_C(0x28DB77F523047D84), UINT64_C(0x32CAAB7B40C72493),
+	UINT64_C(0x3C9EBE0A15C9BEBC), UINT64_C(0x431D67C49C100D4C),
+	UINT64_C(0x4CC5D4BECB3E42B6), UINT64_C(0x597F299CFC657E2A),
+	UINT64_C(0x5FCB6FAB3AD6FAEC), UINT64_C(0x6C44198C4A475817),
+};
+
 static void
 digest_transform_block_sha2_512(union digest_direct_ctx *const state, const uint64_t *data)
 {
-	static const uint64_t K[] = {
-
-		UINT64_C(0x428A2F98D728AE22), UINT64_C(0x7137449123EF65CD),
-		UINT64_C(0xB5C0FBCFEC4D3B2F), UINT64_C(0xE9B5DBA58189DBBC),
-		UINT64_C(0x3956C25BF348B538), UINT64_C(0x59F111F1B605D019),
-		UINT64_C(0x923F82A4AF194F9B), UINT64_C(0xAB1C5ED5DA6D8118),
-		UINT64_C(0xD807AA98A3030242), UINT64_C(0x12835B0145706FBE),
-		UINT64_C(0x243185BE4EE4B28C), UINT64_C(0x550C7DC3D5FFB4E2),
-		UINT64_C(0x72BE5D74F27B896F), UINT64_C(0x80DEB1FE3B1696B1),
-		UINT64_C(0x9BDC06A725C71235), UINT64_C(0xC19BF174CF692694),
-		UINT64_C(0xE49B69C19EF14AD2), UINT64_C(0xEFBE4786384F25E3),
-		UINT64_C(0x0FC19DC68B8CD5B5), UINT64_C(0x240CA1CC77AC9C65),
-		UINT64_C(0x2DE92C6F592B0275), UINT64_C(0x4A7484AA6EA6E483),
-		UINT64_C(0x5CB0A9DCBD41FBD4), UINT64_C(0x76F988DA831153B5),
-		UINT64_C(0x983E5152EE66DFAB), UINT64_C(0xA831C66D2DB43210),
-		UINT64_C(0xB00327C898FB213F), UINT64_C(0xBF597FC7BEEF0EE4),
-		UINT64_C(0xC6E00BF33DA88FC2), UINT64_C(0xD5A79147930AA725),
-		UINT64_C(0x06CA6351E003826F), UINT64_C(0x142929670A0E6E70),
-		UINT64_C(0x27B70A8546D22FFC), UINT64_C(0x2E1B21385C26C926),
-		UINT64_C(0x4D2C6DFC5AC42AED), UINT64_C(0x53380D139D95B3DF),
-		UINT64_C(0x650A73548BAF63DE), UINT64_C(0x766A0ABB3C77B2A8),
-		UINT64_C(0x81C2C92E47EDAEE6), UINT64_C(0x92722C851482353B),
-		UINT64_C(0xA2BFE8A14CF10364), UINT64_C(0xA81A664BBC423001),
-		UINT64_C(0xC24B8B70D0F89791), UINT64_C(0xC76C51A30654BE30),
-		UINT64_C(0xD192E819D6EF5218), UINT64_C(0xD69906245565A910),
-		UINT64_C(0xF40E35855771202A), UINT64_C(0x106AA07032BBD1B8),
-		UINT64_C(0x19A4C116B8D2D0C8), UINT64_C(0x1E376C085141AB53),
-		UINT64_C(0x2748774CDF8EEB99), UINT64_C(0x34B0BCB5E19B48A8),
-		UINT64_C(0x391C0CB3C5C95A63), UINT64_C(0x4ED8AA4AE3418ACB),
-		UINT64_C(0x5B9CCA4F7763E373), UINT64_C(0x682E6FF3D6B2B8A3),
-		UINT64_C(0x748F82EE5DEFB2FC), UINT64_C(0x78A5636F43172F60),
-		UINT64_C(0x84C87814A1F0AB72), UINT64_C(0x8CC702081A6439EC),
-		UINT64_C(0x90BEFFFA23631E28), UINT64_C(0xA4506CEBDE82BDE9),
-		UINT64_C(0xBEF9A3F7B2C67915), UINT64_C(0xC67178F2E372532B),
-		UINT64_C(0xCA273ECEEA26619C), UINT64_C(0xD186B8C721C0C207),
-		UINT64_C(0xEADA7DD6CDE0EB1E), UINT64_C(0xF57D4F7FEE6ED178),
-		UINT64_C(0x06F067AA72176FBA), UINT64_C(0x0A637DC5A2C898A6),
-		UINT64_C(0x113F9804BEF90DAE), UINT64_C(0x1B710B35131C471B),
-		UINT64_C(0x28DB77F523047D84), UINT64_C(0x32CAAB7B40C72493),
-		UINT64_C(0x3C9EBE0A15C9BEBC), UINT64_C(0x431D67C49C100D4C),
-		UINT64_C(0x4CC5D4BECB3E42B6), UINT64_C(0x597F299CFC657E2A),
-		UINT64_C(0x5FCB6FAB3AD6FAEC), UINT64_C(0x6C44198C4A475817),
-	};
+	const uint64_t *const K = digest_sha2_512_K;
 
 	uint64_t *const W = (uint64_t *) state->sha2_512.buf;
 	uint64_t j = 0x00U;
@@ -292,6 +493,94 @@ digest_transform_block_sha2_512(union digest_direct_ctx *const state, const uint
 	(void) smemzero(s, sizeof s);
 }
 
+bool
+digest_direct_use_kernel_sha2_256(const enum digest_direct_kernel kernel)
+{
+	switch (kernel)
+	{
+		case DIGEST_DIRECT_KERNEL_PORTABLE:
+			digest_transform_block_sha2_256 = &digest_transform_block_sha2_256_portable;
+			return true;
+
+#ifdef DIGEST_DIRECT_HAVE_X86_SHA
+		case DIGEST_DIRECT_KERNEL_X86_SHA:
+			digest_transform_block_sha2_256 = &digest_transform_block_sha2_256_x86;
+			return true;
+#endif
+
+#ifdef DIGEST_DIRECT_HAVE_ARMV8_SHA
+		case DIGEST_DIRECT_KERNEL_ARMV8_SHA:
+			digest_transform_block_sha2_256 = &digest_transform_block_sha2_256_armv8;
+			return true;
+#endif
+
+		default:
+			return false;
+	}
+}
+
+void DIGEST_DIRECT_LANES_TARGET
+digest_direct_lanes_sha2_256(digest_direct_lane32 *const restrict state, digest_direct_lane32 *const restrict W)
+{
+	digest_direct_lane32 s[DIGEST_IVLEN_SHA2_256];
+
+	(void) memcpy(s, state, sizeof s);
+
+	for (uint32_t j = 0x00U; j < 0x40U; j++)
+	{
+		if (j >= 0x10U)
+			W[j & 0x0FU] += SHA2_256_sigma1(W[(j + 0x0EU) & 0x0FU]) + W[(j + 0x09U) & 0x0FU] +
+			                SHA2_256_sigma0(W[(j + 0x01U) & 0x0FU]);
+
+		const digest_direct_lane32 t1 = s[0x07U] + SHA2_256_Sigma1(s[0x04U]) +
+		                                SHA2_Ch(s[0x04U], s[0x05U], s[0x06U]) + digest_sha2_256_K[j] + W[j & 0x0FU];
+		const digest_direct_lane32 t2 = SHA2_256_Sigma0(s[0x00U]) + SHA2_Maj(s[0x00U], s[0x01U], s[0x02U]);
+
+		s[0x07U] = s[0x06U];
+		s[0x06U] = s[0x05U];
+		s[0x05U] = s[0x04U];
+		s[0x04U] = s[0x03U] + t1;
+		s[0x03U] = s[0x02U];
+		s[0x02U] = s[0x01U];
+		s[0x01U] = s[0x00U];
+		s[0x00U] = t1 + t2;
+	}
+
+	for (size_t x = 0x00U; x < DIGEST_IVLEN_SHA2_256; x++)
+		state[x] += s[x];
+}
+
+void DIGEST_DIRECT_LANES_TARGET
+digest_direct_lanes_sha2_512(digest_direct_lane64 *const restrict state, digest_direct_lane64 *const restrict W)
+{
+	digest_direct_lane64 s[DIGEST_IVLEN_SHA2_512];
+
+	(void) memcpy(s, state, sizeof s);
+
+	for (uint32_t j = 0x00U; j < 0x50U; j++)
+	{
+		if (j >= 0x10U)
+			W[j & 0x0FU] += SHA2_512_sigma1(W[(j + 0x0EU) & 0x0FU]) + W[(j + 0x09U) & 0x0FU] +
+			                SHA2_512_sigma0(W[(j + 0x01U) & 0x0FU]);
+
+		const digest_direct_lane64 t1 = s[0x07U] + SHA2_512_Sigma1(s[0x04U]) +
+		                                SHA2_Ch(s[0x04U], s[0x05U], s[0x06U]) + digest_sha2_512_K[j] + W[j & 0x0FU];
+		const digest_direct_lane64 t2 = SHA2_512_Sigma0(s[0x00U]) + SHA2_Maj(s[0x00U], s[0x01U], s[0x02U]);
+
+		s[0x07U] = s[0x06U];
+		s[0x06U] = s[0x05U];
+		s[0x05U] = s[0x04U];
+		s[0x04U] = s[0x03U] + t1;
+		s[0x03U] = s[0x02U];
+		s[0x02U] = s[0x01U];
+		s[0x01U] = s[0x00U];
+		s[0x00U] = t1 + t2;
+	}
+
+	for (size_t x = 0x00U; x < DIGEST_IVLEN_SHA2_512; x++)
+		state[x] += s[x];
+}
+
 void
 digest_direct_init_sha2_256(union digest_direct_ctx *const restrict state)
 {
@@ -11,20 +11,109 @@
 #  error "Do not compile me directly; compile digest_frontend.c instead"
 #endif /* !ATHEME_LAC_DIGEST_FRONTEND_C */
 
+#ifdef DIGEST_DIRECT_HAVE_X86_SHA
+#  include <cpuid.h>
+#  ifndef bit_SHA
+#    define bit_SHA                 (1U << 29U)
+#  endif
+#endif /* DIGEST_DIRECT_HAVE_X86_SHA */
+
+#ifdef DIGEST_DIRECT_HAVE_ARMV8_SHA
+#  include <sys/auxv.h>
+#  include <asm/hwcap.h>
+#  ifndef HWCAP_SHA1
+#    define HWCAP_SHA1              (1UL << 5U)
+#  endif
+#  ifndef HWCAP_SHA2
+#    define HWCAP_SHA2              (1UL << 6U)
+#  endif
+#endif /* DIGEST_DIRECT_HAVE_ARMV8_SHA */
+
 #define DIGEST_HMAC_INNER_XORVAL    0x36U
 #define DIGEST_HMAC_OUTER_XORVAL    0x5CU
 
 static bool _digest_oneshot(enum digest_algorithm, const void *, size_t, void *, size_t *);
 
+static enum digest_direct_kernel digest_kernel = DIGEST_DIRECT_KERNEL_PORTABLE;
+
+static enum digest_direct_kernel
+digest_probe_kernel(void)
+{
+#ifdef DIGEST_DIRECT_HAVE_X86_SHA
+	unsigned int eax = 0U;
+	unsigned int ebx = 0U;
+	unsigned int ecx = 0U;
+	unsigned int edx = 0U;
+
+	// The SHA Extensions kernels also need SSSE3 (PSHUFB) and SSE4.1 (PBLENDW, PEXTRD)
+	if (! __get_cpuid(1U, &eax, &ebx, &ecx, &edx))
+		return DIGEST_DIRECT_KERNEL_PORTABLE;
+
+	if (! ((ecx & bit_SSSE3) && (ecx & bit_SSE4_1)))
+		return DIGEST_DIRECT_KERNEL_PORTABLE;
+
+	if (__get_cpuid_max(0U, NULL) < 7U)
+		return DIGEST_DIRECT_KERNEL_PORTABLE;
+
+	__cpuid_count(7U, 0U, eax, ebx, ecx, edx);
+
+	if (ebx & bit_SHA)
+		return DIGEST_DIRECT_KERNEL_X86_SHA;
+#endif /* DIGEST_DIRECT_HAVE_X86_SHA */
+
+#ifdef DIGEST_DIRECT_HAVE_ARMV8_SHA
+	const unsigned long int hwcap = getauxval(AT_HWCAP);
+
+	if ((hwcap & HWCAP_SHA1) && (hwcap & HWCAP_SHA2))
+		return DIGEST_DIRECT_KERNEL_ARMV8_SHA;
+#endif /* DIGEST_DIRECT_HAVE_ARMV8_SHA */
+
+	return DIGEST_DIRECT_KERNEL_PORTABLE;
+}
+
+static void
+digest_select_kernels(void)
+{
+	static bool selected = false;
+
+	if (selected)
+		return;
+
+	const enum digest_direct_kernel kernel = digest_probe_kernel();
+
+	if (digest_direct_use_kernel_sha1(kernel) && digest_direct_use_kernel_sha2_256(kernel))
+		digest_kernel = kernel;
+	else
+	{
+		(void) digest_direct_use_kernel_sha1(DIGEST_DIRECT_KERNEL_PORTABLE);
+		(void) digest_direct_use_kernel_sha2_256(DIGEST_DIRECT_KERNEL_PORTABLE);
+	}
+
+	selected = true;
+}
+
 const char *
 digest_get_frontend_info(void)
 {
-	return "Internal MD5/SHA1/SHA2/HMAC/PBKDF2 Fallback";
+	(void) digest_select_kernels();
+
+	switch (digest_kernel)
+	{
+		case DIGEST_DIRECT_KERNEL_X86_SHA:
+			return "Internal MD5/SHA1/SHA2/HMAC/PBKDF2 Fallback (x86 SHA Extensions)";
+
+		case DIGEST_DIRECT_KERNEL_ARMV8_SHA:
+			return "Internal MD5/SHA1/SHA2/HMAC/PBKDF2 Fallback (ARMv8 Cryptography Extensions)";
+
+		default:
+			return "Internal MD5/SHA1/SHA2/HMAC/PBKDF2 Fallback";
+	}
 }
 
 static bool
 _digest_init(struct digest_context *const restrict ctx, const enum digest_algorithm alg)
 {
+	(void) digest_select_kernels();
 	(void) memset(ctx, 0x00, sizeof *ctx);
 
 	ctx->alg = alg;
@@ -4954,6 +4954,66 @@ digest_testsuite_run_pbkdf2_sha2_512(void)
 	return true;
 }
 
+static bool
+digest_testsuite_run_pbkdf2_batch(const enum digest_algorithm alg)
+{
+	/* The batched implementation must agree with the (vector-tested) one-at-a-time implementation, for
+	 * more jobs than there are lanes, for passwords longer than the block size, and for derived keys
+	 * longer than the digest size (which take up more than one lane each).
+	 */
+	static const unsigned char pass[] = {
+		0x70U, 0x61U, 0x73U, 0x73U, 0x77U, 0x6FU, 0x72U, 0x64U, 0x50U, 0x41U, 0x53U, 0x53U, 0x57U, 0x4FU, 0x52U,
+		0x44U, 0x70U, 0x61U, 0x73U, 0x73U, 0x77U, 0x6FU, 0x72U, 0x64U, 0x50U, 0x41U, 0x53U, 0x53U, 0x57U, 0x4FU,
+		0x52U, 0x44U, 0x70U, 0x61U, 0x73U, 0x73U, 0x77U, 0x6FU, 0x72U, 0x64U, 0x50U, 0x41U, 0x53U, 0x53U, 0x57U,
+		0x4FU, 0x52U, 0x44U, 0x70U, 0x61U, 0x73U, 0x73U, 0x77U, 0x6FU, 0x72U, 0x64U, 0x50U, 0x41U, 0x53U, 0x53U,
+		0x57U, 0x4FU, 0x52U, 0x44U, 0x70U, 0x61U, 0x73U, 0x73U, 0x77U, 0x6FU, 0x72U, 0x64U, 0x50U, 0x41U, 0x53U,
+		0x53U, 0x57U, 0x4FU, 0x52U, 0x44U, 0x70U, 0x61U, 0x73U, 0x73U, 0x77U, 0x6FU, 0x72U, 0x64U, 0x50U, 0x41U,
+		0x53U, 0x53U, 0x57U, 0x4FU, 0x52U, 0x44U, 0x70U, 0x61U, 0x73U, 0x73U, 0x77U, 0x6FU, 0x72U, 0x64U, 0x50U,
+		0x41U, 0x53U, 0x53U, 0x57U, 0x4FU, 0x52U, 0x44U, 0x70U, 0x61U, 0x73U, 0x73U, 0x77U, 0x6FU, 0x72U, 0x64U,
+		0x50U, 0x41U, 0x53U, 0x53U, 0x57U, 0x4FU, 0x52U, 0x44U, 0x70U, 0x61U, 0x73U, 0x73U, 0x77U, 0x6FU, 0x72U,
+		0x64U, 0x50U,
+	};
+
+	static const unsigned char salt[] = {
+		0x73U, 0x61U, 0x6CU, 0x74U, 0x53U, 0x41U, 0x4CU, 0x54U, 0x73U, 0x61U, 0x6CU, 0x74U, 0x53U, 0x41U, 0x4CU,
+		0x54U, 0x73U, 0x61U, 0x6CU, 0x74U, 0x53U, 0x41U, 0x4CU, 0x54U, 0x73U, 0x61U, 0x6CU, 0x74U, 0x53U, 0x41U,
+		0x4CU, 0x54U, 0x73U, 0x61U, 0x6CU, 0x74U,
+	};
+
+	static const uint32_t iter = 32;
+
+	struct digest_pbkdf2_job jobs[0x0BU];
+	unsigned char result[0x0BU][0x60U];
+	unsigned char vector[sizeof result[0]];
+
+	(void) slog(LG_DEBUG, "%s: %zu lane(s)", MOWGLI_FUNC_NAME, digest_pbkdf2_batch_lanes(alg));
+
+	for (size_t i = 0; i < ARRAY_SIZE(jobs); i++)
+	{
+		jobs[i].pass = pass + i;
+		jobs[i].passLen = sizeof pass - (i * 0x0DU);
+		jobs[i].salt = salt + i;
+		jobs[i].saltLen = sizeof salt - (i * 0x03U);
+		jobs[i].dk = result[i];
+		jobs[i].dkLen = sizeof result[i] - (i * 0x07U);
+	}
+
+	if (! digest_oneshot_pbkdf2_batch(alg, iter, jobs, ARRAY_SIZE(jobs)))
+		return false;
+
+	for (size_t i = 0; i < ARRAY_SIZE(jobs); i++)
+	{
+		if (! digest_oneshot_pbkdf2(alg, jobs[i].pass, jobs[i].passLen, jobs[i].salt, jobs[i].saltLen, iter,
+		                            vector, jobs[i].dkLen))
+			return false;
+
+		if (memcmp(result[i], vector, jobs[i].dkLen) != 0)
+			return false;
+	}
+
+	return true;
+}
+
 bool
 digest_testsuite_run(void)
 {
@@ -4982,6 +5042,9 @@ digest_testsuite_run(void)
 	if (! digest_testsuite_run_pbkdf2_sha1())
 		return false;
 
+	if (! digest_testsuite_run_pbkdf2_batch(DIGALG_SHA1))
+		return false;
+
 
 	if (! digest_testsuite_run_sha2_256())
 		return false;
@@ -4995,6 +5058,9 @@ digest_testsuite_run(void)
 	if (! digest_testsuite_run_pbkdf2_sha2_256())
 		return false;
 
+	if (! digest_testsuite_run_pbkdf2_batch(DIGALG_SHA2_256))
+		return false;
+
 
 	if (! digest_testsuite_run_sha2_512())
 		return false;
@@ -5008,6 +5074,9 @@ digest_testsuite_run(void)
 	if (! digest_testsuite_run_pbkdf2_sha2_512())
 		return false;
 
+	if (! digest_testsuite_run_pbkdf2_batch(DIGALG_SHA2_512))
+		return false;
+
 
 	return true;
 }
@@ -71,12 +71,38 @@ myentity_alloc_uid(void)
 	return last_entity_uid;
 }
 
+/* Position of an ID character in the order myentity_alloc_uid() uses */
+static unsigned int
+myentity_uid_rank(const char c)
+{
+	return (c >= '0' && c <= '9') ? (unsigned int) (c - '0') + 26U : (unsigned int) (c - 'A');
+}
+
+/* Whether myentity_alloc_uid() hands out (or would hand out) ID a after ID b */
+bool
+myentity_uid_after(const char *const restrict a, const char *const restrict b)
+{
+	for (size_t i = 0; i < IDLEN; i++)
+	{
+		if (a[i] == '\0' || b[i] == '\0')
+			return false;
+
+		if (a[i] != b[i])
+			return myentity_uid_rank(a[i]) > myentity_uid_rank(b[i]);
+	}
+
+	return false;
+}
+
 void
 myentity_put(struct myentity *mt)
 {
 	/* If the entity doesn't have an ID yet, allocate one */
 	if (mt->id[0] == '\0')
 		mowgli_strlcpy(mt->id, myentity_alloc_uid(), sizeof mt->id);
+	/* Never hand out an ID again that has already been loaded, whatever LUID said */
+	else if (myentity_uid_after(mt->id, last_entity_uid))
+		(void) mowgli_strlcpy(last_entity_uid, mt->id, sizeof last_entity_uid);
 
 	mowgli_patricia_add(entities, mt->name, mt);
 	mowgli_patricia_add(entities_by_id, mt->id, mt);
@@ -117,6 +117,15 @@ tv2ms(struct timeval *tv)
 }
 #endif
 
+#ifdef HAVE_GETTIMEOFDAY
+/* translates a timeval into microseconds */
+unsigned long long
+tv2us(const struct timeval *tv)
+{
+	return ((unsigned long long) tv->tv_sec * 1000000ULL) + (unsigned long long) tv->tv_usec;
+}
+#endif
+
 /* replaces tabs with a single ASCII 32 */
 void
 tb2sp(char *line)
@@ -366,8 +375,10 @@ canonicalize_emails(void)
 	{
 		struct myuser *mu = user(mt);
 
+		myuser_index_email_delete(mu);
 		strshare_unref(mu->email_canonical);
 		mu->email_canonical = canonicalize_email(mu->email);
+		myuser_index_email_add(mu);
 	}
 }
 
@@ -431,13 +442,24 @@ canonicalize_email_case(char email[static (EMAILLEN + 1)], void *user_data)
 	strcasecanon(email);
 }
 
+/* Whether match(pattern, email) can only succeed when the email address is
+ * the pattern itself, ignoring ASCII case. Such a pattern can be looked up
+ * by its canonical form instead of being matched against every account.
+ */
+bool
+email_pattern_is_literal(const char *pattern)
+{
+	return_val_if_fail(pattern != NULL, false);
+
+	// match() wildcards and escape, and the characters rfc1459 folds differently from ASCII
+	return (*pattern != '\0' && strpbrk(pattern, "*?&#%\\[]^{}|~") == NULL);
+}
+
 bool
 email_within_limits(const char *email)
 {
 	mowgli_node_t *n;
-	struct myentity_iteration_state state;
-	struct myentity *mt;
-	unsigned int tcnt = 0;
+	const mowgli_list_t *accounts;
 	stringref email_canonical;
 	bool result = true;
 
@@ -452,19 +474,8 @@ email_within_limits(const char *email)
 
 	email_canonical = canonicalize_email(email);
 
-	MYENTITY_FOREACH_T(mt, &state, ENT_USER)
-	{
-		struct myuser *mu = user(mt);
-
-		if (mu->email_canonical == email_canonical)
-			tcnt++;
-
-		/* optimization: if tcnt >= me.maxusers, quit iterating. -nenolod */
-		if (tcnt >= me.maxusers) {
-			result = false;
-			break;
-		}
-	}
+	if ((accounts = myuser_index_email(email_canonical)) != NULL && MOWGLI_LIST_LENGTH(accounts) >= me.maxusers)
+		result = false;
 
 	strshare_unref(email_canonical);
 	return result;
@@ -666,19 +677,6 @@ has_ctrl_chars(const char *text)
 	return false;
 }
 
-#ifndef MOWGLI_OS_WIN
-static void
-sendemail_waited(pid_t pid, int status, void *data)
-{
-	char *email;
-
-	email = data;
-	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
-		slog(LG_INFO, "sendemail_waited(): email for %s failed", email);
-	sfree(email);
-}
-#endif
-
 /* send the specified type of email.
  *
  * u is whoever caused this to be called, the corresponding service
@@ -686,6 +684,9 @@ sendemail_waited(pid_t pid, int status, void *data)
  * type is EMAIL_*, see include/tools.h
  * mu is the recipient user
  * param depends on type, also see include/tools.h
+ *
+ * the message is written to the mail spool and delivered later by
+ * the mail queue (see mailqueue.c); success means it was queued.
  */
 int
 sendemail(struct user *u, struct myuser *mu, const char *type, const char *email, const char *param)
@@ -693,12 +694,10 @@ sendemail(struct user *u, struct myuser *mu, const char *type, const char *email
 #ifndef MOWGLI_OS_WIN
 	char *date = NULL;
 	char timebuf[BUFSIZE], to[BUFSIZE], from[BUFSIZE], buf[BUFSIZE], pathbuf[BUFSIZE], sourceinfo[BUFSIZE];
+	char spoolname[BUFSIZE];
 	FILE *in, *out;
 	time_t t;
 	struct tm *tm;
-	int pipfds[2];
-	pid_t pid;
-	int rc;
 	static time_t period_start = 0, lastwallops = 0;
 	static unsigned int emailcount = 0;
 	struct service *svs;
@@ -775,26 +774,11 @@ sendemail(struct user *u, struct myuser *mu, const char *type, const char *email
 	snprintf(sourceinfo, sizeof sourceinfo, "%s[%s@%s]", u->nick, u->user, u->vhost);
 
 	/* now set up the email */
-	if (pipe(pipfds) < 0)
+	if ((out = mailqueue_create(email, spoolname, sizeof spoolname)) == NULL)
 	{
 		fclose(in);
 		return 0;
 	}
-	switch (pid = fork())
-	{
-		case -1:
-			fclose(in);
-			return 0;
-		case 0:
-			connection_close_all_fds();
-			close(pipfds[1]);
-			dup2(pipfds[0], 0);
-			execl(me.mta, me.mta, "-t", "-f", me.register_email, NULL);
-			_exit(255);
-	}
-	close(pipfds[0]);
-	childproc_add(pid, "email", sendemail_waited, sstrdup(email));
-	out = fdopen(pipfds[1], "w");
 
 	while (fgets(buf, BUFSIZE, in))
 	{
@@ -857,14 +841,12 @@ sendemail(struct user *u, struct myuser *mu, const char *type, const char *email
 
 	fclose(in);
 
-	rc = 1;
-	if (ferror(out))
-		rc = 0;
-	if (fclose(out) < 0)
-		rc = 0;
-	if (rc == 0)
-		slog(LG_ERROR, "sendemail(): mta failure");
-	return rc;
+	if (!mailqueue_commit(out, spoolname))
+	{
+		slog(LG_ERROR, "sendemail(): cannot queue email for %s", email);
+		return 0;
+	}
+	return 1;
 #else
 # warning implement me :(
 	return 0;
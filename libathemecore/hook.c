@@ -18,21 +18,23 @@
 #include "internal.h"
 
 static mowgli_patricia_t *hooks = NULL;
-static mowgli_heap_t *hook_heap = NULL;
-static mowgli_heap_t *hook_privfn_heap = NULL;
+static struct sharedheap *hook_heap = NULL;
+static struct sharedheap *hook_privfn_heap = NULL;
+
+typedef struct {
+	hook_fn hookfn;
+	mowgli_node_t node;
+	struct hook_handler_stats stats;
+} hook_privfn_ctx_t;
 
 typedef struct {
 	struct hook *hook;
 	void *dptr;
 	mowgli_node_t node;
 	unsigned int flags;
+	hook_privfn_ctx_t *running;	/* NULL if the handler removed itself */
 } hook_run_ctx_t;
 
-typedef struct {
-	hook_fn hookfn;
-	mowgli_node_t node;
-} hook_privfn_ctx_t;
-
 #define HF_RUN		0x1
 #define HF_STOP		0x2
 
@@ -42,8 +44,8 @@ void
 hooks_init(void)
 {
 	hooks = mowgli_patricia_create(strcasecanon);
-	hook_heap = sharedheap_get(sizeof(struct hook));
-	hook_privfn_heap = sharedheap_get(sizeof(hook_privfn_ctx_t));
+	hook_heap = sharedheap_get("hook", sizeof(struct hook));
+	hook_privfn_heap = sharedheap_get("hook_handler", sizeof(hook_privfn_ctx_t));
 
 	if (hook_heap == NULL || hook_privfn_heap == NULL || hooks == NULL)
 	{
@@ -66,7 +68,7 @@ hook_add_event(const char *name)
 	if((nh = hook_find(name)) != NULL)
 		return nh;
 
-	nh = mowgli_heap_alloc(hook_heap);
+	nh = sharedheap_alloc(hook_heap);
 	nh->name = strshare_get(name);
 
 	mowgli_patricia_add(hooks, nh->name, nh);
@@ -77,8 +79,19 @@ hook_add_event(const char *name)
 static inline void
 hook_destroy(struct hook *hook, hook_privfn_ctx_t *priv)
 {
+	mowgli_node_t *n;
+
+	MOWGLI_ITER_FOREACH(n, hook_run_stack.head)
+	{
+		hook_run_ctx_t *ctx = n->data;
+
+		if (ctx->running == priv)
+			ctx->running = NULL;
+	}
+
+	strshare_unref(priv->stats.owner);
 	mowgli_node_delete(&priv->node, &hook->hooks);
-	mowgli_heap_free(hook_privfn_heap, priv);
+	sharedheap_free(hook_privfn_heap, priv);
 }
 
 void
@@ -113,8 +126,13 @@ hook_create_and_add(struct hook *hook, hook_fn handler,
 	return_val_if_fail(handler != NULL, NULL);
 	return_val_if_fail(addfn != NULL, NULL);
 
-	priv = mowgli_heap_alloc(hook_privfn_heap);
+	struct module *m = module_loading();
+
+	priv = sharedheap_alloc(hook_privfn_heap);
 	priv->hookfn = handler;
+	memset(&priv->stats, 0, sizeof priv->stats);
+	priv->stats.event = hook->name;
+	priv->stats.owner = strshare_get(m != NULL ? m->name : "core");
 
 	addfn(priv, &priv->node, &hook->hooks);
 
@@ -152,12 +170,51 @@ hook_add_hook_first(const char *event, hook_fn handler)
 	hook_create_and_add(h, handler, mowgli_node_add_head);
 }
 
+#ifdef HAVE_GETTIMEOFDAY
+static void
+hook_record(hook_privfn_ctx_t *priv, unsigned long long usec)
+{
+	priv->stats.calls++;
+	priv->stats.usec_total += usec;
+
+	if (usec > priv->stats.usec_max)
+		priv->stats.usec_max = usec;
+
+	if (config_options.slow_operation_threshold && usec >= config_options.slow_operation_threshold * 1000ULL)
+		slog(LG_INFO, "slow operation: %s hook handler from %s ran for %llu ms",
+		     priv->stats.event, priv->stats.owner, usec / 1000ULL);
+}
+#endif
+
+static void
+hook_run_handler(hook_run_ctx_t *ctx, hook_privfn_ctx_t *priv)
+{
+#ifdef HAVE_GETTIMEOFDAY
+	struct timeval start, tv;
+
+	ctx->running = priv;
+	s_time(&start);
+#endif
+
+	priv->hookfn(ctx->dptr);
+
+#ifdef HAVE_GETTIMEOFDAY
+	e_time(start, &tv);
+
+	if (ctx->running != NULL)
+		hook_record(priv, tv2us(&tv));
+#endif
+}
+
+/*
+ * Handlers are timed one by one; a handler that calls another hook
+ * includes the time spent in that hook's handlers.
+ */
 void
 hook_call_event(const char *event, void *dptr)
 {
 	hook_run_ctx_t ctx;
 	mowgli_node_t *n, *tn;
-	void (*func)(void *data);
 
 	return_if_fail(event != NULL);
 
@@ -167,22 +224,101 @@ hook_call_event(const char *event, void *dptr)
 
 	ctx.dptr = dptr;
 	ctx.flags = HF_RUN;
+	ctx.running = NULL;
 
 	mowgli_node_add_head(&ctx, &ctx.node, &hook_run_stack);
 
 	MOWGLI_ITER_FOREACH_SAFE(n, tn, ctx.hook->hooks.head)
 	{
-		hook_privfn_ctx_t *priv = n->data;
+		hook_run_handler(&ctx, n->data);
 
-		priv->hookfn(ctx.dptr);
 		if (ctx.flags & HF_STOP)
-			goto out;
+			break;
 	}
 
-out:
 	mowgli_node_delete(&ctx.node, &hook_run_stack);
 }
 
+/*
+ * hook_get_handlers and hook_call_handler let a caller spread an event's
+ * handlers over several event loop passes: take the list once, then run
+ * them one at a time. A handler removed in the meantime is skipped.
+ */
+size_t
+hook_get_handlers(const char *event, hook_fn *handlers, size_t max)
+{
+	struct hook *h;
+	mowgli_node_t *n;
+	size_t count = 0;
+
+	return_val_if_fail(event != NULL, 0);
+
+	if ((h = hook_find(event)) == NULL)
+		return 0;
+
+	MOWGLI_ITER_FOREACH(n, h->hooks.head)
+	{
+		hook_privfn_ctx_t *priv = n->data;
+
+		if (count < max)
+			handlers[count] = priv->hookfn;
+
+		count++;
+	}
+
+	return count;
+}
+
+void
+hook_call_handler(const char *event, hook_fn handler, void *dptr)
+{
+	hook_run_ctx_t ctx;
+	mowgli_node_t *n;
+
+	return_if_fail(event != NULL);
+	return_if_fail(handler != NULL);
+
+	ctx.hook = hook_find(event);
+	if (ctx.hook == NULL)
+		return;
+
+	ctx.dptr = dptr;
+	ctx.flags = HF_RUN;
+	ctx.running = NULL;
+
+	MOWGLI_ITER_FOREACH(n, ctx.hook->hooks.head)
+	{
+		hook_privfn_ctx_t *priv = n->data;
+
+		if (priv->hookfn != handler)
+			continue;
+
+		mowgli_node_add_head(&ctx, &ctx.node, &hook_run_stack);
+		hook_run_handler(&ctx, priv);
+		mowgli_node_delete(&ctx.node, &hook_run_stack);
+		return;
+	}
+}
+
+void
+hook_stats_foreach(int (*cb)(const struct hook_handler_stats *stats, void *privdata), void *privdata)
+{
+	mowgli_patricia_iteration_state_t state;
+	struct hook *h;
+	mowgli_node_t *n;
+
+	MOWGLI_PATRICIA_FOREACH(h, &state, hooks)
+	{
+		MOWGLI_ITER_FOREACH(n, h->hooks.head)
+		{
+			hook_privfn_ctx_t *priv = n->data;
+
+			if (priv->stats.calls && cb(&priv->stats, privdata))
+				return;
+		}
+	}
+}
+
 static inline hook_run_ctx_t *
 hook_run_stack_highest(void)
 {
@@ -23,4 +23,53 @@ void init_signal_handlers(void);
 
 void language_init(void);
 
+/* accountindex.c */
+void myuser_index_init(void);
+void myuser_index_add(struct myuser *mu);
+void myuser_index_delete(struct myuser *mu);
+void myuser_index_email_add(struct myuser *mu);
+void myuser_index_email_delete(struct myuser *mu);
+
+/* hook.c */
+struct hook_handler_stats
+{
+	stringref           event;
+	stringref           owner;          // module that added the handler, or "core"
+	unsigned long long  calls;
+	unsigned long long  usec_total;
+	unsigned long long  usec_max;
+};
+
+void hook_stats_foreach(int (*cb)(const struct hook_handler_stats *stats, void *privdata), void *privdata);
+
+/* loopstats.c */
+struct timer_stats
+{
+	char *              name;
+	unsigned long long  runs;
+	unsigned long long  usec_total;
+	unsigned long long  usec_max;
+	unsigned long long  late_usec_total;
+	unsigned long long  late_usec_max;
+};
+
+void loopstats_init(void);
+void loopstats_run_timers(void);
+void loopstats_add_busy(unsigned long long usec);
+void loopstats_iteration_end(void);
+void loopstats_timer_foreach(int (*cb)(const struct timer_stats *stats, void *privdata), void *privdata);
+void loopstats_stats_report(void (*cb)(const char *line, void *privdata), void *privdata);
+
+/* metrics.c */
+void metrics_init(void);
+
+/* mailqueue.c */
+void mailqueue_init(void);
+FILE *mailqueue_create(const char *rcpt, char *name, size_t namesize);
+bool mailqueue_commit(FILE *out, const char *name);
+void mailqueue_stats_report(void (*cb)(const char *line, void *privdata), void *privdata);
+
+/* module.c */
+struct module *module_loading(void);
+
 #endif /* !ATHEME_LAC_INTERNAL_H */
@@ -0,0 +1,346 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * atheme-services: A collection of minimalist IRC services
+ * loopstats.c: Event loop instrumentation
+ *
+ * Keeps track of how busy each event loop iteration is, how long each
+ * named timer takes to run and how late it runs, and logs anything that
+ * takes longer than general::slow_operation_threshold. Hook handlers are
+ * timed in hook.c.
+ */
+
+#include <atheme.h>
+#include "internal.h"
+
+#define LOOPSTATS_REPORT_HOOKS  15U
+
+#ifdef HAVE_GETTIMEOFDAY
+
+static mowgli_patricia_t *timer_stats_index = NULL;
+static struct metric *metric_loop_busy = NULL;
+static struct metric *metric_loop_lag = NULL;
+
+static struct
+{
+	unsigned long long  iterations;         // iterations that did any work
+	unsigned long long  slow;               // ... of which took longer than the threshold
+	unsigned long long  usec_total;
+	unsigned long long  usec_max;
+	time_t              max_time;
+	unsigned long long  current;            // busy time of the iteration in progress
+	unsigned long long  current_timers;     // ... of which running timers
+	unsigned long long  awake;              // time spent on connections since the last wait for events
+} loop_stats;
+
+static inline unsigned long long
+loopstats_threshold(void)
+{
+	return config_options.slow_operation_threshold * 1000ULL;
+}
+
+static void
+loopstats_timer_record(const char *const restrict name, const unsigned long long late, const unsigned long long usec)
+{
+	struct timer_stats *ts = mowgli_patricia_retrieve(timer_stats_index, name);
+
+	if (! ts)
+	{
+		ts = smalloc(sizeof *ts);
+		ts->name = sstrdup(name);
+
+		(void) mowgli_patricia_add(timer_stats_index, ts->name, ts);
+	}
+
+	ts->runs++;
+	ts->usec_total += usec;
+	ts->late_usec_total += late;
+
+	if (usec > ts->usec_max)
+		ts->usec_max = usec;
+
+	if (late > ts->late_usec_max)
+		ts->late_usec_max = late;
+
+	const unsigned long long threshold = loopstats_threshold();
+
+	if (! threshold)
+		return;
+
+	if (usec >= threshold)
+		(void) slog(LG_INFO, "slow operation: timer %s ran for %llu ms", name, usec / 1000ULL);
+
+	// deadlines are whole seconds, so any timer may run up to a second after its deadline
+	if (late >= threshold + 1000000ULL)
+		(void) slog(LG_INFO, "slow operation: timer %s ran %llu ms after it was due", name, late / 1000ULL);
+}
+
+/* Runs the timers that are due, the same way mowgli_eventloop_run_once()
+ * would, but timing each of them. It is called right before that, which
+ * then finds nothing left to do, unless the clock ticks over to the next
+ * second in between.
+ *
+ * A timer's lag is how long it waited on other work once due: how late it
+ * ran, but no more than the loop has been busy since it last waited for
+ * events. Waiting itself does not count, as deadlines are whole seconds
+ * and mowgli only wakes up to the second.
+ */
+void
+loopstats_run_timers(void)
+{
+	mowgli_node_t *n, *tn;
+	unsigned long long busy = loop_stats.awake;
+
+	(void) mowgli_eventloop_synchronize(base_eventloop);
+
+	const time_t now = mowgli_eventloop_get_time(base_eventloop);
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, base_eventloop->timer_list.head)
+	{
+		mowgli_eventloop_timer_t *const timer = n->data;
+		struct timeval start, tv;
+		unsigned long long late = 0;
+		char name[BUFSIZE];
+
+		if (! timer->active || timer->deadline > now)
+			continue;
+
+		// the callback may unload the module the name belongs to
+		(void) mowgli_strlcpy(name, timer->name, sizeof name);
+
+		(void) s_time(&start);
+
+		if (start.tv_sec >= timer->deadline)
+			late = (((unsigned long long) (start.tv_sec - timer->deadline)) * 1000000ULL) +
+			       (unsigned long long) start.tv_usec;
+
+		base_eventloop->last_ran = timer->name;
+		timer->func(timer->arg);
+
+		// make mowgli work out when it has to wake up next
+		base_eventloop->deadline = -1;
+
+		(void) e_time(start, &tv);
+
+		const unsigned long long usec = tv2us(&tv);
+
+		loop_stats.current += usec;
+		loop_stats.current_timers += usec;
+
+		(void) loopstats_timer_record(name, late, usec);
+		(void) metric_observe(metric_loop_lag, NULL, ((double) ((late < busy) ? late : busy)) / 1000000.0);
+
+		busy += usec;
+
+		if (timer->frequency)
+			timer->deadline = now + timer->frequency;
+		else
+		{
+			base_eventloop->last_ran = "<onceonly>";
+			(void) mowgli_timer_destroy(base_eventloop, timer);
+		}
+	}
+}
+
+void
+loopstats_add_busy(const unsigned long long usec)
+{
+	loop_stats.current += usec;
+}
+
+void
+loopstats_iteration_end(void)
+{
+	const unsigned long long usec = loop_stats.current;
+
+	// the next pass over the timers comes right after this
+	loop_stats.awake = usec - loop_stats.current_timers;
+
+	if (! usec)
+		return;
+
+	loop_stats.current = 0;
+	loop_stats.current_timers = 0;
+	loop_stats.iterations++;
+	loop_stats.usec_total += usec;
+
+	if (usec > loop_stats.usec_max)
+	{
+		loop_stats.usec_max = usec;
+		loop_stats.max_time = CURRTIME;
+	}
+
+	(void) metric_observe(metric_loop_busy, NULL, ((double) usec) / 1000000.0);
+
+	const unsigned long long threshold = loopstats_threshold();
+
+	if (! threshold || usec < threshold)
+		return;
+
+	loop_stats.slow++;
+
+	(void) slog(LG_INFO, "slow operation: event loop iteration was busy for %llu ms (last event: %s)",
+	            usec / 1000ULL, base_eventloop->last_ran ? base_eventloop->last_ran : "none");
+}
+
+void
+loopstats_timer_foreach(int (*cb)(const struct timer_stats *stats, void *privdata), void *privdata)
+{
+	mowgli_patricia_iteration_state_t state;
+	struct timer_stats *ts;
+
+	MOWGLI_PATRICIA_FOREACH(ts, &state, timer_stats_index)
+		if (cb(ts, privdata))
+			return;
+}
+
+struct loopstats_hooks
+{
+	const struct hook_handler_stats **  entries;
+	size_t                              count;
+	size_t                              size;
+};
+
+static int
+loopstats_hooks_collect(const struct hook_handler_stats *const restrict stats, void *const restrict privdata)
+{
+	struct loopstats_hooks *const lh = privdata;
+
+	if (lh->count == lh->size)
+	{
+		lh->size = lh->size ? (lh->size * 2U) : 64U;
+		lh->entries = sreallocarray(lh->entries, lh->size, sizeof *lh->entries);
+	}
+
+	lh->entries[lh->count++] = stats;
+
+	return 0;
+}
+
+static int
+loopstats_hooks_cmp(const void *const a, const void *const b)
+{
+	const unsigned long long ta = (*((const struct hook_handler_stats *const *) a))->usec_total;
+	const unsigned long long tb = (*((const struct hook_handler_stats *const *) b))->usec_total;
+
+	// descending
+	return (ta < tb) - (ta > tb);
+}
+
+static const char *
+loopstats_ms(const unsigned long long usec, char *const restrict buf, const size_t bufsize)
+{
+	(void) snprintf(buf, bufsize, "%llu.%03llums", usec / 1000ULL, usec % 1000ULL);
+
+	return buf;
+}
+
+void
+loopstats_stats_report(void (*cb)(const char *line, void *privdata), void *privdata)
+{
+	mowgli_patricia_iteration_state_t state;
+	struct loopstats_hooks lh = { NULL, 0, 0 };
+	struct timer_stats *ts;
+	char buf[BUFSIZE];
+	char avg[32], max[32], lateavg[32], latemax[32];
+
+	(void) snprintf(buf, sizeof buf, "Event loop: %llu busy iterations, average %s, max %s (%s ago), "
+	                "%llu over %u ms", loop_stats.iterations,
+	                loopstats_ms(loop_stats.iterations ? (loop_stats.usec_total / loop_stats.iterations) : 0,
+	                             avg, sizeof avg),
+	                loopstats_ms(loop_stats.usec_max, max, sizeof max),
+	                loop_stats.max_time ? time_ago(loop_stats.max_time) : "never",
+	                loop_stats.slow, config_options.slow_operation_threshold);
+	cb(buf, privdata);
+
+	(void) snprintf(buf, sizeof buf, "%-28s %8s %12s %12s %12s %12s", "Timer", "Runs", "Average", "Max",
+	                "Late (avg)", "Late (max)");
+	cb(buf, privdata);
+
+	MOWGLI_PATRICIA_FOREACH(ts, &state, timer_stats_index)
+	{
+		(void) snprintf(buf, sizeof buf, "%-28s %8llu %12s %12s %12s %12s", ts->name, ts->runs,
+		                loopstats_ms(ts->usec_total / ts->runs, avg, sizeof avg),
+		                loopstats_ms(ts->usec_max, max, sizeof max),
+		                loopstats_ms(ts->late_usec_total / ts->runs, lateavg, sizeof lateavg),
+		                loopstats_ms(ts->late_usec_max, latemax, sizeof latemax));
+		cb(buf, privdata);
+	}
+
+	(void) hook_stats_foreach(&loopstats_hooks_collect, &lh);
+
+	if (! lh.count)
+		return;
+
+	(void) qsort(lh.entries, lh.count, sizeof *lh.entries, &loopstats_hooks_cmp);
+
+	(void) snprintf(buf, sizeof buf, "%-28s %-20s %8s %12s %12s", "Hook", "Handler from", "Calls", "Total",
+	                "Max");
+	cb(buf, privdata);
+
+	for (size_t i = 0; i < lh.count && i < LOOPSTATS_REPORT_HOOKS; i++)
+	{
+		const struct hook_handler_stats *const hs = lh.entries[i];
+
+		(void) snprintf(buf, sizeof buf, "%-28s %-20s %8llu %12s %12s", hs->event, hs->owner, hs->calls,
+		                loopstats_ms(hs->usec_total, avg, sizeof avg),
+		                loopstats_ms(hs->usec_max, max, sizeof max));
+		cb(buf, privdata);
+	}
+
+	(void) sfree(lh.entries);
+}
+
+void
+loopstats_init(void)
+{
+	static const double busy_bounds[] = { 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5 };
+
+	timer_stats_index = mowgli_patricia_create(NULL);
+
+	metric_loop_busy = metric_histogram_create("atheme_event_loop_busy_seconds", "Time spent running timers "
+	                                           "and handling connections in each event loop iteration that "
+	                                           "did either", busy_bounds, ARRAY_SIZE(busy_bounds));
+
+	metric_loop_lag = metric_histogram_create("atheme_event_loop_lag_seconds", "How long timers that are due "
+	                                          "wait for other work to finish", busy_bounds, ARRAY_SIZE(busy_bounds));
+}
+
+#else /* HAVE_GETTIMEOFDAY */
+
+void
+loopstats_init(void)
+{
+}
+
+void
+loopstats_run_timers(void)
+{
+}
+
+void
+loopstats_add_busy(const unsigned long long ATHEME_VATTR_UNUSED usec)
+{
+}
+
+void
+loopstats_iteration_end(void)
+{
+}
+
+void
+loopstats_timer_foreach(int ATHEME_VATTR_UNUSED (*cb)(const struct timer_stats *, void *),
+                        void ATHEME_VATTR_UNUSED *privdata)
+{
+}
+
+void
+loopstats_stats_report(void (*cb)(const char *line, void *privdata), void *privdata)
+{
+	cb("event loop statistics need gettimeofday(2)", privdata);
+}
+
+#endif /* !HAVE_GETTIMEOFDAY */
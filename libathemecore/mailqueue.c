@@ -0,0 +1,882 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * atheme-services: A collection of minimalist IRC services
+ * mailqueue.c: On-disk spool for outgoing email
+ *
+ * sendemail() writes each message to a file in <datadir>/mailspool and
+ * returns; the first line of the file is the envelope recipient. A single
+ * long-lived worker process is told the name of each message as it comes
+ * due, hands it to the MTA and answers whether the MTA took it. By default
+ * it runs "mta -t" for each message, which every sendmail-compatible MTA
+ * supports; with serverinfo::mta_smtp it instead keeps one SMTP session
+ * open to the MTA (run as "mta -bs", talking SMTP over its standard input
+ * and output), starting it again if it goes away. Accepted messages are
+ * deleted, rejected ones set aside as <name>.failed, and the rest retried
+ * later with exponential backoff. The worker is started again if it dies.
+ * Messages left in the spool when services stops are picked up again at
+ * the next start.
+ */
+
+#include <atheme.h>
+#include "internal.h"
+
+#ifndef MOWGLI_OS_WIN
+
+#define MAILQUEUE_DIR           "mailspool"
+#define MAILQUEUE_WINDOW        20U     // messages handed to the worker at once
+#define MAILQUEUE_ATTEMPTS      8U
+#define MAILQUEUE_BACKOFF_MIN   SECONDS_PER_MINUTE
+#define MAILQUEUE_BACKOFF_MAX   SECONDS_PER_HOUR
+
+struct mailqueue_entry
+{
+	mowgli_node_t   node;
+	char            name[64];
+	time_t          queued;
+	time_t          due;            // not to be tried before this
+	unsigned int    attempts;
+};
+
+struct mailqueue_stats
+{
+	unsigned long long      queued;
+	unsigned long long      delivered;
+	unsigned long long      retried;
+	unsigned long long      failed;
+	unsigned long long      workers;
+	unsigned long long      latency_total;  // seconds from queueing to delivery
+	time_t                  latency_max;
+};
+
+static char mailqueue_path[BUFSIZE];
+static mowgli_list_t mailqueue = { NULL, NULL, 0 };             // waiting, oldest first
+static mowgli_list_t mailqueue_inflight = { NULL, NULL, 0 };    // given to the worker, in order
+static mowgli_eventloop_timer_t *mailqueue_timer = NULL;
+static struct connection *mailqueue_worker = NULL;
+static unsigned int mailqueue_seq = 0;
+static struct mailqueue_stats mailqueue_stats;
+
+static void mailqueue_schedule(void);
+
+static void
+mailqueue_file(const char *const restrict name, char *const restrict buf, const size_t bufsize)
+{
+	(void) snprintf(buf, bufsize, "%s/%s", mailqueue_path, name);
+}
+
+static struct mailqueue_entry *
+mailqueue_entry_create(const char *const restrict name, const time_t queued)
+{
+	struct mailqueue_entry *const entry = smalloc(sizeof *entry);
+
+	(void) mowgli_strlcpy(entry->name, name, sizeof entry->name);
+	entry->queued = queued;
+	entry->due = queued;
+
+	return entry;
+}
+
+/* Keeps the waiting list ordered by due time; entries are nearly always
+ * added at the end.
+ */
+static void
+mailqueue_insert(struct mailqueue_entry *const restrict entry)
+{
+	mowgli_node_t *n;
+
+	for (n = mailqueue.tail; n != NULL && ((struct mailqueue_entry *) n->data)->due > entry->due; n = n->prev)
+		;
+
+	if (n != NULL)
+		(void) mowgli_node_add_after(entry, &entry->node, &mailqueue, n);
+	else
+		(void) mowgli_node_add_head(entry, &entry->node, &mailqueue);
+}
+
+enum mailqueue_result
+{
+	MAILQUEUE_SENT,
+	MAILQUEUE_RETRY,        // try again later
+	MAILQUEUE_REJECTED,     // the MTA will never take it, or it is unreadable
+};
+
+static const char *const mailqueue_result_names[] = { "sent", "retry", "rejected" };
+
+// The worker's SMTP session with the MTA.
+struct mailqueue_mta
+{
+	pid_t   pid;
+	FILE *  in;
+	FILE *  out;
+};
+
+static void
+mailqueue_mta_close(struct mailqueue_mta *const restrict mta, const bool quit)
+{
+	char buf[BUFSIZE];
+	int status;
+
+	if (mta->out == NULL)
+		return;
+
+	if (quit && fputs("QUIT\r\n", mta->out) >= 0 && fflush(mta->out) == 0)
+		(void) fgets(buf, sizeof buf, mta->in);
+
+	(void) fclose(mta->out);
+	(void) fclose(mta->in);
+
+	while (waitpid(mta->pid, &status, 0) < 0 && errno == EINTR)
+		;
+
+	mta->out = NULL;
+	mta->in = NULL;
+	mta->pid = 0;
+}
+
+/* Reads a (possibly multi-line) reply from the MTA and returns its code,
+ * or -1 if the session is gone, in which case it has been closed.
+ */
+static int
+mailqueue_mta_reply(struct mailqueue_mta *const restrict mta)
+{
+	char buf[BUFSIZE];
+
+	do
+	{
+		if (fgets(buf, sizeof buf, mta->in) == NULL || strlen(buf) < 4 || !isdigit((unsigned char) buf[0]))
+		{
+			(void) mailqueue_mta_close(mta, false);
+			return -1;
+		}
+	} while (buf[3] == '-');
+
+	return atoi(buf);
+}
+
+static int ATHEME_FATTR_PRINTF(2, 3)
+mailqueue_mta_command(struct mailqueue_mta *const restrict mta, const char *const restrict fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void) vfprintf(mta->out, fmt, ap);
+	va_end(ap);
+
+	if (fflush(mta->out) != 0)
+	{
+		(void) mailqueue_mta_close(mta, false);
+		return -1;
+	}
+
+	return mailqueue_mta_reply(mta);
+}
+
+static bool
+mailqueue_mta_open(struct mailqueue_mta *const restrict mta)
+{
+	int to[2], from[2];
+
+	if (pipe(to) < 0)
+		return false;
+
+	if (pipe(from) < 0)
+	{
+		(void) close(to[0]);
+		(void) close(to[1]);
+		return false;
+	}
+
+	switch (mta->pid = fork())
+	{
+		case -1:
+			(void) close(to[0]);
+			(void) close(to[1]);
+			(void) close(from[0]);
+			(void) close(from[1]);
+			return false;
+		case 0:
+			(void) dup2(to[0], 0);
+			(void) dup2(from[1], 1);
+			(void) close(to[0]);
+			(void) close(to[1]);
+			(void) close(from[0]);
+			(void) close(from[1]);
+			(void) execl(me.mta, me.mta, "-bs", NULL);
+			_exit(255);
+	}
+
+	(void) close(to[0]);
+	(void) close(from[1]);
+
+	mta->out = fdopen(to[1], "w");
+	mta->in = fdopen(from[0], "r");
+
+	if (mta->out == NULL || mta->in == NULL)
+	{
+		if (mta->out != NULL)
+			(void) fclose(mta->out);
+		else
+			(void) close(to[1]);
+
+		if (mta->in != NULL)
+			(void) fclose(mta->in);
+		else
+			(void) close(from[0]);
+
+		(void) waitpid(mta->pid, NULL, 0);
+		mta->out = mta->in = NULL;
+		return false;
+	}
+
+	if (mailqueue_mta_reply(mta) / 100 != 2 || mailqueue_mta_command(mta, "HELO %s\r\n", me.name) / 100 != 2)
+	{
+		(void) mailqueue_mta_close(mta, true);
+		return false;
+	}
+
+	return true;
+}
+
+/* Turns an MTA reply to a command in the middle of a transaction into a
+ * result, resetting the transaction if the session is still there.
+ */
+static enum mailqueue_result
+mailqueue_mta_refused(struct mailqueue_mta *const restrict mta, const int code)
+{
+	if (code < 0)
+		return MAILQUEUE_RETRY;
+
+	(void) mailqueue_mta_command(mta, "RSET\r\n");
+
+	return (code / 100 == 5) ? MAILQUEUE_REJECTED : MAILQUEUE_RETRY;
+}
+
+/* Runs in the worker process: hands one spooled message to the MTA over
+ * the session, opening it first if need be.
+ */
+static enum mailqueue_result
+mailqueue_deliver_one(struct mailqueue_mta *const restrict mta, const char *const restrict path)
+{
+	char rcpt[BUFSIZE];
+	char buf[BUFSIZE];
+	bool bol = true;
+	FILE *in;
+	int code;
+
+	if ((in = fopen(path, "r")) == NULL)
+		return MAILQUEUE_REJECTED;
+
+	if (fgets(rcpt, sizeof rcpt, in) == NULL || strchr(rcpt, '\n') == NULL)
+	{
+		(void) fclose(in);
+		return MAILQUEUE_REJECTED;
+	}
+
+	rcpt[strcspn(rcpt, "\r\n")] = '\0';
+
+	// An idle session may have been dropped by the MTA; start a new one once if so
+	for (unsigned int tries = 0; /* */; tries++)
+	{
+		const bool reused = (mta->out != NULL);
+
+		if (!reused && !mailqueue_mta_open(mta))
+		{
+			(void) fclose(in);
+			return MAILQUEUE_RETRY;
+		}
+
+		if ((code = mailqueue_mta_command(mta, "MAIL FROM:<%s>\r\n", me.register_email)) >= 0 || !reused || tries)
+			break;
+	}
+
+	if (code / 100 != 2)
+	{
+		(void) fclose(in);
+		return mailqueue_mta_refused(mta, code);
+	}
+
+	if ((code = mailqueue_mta_command(mta, "RCPT TO:<%s>\r\n", rcpt)) / 100 != 2 ||
+	    (code = mailqueue_mta_command(mta, "DATA\r\n")) != 354)
+	{
+		(void) fclose(in);
+		return mailqueue_mta_refused(mta, code);
+	}
+
+	while (fgets(buf, sizeof buf, in) != NULL)
+	{
+		const size_t len = strlen(buf);
+		const bool eol = (len && buf[len - 1] == '\n');
+
+		if (eol)
+			buf[len - 1] = '\0';
+
+		(void) fprintf(mta->out, "%s%s%s", (bol && buf[0] == '.') ? "." : "", buf, eol ? "\r\n" : "");
+		bol = eol;
+	}
+
+	const bool ok = !ferror(in);
+
+	(void) fclose(in);
+
+	/* If the file could not be read to the end, the MTA must not send what
+	 * it got; dropping the session is the only way to abort DATA.
+	 */
+	if (!ok)
+	{
+		(void) mailqueue_mta_close(mta, false);
+		return MAILQUEUE_RETRY;
+	}
+
+	code = mailqueue_mta_command(mta, "%s.\r\n", bol ? "" : "\r\n");
+
+	if (code / 100 == 2)
+		return MAILQUEUE_SENT;
+
+	return (code / 100 == 5) ? MAILQUEUE_REJECTED : MAILQUEUE_RETRY;
+}
+
+/* Runs in the worker process: pipes one spooled message to "mta -t", for
+ * MTAs that do not speak SMTP on their standard input (msmtp, nullmailer,
+ * ssmtp and the like). It is sent if the MTA exits successfully.
+ */
+static enum mailqueue_result
+mailqueue_deliver_pipe(const char *const restrict path)
+{
+	char buf[BUFSIZE];
+	int pipfds[2];
+	int status;
+	size_t len;
+	FILE *in, *out;
+	pid_t pid;
+
+	if ((in = fopen(path, "r")) == NULL)
+		return MAILQUEUE_REJECTED;
+
+	// "-t" takes the recipients from the headers; skip the envelope recipient
+	if (fgets(buf, sizeof buf, in) == NULL || strchr(buf, '\n') == NULL)
+	{
+		(void) fclose(in);
+		return MAILQUEUE_REJECTED;
+	}
+
+	if (pipe(pipfds) < 0)
+	{
+		(void) fclose(in);
+		return MAILQUEUE_RETRY;
+	}
+
+	switch (pid = fork())
+	{
+		case -1:
+			(void) close(pipfds[0]);
+			(void) close(pipfds[1]);
+			(void) fclose(in);
+			return MAILQUEUE_RETRY;
+		case 0:
+			(void) dup2(pipfds[0], 0);
+			(void) close(pipfds[0]);
+			(void) close(pipfds[1]);
+			(void) execl(me.mta, me.mta, "-t", "-f", me.register_email, NULL);
+			_exit(255);
+	}
+
+	(void) close(pipfds[0]);
+
+	if ((out = fdopen(pipfds[1], "w")) == NULL)
+		(void) close(pipfds[1]);
+
+	while (out != NULL && (len = fread(buf, 1, sizeof buf, in)) > 0 && fwrite(buf, 1, len, out) == len)
+		;
+
+	const bool ok = (out != NULL && !ferror(in) && fflush(out) == 0);
+
+	(void) fclose(in);
+
+	// the MTA must not send a message cut short, so stop it before it sees the end
+	if (!ok)
+		(void) kill(pid, SIGTERM);
+
+	if (out != NULL)
+		(void) fclose(out);
+
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+		;
+
+	if (ok && WIFEXITED(status) && WEXITSTATUS(status) == 0)
+		return MAILQUEUE_SENT;
+
+	return MAILQUEUE_RETRY;
+}
+
+/* The worker process: reads message names, one per line, and answers each
+ * with "<name> <result>" once the MTA has dealt with it.
+ */
+static void ATHEME_FATTR_NORETURN
+mailqueue_worker_main(const int fd)
+{
+	struct mailqueue_mta mta = { 0, NULL, NULL };
+	char name[BUFSIZE];
+	char path[BUFSIZE];
+	FILE *in, *out;
+
+	if ((in = fdopen(fd, "r")) == NULL || (out = fdopen(dup(fd), "w")) == NULL)
+		_exit(1);
+
+	while (fgets(name, sizeof name, in) != NULL)
+	{
+		name[strcspn(name, "\r\n")] = '\0';
+
+		(void) mailqueue_file(name, path, sizeof path);
+
+		const enum mailqueue_result res = me.mta_smtp ? mailqueue_deliver_one(&mta, path) : mailqueue_deliver_pipe(path);
+
+		if (fprintf(out, "%s %s\n", name, mailqueue_result_names[res]) < 0 || fflush(out) != 0)
+			break;
+	}
+
+	(void) mailqueue_mta_close(&mta, true);
+	_exit(0);
+}
+
+static void
+mailqueue_give_up(struct mailqueue_entry *const restrict entry)
+{
+	char path[BUFSIZE];
+	char failpath[BUFSIZE + 8];
+
+	(void) mailqueue_file(entry->name, path, sizeof path);
+	(void) snprintf(failpath, sizeof failpath, "%s.failed", path);
+	(void) srename(path, failpath);
+
+	mailqueue_stats.failed++;
+	(void) sfree(entry);
+}
+
+// Deals with the worker's verdict on a message it was given.
+static void
+mailqueue_result(struct mailqueue_entry *const restrict entry, const enum mailqueue_result res)
+{
+	char path[BUFSIZE];
+
+	(void) mowgli_node_delete(&entry->node, &mailqueue_inflight);
+	entry->attempts++;
+
+	switch (res)
+	{
+		case MAILQUEUE_SENT:
+		{
+			const time_t latency = CURRTIME - entry->queued;
+
+			(void) mailqueue_file(entry->name, path, sizeof path);
+			(void) unlink(path);
+
+			mailqueue_stats.delivered++;
+			mailqueue_stats.latency_total += (unsigned long long) latency;
+
+			if (latency > mailqueue_stats.latency_max)
+				mailqueue_stats.latency_max = latency;
+
+			(void) sfree(entry);
+			return;
+		}
+
+		case MAILQUEUE_REJECTED:
+			(void) slog(LG_ERROR, "mailqueue: %s was refused or is unreadable, setting it aside", entry->name);
+			(void) mailqueue_give_up(entry);
+			return;
+
+		case MAILQUEUE_RETRY:
+			break;
+	}
+
+	if (entry->attempts >= MAILQUEUE_ATTEMPTS)
+	{
+		(void) slog(LG_ERROR, "mailqueue: giving up on %s after %u attempts", entry->name, entry->attempts);
+		(void) mailqueue_give_up(entry);
+		return;
+	}
+
+	time_t backoff = MAILQUEUE_BACKOFF_MIN << (entry->attempts - 1U);
+
+	if (backoff > MAILQUEUE_BACKOFF_MAX)
+		backoff = MAILQUEUE_BACKOFF_MAX;
+
+	entry->due = CURRTIME + backoff;
+	mailqueue_stats.retried++;
+	(void) mailqueue_insert(entry);
+}
+
+static void mailqueue_dispatch(void *arg);
+
+static void
+mailqueue_worker_reply(struct connection *const restrict cptr)
+{
+	char line[BUFSIZE];
+	int len;
+
+	while ((len = recvq_getline(cptr, line, sizeof line - 1)) > 0)
+	{
+		line[len] = '\0';
+		line[strcspn(line, "\r\n")] = '\0';
+
+		char *const verdict = strrchr(line, ' ');
+		size_t res;
+
+		if (verdict == NULL || mailqueue_inflight.head == NULL)
+			continue;
+
+		*verdict = '\0';
+
+		// the worker answers in the order it was given them
+		struct mailqueue_entry *const entry = mailqueue_inflight.head->data;
+
+		if (strcmp(line, entry->name) != 0)
+		{
+			(void) slog(LG_ERROR, "mailqueue: worker answered for %s, expected %s", line, entry->name);
+			continue;
+		}
+
+		for (res = 0; res < ARRAY_SIZE(mailqueue_result_names); res++)
+			if (!strcmp(verdict + 1, mailqueue_result_names[res]))
+				break;
+
+		(void) mailqueue_result(entry, (res < ARRAY_SIZE(mailqueue_result_names)) ? res : MAILQUEUE_RETRY);
+	}
+
+	(void) mailqueue_dispatch(NULL);
+}
+
+// The worker has gone away; whatever it had not answered for yet is tried again later.
+static void
+mailqueue_worker_closed(struct connection ATHEME_VATTR_UNUSED *const restrict cptr)
+{
+	mowgli_node_t *n, *tn;
+
+	mailqueue_worker = NULL;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, mailqueue_inflight.head)
+		(void) mailqueue_result(n->data, MAILQUEUE_RETRY);
+
+	(void) mailqueue_schedule();
+}
+
+static void
+mailqueue_worker_exited(pid_t ATHEME_VATTR_UNUSED pid, int status, void ATHEME_VATTR_UNUSED *data)
+{
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		(void) slog(LG_ERROR, "mailqueue: delivery worker failed (status %d)", status);
+}
+
+static bool
+mailqueue_worker_start(void)
+{
+	int fds[2];
+	pid_t pid;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+	{
+		(void) slog(LG_ERROR, "mailqueue: cannot create socket pair: %s", strerror(errno));
+		return false;
+	}
+
+	switch (pid = fork())
+	{
+		case -1:
+			(void) slog(LG_ERROR, "mailqueue: cannot fork delivery worker: %s", strerror(errno));
+			(void) close(fds[0]);
+			(void) close(fds[1]);
+			return false;
+
+		case 0:
+			(void) connection_close_all_fds();
+			(void) close(fds[0]);
+			(void) mailqueue_worker_main(fds[1]);
+	}
+
+	(void) close(fds[1]);
+
+	if ((mailqueue_worker = connection_add("mailqueue worker", fds[0], 0, recvq_put, NULL)) == NULL)
+	{
+		(void) close(fds[0]);
+		(void) kill(pid, SIGTERM);
+		(void) childproc_add(pid, "mailqueue", &mailqueue_worker_exited, NULL);
+		return false;
+	}
+
+	mailqueue_worker->recvq_handler = &mailqueue_worker_reply;
+	mailqueue_worker->close_handler = &mailqueue_worker_closed;
+	mailqueue_stats.workers++;
+
+	(void) childproc_add(pid, "mailqueue", &mailqueue_worker_exited, NULL);
+
+	return true;
+}
+
+// Hands the worker whatever is due, as far as the window allows.
+static void
+mailqueue_dispatch(void ATHEME_VATTR_UNUSED *arg)
+{
+	char buf[BUFSIZE];
+
+	mailqueue_timer = NULL;
+
+	if (me.mta == NULL || mailqueue.head == NULL || ((const struct mailqueue_entry *) mailqueue.head->data)->due > CURRTIME)
+	{
+		(void) mailqueue_schedule();
+		return;
+	}
+
+	if (mailqueue_worker == NULL && !mailqueue_worker_start())
+	{
+		mowgli_node_t *n, *tn;
+
+		// try again later
+		MOWGLI_ITER_FOREACH_SAFE(n, tn, mailqueue.head)
+		{
+			struct mailqueue_entry *const entry = n->data;
+
+			if (entry->due > CURRTIME)
+				break;
+
+			(void) mowgli_node_delete(&entry->node, &mailqueue);
+			entry->due = CURRTIME + MAILQUEUE_BACKOFF_MIN;
+			(void) mailqueue_insert(entry);
+		}
+
+		(void) mailqueue_schedule();
+		return;
+	}
+
+	while (MOWGLI_LIST_LENGTH(&mailqueue_inflight) < MAILQUEUE_WINDOW && mailqueue.head != NULL)
+	{
+		struct mailqueue_entry *const entry = mailqueue.head->data;
+
+		if (entry->due > CURRTIME)
+			break;
+
+		(void) mowgli_node_delete(&entry->node, &mailqueue);
+		(void) mowgli_node_add(entry, &entry->node, &mailqueue_inflight);
+
+		const int len = snprintf(buf, sizeof buf, "%s\n", entry->name);
+
+		(void) sendq_add(mailqueue_worker, buf, (size_t) len);
+	}
+
+	(void) mailqueue_schedule();
+}
+
+// Arranges for mailqueue_dispatch() to run when the first waiting message is due.
+static void
+mailqueue_schedule(void)
+{
+	if (mailqueue_timer != NULL || mailqueue.head == NULL)
+		return;
+
+	// the worker will ask for more when it answers
+	if (mailqueue_worker != NULL && MOWGLI_LIST_LENGTH(&mailqueue_inflight) >= MAILQUEUE_WINDOW)
+		return;
+
+	const struct mailqueue_entry *const entry = mailqueue.head->data;
+	const time_t delay = (entry->due > CURRTIME) ? (entry->due - CURRTIME) : 0;
+
+	mailqueue_timer = mowgli_timer_add_once(base_eventloop, "mailqueue_dispatch", &mailqueue_dispatch, NULL, delay);
+}
+
+static bool
+mailqueue_ensure_dir(void)
+{
+	if (mailqueue_path[0] != '\0')
+		return true;
+
+	(void) snprintf(mailqueue_path, sizeof mailqueue_path, "%s/%s", datadir, MAILQUEUE_DIR);
+
+	if (mkdir(mailqueue_path, S_IRWXU) != 0 && errno != EEXIST)
+	{
+		(void) slog(LG_ERROR, "mailqueue: cannot create %s: %s", mailqueue_path, strerror(errno));
+		mailqueue_path[0] = '\0';
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * mailqueue_init()
+ *
+ * Creates the spool directory if needed and queues whatever a previous
+ * run left in it.
+ */
+void
+mailqueue_init(void)
+{
+	struct dirent *ent;
+	DIR *dir;
+
+	if (!mailqueue_ensure_dir())
+		return;
+
+	if ((dir = opendir(mailqueue_path)) == NULL)
+		return;
+
+	while ((ent = readdir(dir)) != NULL)
+	{
+		unsigned long long queued;
+		int consumed = 0;
+
+		// <time>.<pid>.<seq>; anything else (.tmp, .failed) is not ours to send
+		if (sscanf(ent->d_name, "%llu.%*u.%*u%n", &queued, &consumed) != 1 || ent->d_name[consumed] != '\0')
+			continue;
+
+		if (strlen(ent->d_name) >= sizeof ((struct mailqueue_entry *) NULL)->name)
+			continue;
+
+		(void) mailqueue_insert(mailqueue_entry_create(ent->d_name, (time_t) queued));
+	}
+
+	(void) closedir(dir);
+
+	if (MOWGLI_LIST_LENGTH(&mailqueue))
+		(void) slog(LG_INFO, "mailqueue: %zu messages waiting from a previous run", MOWGLI_LIST_LENGTH(&mailqueue));
+
+	(void) mailqueue_schedule();
+}
+
+/*
+ * mailqueue_create(const char *rcpt, char *name, size_t namesize)
+ *
+ * Starts a new message to rcpt (a bare, valid address) in the spool.
+ * Write it to the returned stream, then pass both to mailqueue_commit().
+ *
+ * Outputs:
+ *      - stream to write the message (headers and body) to, or NULL if
+ *        the spool is not writable
+ */
+FILE *
+mailqueue_create(const char *const restrict rcpt, char *const restrict name, const size_t namesize)
+{
+	char path[BUFSIZE];
+	FILE *out;
+	int fd;
+
+	if (!mailqueue_ensure_dir())
+		return NULL;
+
+	(void) snprintf(name, namesize, "%lu.%lu.%u", (unsigned long) CURRTIME, (unsigned long) getpid(), mailqueue_seq++);
+	(void) snprintf(path, sizeof path, "%s/%s.tmp", mailqueue_path, name);
+
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) < 0)
+	{
+		(void) slog(LG_ERROR, "mailqueue: cannot create %s: %s", path, strerror(errno));
+		return NULL;
+	}
+
+	if ((out = fdopen(fd, "w")) == NULL)
+	{
+		(void) close(fd);
+		(void) unlink(path);
+		return NULL;
+	}
+
+	(void) fprintf(out, "%s\n", rcpt);
+
+	return out;
+}
+
+/*
+ * mailqueue_commit(FILE *out, const char *name)
+ *
+ * Closes a message started with mailqueue_create() and queues it for
+ * delivery.
+ *
+ * Outputs:
+ *      - whether the message was queued; if not, it has been discarded
+ */
+bool
+mailqueue_commit(FILE *const restrict out, const char *const restrict name)
+{
+	char tmppath[BUFSIZE];
+	char path[BUFSIZE];
+	bool ok = !ferror(out);
+
+	if (fclose(out) != 0)
+		ok = false;
+
+	(void) snprintf(tmppath, sizeof tmppath, "%s/%s.tmp", mailqueue_path, name);
+	(void) mailqueue_file(name, path, sizeof path);
+
+	if (!ok || srename(tmppath, path) != 0)
+	{
+		(void) slog(LG_ERROR, "mailqueue: cannot write %s: %s", path, strerror(errno));
+		(void) unlink(tmppath);
+		return false;
+	}
+
+	mailqueue_stats.queued++;
+	(void) mailqueue_insert(mailqueue_entry_create(name, CURRTIME));
+	(void) mailqueue_schedule();
+
+	return true;
+}
+
+/*
+ * mailqueue_stats_report(void (*cb)(const char *line, void *privdata), void *privdata)
+ *
+ * Describes the state of the spool, one line per call of cb.
+ */
+void
+mailqueue_stats_report(void (*cb)(const char *line, void *privdata), void *privdata)
+{
+	char buf[BUFSIZE];
+	time_t oldest = 0;
+	mowgli_node_t *n;
+
+	MOWGLI_ITER_FOREACH(n, mailqueue.head)
+	{
+		const struct mailqueue_entry *const entry = n->data;
+
+		if (!oldest || entry->queued < oldest)
+			oldest = entry->queued;
+	}
+
+	MOWGLI_ITER_FOREACH(n, mailqueue_inflight.head)
+	{
+		const struct mailqueue_entry *const entry = n->data;
+
+		if (!oldest || entry->queued < oldest)
+			oldest = entry->queued;
+	}
+
+	(void) snprintf(buf, sizeof buf, "spool: %zu waiting, %zu in delivery, oldest %lu s",
+	                MOWGLI_LIST_LENGTH(&mailqueue), MOWGLI_LIST_LENGTH(&mailqueue_inflight),
+	                oldest ? (unsigned long) (CURRTIME - oldest) : 0UL);
+	cb(buf, privdata);
+
+	(void) snprintf(buf, sizeof buf, "queued %llu, delivered %llu, retried %llu, failed %llu, worker starts %llu",
+	                mailqueue_stats.queued, mailqueue_stats.delivered, mailqueue_stats.retried,
+	                mailqueue_stats.failed, mailqueue_stats.workers);
+	cb(buf, privdata);
+
+	(void) snprintf(buf, sizeof buf, "latency: average %llu s, max %lu s",
+	                mailqueue_stats.delivered ? (mailqueue_stats.latency_total / mailqueue_stats.delivered) : 0ULL,
+	                (unsigned long) mailqueue_stats.latency_max);
+	cb(buf, privdata);
+}
+
+#else /* !MOWGLI_OS_WIN */
+
+void
+mailqueue_init(void)
+{
+}
+
+void
+mailqueue_stats_report(void (*cb)(const char *line, void *privdata), void *privdata)
+{
+	cb("email is not supported on this platform", privdata);
+}
+
+#endif /* MOWGLI_OS_WIN */
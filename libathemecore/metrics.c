@@ -0,0 +1,734 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * atheme-services: A collection of minimalist IRC services
+ * metrics.c: Runtime metrics registry
+ *
+ * Counters, gauges and histograms that core and modules update as they
+ * go, and that metrics_render() writes out in the Prometheus text
+ * exposition format (see modules/misc/metrics.c). Values that already
+ * exist elsewhere (user counts, queue lengths, ...) are not duplicated;
+ * a collector callback copies them into the metric just before it is
+ * rendered.
+ */
+
+#include <atheme.h>
+#include "internal.h"
+
+static mowgli_list_t metrics_list = { NULL, NULL, 0 };
+static mowgli_patricia_t *metrics_index = NULL;
+
+
+static bool
+metric_name_valid(const char *name)
+{
+	if (! *name || isdigit((unsigned char) *name))
+		return false;
+
+	for (; *name; name++)
+		if (! isalnum((unsigned char) *name) && *name != '_' && *name != ':')
+			return false;
+
+	return true;
+}
+
+static struct metric *
+metric_create_common(const char *const restrict name, const char *const restrict help, const enum metric_type type)
+{
+	return_val_if_fail(name != NULL, NULL);
+	return_val_if_fail(help != NULL, NULL);
+
+	if (! metric_name_valid(name))
+	{
+		(void) slog(LG_ERROR, "%s: invalid metric name '%s' (BUG)", MOWGLI_FUNC_NAME, name);
+		return NULL;
+	}
+
+	if (mowgli_patricia_retrieve(metrics_index, name))
+	{
+		(void) slog(LG_ERROR, "%s: metric '%s' already exists (BUG)", MOWGLI_FUNC_NAME, name);
+		return NULL;
+	}
+
+	struct metric *const m = smalloc(sizeof *m);
+
+	m->name = sstrdup(name);
+	m->help = sstrdup(help);
+	m->type = type;
+	m->series_index = mowgli_patricia_create(NULL);
+
+	(void) mowgli_patricia_add(metrics_index, m->name, m);
+	(void) mowgli_node_add(m, &m->node, &metrics_list);
+
+	return m;
+}
+
+/*
+ * metric_create(const char *name, const char *help, enum metric_type type)
+ *
+ * Registers a counter or gauge. Names follow the Prometheus rules
+ * ([a-zA-Z_:][a-zA-Z0-9_:]*) and must be unique; by convention they start
+ * with "atheme_", and counters end in "_total".
+ *
+ * Outputs:
+ *      - the metric, or NULL if the name is invalid or taken; all of the
+ *        metric_*() functions accept NULL and do nothing with it
+ */
+struct metric *
+metric_create(const char *const restrict name, const char *const restrict help, const enum metric_type type)
+{
+	return_val_if_fail(type != METRIC_HISTOGRAM, NULL);
+
+	return metric_create_common(name, help, type);
+}
+
+/*
+ * metric_histogram_create(const char *name, const char *help, const double *bounds, size_t nbounds)
+ *
+ * Registers a histogram with the given (ascending) bucket upper bounds.
+ * The implicit +Inf bucket is not included in bounds.
+ */
+struct metric *
+metric_histogram_create(const char *const restrict name, const char *const restrict help,
+                        const double *const restrict bounds, const size_t nbounds)
+{
+	return_val_if_fail(bounds != NULL, NULL);
+	return_val_if_fail(nbounds != 0, NULL);
+
+	struct metric *const m = metric_create_common(name, help, METRIC_HISTOGRAM);
+
+	if (! m)
+		return NULL;
+
+	m->bounds = smalloc(nbounds * sizeof *m->bounds);
+	m->nbounds = nbounds;
+
+	(void) memcpy(m->bounds, bounds, nbounds * sizeof *m->bounds);
+
+	return m;
+}
+
+/*
+ * metric_set_collector(struct metric *m, void (*collect)(struct metric *, void *), void *privdata)
+ *
+ * Arranges for collect(m, privdata) to be called every time the metric is
+ * about to be rendered, so that it can set the current values.
+ */
+void
+metric_set_collector(struct metric *const restrict m, void (*const collect)(struct metric *, void *),
+                     void *const restrict privdata)
+{
+	if (! m)
+		return;
+
+	m->collect = collect;
+	m->privdata = privdata;
+}
+
+void
+metric_destroy(struct metric *const restrict m)
+{
+	mowgli_node_t *n, *tn;
+
+	if (! m)
+		return;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, m->series.head)
+	{
+		struct metric_series *const s = n->data;
+
+		(void) mowgli_node_delete(&s->node, &m->series);
+		(void) sfree(s->buckets);
+		(void) sfree(s->labels);
+		(void) sfree(s);
+	}
+
+	(void) mowgli_patricia_destroy(m->series_index, NULL, NULL);
+	(void) mowgli_patricia_delete(metrics_index, m->name);
+	(void) mowgli_node_delete(&m->node, &metrics_list);
+
+	(void) sfree(m->bounds);
+	(void) sfree(m->help);
+	(void) sfree(m->name);
+	(void) sfree(m);
+}
+
+/*
+ * metric_series_get(struct metric *m, const char *labels)
+ *
+ * Finds or creates the series of a metric with the given labels, as
+ * produced by metric_labels(); NULL or "" for a metric without labels.
+ */
+struct metric_series *
+metric_series_get(struct metric *const restrict m, const char *labels)
+{
+	struct metric_series *s;
+
+	if (! m)
+		return NULL;
+
+	if (! labels)
+		labels = "";
+
+	// the series without labels, if any, is kept at the front (a patricia key cannot be empty)
+	if (! *labels)
+	{
+		if (m->series.head && ! *((struct metric_series *) m->series.head->data)->labels)
+			return m->series.head->data;
+	}
+	else if ((s = mowgli_patricia_retrieve(m->series_index, labels)))
+		return s;
+
+	s = smalloc(sizeof *s);
+	s->metric = m;
+	s->labels = sstrdup(labels);
+
+	if (m->type == METRIC_HISTOGRAM)
+		s->buckets = smalloc(m->nbounds * sizeof *s->buckets);
+
+	if (*labels)
+	{
+		(void) mowgli_patricia_add(m->series_index, s->labels, s);
+		(void) mowgli_node_add(s, &s->node, &m->series);
+	}
+	else
+		(void) mowgli_node_add_head(s, &s->node, &m->series);
+
+	return s;
+}
+
+void
+metric_series_add(struct metric_series *const restrict s, const double value)
+{
+	if (s)
+		s->value += value;
+}
+
+void
+metric_series_set(struct metric_series *const restrict s, const double value)
+{
+	if (s)
+		s->value = value;
+}
+
+void
+metric_series_observe(struct metric_series *const restrict s, const double value)
+{
+	if (! s || ! s->buckets)
+		return;
+
+	const struct metric *const m = s->metric;
+
+	for (size_t i = 0; i < m->nbounds; i++)
+	{
+		if (value <= m->bounds[i])
+		{
+			s->buckets[i]++;
+			break;
+		}
+	}
+
+	s->count++;
+	s->sum += value;
+}
+
+void
+metric_add(struct metric *const restrict m, const char *const restrict labels, const double value)
+{
+	(void) metric_series_add(metric_series_get(m, labels), value);
+}
+
+void
+metric_set(struct metric *const restrict m, const char *const restrict labels, const double value)
+{
+	(void) metric_series_set(metric_series_get(m, labels), value);
+}
+
+void
+metric_observe(struct metric *const restrict m, const char *const restrict labels, const double value)
+{
+	(void) metric_series_observe(metric_series_get(m, labels), value);
+}
+
+/*
+ * metric_labels(char *buf, size_t bufsize, const char *name, const char *value, ..., NULL)
+ *
+ * Formats label name/value pairs for metric_series_get(), escaping the
+ * values. The list of pairs ends with a NULL name.
+ *
+ * Outputs:
+ *      - the length of the result in buf (truncated to fit if necessary)
+ */
+size_t
+metric_labels(char *const restrict buf, const size_t bufsize, ...)
+{
+	const char *name;
+	size_t len = 0;
+	va_list ap;
+
+	return_val_if_fail(buf != NULL, 0);
+	return_val_if_fail(bufsize != 0, 0);
+
+	*buf = '\0';
+
+	va_start(ap, bufsize);
+
+	while ((name = va_arg(ap, const char *)))
+	{
+		const char *value = va_arg(ap, const char *);
+
+		if (! value)
+			value = "";
+
+		if (len)
+			(void) mowgli_strlcat(buf, ",", bufsize);
+
+		(void) mowgli_strlcat(buf, name, bufsize);
+		(void) mowgli_strlcat(buf, "=\"", bufsize);
+
+		len = strlen(buf);
+
+		// room for an escaped character and the closing quote
+		for (; *value && len + 3 < bufsize; value++)
+		{
+			if (*value == '\n')
+			{
+				buf[len++] = '\\';
+				buf[len++] = 'n';
+				continue;
+			}
+
+			if (*value == '\\' || *value == '"')
+				buf[len++] = '\\';
+
+			buf[len++] = *value;
+		}
+
+		buf[len] = '\0';
+
+		(void) mowgli_strlcat(buf, "\"", bufsize);
+
+		len = strlen(buf);
+	}
+
+	va_end(ap);
+
+	return len;
+}
+
+static void
+metric_format_value(char *const restrict buf, const size_t bufsize, const double value)
+{
+	if (isnan(value))
+		(void) mowgli_strlcpy(buf, "NaN", bufsize);
+	else if (isinf(value))
+		(void) mowgli_strlcpy(buf, (value > 0) ? "+Inf" : "-Inf", bufsize);
+	else if (value > -1e15 && value < 1e15 && value == (double) (long long) value)
+		(void) snprintf(buf, bufsize, "%.0f", value);
+	else
+		(void) snprintf(buf, bufsize, "%.17g", value);
+}
+
+static void
+metrics_render_series(const struct metric *const restrict m, const struct metric_series *const restrict s,
+                      void (*const emit)(const char *, size_t, void *), void *const restrict privdata)
+{
+	char line[BUFSIZE * 2];
+	char value[64];
+	int len;
+
+	if (m->type != METRIC_HISTOGRAM)
+	{
+		(void) metric_format_value(value, sizeof value, s->value);
+
+		if (*s->labels)
+			len = snprintf(line, sizeof line, "%s{%s} %s\n", m->name, s->labels, value);
+		else
+			len = snprintf(line, sizeof line, "%s %s\n", m->name, value);
+
+		if (len > 0 && (size_t) len < sizeof line)
+			emit(line, (size_t) len, privdata);
+
+		return;
+	}
+
+	const char *const sep = *s->labels ? "," : "";
+	unsigned long long cumulative = 0;
+	char bound[64];
+
+	for (size_t i = 0; i <= m->nbounds; i++)
+	{
+		if (i < m->nbounds)
+		{
+			cumulative += s->buckets[i];
+			(void) metric_format_value(bound, sizeof bound, m->bounds[i]);
+		}
+		else
+		{
+			cumulative = s->count;
+			(void) mowgli_strlcpy(bound, "+Inf", sizeof bound);
+		}
+
+		len = snprintf(line, sizeof line, "%s_bucket{%s%sle=\"%s\"} %llu\n", m->name, s->labels, sep, bound,
+		               cumulative);
+
+		if (len > 0 && (size_t) len < sizeof line)
+			emit(line, (size_t) len, privdata);
+	}
+
+	(void) metric_format_value(value, sizeof value, s->sum);
+
+	if (*s->labels)
+		len = snprintf(line, sizeof line, "%s_sum{%s} %s\n%s_count{%s} %llu\n", m->name, s->labels, value,
+		               m->name, s->labels, s->count);
+	else
+		len = snprintf(line, sizeof line, "%s_sum %s\n%s_count %llu\n", m->name, value, m->name, s->count);
+
+	if (len > 0 && (size_t) len < sizeof line)
+		emit(line, (size_t) len, privdata);
+}
+
+/*
+ * metrics_render(void (*emit)(const char *buf, size_t len, void *privdata), void *privdata)
+ *
+ * Writes every metric out in the Prometheus text exposition format
+ * (version 0.0.4), a line or so per call of emit.
+ */
+void
+metrics_render(void (*const emit)(const char *, size_t, void *), void *const restrict privdata)
+{
+	static const char *const type_names[] = {
+		[METRIC_COUNTER]   = "counter",
+		[METRIC_GAUGE]     = "gauge",
+		[METRIC_HISTOGRAM] = "histogram",
+	};
+
+	char line[BUFSIZE * 2];
+	mowgli_node_t *n, *sn;
+	int len;
+
+	return_if_fail(emit != NULL);
+
+	MOWGLI_ITER_FOREACH(n, metrics_list.head)
+	{
+		struct metric *const m = n->data;
+
+		if (m->collect)
+			m->collect(m, m->privdata);
+
+		len = snprintf(line, sizeof line, "# HELP %s %s\n# TYPE %s %s\n", m->name, m->help, m->name,
+		               type_names[m->type]);
+
+		if (len > 0 && (size_t) len < sizeof line)
+			emit(line, (size_t) len, privdata);
+
+		MOWGLI_ITER_FOREACH(sn, m->series.head)
+			(void) metrics_render_series(m, sn->data, emit, privdata);
+	}
+}
+
+static void
+metrics_collect_uint(struct metric *const restrict m, void *const restrict privdata)
+{
+	(void) metric_set(m, NULL, *((const unsigned int *) privdata));
+}
+
+static void
+metrics_collect_time(struct metric *const restrict m, void *const restrict privdata)
+{
+	(void) metric_set(m, NULL, (double) *((const time_t *) privdata));
+}
+
+static void
+metrics_collect_network_bytes(struct metric *const restrict m, void ATHEME_VATTR_UNUSED *const restrict privdata)
+{
+	(void) metric_set(m, "direction=\"in\"", cnt.bin);
+	(void) metric_set(m, "direction=\"out\"", cnt.bout);
+}
+
+static void
+metrics_collect_connections(struct metric *const restrict m, void ATHEME_VATTR_UNUSED *const restrict privdata)
+{
+	(void) metric_set(m, NULL, MOWGLI_LIST_LENGTH(&connection_list));
+}
+
+static void
+metrics_collect_sendq(struct metric *const restrict m, void ATHEME_VATTR_UNUSED *const restrict privdata)
+{
+	double uplink = 0, other = 0;
+	mowgli_node_t *n;
+
+	MOWGLI_ITER_FOREACH(n, connection_list.head)
+	{
+		struct connection *const cptr = n->data;
+		const size_t len = sendq_length(cptr);
+
+		if (cptr->flags & CF_UPLINK)
+			uplink += len;
+		else
+			other += len;
+	}
+
+	(void) metric_set(m, "connection=\"uplink\"", uplink);
+	(void) metric_set(m, "connection=\"other\"", other);
+}
+
+static void
+metrics_collect_recvq(struct metric *const restrict m, void ATHEME_VATTR_UNUSED *const restrict privdata)
+{
+	double uplink = 0, other = 0;
+	mowgli_node_t *n;
+
+	MOWGLI_ITER_FOREACH(n, connection_list.head)
+	{
+		struct connection *const cptr = n->data;
+		const int len = recvq_length(cptr);
+
+		if (cptr->flags & CF_UPLINK)
+			uplink += len;
+		else
+			other += len;
+	}
+
+	(void) metric_set(m, "connection=\"uplink\"", uplink);
+	(void) metric_set(m, "connection=\"other\"", other);
+}
+
+static int
+metrics_collect_command(struct command *const restrict c, void *const restrict privdata)
+{
+	struct metric *const m = privdata;
+	char labels[BUFSIZE];
+
+	(void) metric_labels(labels, sizeof labels, "service", c->stats.service, "command", c->stats.name, NULL);
+
+	// commands that share a name (in different modules) are added together
+	struct metric_series *const s = metric_series_get(m, labels);
+
+	if (m->type != METRIC_HISTOGRAM)
+	{
+		(void) metric_series_add(s, (double) c->stats.calls);
+		return 0;
+	}
+
+	// the histogram has the command's buckets as they are, less the last (+Inf) one
+	for (size_t i = 0; i < m->nbounds; i++)
+		s->buckets[i] += c->stats.buckets[i];
+
+	s->count += c->stats.calls;
+	s->sum += ((double) c->stats.usec_total) / 1000000.0;
+
+	return 0;
+}
+
+/* Collectors whose series come and go (commands that are removed, hook
+ * handlers of unloaded modules) would keep their last values otherwise,
+ * so they start from scratch.
+ */
+static void
+metrics_clear_series(struct metric *const restrict m)
+{
+	mowgli_node_t *n, *tn;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, m->series.head)
+	{
+		struct metric_series *const s = n->data;
+
+		(void) mowgli_node_delete(&s->node, &m->series);
+		(void) mowgli_patricia_delete(m->series_index, s->labels);
+		(void) sfree(s->buckets);
+		(void) sfree(s->labels);
+		(void) sfree(s);
+	}
+}
+
+static void
+metrics_collect_commands(struct metric *const restrict m, void ATHEME_VATTR_UNUSED *const restrict privdata)
+{
+	(void) metrics_clear_series(m);
+	(void) command_stats_foreach(&metrics_collect_command, m);
+}
+
+static int
+metrics_collect_timer(const struct timer_stats *const restrict ts, void *const restrict privdata)
+{
+	char labels[BUFSIZE];
+
+	(void) metric_labels(labels, sizeof labels, "timer", ts->name, NULL);
+	(void) metric_set(privdata, labels, ((double) ts->usec_total) / 1000000.0);
+
+	return 0;
+}
+
+static void
+metrics_collect_timers(struct metric *const restrict m, void ATHEME_VATTR_UNUSED *const restrict privdata)
+{
+	(void) loopstats_timer_foreach(&metrics_collect_timer, m);
+}
+
+static int
+metrics_collect_hook(const struct hook_handler_stats *const restrict hs, void *const restrict privdata)
+{
+	char labels[BUFSIZE];
+
+	(void) metric_labels(labels, sizeof labels, "hook", hs->event, "module", hs->owner, NULL);
+
+	// a module may have several handlers for one hook
+	(void) metric_add(privdata, labels, ((double) hs->usec_total) / 1000000.0);
+
+	return 0;
+}
+
+static void
+metrics_collect_hooks(struct metric *const restrict m, void ATHEME_VATTR_UNUSED *const restrict privdata)
+{
+	(void) metrics_clear_series(m);
+	(void) hook_stats_foreach(&metrics_collect_hook, m);
+}
+
+struct metrics_heap_collect
+{
+	struct metric * metric;
+	bool            bytes;
+};
+
+static int
+metrics_collect_heap(const struct sharedheap *const restrict s, void *const restrict privdata)
+{
+	const struct metrics_heap_collect *const hc = privdata;
+	char labels[BUFSIZE];
+
+	(void) metric_labels(labels, sizeof labels, "tag", s->tag, NULL);
+
+	// a tag may be used for objects of more than one size
+	(void) metric_add(hc->metric, labels, (double) (hc->bytes ? (s->objects * s->size) : s->objects));
+
+	return 0;
+}
+
+// heaps that are gone would keep their last values otherwise, as with commands
+static void
+metrics_collect_heaps(struct metric *const restrict m, const bool bytes)
+{
+	const struct metrics_heap_collect hc = { m, bytes };
+
+	(void) metrics_clear_series(m);
+	(void) sharedheap_foreach(&metrics_collect_heap, (void *) &hc);
+}
+
+static void
+metrics_collect_heap_objects(struct metric *const restrict m, void ATHEME_VATTR_UNUSED *const restrict privdata)
+{
+	(void) metrics_collect_heaps(m, false);
+}
+
+static void
+metrics_collect_heap_bytes(struct metric *const restrict m, void ATHEME_VATTR_UNUSED *const restrict privdata)
+{
+	(void) metrics_collect_heaps(m, true);
+}
+
+static void
+metrics_collect_max_rss(struct metric *const restrict m, void ATHEME_VATTR_UNUSED *const restrict privdata)
+{
+#ifndef MOWGLI_OS_WIN
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+		return;
+
+#ifdef MOWGLI_OS_OSX
+	(void) metric_set(m, NULL, (double) ru.ru_maxrss);
+#else
+	(void) metric_set(m, NULL, ((double) ru.ru_maxrss) * 1024.0);
+#endif
+#endif
+}
+
+static void
+metrics_collect_rss(struct metric *const restrict m, void ATHEME_VATTR_UNUSED *const restrict privdata)
+{
+	unsigned long size, resident;
+	FILE *f;
+
+	// Linux only; elsewhere the metric is left at 0
+	if (! (f = fopen("/proc/self/statm", "r")))
+		return;
+
+	if (fscanf(f, "%lu %lu", &size, &resident) == 2)
+		(void) metric_set(m, NULL, ((double) resident) * (double) sysconf(_SC_PAGESIZE));
+
+	(void) fclose(f);
+}
+
+static void
+metrics_add_uint_gauge(const char *const restrict name, const char *const restrict help,
+                       const unsigned int *const restrict value)
+{
+	(void) metric_set_collector(metric_create(name, help, METRIC_GAUGE), &metrics_collect_uint, (void *) value);
+}
+
+void
+metrics_init(void)
+{
+	metrics_index = mowgli_patricia_create(NULL);
+
+	(void) metrics_add_uint_gauge("atheme_users", "Users on the network", &cnt.user);
+	(void) metrics_add_uint_gauge("atheme_channels", "Channels on the network", &cnt.chan);
+	(void) metrics_add_uint_gauge("atheme_servers", "Servers on the network", &cnt.server);
+	(void) metrics_add_uint_gauge("atheme_accounts", "Registered accounts", &cnt.myuser);
+	(void) metrics_add_uint_gauge("atheme_registered_nicks", "Registered nicknames", &cnt.mynick);
+	(void) metrics_add_uint_gauge("atheme_registered_channels", "Registered channels", &cnt.mychan);
+
+	(void) metric_set_collector(metric_create("atheme_start_time_seconds",
+	                                          "Time services started, in seconds since the epoch",
+	                                          METRIC_GAUGE), &metrics_collect_time, &me.start);
+
+	(void) metric_set_collector(metric_create("atheme_connections", "Open connections (uplink, listeners, "
+	                                          "clients)", METRIC_GAUGE), &metrics_collect_connections, NULL);
+
+	(void) metric_set_collector(metric_create("atheme_network_bytes_total", "Bytes received and sent",
+	                                          METRIC_COUNTER), &metrics_collect_network_bytes, NULL);
+
+	(void) metric_set_collector(metric_create("atheme_sendq_bytes", "Bytes waiting to be sent",
+	                                          METRIC_GAUGE), &metrics_collect_sendq, NULL);
+
+	(void) metric_set_collector(metric_create("atheme_recvq_bytes", "Bytes received but not yet processed",
+	                                          METRIC_GAUGE), &metrics_collect_recvq, NULL);
+
+	(void) metric_set_collector(metric_create("atheme_process_resident_memory_bytes",
+	                                          "Resident memory size", METRIC_GAUGE), &metrics_collect_rss, NULL);
+
+	(void) metric_set_collector(metric_create("atheme_process_max_resident_memory_bytes",
+	                                          "Largest resident memory size so far", METRIC_GAUGE),
+	                            &metrics_collect_max_rss, NULL);
+
+	(void) metric_set_collector(metric_create("atheme_commands_total", "Service commands run, by service and "
+	                                          "command", METRIC_COUNTER), &metrics_collect_commands, NULL);
+
+	double command_bounds[COMMAND_LATENCY_BUCKETS - 1];
+
+	for (unsigned int i = 0; i < COMMAND_LATENCY_BUCKETS - 1; i++)
+		command_bounds[i] = ((double) (1ULL << (i + 1))) / 1000000.0;
+
+	(void) metric_set_collector(metric_histogram_create("atheme_command_duration_seconds", "How long service "
+	                                                    "commands take to run, by service and command",
+	                                                    command_bounds, ARRAY_SIZE(command_bounds)),
+	                            &metrics_collect_commands, NULL);
+
+	(void) metric_set_collector(metric_create("atheme_heap_objects", "Objects allocated from shared heaps, by "
+	                                          "tag", METRIC_GAUGE), &metrics_collect_heap_objects, NULL);
+
+	(void) metric_set_collector(metric_create("atheme_heap_bytes", "Bytes of objects allocated from shared "
+	                                          "heaps, by tag", METRIC_GAUGE), &metrics_collect_heap_bytes, NULL);
+
+	(void) metric_set_collector(metric_create("atheme_timer_seconds_total", "Time spent running timers, by "
+	                                          "timer", METRIC_COUNTER), &metrics_collect_timers, NULL);
+
+	(void) metric_set_collector(metric_create("atheme_hook_seconds_total", "Time spent in hook handlers, by "
+	                                          "hook and the module that added the handler", METRIC_COUNTER),
+	                            &metrics_collect_hooks, NULL);
+}
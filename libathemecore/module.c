@@ -24,7 +24,7 @@
 static struct module *module_load_internal(const char *pathname, char *errbuf, int errlen);
 
 static mowgli_list_t modules_inprogress;
-static mowgli_heap_t *module_heap = NULL;
+static struct sharedheap *module_heap = NULL;
 static struct module *modtarget = NULL;
 
 mowgli_list_t modules;
@@ -32,7 +32,7 @@ mowgli_list_t modules;
 void
 modules_init(void)
 {
-	module_heap = sharedheap_get(sizeof(struct module));
+	module_heap = sharedheap_get("module", sizeof(struct module));
 
 	if (!module_heap)
 	{
@@ -168,7 +168,7 @@ module_load_internal(const char *pathname, char *errbuf, int errlen)
 		return NULL;
 	}
 
-	m = mowgli_heap_alloc(module_heap);
+	m = sharedheap_alloc(module_heap);
 
 	mowgli_strlcpy(m->modpath, pathname, BUFSIZE);
 	mowgli_strlcpy(m->name, h->name, BUFSIZE);
@@ -350,7 +350,7 @@ module_unload(struct module *m, const enum module_unload_intent intent)
 	if (m->handle)
 	{
 		mowgli_module_close(m->handle);
-		mowgli_heap_free(module_heap, m);
+		sharedheap_free(module_heap, m);
 	}
 	else
 	{
@@ -433,6 +433,24 @@ module_find(const char *name)
 	return NULL;
 }
 
+/*
+ * module_loading()
+ *
+ * inputs:
+ *       none
+ *
+ * outputs:
+ *       the module whose initialisation is running, else NULL.
+ *
+ * side effects:
+ *       none
+ */
+struct module *
+module_loading(void)
+{
+	return modtarget;
+}
+
 /*
  * module_find_published()
  *
@@ -20,9 +20,9 @@ mowgli_list_t klnlist;
 mowgli_list_t xlnlist;
 mowgli_list_t qlnlist;
 
-static mowgli_heap_t *kline_heap = NULL;	/* 16 */
-static mowgli_heap_t *xline_heap = NULL;	/* 16 */
-static mowgli_heap_t *qline_heap = NULL;	/* 16 */
+static struct sharedheap *kline_heap = NULL;	/* 16 */
+static struct sharedheap *xline_heap = NULL;	/* 16 */
+static struct sharedheap *qline_heap = NULL;	/* 16 */
 
 /*************
  * L I S T S *
@@ -31,9 +31,9 @@ static mowgli_heap_t *qline_heap = NULL;	/* 16 */
 void
 init_nodes(void)
 {
-	kline_heap = sharedheap_get(sizeof(struct kline));
-	xline_heap = sharedheap_get(sizeof(struct xline));
-	qline_heap = sharedheap_get(sizeof(struct qline));
+	kline_heap = sharedheap_get("kline", sizeof(struct kline));
+	xline_heap = sharedheap_get("xline", sizeof(struct xline));
+	qline_heap = sharedheap_get("qline", sizeof(struct qline));
 
 	if (kline_heap == NULL || xline_heap == NULL || qline_heap == NULL)
 	{
@@ -122,7 +122,7 @@ kline_add_with_id(const char *user, const char *host, const char *reason, long d
 
 	slog(LG_DEBUG, "kline_add(): %s@%s -> %s (%ld)", user, host, reason, duration);
 
-	k = mowgli_heap_alloc(kline_heap);
+	k = sharedheap_alloc(kline_heap);
 
 	mowgli_node_add(k, n, &klnlist);
 
@@ -183,7 +183,7 @@ kline_delete(struct kline *k)
 	sfree(k->reason);
 	sfree(k->setby);
 
-	mowgli_heap_free(kline_heap, k);
+	sharedheap_free(kline_heap, k);
 
 	cnt.kline--;
 }
@@ -284,7 +284,7 @@ xline_add(const char *realname, const char *reason, long duration, const char *s
 
 	slog(LG_DEBUG, "xline_add(): %s -> %s (%ld)", realname, reason, duration);
 
-	x = mowgli_heap_alloc(xline_heap);
+	x = sharedheap_alloc(xline_heap);
 
 	mowgli_node_add(x, n, &xlnlist);
 
@@ -330,7 +330,7 @@ xline_delete(const char *realname)
 	sfree(x->reason);
 	sfree(x->setby);
 
-	mowgli_heap_free(xline_heap, x);
+	sharedheap_free(xline_heap, x);
 
 	cnt.xline--;
 }
@@ -428,7 +428,7 @@ qline_add(const char *mask, const char *reason, long duration, const char *setby
 
 	slog(LG_DEBUG, "qline_add(): %s -> %s (%ld)", mask, reason, duration);
 
-	q = mowgli_heap_alloc(qline_heap);
+	q = sharedheap_alloc(qline_heap);
 	mowgli_node_add(q, n, &qlnlist);
 
 	q->mask = sstrdup(mask);
@@ -473,7 +473,7 @@ qline_delete(const char *mask)
 	sfree(q->reason);
 	sfree(q->setby);
 
-	mowgli_heap_free(qline_heap, q);
+	sharedheap_free(qline_heap, q);
 
 	cnt.qline--;
 }
@@ -20,12 +20,12 @@
 mowgli_list_t object_list = { NULL, NULL, 0 };
 #endif
 
-static mowgli_heap_t *metadata_heap = NULL;	/* HEAP_CHANUSER */
+static struct sharedheap *metadata_heap = NULL;	/* HEAP_CHANUSER */
 
 void
 init_metadata(void)
 {
-	metadata_heap = sharedheap_get(sizeof(struct metadata));
+	metadata_heap = sharedheap_get("metadata", sizeof(struct metadata));
 
 	if (metadata_heap == NULL)
 	{
@@ -200,6 +200,9 @@ atheme_object_dispose(void *object)
 	mowgli_node_delete(&obj->dnode, &object_list);
 #endif
 
+	// let a save in progress write out what this belonged to first
+	db_modifying(object);
+
 	if (obj->destructor != NULL)
 		obj->destructor(obj);
 	else
@@ -224,6 +227,8 @@ metadata_add(void *target, const char *name, const char *value)
 	return_val_if_fail(name != NULL, NULL);
 	return_val_if_fail(value != NULL, NULL);
 
+	db_modifying(target);
+
 	obj = atheme_object(target);
 
 	if (obj->metadata == NULL)
@@ -231,7 +236,7 @@ metadata_add(void *target, const char *name, const char *value)
 	else if (metadata_find(target, name))
 		metadata_delete(target, name);
 
-	md = mowgli_heap_alloc(metadata_heap);
+	md = sharedheap_alloc(metadata_heap);
 
 	md->name = strshare_get(name);
 	md->value = sstrdup(value);
@@ -250,6 +255,8 @@ metadata_delete(void *target, const char *name)
 	if (!md)
 		return;
 
+	db_modifying(target);
+
 	obj = atheme_object(target);
 
 	return_if_fail(obj->metadata != NULL);
@@ -259,7 +266,7 @@ metadata_delete(void *target, const char *name)
 	strshare_unref(md->name);
 	sfree(md->value);
 
-	mowgli_heap_free(metadata_heap, md);
+	sharedheap_free(metadata_heap, md);
 }
 
 struct metadata *
@@ -320,6 +327,24 @@ privatedata_set(void *target, const char *key, void *data)
 	mowgli_patricia_add(obj->privatedata, key, data);
 }
 
+void
+privatedata_delete(void *target, const char *key)
+{
+	struct atheme_object *obj;
+
+	obj = atheme_object(target);
+	if (obj->privatedata == NULL)
+		return;
+
+	mowgli_patricia_delete(obj->privatedata, key);
+
+	if (mowgli_patricia_size(obj->privatedata) == 0)
+	{
+		mowgli_patricia_destroy(obj->privatedata, NULL, NULL);
+		obj->privatedata = NULL;
+	}
+}
+
 /* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
  * vim:ts=8
  * vim:sw=8
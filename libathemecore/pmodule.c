@@ -18,7 +18,7 @@
 
 mowgli_patricia_t *pcommands;
 
-mowgli_heap_t *pcommand_heap;
+struct sharedheap *pcommand_heap;
 mowgli_heap_t *messagetree_heap;
 
 const struct cmode *mode_list = NULL;
@@ -33,7 +33,7 @@ bool backend_loaded = false;
 void
 pcommand_init(void)
 {
-	pcommand_heap = sharedheap_get(sizeof(struct proto_cmd));
+	pcommand_heap = sharedheap_get("proto_cmd", sizeof(struct proto_cmd));
 
 	if (!pcommand_heap)
 	{
@@ -55,7 +55,7 @@ pcommand_add(const char *token, void (*handler) (struct sourceinfo *si, int parc
 		return;
 	}
 
-	pcmd = mowgli_heap_alloc(pcommand_heap);
+	pcmd = sharedheap_alloc(pcommand_heap);
 	pcmd->token = sstrdup(token);
 	pcmd->handler = handler;
 	pcmd->minparc = minparc;
@@ -79,7 +79,7 @@ pcommand_delete(const char *token)
 
 	sfree(pcmd->token);
 	pcmd->handler = NULL;
-	mowgli_heap_free(pcommand_heap, pcmd);
+	sharedheap_free(pcommand_heap, pcmd);
 }
 
 struct proto_cmd *
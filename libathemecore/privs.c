@@ -19,8 +19,8 @@
 mowgli_list_t operclasslist;
 mowgli_list_t soperlist;
 
-static mowgli_heap_t *operclass_heap = NULL;
-static mowgli_heap_t *soper_heap = NULL;
+static struct sharedheap *operclass_heap = NULL;
+static struct sharedheap *soper_heap = NULL;
 
 static struct operclass *user_r = NULL;
 static struct operclass *authenticated_r = NULL;
@@ -29,8 +29,8 @@ static struct operclass *ircop_r = NULL;
 void
 init_privs(void)
 {
-	operclass_heap = sharedheap_get(sizeof(struct operclass));
-	soper_heap = sharedheap_get(sizeof(struct soper));
+	operclass_heap = sharedheap_get("operclass", sizeof(struct operclass));
+	soper_heap = sharedheap_get("soper", sizeof(struct soper));
 
 	if (!operclass_heap || !soper_heap)
 	{
@@ -75,7 +75,7 @@ operclass_add(const char *name, const char *privs, int flags)
 
 	slog(LG_DEBUG, "operclass_add(): create %s [%s]", name, privs);
 
-	operclass = mowgli_heap_alloc(operclass_heap);
+	operclass = sharedheap_alloc(operclass_heap);
 	operclass->name = sstrdup(name);
 	operclass->privs = sstrdup(privs);
 	operclass->flags = flags;
@@ -119,7 +119,7 @@ operclass_delete(struct operclass *operclass)
 	sfree(operclass->name);
 	sfree(operclass->privs);
 
-	mowgli_heap_free(operclass_heap, operclass);
+	sharedheap_free(operclass_heap, operclass);
 	cnt.operclass--;
 }
 
@@ -175,7 +175,7 @@ soper_add(const char *name, const char *classname, int flags, const char *passwo
 
 	slog(LG_DEBUG, "soper_add(): %s -> %s", (mu) ? entity(mu)->name : name, operclass ? operclass->name : "<null>");
 
-	soper = mowgli_heap_alloc(soper_heap);
+	soper = sharedheap_alloc(soper_heap);
 	n = mowgli_node_create();
 
 	mowgli_node_add(soper, n, &soperlist);
@@ -227,7 +227,7 @@ soper_delete(struct soper *soper)
 	sfree(soper->classname);
 	sfree(soper->password);
 
-	mowgli_heap_free(soper_heap, soper);
+	sharedheap_free(soper_heap, soper);
 
 	cnt.soper--;
 }
@@ -101,12 +101,33 @@ dictionary_stats_cb(const char *line, void *privdata)
 	numeric_sts(me.me, 249, ((struct user *)privdata), "B :%s", line);
 }
 
+static int
+sharedheap_stats_cb(const struct sharedheap *s, void *privdata)
+{
+	numeric_sts(me.me, 249, ((struct user *)privdata), "B :heap %s: %zu objects of %zu bytes (%zu KiB), peak %zu, %llu allocated in total",
+		s->tag, s->objects, s->size, (s->objects * s->size) / 1024U, s->objects_peak, s->allocs);
+
+	return 0;
+}
+
 static void
 connection_stats_cb(const char *line, void *privdata)
 {
 	numeric_sts(me.me, 249, ((struct user *)privdata), "F :%s", line);
 }
 
+static void
+loopstats_stats_cb(const char *line, void *privdata)
+{
+	numeric_sts(me.me, 249, ((struct user *)privdata), "E :%s", line);
+}
+
+static void
+mailqueue_stats_cb(const char *line, void *privdata)
+{
+	numeric_sts(me.me, 249, ((struct user *)privdata), "M :%s", line);
+}
+
 void
 handle_stats(struct user *u, char req)
 {
@@ -135,6 +156,7 @@ handle_stats(struct user *u, char req)
 		  myentity_stats(dictionary_stats_cb, u);
 		  mowgli_patricia_stats(nicklist, dictionary_stats_cb, u);
 		  mowgli_patricia_stats(mclist, dictionary_stats_cb, u);
+		  sharedheap_foreach(sharedheap_stats_cb, u);
 		  break;
 
 	  case 'C':
@@ -165,6 +187,8 @@ handle_stats(struct user *u, char req)
 				  numeric_sts(me.me, 249, u, "E :%-28s %4ld seconds (%ld)", timer->name, (long)(timer->deadline - mowgli_eventloop_get_time(base_eventloop)), (long)timer->frequency);
 		  }
 
+		  loopstats_stats_report(loopstats_stats_cb, u);
+
 		  break;
 
 	  case 'f':
@@ -220,6 +244,14 @@ handle_stats(struct user *u, char req)
 
 		  break;
 
+	  case 'M':
+	  case 'm':
+		  if (!has_priv_user(u, PRIV_SERVER_AUSPEX))
+			  break;
+
+		  mailqueue_stats_report(mailqueue_stats_cb, u);
+		  break;
+
 	  case 'o':
 	  case 'O':
 		  if (!has_priv_user(u, PRIV_VIEWPRIVS))
@@ -338,6 +370,13 @@ handle_stats(struct user *u, char req)
 		  break;
 	}
 
+	struct hook_stats_req req_data = {
+		.u   = u,
+		.req = req,
+	};
+
+	hook_call_stats_request(&req_data);
+
 	numeric_sts(me.me, 219, u, "%c :End of /STATS report", req);
 }
 
@@ -66,7 +66,9 @@ io_loop(void)
 	while (!(runflags & (RF_SHUTDOWN | RF_RESTART)))
 	{
 		CURRTIME = mowgli_eventloop_get_time(base_eventloop);
+		loopstats_run_timers();
 		mowgli_eventloop_run_once(base_eventloop);
+		loopstats_iteration_end();
 		check_signals();
 	}
 }
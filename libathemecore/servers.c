@@ -19,8 +19,8 @@
 static void server_delete_serv(struct server *s);
 
 static mowgli_patricia_t *sidlist = NULL;
-static mowgli_heap_t *serv_heap = NULL;
-static mowgli_heap_t *tld_heap = NULL;
+static struct sharedheap *serv_heap = NULL;
+static struct sharedheap *tld_heap = NULL;
 
 mowgli_patricia_t *servlist;
 mowgli_list_t tldlist;
@@ -43,8 +43,8 @@ mowgli_list_t tldlist;
 void
 init_servers(void)
 {
-	serv_heap = sharedheap_get(sizeof(struct server));
-	tld_heap = sharedheap_get(sizeof(struct tld));
+	serv_heap = sharedheap_get("server", sizeof(struct server));
+	tld_heap = sharedheap_get("tld", sizeof(struct tld));
 
 	if (serv_heap == NULL || tld_heap == NULL)
 	{
@@ -98,7 +98,7 @@ server_add(const char *name, unsigned int hops, struct server *uplink, const cha
 	else
 		slog(LG_DEBUG, "server_add(): %s, root", name);
 
-	s = mowgli_heap_alloc(serv_heap);
+	s = sharedheap_alloc(serv_heap);
 
 	if (id != NULL)
 	{
@@ -212,7 +212,10 @@ server_delete_serv(struct server *s)
 		 * XXX should we do this here?
 		 * -- jilles */
 		if (u->myuser != NULL)
+		{
+			db_modifying(u->myuser);
 			u->myuser->flags &= ~MU_NOBURSTLOGIN;
+		}
 		user_delete(u, "*.net *.split");
 	}
 
@@ -246,7 +249,7 @@ server_delete_serv(struct server *s)
 	sfree(s->desc);
 	sfree(s->sid);
 
-	mowgli_heap_free(serv_heap, s);
+	sharedheap_free(serv_heap, s);
 
 	cnt.server--;
 }
@@ -301,7 +304,7 @@ tld_add(const char *name)
 
         slog(LG_DEBUG, "tld_add(): %s", name);
 
-        tld = mowgli_heap_alloc(tld_heap);
+        tld = sharedheap_alloc(tld_heap);
 
         mowgli_node_add(tld, n, &tldlist);
 
@@ -346,7 +349,7 @@ tld_delete(const char *name)
         mowgli_node_free(n);
 
         sfree(tld->name);
-        mowgli_heap_free(tld_heap, tld);
+        sharedheap_free(tld_heap, tld);
 
         cnt.tld--;
 }
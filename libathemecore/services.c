@@ -16,7 +16,7 @@
 #include <atheme.h>
 #include "internal.h"
 
-static mowgli_heap_t *sourceinfo_heap = NULL;
+static struct sharedheap *sourceinfo_heap = NULL;
 
 int authservice_loaded = 0;
 int use_myuser_access = 0;
@@ -466,7 +466,10 @@ handle_burstlogin(struct user *u, const char *login, time_t ts)
 		/* we're running without a persistent db, create it */
 		mu = myuser_add(login, "*", "noemail", MU_CRYPTPASS);
 		if (ts != 0)
+		{
 			mu->registered = ts;
+			myuser_index_update(mu);
+		}
 		metadata_add(mu, "fake", "1");
 	}
 	if (u->myuser != NULL)	/* already logged in, hmm */
@@ -495,6 +498,7 @@ handle_burstlogin(struct user *u, const char *login, time_t ts)
 	}
 	u->myuser = mu;
 	u->flags &= ~UF_SOPER_PASS;
+	db_modifying(mu);
 	n = mowgli_node_create();
 	mowgli_node_add(u, n, &mu->logins);
 	slog(LG_DEBUG, "handle_burstlogin(): automatically identified %s as %s", u->nick, login);
@@ -534,6 +538,7 @@ handle_setlogin(struct sourceinfo *si, struct user *u, const char *login, time_t
 		n = mowgli_node_find(u, &u->myuser->logins);
 		if (n != NULL)
 		{
+			db_modifying(u->myuser);
 			mowgli_node_delete(n, &u->myuser->logins);
 			mowgli_node_free(n);
 		}
@@ -549,7 +554,10 @@ handle_setlogin(struct sourceinfo *si, struct user *u, const char *login, time_t
 		/* we're running without a persistent db, create it */
 		mu = myuser_add(login, "*", "noemail", MU_CRYPTPASS);
 		if (ts != 0)
+		{
 			mu->registered = ts;
+			myuser_index_update(mu);
+		}
 		metadata_add(mu, "fake", "1");
 	}
 	else if (ts != 0 && ts != mu->registered)
@@ -567,10 +575,13 @@ handle_setlogin(struct sourceinfo *si, struct user *u, const char *login, time_t
 		slog(LG_DEBUG, "handle_setlogin(): changing registration time for %s from %lu to %lu",
 				entity(mu)->name, (unsigned long)mu->registered,
 				(unsigned long)ts);
+		db_modifying(mu);
 		mu->registered = ts;
+		myuser_index_update(mu);
 	}
 	u->myuser = mu;
 	u->flags &= ~UF_SOPER_PASS;
+	db_modifying(mu);
 	n = mowgli_node_create();
 	mowgli_node_add(u, n, &mu->logins);
 	slog(LG_DEBUG, "handle_setlogin(): %s set %s logged in as %s",
@@ -597,6 +608,7 @@ handle_clearlogin(struct sourceinfo *si, struct user *u)
 	n = mowgli_node_find(u, &u->myuser->logins);
 	if (n != NULL)
 	{
+		db_modifying(u->myuser);
 		mowgli_node_delete(n, &u->myuser->logins);
 		mowgli_node_free(n);
 	}
@@ -671,6 +683,7 @@ myuser_login(struct service *svs, struct user *u, struct myuser *mu, bool sendac
 	myuser_notice(svs->me->nick, mu, "%s!%s@%s has just authenticated as you (%s)", u->nick, u->user, u->vhost, entity(mu)->name);
 
 	u->myuser = mu;
+	db_modifying(mu);
 	mowgli_node_add(u, mowgli_node_create(), &mu->logins);
 	u->flags &= ~UF_SOPER_PASS;
 
@@ -893,7 +906,7 @@ bad_password(struct sourceinfo *si, struct myuser *mu)
 static void
 sourceinfo_delete(struct sourceinfo *si)
 {
-	mowgli_heap_free(sourceinfo_heap, si);
+	sharedheap_free(sourceinfo_heap, si);
 }
 
 struct sourceinfo *
@@ -902,9 +915,9 @@ sourceinfo_create(void)
 	struct sourceinfo *out;
 
 	if (sourceinfo_heap == NULL)
-		sourceinfo_heap = sharedheap_get(sizeof(struct sourceinfo));
+		sourceinfo_heap = sharedheap_get("sourceinfo", sizeof(struct sourceinfo));
 
-	out = mowgli_heap_alloc(sourceinfo_heap);
+	out = sharedheap_alloc(sourceinfo_heap);
 	atheme_object_init(atheme_object(out), "<sourceinfo>", (atheme_object_destructor_fn) sourceinfo_delete);
 
 	return out;
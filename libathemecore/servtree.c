@@ -16,7 +16,7 @@
 #include <atheme.h>
 #include "internal.h"
 
-static mowgli_heap_t *service_heap = NULL;
+static struct sharedheap *service_heap = NULL;
 
 mowgli_patricia_t *services_name;
 mowgli_patricia_t *services_nick;
@@ -65,7 +65,7 @@ service_default_handler(struct sourceinfo *si, int parc, char *parv[])
 void
 servtree_init(void)
 {
-	service_heap = sharedheap_get(sizeof(struct service));
+	service_heap = sharedheap_get("service", sizeof(struct service));
 	services_name = mowgli_patricia_create(strcasecanon);
 	services_nick = mowgli_patricia_create(strcasecanon);
 
@@ -291,7 +291,7 @@ service_add(const char *name, void (*handler)(struct sourceinfo *si, int parc, c
 	return_val_if_fail(name != NULL, NULL);
 	return_val_if_fail(service_find(name) == NULL, NULL);
 
-	if (! (sptr = mowgli_heap_alloc(service_heap)))
+	if (! (sptr = sharedheap_alloc(service_heap)))
 		return NULL;
 
 	sptr->internal_name = sstrdup(name);
@@ -389,7 +389,7 @@ service_delete(struct service *sptr)
 	sfree(sptr->host);
 	sfree(sptr->real);
 
-	mowgli_heap_free(service_heap, sptr);
+	sharedheap_free(service_heap, sptr);
 }
 
 struct service *
@@ -16,37 +16,12 @@
 #include <atheme.h>
 #include "internal.h"
 
-#ifdef ATHEME_ENABLE_HEAP_ALLOCATOR
-
 static mowgli_list_t sharedheap_list;
 
-static struct sharedheap *
-sharedheap_find_by_size(const size_t size)
-{
-	mowgli_node_t *n;
-
-	MOWGLI_ITER_FOREACH(n, sharedheap_list.head)
-	{
-		struct sharedheap *const s = n->data;
-
-		if (s->size == size)
-		{
-#ifdef HEAP_DEBUG
-			(void) slog(LG_DEBUG, "%s: %zu --> %p", MOWGLI_FUNC_NAME, size, (void *) s);
-#endif
-			return s;
-		}
-	}
-
-#ifdef HEAP_DEBUG
-	(void) slog(LG_DEBUG, "%s: %zu --> NULL", MOWGLI_FUNC_NAME, size);
-#endif
-
-	return NULL;
-}
+#ifdef ATHEME_ENABLE_HEAP_ALLOCATOR
 
 static struct sharedheap *
-sharedheap_find_by_heap(mowgli_heap_t *const restrict heap)
+sharedheap_find(const char *const restrict tag, const size_t size)
 {
 	mowgli_node_t *n;
 
@@ -54,40 +29,22 @@ sharedheap_find_by_heap(mowgli_heap_t *const restrict heap)
 	{
 		struct sharedheap *const s = n->data;
 
-		if (s->heap == heap)
+		if (s->size == size && strcmp(s->tag, tag) == 0)
 		{
 #ifdef HEAP_DEBUG
-			(void) slog(LG_DEBUG, "%s: %p --> %p", MOWGLI_FUNC_NAME, (void *) heap, (void *) s);
+			(void) slog(LG_DEBUG, "%s: %s/%zu --> %p", MOWGLI_FUNC_NAME, tag, size, (void *) s);
 #endif
 			return s;
 		}
 	}
 
 #ifdef HEAP_DEBUG
-	(void) slog(LG_DEBUG, "%s: %p --> NULL", MOWGLI_FUNC_NAME, (void *) heap);
+	(void) slog(LG_DEBUG, "%s: %s/%zu --> NULL", MOWGLI_FUNC_NAME, tag, size);
 #endif
 
 	return NULL;
 }
 
-static void
-sharedheap_destroy(void *const restrict ptr)
-{
-	return_if_fail(ptr != NULL);
-
-	struct sharedheap *const s = ptr;
-
-	const size_t elem_size = s->size;
-
-	(void) mowgli_node_delete(&s->node, &sharedheap_list);
-	(void) mowgli_heap_destroy(s->heap);
-	(void) sfree(s);
-
-#ifdef HEAP_DEBUG
-	(void) slog(LG_DEBUG, "%s: sharedheap@%p: destroyed (elem_size %zu)", MOWGLI_FUNC_NAME, ptr, elem_size);
-#endif
-}
-
 static inline size_t
 sharedheap_prealloc_size(const size_t size)
 {
@@ -125,8 +82,56 @@ sharedheap_normalize_size(const size_t size)
 	return normalized;
 }
 
+#else /* ATHEME_ENABLE_HEAP_ALLOCATOR */
+
+// every caller gets a heap of its own
+static inline struct sharedheap *
+sharedheap_find(const char ATHEME_VATTR_UNUSED *const restrict tag, const size_t ATHEME_VATTR_UNUSED size)
+{
+	return NULL;
+}
+
+static inline size_t
+sharedheap_prealloc_size(const size_t ATHEME_VATTR_UNUSED size)
+{
+	return 2U;
+}
+
+static inline size_t
+sharedheap_normalize_size(const size_t size)
+{
+	return size;
+}
+
+#endif /* !ATHEME_ENABLE_HEAP_ALLOCATOR */
+
+static void
+sharedheap_destroy(void *const restrict ptr)
+{
+	return_if_fail(ptr != NULL);
+
+	struct sharedheap *const s = ptr;
+
+	const size_t elem_size = s->size;
+
+	if (s->objects)
+		(void) slog(LG_DEBUG, "%s: sharedheap@%p (%s): destroyed with %zu objects still allocated",
+		            MOWGLI_FUNC_NAME, ptr, s->tag, s->objects);
+
+	(void) mowgli_node_delete(&s->node, &sharedheap_list);
+	(void) mowgli_heap_destroy(s->heap);
+	(void) sfree(s->tag);
+	(void) sfree(s);
+
+#ifdef HEAP_DEBUG
+	(void) slog(LG_DEBUG, "%s: sharedheap@%p: destroyed (elem_size %zu)", MOWGLI_FUNC_NAME, ptr, elem_size);
+#else
+	(void) elem_size;
+#endif
+}
+
 static struct sharedheap * ATHEME_FATTR_MALLOC
-sharedheap_new(const size_t size)
+sharedheap_new(const char *const restrict tag, const size_t size)
 {
 	mowgli_heap_t *const heap = mowgli_heap_create(size, sharedheap_prealloc_size(size), BH_NOW);
 
@@ -143,60 +148,72 @@ sharedheap_new(const size_t size)
 
 	s->size = size;
 	s->heap = heap;
+	s->tag = sstrdup(tag);
 
 #ifdef HEAP_DEBUG
-	(void) slog(LG_DEBUG, "%s: created (elem_size %zu)", MOWGLI_FUNC_NAME, size);
+	(void) slog(LG_DEBUG, "%s: created (tag %s, elem_size %zu)", MOWGLI_FUNC_NAME, tag, size);
 #endif
 
 	return s;
 }
 
-mowgli_heap_t *
-sharedheap_get(const size_t size)
+struct sharedheap *
+sharedheap_get(const char *const restrict tag, const size_t size)
 {
+	return_val_if_fail(tag != NULL, NULL);
+
 	const size_t normalized = sharedheap_normalize_size(size);
 
-	struct sharedheap *s = sharedheap_find_by_size(normalized);
+	struct sharedheap *s = sharedheap_find(tag, normalized);
 
 	if (s)
 		(void) atheme_object_ref(s);
-	else if (! (s = sharedheap_new(normalized)))
+	else if (! (s = sharedheap_new(tag, normalized)))
 		return NULL;
 
-	return s->heap;
+	return s;
 }
 
 void
-sharedheap_unref(mowgli_heap_t *const restrict heap)
+sharedheap_unref(struct sharedheap *const restrict s)
 {
-	return_if_fail(heap != NULL);
-
-	struct sharedheap *const s = sharedheap_find_by_heap(heap);
-
 	return_if_fail(s != NULL);
 
 	(void) atheme_object_unref(s);
 }
 
-#else /* ATHEME_ENABLE_HEAP_ALLOCATOR */
-
-mowgli_heap_t *
-sharedheap_get(const size_t size)
+void *
+sharedheap_alloc(struct sharedheap *const restrict s)
 {
-	mowgli_heap_t *const heap = mowgli_heap_create(size, 2, BH_NOW);
+	void *const ptr = mowgli_heap_alloc(s->heap);
 
-	if (! heap)
+	if (! ptr)
 		return NULL;
 
-	return heap;
+	s->allocs++;
+
+	if (++s->objects > s->objects_peak)
+		s->objects_peak = s->objects;
+
+	return ptr;
 }
 
 void
-sharedheap_unref(mowgli_heap_t *const restrict heap)
+sharedheap_free(struct sharedheap *const restrict s, void *const restrict ptr)
 {
-	return_if_fail(heap != NULL);
+	return_if_fail(ptr != NULL);
+
+	(void) mowgli_heap_free(s->heap, ptr);
 
-	(void) mowgli_heap_destroy(heap);
+	s->objects--;
 }
 
-#endif /* !ATHEME_ENABLE_HEAP_ALLOCATOR */
+void
+sharedheap_foreach(int (*cb)(const struct sharedheap *s, void *privdata), void *privdata)
+{
+	mowgli_node_t *n;
+
+	MOWGLI_ITER_FOREACH(n, sharedheap_list.head)
+		if (cb(n->data, privdata))
+			return;
+}
@@ -18,7 +18,7 @@
 
 static void uplink_close(struct connection *cptr);
 
-static mowgli_heap_t *uplink_heap = NULL;
+static struct sharedheap *uplink_heap = NULL;
 
 mowgli_list_t uplinks;
 struct uplink *curr_uplink;
@@ -28,7 +28,7 @@ void (*parse)(char *line) = NULL;
 void
 init_uplinks(void)
 {
-	uplink_heap = sharedheap_get(sizeof(struct uplink));
+	uplink_heap = sharedheap_get("uplink", sizeof(struct uplink));
 	if (!uplink_heap)
 	{
 		slog(LG_INFO, "init_uplinks(): block allocator failed.");
@@ -63,7 +63,7 @@ uplink_add(const char *name, const char *host, const char *send_password, const
 	}
 	else
 	{
-		u = mowgli_heap_alloc(uplink_heap);
+		u = sharedheap_alloc(uplink_heap);
 		mowgli_node_add(u, &u->node, &uplinks);
 		cnt.uplink++;
 	}
@@ -88,7 +88,7 @@ uplink_delete(struct uplink * u)
 	sfree(u->vhost);
 
 	mowgli_node_delete(&u->node, &uplinks);
-	mowgli_heap_free(uplink_heap, u);
+	sharedheap_free(uplink_heap, u);
 
 	cnt.uplink--;
 }
@@ -16,7 +16,7 @@
 #include <atheme.h>
 #include "internal.h"
 
-static mowgli_heap_t *user_heap = NULL;
+static struct sharedheap *user_heap = NULL;
 
 mowgli_patricia_t *userlist;
 mowgli_patricia_t *uidlist;
@@ -44,7 +44,7 @@ user_delete_cb(void *const restrict user)
 void
 init_users(void)
 {
-	user_heap = sharedheap_get(sizeof(struct user));
+	user_heap = sharedheap_get("user", sizeof(struct user));
 
 	if (user_heap == NULL)
 	{
@@ -151,7 +151,7 @@ user_add(const char *nick, const char *user, const char *host,
 		}
 	}
 
-	u = mowgli_heap_alloc(user_heap);
+	u = sharedheap_alloc(user_heap);
 	atheme_object_init(atheme_object(u), nick, &user_delete_cb);
 
 	if (uid != NULL)
@@ -253,6 +253,7 @@ user_delete(struct user *u, const char *comment)
 
 	if (u->myuser)
 	{
+		db_modifying(u->myuser);
 		MOWGLI_ITER_FOREACH_SAFE(n, tn, u->myuser->logins.head)
 		{
 			if (n->data == u)
@@ -278,7 +279,7 @@ user_delete(struct user *u, const char *comment)
 	strshare_unref(u->chost);
 	strshare_unref(u->ip);
 
-	mowgli_heap_free(user_heap, u);
+	sharedheap_free(user_heap, u);
 
 	cnt.user--;
 
@@ -492,7 +493,10 @@ user_changenick(struct user *u, const char *nick, time_t ts)
 	}
 	if (u->myuser != NULL && (mn = mynick_find(u->nick)) != NULL &&
 			mn->owner == u->myuser)
+	{
+		db_modifying(u->myuser);
 		mn->lastseen = CURRTIME;
+	}
 	mowgli_patricia_delete(userlist, u->nick);
 
 	strshare_unref(u->nick);
@@ -44,6 +44,10 @@
 #define ALIS_MAXMATCH_DEF       64U
 #define ALIS_MAXMATCH_MAX       128U
 
+#define ALIS_INDEX_BUCKETS      24U                         // User-count buckets: [0, 2), [2, 4), [4, 8), ...
+#define ALIS_CURSOR_MAX         64U                         // Paging cursors kept at once (least recent dropped)
+#define ALIS_CURSOR_TTL         (5U * SECONDS_PER_MINUTE)   // Idle time after which a cursor is not resumed
+
 enum alis_mode_cmp
 {
 	MODECMP_NONE            = 0,
@@ -70,9 +74,67 @@ struct alis_query
 	char                    topic[BUFSIZE];
 };
 
+/* The channel index. Every channel has an entry, which is on one user-count bucket list and on
+ * the posting list of every distinct trigram (3 consecutive case-folded characters) in its name.
+ * A name pattern containing 3 or more consecutive literal characters can only match channels
+ * on the posting lists of the trigrams in those characters, so a query walks the shortest of
+ * those lists (or the relevant buckets, if that is shorter) and applies the full checks in
+ * alis_show_channel() to those candidates only.
+ */
+struct alis_trigram
+{
+	char                    key[4];
+	mowgli_list_t           entries;
+};
+
+struct alis_posting
+{
+	mowgli_node_t           node;
+	struct alis_trigram *   trigram;
+};
+
+struct alis_entry
+{
+	struct channel *        chan;
+	struct alis_posting *   postings;
+	size_t                  num_postings;
+	mowgli_node_t           bnode;
+	unsigned int            bucket;
+};
+
+// Where a query is up to; list is a posting list, or NULL for a range of user-count buckets
+struct alis_scan
+{
+	mowgli_list_t *         list;
+	mowgli_node_t *         next;
+	unsigned int            bucket;
+	unsigned int            bucket_last;
+};
+
+/* A paused query. Repeating a query with -skip equal to the number of matches it has already
+ * gone past continues from here instead of matching the skipped channels all over again.
+ */
+struct alis_cursor
+{
+	mowgli_node_t           node;
+	struct user *           user;
+	time_t                  used;
+	unsigned int            position;
+	struct alis_query       query;
+	struct alis_scan        scan;
+};
+
 static struct service *alissvs = NULL;
 static unsigned int alis_max_matches = ALIS_MAXMATCH_DEF;
 
+static mowgli_patricia_t *alis_entries = NULL;
+static mowgli_patricia_t *alis_trigrams = NULL;
+static mowgli_list_t alis_buckets[ALIS_INDEX_BUCKETS];
+static mowgli_list_t alis_cursors = { NULL, NULL, 0 };
+
+// Scanned when a pattern contains a trigram that no channel name has
+static mowgli_list_t alis_nothing = { NULL, NULL, 0 };
+
 static void
 alis_parse_mode(const char *restrict arg, struct alis_query *const restrict query)
 {
@@ -337,6 +399,353 @@ alis_show_channel(const struct alis_query *const restrict query, const struct ch
 	return true;
 }
 
+static unsigned int
+alis_bucket_of(unsigned int count)
+{
+	unsigned int bucket = 0;
+
+	while ((count >>= 1) && bucket < (ALIS_INDEX_BUCKETS - 1U))
+		bucket++;
+
+	return bucket;
+}
+
+static void
+alis_cursor_destroy(struct alis_cursor *const restrict cursor)
+{
+	(void) mowgli_node_delete(&cursor->node, &alis_cursors);
+	(void) sfree(cursor);
+}
+
+// A list node is about to be removed; move any cursor that would continue from it on to the next one
+static void
+alis_cursors_unlink(const mowgli_node_t *const restrict node)
+{
+	mowgli_node_t *n;
+
+	MOWGLI_ITER_FOREACH(n, alis_cursors.head)
+	{
+		struct alis_cursor *const cursor = n->data;
+
+		if (cursor->scan.next == node)
+			cursor->scan.next = node->next;
+	}
+}
+
+static void
+alis_cursors_drop_list(const mowgli_list_t *const restrict list)
+{
+	mowgli_node_t *n, *tn;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, alis_cursors.head)
+	{
+		struct alis_cursor *const cursor = n->data;
+
+		if (cursor->scan.list == list)
+			(void) alis_cursor_destroy(cursor);
+	}
+}
+
+static void
+alis_index_rebucket(struct alis_entry *const restrict entry, const unsigned int count)
+{
+	const unsigned int bucket = alis_bucket_of(count);
+
+	if (bucket == entry->bucket)
+		return;
+
+	(void) alis_cursors_unlink(&entry->bnode);
+	(void) mowgli_node_delete(&entry->bnode, &alis_buckets[entry->bucket]);
+	(void) mowgli_node_add(entry, &entry->bnode, &alis_buckets[bucket]);
+
+	entry->bucket = bucket;
+}
+
+static struct alis_entry *
+alis_index_add(struct channel *const restrict chptr)
+{
+	struct alis_entry *entry = mowgli_patricia_retrieve(alis_entries, chptr->name);
+
+	if (entry)
+		return entry;
+
+	const size_t namelen = strlen(chptr->name);
+
+	entry = smalloc(sizeof *entry);
+	entry->chan = chptr;
+	entry->bucket = alis_bucket_of(MOWGLI_LIST_LENGTH(&chptr->members));
+
+	if (namelen >= 3)
+		entry->postings = smalloc((namelen - 2) * sizeof *entry->postings);
+
+	for (size_t i = 0; (i + 3) <= namelen; i++)
+	{
+		char key[4];
+		bool seen = false;
+
+		for (size_t j = 0; j < 3; j++)
+			key[j] = (char) ToLower((unsigned char) chptr->name[i + j]);
+
+		key[3] = 0x00;
+
+		// A name like "#aaaa" has the same trigram more than once
+		for (size_t j = 0; j < entry->num_postings && ! seen; j++)
+			seen = (strcmp(entry->postings[j].trigram->key, key) == 0);
+
+		if (seen)
+			continue;
+
+		struct alis_trigram *trigram = mowgli_patricia_retrieve(alis_trigrams, key);
+
+		if (! trigram)
+		{
+			trigram = smalloc(sizeof *trigram);
+
+			(void) memcpy(trigram->key, key, sizeof key);
+			(void) mowgli_patricia_add(alis_trigrams, trigram->key, trigram);
+		}
+
+		struct alis_posting *const posting = &entry->postings[entry->num_postings++];
+
+		posting->trigram = trigram;
+
+		(void) mowgli_node_add(entry, &posting->node, &trigram->entries);
+	}
+
+	(void) mowgli_node_add(entry, &entry->bnode, &alis_buckets[entry->bucket]);
+	(void) mowgli_patricia_add(alis_entries, chptr->name, entry);
+
+	return entry;
+}
+
+static void
+alis_index_delete(struct alis_entry *const restrict entry)
+{
+	for (size_t i = 0; i < entry->num_postings; i++)
+	{
+		struct alis_posting *const posting = &entry->postings[i];
+		struct alis_trigram *const trigram = posting->trigram;
+
+		(void) alis_cursors_unlink(&posting->node);
+		(void) mowgli_node_delete(&posting->node, &trigram->entries);
+
+		if (MOWGLI_LIST_LENGTH(&trigram->entries))
+			continue;
+
+		(void) alis_cursors_drop_list(&trigram->entries);
+		(void) mowgli_patricia_delete(alis_trigrams, trigram->key);
+		(void) sfree(trigram);
+	}
+
+	(void) alis_cursors_unlink(&entry->bnode);
+	(void) mowgli_node_delete(&entry->bnode, &alis_buckets[entry->bucket]);
+	(void) mowgli_patricia_delete(alis_entries, entry->chan->name);
+
+	(void) sfree(entry->postings);
+	(void) sfree(entry);
+}
+
+static void
+alis_hook_channel_add(struct channel *const restrict chptr)
+{
+	(void) alis_index_add(chptr);
+}
+
+static void
+alis_hook_channel_delete(struct channel *const restrict chptr)
+{
+	struct alis_entry *const entry = mowgli_patricia_retrieve(alis_entries, chptr->name);
+
+	if (entry)
+		(void) alis_index_delete(entry);
+}
+
+static void
+alis_hook_channel_join(struct hook_channel_joinpart *const restrict hdata)
+{
+	if (! hdata->cu)
+		// Kicked by an earlier hook; the part hook has already seen the new count
+		return;
+
+	struct channel *const chptr = hdata->cu->chan;
+
+	// Channels created by services (e.g. for a ChanServ join) do not call the channel_add hook
+	(void) alis_index_rebucket(alis_index_add(chptr), MOWGLI_LIST_LENGTH(&chptr->members));
+}
+
+static void
+alis_hook_channel_part(struct hook_channel_joinpart *const restrict hdata)
+{
+	if (! hdata->cu)
+		return;
+
+	struct channel *const chptr = hdata->cu->chan;
+	struct alis_entry *const entry = mowgli_patricia_retrieve(alis_entries, chptr->name);
+
+	// This is called before the user is removed
+	if (entry)
+		(void) alis_index_rebucket(entry, MOWGLI_LIST_LENGTH(&chptr->members) - 1U);
+}
+
+static void
+alis_hook_user_delete(struct user *const restrict u)
+{
+	mowgli_node_t *n, *tn;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, alis_cursors.head)
+	{
+		struct alis_cursor *const cursor = n->data;
+
+		if (cursor->user == u)
+			(void) alis_cursor_destroy(cursor);
+	}
+}
+
+/* Choose the candidates for a query: the posting list of the rarest trigram among the literal
+ * runs of the name pattern, or the buckets covering -min and -max, whichever is shorter.
+ * Wildcards (including the match() classes & # % and an unescaped ?) break a literal run.
+ */
+static void
+alis_plan_scan(const struct alis_query *const restrict query, struct alis_scan *const restrict scan)
+{
+	const unsigned int first = alis_bucket_of(query->min);
+	const unsigned int last = query->max ? alis_bucket_of(query->max) : (ALIS_INDEX_BUCKETS - 1U);
+
+	(void) memset(scan, 0x00, sizeof *scan);
+
+	if (query->max && query->max < query->min)
+	{
+		scan->list = &alis_nothing;
+		return;
+	}
+
+	size_t cost = 0;
+
+	for (unsigned int i = first; i <= last; i++)
+		cost += MOWGLI_LIST_LENGTH(&alis_buckets[i]);
+
+	char key[4] = { 0x00, 0x00, 0x00, 0x00 };
+	size_t run = 0;
+
+	for (const char *p = query->mask; *p; p++)
+	{
+		unsigned char ch = (unsigned char) *p;
+
+		if (ch == '\\' && p[1] && strchr("*?&#%", p[1]))
+			ch = (unsigned char) *++p;
+		else if (strchr("*?&#%", ch))
+		{
+			run = 0;
+			continue;
+		}
+
+		key[0] = key[1];
+		key[1] = key[2];
+		key[2] = (char) ToLower(ch);
+
+		if (++run < 3)
+			continue;
+
+		const struct alis_trigram *const trigram = mowgli_patricia_retrieve(alis_trigrams, key);
+
+		if (! trigram)
+		{
+			scan->list = &alis_nothing;
+			return;
+		}
+
+		if (MOWGLI_LIST_LENGTH(&trigram->entries) < cost)
+		{
+			cost = MOWGLI_LIST_LENGTH(&trigram->entries);
+			scan->list = (mowgli_list_t *) &trigram->entries;
+		}
+	}
+
+	if (scan->list)
+	{
+		scan->next = scan->list->head;
+		return;
+	}
+
+	scan->bucket = first;
+	scan->bucket_last = last;
+	scan->next = alis_buckets[first].head;
+}
+
+static struct channel *
+alis_scan_next(struct alis_scan *const restrict scan)
+{
+	while (! scan->next)
+	{
+		if (scan->list || scan->bucket >= scan->bucket_last)
+			return NULL;
+
+		scan->next = alis_buckets[++scan->bucket].head;
+	}
+
+	const struct alis_entry *const entry = scan->next->data;
+
+	scan->next = scan->next->next;
+
+	return entry->chan;
+}
+
+// Whether two queries select the same channels; -skip, -maxmatches and -show do not count
+static bool
+alis_query_same(const struct alis_query *const restrict a, const struct alis_query *const restrict b)
+{
+	return a->min == b->min && a->max == b->max && a->mode == b->mode && a->mode_cmp == b->mode_cmp &&
+	       a->mode_key == b->mode_key && a->mode_limit == b->mode_limit && a->show_secret == b->show_secret &&
+	       memcmp(a->mode_ext, b->mode_ext, sizeof a->mode_ext) == 0 &&
+	       strcmp(a->mask, b->mask) == 0 && strcmp(a->topic, b->topic) == 0;
+}
+
+static struct alis_cursor *
+alis_cursor_find(const struct user *const restrict u)
+{
+	mowgli_node_t *n;
+
+	if (! u)
+		return NULL;
+
+	MOWGLI_ITER_FOREACH(n, alis_cursors.head)
+	{
+		struct alis_cursor *const cursor = n->data;
+
+		if (cursor->user == u)
+			return cursor;
+	}
+
+	return NULL;
+}
+
+static void
+alis_cursor_save(struct user *const restrict u, const struct alis_query *const restrict query,
+                 const struct alis_scan *const restrict scan, const unsigned int position)
+{
+	struct alis_cursor *cursor = alis_cursor_find(u);
+
+	if (cursor)
+		(void) mowgli_node_delete(&cursor->node, &alis_cursors);
+	else if (MOWGLI_LIST_LENGTH(&alis_cursors) >= ALIS_CURSOR_MAX)
+	{
+		// The list is kept in order of use, most recent first
+		cursor = alis_cursors.tail->data;
+
+		(void) mowgli_node_delete(&cursor->node, &alis_cursors);
+	}
+	else
+		cursor = smalloc(sizeof *cursor);
+
+	cursor->user = u;
+	cursor->used = CURRTIME;
+	cursor->position = position;
+
+	(void) memcpy(&cursor->query, query, sizeof *query);
+	(void) memcpy(&cursor->scan, scan, sizeof *scan);
+	(void) mowgli_node_add_head(cursor, &cursor->node, &alis_cursors);
+}
+
 static void
 alis_cmd_list_func(struct sourceinfo *const restrict si, const int parc, char **const restrict parv)
 {
@@ -360,14 +769,30 @@ alis_cmd_list_func(struct sourceinfo *const restrict si, const int parc, char **
 		goto end;
 	}
 
+	struct alis_cursor *const cursor = alis_cursor_find(si->su);
 	struct channel *chptr;
-	mowgli_patricia_iteration_state_t state;
+	struct alis_scan scan;
+	unsigned int position = 0;
+	bool paused = false;
 
-	MOWGLI_PATRICIA_FOREACH(chptr, &state, chanlist)
+	if (cursor && query.skip && query.skip == cursor->position && (CURRTIME - cursor->used) < ALIS_CURSOR_TTL &&
+	    alis_query_same(&query, &cursor->query))
+	{
+		(void) memcpy(&scan, &cursor->scan, sizeof scan);
+
+		position = query.skip;
+		query.skip = 0;
+	}
+	else
+		(void) alis_plan_scan(&query, &scan);
+
+	while ((chptr = alis_scan_next(&scan)))
 	{
 		if (! alis_show_channel(&query, chptr))
 			continue;
 
+		position++;
+
 		if (query.skip)
 		{
 			query.skip--;
@@ -380,9 +805,15 @@ alis_cmd_list_func(struct sourceinfo *const restrict si, const int parc, char **
 			continue;
 
 		(void) command_success_nodata(si, _("Maximum channel output reached"));
+		paused = true;
 		break;
 	}
 
+	if (paused && si->su)
+		(void) alis_cursor_save(si->su, &query, &scan, position);
+	else if (cursor)
+		(void) alis_cursor_destroy(cursor);
+
 end:
 	(void) command_success_nodata(si, _("End of output."));
 
@@ -445,6 +876,21 @@ mod_init(struct module *const restrict m)
 	(void) add_uint_conf_item("MAXMATCHES", &alissvs->conf_table, 0, &alis_max_matches,
 	                          ALIS_MAXMATCH_MIN, ALIS_MAXMATCH_MAX, ALIS_MAXMATCH_DEF);
 
+	alis_entries = mowgli_patricia_create(&irccasecanon);
+	alis_trigrams = mowgli_patricia_create(NULL);
+
+	struct channel *chptr;
+	mowgli_patricia_iteration_state_t state;
+
+	MOWGLI_PATRICIA_FOREACH(chptr, &state, chanlist)
+		(void) alis_index_add(chptr);
+
+	(void) hook_add_channel_add(&alis_hook_channel_add);
+	(void) hook_add_channel_delete(&alis_hook_channel_delete);
+	(void) hook_add_channel_join(&alis_hook_channel_join);
+	(void) hook_add_channel_part(&alis_hook_channel_part);
+	(void) hook_add_user_delete(&alis_hook_user_delete);
+
 	(void) service_bind_command(alissvs, &alis_cmd_list);
 	(void) service_bind_command(alissvs, &alis_cmd_help);
 }
@@ -452,6 +898,26 @@ mod_init(struct module *const restrict m)
 static void
 mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 {
+	(void) hook_del_channel_add(&alis_hook_channel_add);
+	(void) hook_del_channel_delete(&alis_hook_channel_delete);
+	(void) hook_del_channel_join(&alis_hook_channel_join);
+	(void) hook_del_channel_part(&alis_hook_channel_part);
+	(void) hook_del_user_delete(&alis_hook_user_delete);
+
+	mowgli_node_t *n, *tn;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, alis_cursors.head)
+		(void) alis_cursor_destroy(n->data);
+
+	struct alis_entry *entry;
+	mowgli_patricia_iteration_state_t state;
+
+	MOWGLI_PATRICIA_FOREACH(entry, &state, alis_entries)
+		(void) alis_index_delete(entry);
+
+	(void) mowgli_patricia_destroy(alis_entries, NULL, NULL);
+	(void) mowgli_patricia_destroy(alis_trigrams, NULL, NULL);
+
 	(void) del_conf_item("MAXMATCHES", &alissvs->conf_table);
 	(void) service_delete(alissvs);
 }
@@ -3,6 +3,7 @@
  * SPDX-URL: https://spdx.org/licenses/ISC.html
  *
  * Copyright (C) 2009 Atheme Project (http://atheme.org/)
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
  *
  * LDAP authentication.
  */
@@ -23,6 +24,23 @@
  *   binddn    -- distinguished name to bind to for searching (optional)
  *   bindauth  -- password for the distinguished name
  *                (optional, must specify if binddn given)
+ *
+ * and optionally:
+ *
+ *   poolsize  -- number of connections used for IDENTIFY (default 4)
+ *   timeout   -- seconds to wait for the server to answer (default 5)
+ *   cache_ttl -- seconds a successful verification is remembered (default 60,
+ *                0 disables the cache)
+ *
+ * Requests that can wait for an answer (NickServ IDENTIFY) are sent on one of
+ * a small pool of connections whose sockets are watched by the event loop, so
+ * services keep running while the server thinks. Everything else (SASL PLAIN,
+ * XMLRPC, GHOST, ...) still needs an answer immediately, and uses a separate
+ * connection synchronously, bounded by the timeout above.
+ *
+ * Successful verifications are remembered for cache_ttl seconds as an HMAC of
+ * the account name and password under a key generated when the module loads,
+ * so the cache never holds anything that could be used to recover a password.
  */
 
 #include <atheme.h>
@@ -31,6 +49,53 @@
 
 #include <ldap.h>
 
+#define LDAP_POOLSIZE_MIN       1U
+#define LDAP_POOLSIZE_DEF       4U
+#define LDAP_POOLSIZE_MAX       32U
+
+#define LDAP_TIMEOUT_MIN        1U
+#define LDAP_TIMEOUT_DEF        5U
+#define LDAP_TIMEOUT_MAX        60U
+
+#define LDAP_CACHE_TTL_DEF      60U
+#define LDAP_CACHE_TTL_MAX      3600U
+
+enum ldap_job_state
+{
+	LDAP_JOB_BIND_SEARCHER,
+	LDAP_JOB_SEARCH,
+	LDAP_JOB_BIND_USER,
+};
+
+struct ldap_job
+{
+	mowgli_node_t                   node;           // in ldap_queue while every connection is busy
+	struct auth_request *           req;            // NULL for a synchronous verification
+	char *                          name;
+	char *                          password;
+	mowgli_list_t                   dns;            // candidate DNs found by the search
+	enum ldap_job_state             state;
+	bool                            retried;        // reconnected once already
+	bool                            done;
+	enum auth_verdict               verdict;
+};
+
+struct ldap_conn
+{
+	LDAP *                          ld;
+	mowgli_eventloop_pollable_t *   pollable;
+	mowgli_eventloop_timer_t *      timer;
+	struct ldap_job *               job;
+	int                             msgid;
+};
+
+struct ldap_cache_entry
+{
+	char *                          name;
+	unsigned char                   hash[DIGEST_MDLEN_SHA2_256];
+	time_t                          expires;
+};
+
 static struct
 {
 	char *url;
@@ -40,193 +105,807 @@ static struct
 	char *binddn;
 	char *bindauth;
 	bool useDN;
+	bool valid;
+	unsigned int poolsize;
+	unsigned int timeout;
+	unsigned int cache_ttl;
 } ldap_config;
 
-static LDAP *ldap_conn;
+static struct ldap_conn *ldap_pool = NULL;
+static size_t ldap_pool_size = 0;
+static struct ldap_conn ldap_sync;
+static mowgli_list_t ldap_queue;
+
+static mowgli_patricia_t *ldap_cache = NULL;
+static mowgli_eventloop_timer_t *ldap_cache_timer = NULL;
+static unsigned char ldap_cache_key[DIGEST_MDLEN_SHA2_256];
 
 static mowgli_list_t conf_ldap_table;
 
+static void ldap_job_start(struct ldap_conn *, struct ldap_job *);
+
 static void
-ldap_config_ready(void *unused)
+ldap_warn(const int res)
 {
-	int res;
-	char *p;
 	static time_t lastwarning;
 
-	if (ldap_conn != NULL)
-		ldap_unbind_ext_s(ldap_conn, NULL, NULL);
-	ldap_conn = NULL;
-	if (ldap_config.url == NULL)
+	if (CURRTIME > lastwarning + 300)
 	{
-		slog(LG_ERROR, "ldap_config_ready(): ldap {} missing url definition");
+		slog(LG_INFO, "LDAP:ERROR: \2%s\2", ldap_err2string(res));
+		wallops("Problem with LDAP server: %s", ldap_err2string(res));
+		lastwarning = CURRTIME;
+	}
+}
+
+static bool
+ldap_cache_hash(const char *const restrict name, const char *const restrict password, unsigned char *const restrict out)
+{
+	const struct digest_vector vec[] = {
+		{ name,     strlen(name) + 1 },
+		{ password, strlen(password) },
+	};
+
+	return digest_oneshot_hmac_vector(DIGALG_SHA2_256, ldap_cache_key, sizeof ldap_cache_key, vec, ARRAY_SIZE(vec),
+	                                  out, NULL);
+}
+
+static void
+ldap_cache_entry_free(const char ATHEME_VATTR_UNUSED *const restrict key, void *const restrict data,
+                      void ATHEME_VATTR_UNUSED *const restrict privdata)
+{
+	struct ldap_cache_entry *const ent = data;
+
+	(void) smemzero(ent->hash, sizeof ent->hash);
+	(void) sfree(ent->name);
+	(void) sfree(ent);
+}
+
+static bool
+ldap_cache_check(const char *const restrict name, const char *const restrict password)
+{
+	unsigned char hash[DIGEST_MDLEN_SHA2_256];
+	struct ldap_cache_entry *ent;
+
+	if (! ldap_config.cache_ttl || ! (ent = mowgli_patricia_retrieve(ldap_cache, name)))
+		return false;
+
+	if (ent->expires <= CURRTIME)
+	{
+		(void) mowgli_patricia_delete(ldap_cache, ent->name);
+		(void) ldap_cache_entry_free(NULL, ent, NULL);
+		return false;
+	}
+
+	if (! ldap_cache_hash(name, password, hash))
+		return false;
+
+	const bool match = (smemcmp(hash, ent->hash, sizeof hash) == 0);
+
+	(void) smemzero(hash, sizeof hash);
+	return match;
+}
+
+static void
+ldap_cache_store(const char *const restrict name, const char *const restrict password)
+{
+	struct ldap_cache_entry *ent;
+
+	if (! ldap_config.cache_ttl)
 		return;
+
+	if (! (ent = mowgli_patricia_retrieve(ldap_cache, name)))
+	{
+		ent = smalloc(sizeof *ent);
+		ent->name = sstrdup(name);
+		(void) mowgli_patricia_add(ldap_cache, ent->name, ent);
 	}
-	if ((ldap_config.dnformat == NULL) && ((ldap_config.base == NULL) || (ldap_config.attribute == NULL)))
+
+	if (! ldap_cache_hash(name, password, ent->hash))
 	{
-		slog(LG_ERROR, "ldap_config_ready(): ldap {} block requires dnformat or base & attribute definition");
+		(void) mowgli_patricia_delete(ldap_cache, ent->name);
+		(void) ldap_cache_entry_free(NULL, ent, NULL);
 		return;
 	}
-	if (ldap_config.binddn != NULL && ldap_config.bindauth == NULL)
+
+	ent->expires = CURRTIME + (time_t) ldap_config.cache_ttl;
+}
+
+static void
+ldap_cache_expire(void ATHEME_VATTR_UNUSED *const restrict unused)
+{
+	mowgli_patricia_iteration_state_t state;
+	struct ldap_cache_entry *ent;
+
+	MOWGLI_PATRICIA_FOREACH(ent, &state, ldap_cache)
 	{
-		slog(LG_ERROR, "ldap_config_ready(): ldap{} block requires bindauth to be defined if binddn is defined");
+		if (ent->expires > CURRTIME)
+			continue;
+
+		(void) mowgli_patricia_delete(ldap_cache, ent->name);
+		(void) ldap_cache_entry_free(NULL, ent, NULL);
+	}
+}
+
+static void
+ldap_job_free(struct ldap_job *const restrict job)
+{
+	mowgli_node_t *n, *tn;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, job->dns.head)
+	{
+		(void) sfree(n->data);
+		(void) mowgli_node_delete(n, &job->dns);
+		(void) mowgli_node_free(n);
+	}
+
+	(void) smemzero(job->password, strlen(job->password));
+	(void) sfree(job->password);
+	(void) sfree(job->name);
+	(void) sfree(job);
+}
+
+static void
+ldap_conn_close(struct ldap_conn *const restrict c)
+{
+	if (c->timer)
+		(void) mowgli_timer_destroy(base_eventloop, c->timer);
+
+	if (c->pollable)
+		(void) mowgli_pollable_destroy(base_eventloop, c->pollable);
+
+	if (c->ld)
+		(void) ldap_unbind_ext(c->ld, NULL, NULL);
+
+	c->timer = NULL;
+	c->pollable = NULL;
+	c->ld = NULL;
+}
+
+static bool
+ldap_conn_open(struct ldap_conn *const restrict c)
+{
+	const struct timeval timeout = { (time_t) ldap_config.timeout, 0 };
+	int res;
+
+	if (c->ld)
+		return true;
+
+	if ((res = ldap_initialize(&c->ld, ldap_config.url)) != LDAP_SUCCESS)
+	{
+		slog(LG_ERROR, "ldap_conn_open(): ldap_initialize(%s) failed: %s", ldap_config.url, ldap_err2string(res));
+		ldap_warn(res);
+		c->ld = NULL;
+		return false;
+	}
+
+	(void) ldap_set_option(c->ld, LDAP_OPT_PROTOCOL_VERSION, &(const int){LDAP_VERSION3});
+	(void) ldap_set_option(c->ld, LDAP_OPT_TIMEOUT, &timeout);
+	(void) ldap_set_option(c->ld, LDAP_OPT_NETWORK_TIMEOUT, &timeout);
+	(void) ldap_set_option(c->ld, LDAP_OPT_DEREF, &(const int){LDAP_DEREF_NEVER});
+	(void) ldap_set_option(c->ld, LDAP_OPT_REFERRALS, LDAP_OPT_OFF);
+
+#ifdef LDAP_OPT_CONNECT_ASYNC
+	// Don't wait for a slow or unreachable server to accept the connection; see ldap_conn_writable()
+	if (c != &ldap_sync)
+		(void) ldap_set_option(c->ld, LDAP_OPT_CONNECT_ASYNC, LDAP_OPT_ON);
+#endif
+
+	return true;
+}
+
+static void ldap_conn_readable(mowgli_eventloop_t *, mowgli_eventloop_io_t *, mowgli_eventloop_io_dir_t, void *);
+
+/* The socket of a new connection becomes writable once the connect has
+ * finished or failed; libldap then sends the request it held back, or
+ * reports the failure, from ldap_result().
+ */
+static void
+ldap_conn_writable(mowgli_eventloop_t *const restrict eventloop, mowgli_eventloop_io_t *const restrict io,
+                   const mowgli_eventloop_io_dir_t dir, void *const restrict userdata)
+{
+	struct ldap_conn *const c = userdata;
+
+	(void) mowgli_pollable_setselect(base_eventloop, c->pollable, MOWGLI_EVENTLOOP_IO_WRITE, NULL);
+	(void) ldap_conn_readable(eventloop, io, dir, userdata);
+}
+
+static void
+ldap_conn_watch(struct ldap_conn *const restrict c)
+{
+	int fd = -1;
+
+	// The synchronous connection is polled with ldap_result() directly
+	if (c == &ldap_sync || c->pollable)
 		return;
+
+	// libldap only has a socket once the first request has been sent
+	if (ldap_get_option(c->ld, LDAP_OPT_DESC, &fd) != LDAP_OPT_SUCCESS || fd < 0)
+		return;
+
+	c->pollable = mowgli_pollable_create(base_eventloop, fd, c);
+	(void) mowgli_pollable_setselect(base_eventloop, c->pollable, MOWGLI_EVENTLOOP_IO_READ, &ldap_conn_readable);
+	(void) mowgli_pollable_setselect(base_eventloop, c->pollable, MOWGLI_EVENTLOOP_IO_WRITE, &ldap_conn_writable);
+}
+
+/* Only a bind the server refused, or a search that found nobody, is a
+ * REJECTED verdict; anything going wrong on the way is UNAVAILABLE.
+ */
+static void
+ldap_job_finish(struct ldap_conn *const restrict c, struct ldap_job *const restrict job,
+                const enum auth_verdict verdict)
+{
+	if (c->timer)
+		(void) mowgli_timer_destroy(base_eventloop, c->timer);
+
+	c->timer = NULL;
+	c->job = NULL;
+	c->msgid = -1;
+
+	if (verdict == AUTH_VERDICT_VERIFIED)
+		(void) ldap_cache_store(job->name, job->password);
+
+	if (job->req)
+	{
+		(void) auth_request_complete(job->req, verdict);
+		(void) ldap_job_free(job);
+	}
+	else
+	{
+		job->done = true;
+		job->verdict = verdict;
 	}
 
-	if (ldap_config.dnformat != NULL)
+	if (c != &ldap_sync && ! c->job && ldap_queue.head)
 	{
-		ldap_config.useDN = true;
-		p = strchr(ldap_config.dnformat, '%');
-		if (p == NULL || p[1] != 's' || strchr(p + 1, '%'))
+		struct ldap_job *const next = ldap_queue.head->data;
+
+		(void) mowgli_node_delete(&next->node, &ldap_queue);
+		(void) ldap_job_start(c, next);
+	}
+}
+
+static void
+ldap_job_step(struct ldap_conn *const restrict c, struct ldap_job *const restrict job)
+{
+	char *attrs[] = { LDAP_NO_ATTRS, NULL };
+	struct berval cred = { 0, NULL };
+	char *dn = NULL;
+	char filter[BUFSIZE];
+	char dnbuf[BUFSIZE];
+	int res;
+
+	switch (job->state)
+	{
+		case LDAP_JOB_BIND_SEARCHER:
+			if (ldap_config.binddn != NULL)
+			{
+				dn = ldap_config.binddn;
+				cred.bv_val = ldap_config.bindauth;
+				cred.bv_len = strlen(ldap_config.bindauth);
+			}
+
+			res = ldap_sasl_bind(c->ld, dn, LDAP_SASL_SIMPLE, &cred, NULL, NULL, &c->msgid);
+			break;
+
+		case LDAP_JOB_SEARCH:
 		{
-			slog(LG_ERROR, "ldap_config_ready(): dnformat must contain exactly one %%s and no other %%");
-			return;
+			// Escape the RFC 4515 filter metacharacters that IRC nicknames may contain
+			char *out = filter + snprintf(filter, sizeof filter, "%s=", ldap_config.attribute);
+
+			for (const char *p = job->name; *p && out < filter + sizeof filter - 4; p++)
+			{
+				if (*p == '*' || *p == '(' || *p == ')' || *p == '\\')
+					out += snprintf(out, 4, "\\%02x", (unsigned int) (unsigned char) *p);
+				else
+					*out++ = *p;
+			}
+
+			*out = 0x00;
+
+			res = ldap_search_ext(c->ld, ldap_config.base, LDAP_SCOPE_SUBTREE, filter, attrs, 0, NULL, NULL,
+			                      NULL, 0, &c->msgid);
+			break;
 		}
-	}
-	else
-		ldap_config.useDN = false;
 
-	ldap_set_option(NULL, LDAP_OPT_PROTOCOL_VERSION, &(const int)
+		case LDAP_JOB_BIND_USER:
+			if (ldap_config.useDN)
+			{
+				(void) snprintf(dnbuf, sizeof dnbuf, ldap_config.dnformat, job->name);
+				dn = dnbuf;
+			}
+			else if (job->dns.head)
 			{
-			3});
-	res = ldap_initialize(&ldap_conn, ldap_config.url);
-	if (res != LDAP_SUCCESS)
+				mowgli_node_t *const n = job->dns.head;
+
+				(void) mowgli_strlcpy(dnbuf, n->data, sizeof dnbuf);
+				(void) sfree(n->data);
+				(void) mowgli_node_delete(n, &job->dns);
+				(void) mowgli_node_free(n);
+
+				dn = dnbuf;
+			}
+			else
+			{
+				slog(LG_INFO, "ldap_auth_user(%s): ldap auth bind failed: no matching entry", job->name);
+				(void) ldap_job_finish(c, job, AUTH_VERDICT_REJECTED);
+				return;
+			}
+
+			cred.bv_val = job->password;
+			cred.bv_len = strlen(job->password);
+
+			res = ldap_sasl_bind(c->ld, dn, LDAP_SASL_SIMPLE, &cred, NULL, NULL, &c->msgid);
+			break;
+
+		default:
+			res = LDAP_OTHER;
+			break;
+	}
+
+	if (res == LDAP_SUCCESS)
+	{
+		(void) ldap_conn_watch(c);
+		return;
+	}
+
+	slog(LG_INFO, "ldap_auth_user(%s): sending request failed: %s", job->name, ldap_err2string(res));
+
+	// The server may have dropped an idle connection; reconnect and start over, once
+	(void) ldap_conn_close(c);
+
+	if (res == LDAP_SERVER_DOWN && ! job->retried)
+	{
+		job->retried = true;
+		(void) ldap_job_start(c, job);
+		return;
+	}
+
+	ldap_warn(res);
+	(void) ldap_job_finish(c, job, AUTH_VERDICT_UNAVAILABLE);
+}
+
+static void
+ldap_conn_timeout(void *const restrict vptr)
+{
+	struct ldap_conn *const c = vptr;
+	struct ldap_job *const job = c->job;
+
+	// This was a one-shot timer and has already been destroyed
+	c->timer = NULL;
+
+	slog(LG_INFO, "ldap_auth_user(%s): no answer from the server in %u seconds", job->name, ldap_config.timeout);
+
+	(void) ldap_conn_close(c);
+	(void) ldap_job_finish(c, job, AUTH_VERDICT_UNAVAILABLE);
+}
+
+static void
+ldap_job_start(struct ldap_conn *const restrict c, struct ldap_job *const restrict job)
+{
+	c->job = job;
+	c->msgid = -1;
+
+	job->state = (ldap_config.useDN) ? LDAP_JOB_BIND_USER : LDAP_JOB_BIND_SEARCHER;
+
+	if (! ldap_conn_open(c))
+	{
+		(void) ldap_job_finish(c, job, AUTH_VERDICT_UNAVAILABLE);
+		return;
+	}
+
+	if (c != &ldap_sync && ! c->timer)
+		c->timer = mowgli_timer_add_once(base_eventloop, "ldap_conn_timeout", &ldap_conn_timeout, c,
+		                                 ldap_config.timeout);
+
+	(void) ldap_job_step(c, job);
+}
+
+static void
+ldap_conn_lost(struct ldap_conn *const restrict c)
+{
+	struct ldap_job *const job = c->job;
+
+	(void) ldap_conn_close(c);
+
+	if (! job)
+		return;
+
+	if (! job->retried)
+	{
+		job->retried = true;
+		(void) ldap_job_start(c, job);
+		return;
+	}
+
+	slog(LG_INFO, "ldap_auth_user(%s): lost connection to the server", job->name);
+	(void) ldap_job_finish(c, job, AUTH_VERDICT_UNAVAILABLE);
+}
+
+static void
+ldap_conn_handle(struct ldap_conn *const restrict c, LDAPMessage *const restrict msg)
+{
+	struct ldap_job *const job = c->job;
+	const int msgtype = ldap_msgtype(msg);
+	int res = LDAP_OTHER;
+	char *dn;
+
+	if (! job || ldap_msgid(msg) != c->msgid)
 	{
-		slog(LG_ERROR, "ldap_config_ready(): ldap_initialize(%s) failed: %s", ldap_config.url, ldap_err2string(res));
-		if (CURRTIME > lastwarning + 300)
+		// Left over from a request we've given up on
+		(void) ldap_msgfree(msg);
+		return;
+	}
+
+	if (msgtype == LDAP_RES_SEARCH_ENTRY)
+	{
+		if ((dn = ldap_get_dn(c->ld, msg)) != NULL)
 		{
-			slog(LG_INFO, "LDAP:ERROR: \2%s\2", ldap_err2string(res));
-			wallops("Problem with LDAP server: %s", ldap_err2string(res));
-			lastwarning = CURRTIME;
+			(void) mowgli_node_add(sstrdup(dn), mowgli_node_create(), &job->dns);
+			(void) ldap_memfree(dn);
 		}
+
+		(void) ldap_msgfree(msg);
 		return;
 	}
 
-	// short timeouts, because this blocks atheme as a whole
-	ldap_set_option(ldap_conn, LDAP_OPT_TIMEOUT, &(const struct timeval){1, 0});
-	ldap_set_option(ldap_conn, LDAP_OPT_NETWORK_TIMEOUT, &(const struct timeval){1, 0});
-	ldap_set_option(ldap_conn, LDAP_OPT_DEREF, &(const int){false});
-	ldap_set_option(ldap_conn, LDAP_OPT_REFERRALS, &(const int){false});
+	if (msgtype == LDAP_RES_SEARCH_REFERENCE)
+	{
+		(void) ldap_msgfree(msg);
+		return;
+	}
+
+	if (ldap_parse_result(c->ld, msg, &res, NULL, NULL, NULL, NULL, 1) != LDAP_SUCCESS)
+		res = LDAP_OTHER;
+
+	switch (job->state)
+	{
+		case LDAP_JOB_BIND_SEARCHER:
+			if (res != LDAP_SUCCESS)
+			{
+				slog(LG_INFO, "ldap_auth_user(): ldap_bind failed: %s", ldap_err2string(res));
+				ldap_warn(res);
+				(void) ldap_job_finish(c, job, AUTH_VERDICT_UNAVAILABLE);
+				return;
+			}
+
+			job->state = LDAP_JOB_SEARCH;
+			(void) ldap_job_step(c, job);
+			return;
+
+		case LDAP_JOB_SEARCH:
+			if (res != LDAP_SUCCESS)
+			{
+				slog(LG_INFO, "ldap_auth_user(%s): ldap search failed: %s", job->name, ldap_err2string(res));
+				(void) ldap_job_finish(c, job, AUTH_VERDICT_UNAVAILABLE);
+				return;
+			}
+
+			job->state = LDAP_JOB_BIND_USER;
+			(void) ldap_job_step(c, job);
+			return;
+
+		case LDAP_JOB_BIND_USER:
+			if (res == LDAP_SUCCESS)
+			{
+				(void) ldap_job_finish(c, job, AUTH_VERDICT_VERIFIED);
+				return;
+			}
+			if (res == LDAP_INVALID_CREDENTIALS && job->dns.head)
+			{
+				// Try the next entry the search turned up
+				(void) ldap_job_step(c, job);
+				return;
+			}
+
+			slog(LG_INFO, "ldap_auth_user(%s): ldap auth bind failed: %s", job->name, ldap_err2string(res));
+
+			// The DN built from dnformat may name nobody at all
+			if (res == LDAP_INVALID_CREDENTIALS || res == LDAP_NO_SUCH_OBJECT || res == LDAP_INVALID_DN_SYNTAX)
+			{
+				(void) ldap_job_finish(c, job, AUTH_VERDICT_REJECTED);
+				return;
+			}
+
+			ldap_warn(res);
+			(void) ldap_job_finish(c, job, AUTH_VERDICT_UNAVAILABLE);
+			return;
+	}
 }
 
-static bool
-ldap_auth_user(struct myuser *mu, const char *password)
+static void
+ldap_conn_readable(mowgli_eventloop_t ATHEME_VATTR_UNUSED *const restrict eventloop,
+                   mowgli_eventloop_io_t ATHEME_VATTR_UNUSED *const restrict io,
+                   const mowgli_eventloop_io_dir_t ATHEME_VATTR_UNUSED dir, void *const restrict userdata)
 {
-	int res;
-	struct berval cred;
-	LDAPMessage *message, *entry;
+	struct ldap_conn *const c = userdata;
 
-	if (ldap_conn == NULL)
+	while (c->ld)
 	{
-		ldap_config_ready(NULL);
+		struct timeval zero = { 0, 0 };
+		LDAPMessage *msg = NULL;
+
+		const int ret = ldap_result(c->ld, LDAP_RES_ANY, LDAP_MSG_ONE, &zero, &msg);
+
+		if (ret == 0)
+			return;
+
+		if (ret < 0)
+		{
+			(void) ldap_conn_lost(c);
+			return;
+		}
+
+		(void) ldap_conn_handle(c, msg);
 	}
-	if (ldap_conn == NULL)
+}
+
+static bool
+ldap_check_name(const char *const restrict name)
+{
+	if (strchr(name, ' '))
 	{
-		slog(LG_INFO, "ldap_auth_user(): no connection");
+		slog(LG_INFO, "ldap_auth_user(%s): bad name: found space", name);
 		return false;
 	}
-
-	if (strchr(entity(mu)->name, ' '))
+	if (strchr(name, ','))
 	{
-		slog(LG_INFO, "ldap_auth_user(%s): bad name: found space", entity(mu)->name);
+		slog(LG_INFO, "ldap_auth_user(%s): bad name: found comma", name);
 		return false;
 	}
-	if (strchr(entity(mu)->name, ','))
+	if (strchr(name, '/'))
 	{
-		slog(LG_INFO, "ldap_auth_user(%s): bad name: found comma", entity(mu)->name);
+		slog(LG_INFO, "ldap_auth_user(%s): bad name: found /", name);
 		return false;
 	}
-	if (strchr(entity(mu)->name, '/'))
+
+	return true;
+}
+
+static struct ldap_job *
+ldap_job_create(struct auth_request *const restrict req, const char *const restrict name,
+                const char *const restrict password)
+{
+	struct ldap_job *const job = smalloc(sizeof *job);
+
+	job->req = req;
+	job->name = sstrdup(name);
+	job->password = sstrdup(password);
+
+	return job;
+}
+
+static void
+ldap_auth_user_async(struct auth_request *const restrict req, struct myuser *const restrict mu,
+                     const char *const restrict password)
+{
+	if (! ldap_config.valid)
+	{
+		(void) auth_request_complete(req, AUTH_VERDICT_UNAVAILABLE);
+		return;
+	}
+
+	if (! ldap_check_name(entity(mu)->name))
 	{
-		slog(LG_INFO, "ldap_auth_user(%s): bad name: found /", entity(mu)->name);
-		return false;
+		(void) auth_request_complete(req, AUTH_VERDICT_REJECTED);
+		return;
 	}
 
-	if (ldap_config.useDN)
+	if (ldap_cache_check(entity(mu)->name, password))
 	{
-		// Use DN to find exact match
-		char dn[512];
-		cred.bv_len = strlen(password);
+		(void) auth_request_complete(req, AUTH_VERDICT_VERIFIED);
+		return;
+	}
 
-		// sstrdup it to remove the const
-		cred.bv_val = sstrdup(password);
+	struct ldap_job *const job = ldap_job_create(req, entity(mu)->name, password);
 
-		snprintf(dn, sizeof dn, ldap_config.dnformat, entity(mu)->name);
-		res = ldap_sasl_bind_s(ldap_conn, dn, LDAP_SASL_SIMPLE, &cred, NULL, NULL, NULL);
-		if (res == LDAP_SERVER_DOWN)
-		{
-			ldap_config_ready(NULL);
-			res = ldap_sasl_bind_s(ldap_conn, dn, LDAP_SASL_SIMPLE, &cred, NULL, NULL, NULL);
-		}
-		if (res == LDAP_SUCCESS)
-			return true;
-		else if (res == LDAP_INVALID_CREDENTIALS)
+	for (size_t i = 0; i < ldap_pool_size; i++)
+	{
+		if (! ldap_pool[i].job)
 		{
-			slog(LG_INFO, "ldap_auth_user(%s): ldap auth bind failed: %s", entity(mu)->name, ldap_err2string(res));
-			return false;
+			(void) ldap_job_start(&ldap_pool[i], job);
+			return;
 		}
-		slog(LG_INFO, "ldap_auth_user(): ldap_bind_s failed: %s", ldap_err2string(res));
-		return false;
 	}
-	else
+
+	(void) mowgli_node_add(job, &job->node, &ldap_queue);
+}
+
+static bool
+ldap_auth_user(struct myuser *mu, const char *password)
+{
+	if (! ldap_config.valid || ! ldap_check_name(entity(mu)->name))
+		return false;
+
+	if (ldap_cache_check(entity(mu)->name, password))
+		return true;
+
+	struct ldap_job *const job = ldap_job_create(NULL, entity(mu)->name, password);
+
+	// One deadline for the whole verification, however many requests and reconnects it takes
+	const time_t deadline = time(NULL) + (time_t) ldap_config.timeout;
+
+	(void) ldap_job_start(&ldap_sync, job);
+
+	while (! job->done)
 	{
-		// Use base + attribute search for Auth
-		char what[512];
-		char *binddn = NULL;
+		const time_t now = time(NULL);
+		struct timeval timeout = { (deadline > now) ? (deadline - now) : 0, 0 };
+		LDAPMessage *msg = NULL;
 
-		cred.bv_len = 0;
+		const int ret = ldap_result(ldap_sync.ld, LDAP_RES_ANY, LDAP_MSG_ONE, &timeout, &msg);
 
-		if (ldap_config.binddn != NULL && ldap_config.bindauth != NULL)
+		if (ret == 0)
 		{
-			binddn = ldap_config.binddn;
-			cred.bv_val = ldap_config.bindauth;
-			cred.bv_len = strlen(ldap_config.bindauth);
-		}
+			slog(LG_INFO, "ldap_auth_user(%s): no answer from the server in %u seconds", job->name,
+			     ldap_config.timeout);
 
-		res = ldap_sasl_bind_s(ldap_conn, binddn, LDAP_SASL_SIMPLE, &cred, NULL, NULL, NULL);
-		if (res == LDAP_SERVER_DOWN)
-		{
-			ldap_config_ready(NULL);
-			res = ldap_sasl_bind_s(ldap_conn, binddn, LDAP_SASL_SIMPLE, &cred, NULL, NULL, NULL);
+			(void) ldap_conn_close(&ldap_sync);
+			(void) ldap_job_finish(&ldap_sync, job, AUTH_VERDICT_UNAVAILABLE);
 		}
-		if (res != LDAP_SUCCESS)
+		else if (ret < 0)
+			(void) ldap_conn_lost(&ldap_sync);
+		else
+			(void) ldap_conn_handle(&ldap_sync, msg);
+	}
+
+	// The synchronous interface cannot tell an outage from a wrong password
+	const bool verified = (job->verdict == AUTH_VERDICT_VERIFIED);
+
+	(void) ldap_job_free(job);
+	return verified;
+}
+
+// Close every connection, putting the verifications in progress back at the front of the queue
+static void
+ldap_requeue_all(void)
+{
+	for (size_t i = ldap_pool_size; i > 0; i--)
+	{
+		struct ldap_conn *const c = &ldap_pool[i - 1];
+		struct ldap_job *const job = c->job;
+		mowgli_node_t *n, *tn;
+
+		(void) ldap_conn_close(c);
+
+		if (! job)
+			continue;
+
+		c->job = NULL;
+
+		MOWGLI_ITER_FOREACH_SAFE(n, tn, job->dns.head)
 		{
-			slog(LG_INFO, "ldap_auth_user(): ldap_bind_s failed: %s", ldap_err2string(res));
-			return false;
+			(void) sfree(n->data);
+			(void) mowgli_node_delete(n, &job->dns);
+			(void) mowgli_node_free(n);
 		}
 
-		sprintf(what, "%s=%s", ldap_config.attribute, entity(mu)->name);
-		if ((res = ldap_search_ext_s(ldap_conn, ldap_config.base, LDAP_SCOPE_SUBTREE, what, NULL, 0, NULL, NULL, NULL, 0, &message)) != LDAP_SUCCESS)
+		job->retried = false;
+
+		(void) mowgli_node_add_head(job, &job->node, &ldap_queue);
+	}
+
+	(void) ldap_conn_close(&ldap_sync);
+}
+
+// Give every queued verification to a free connection, as far as they go
+static void
+ldap_run_queue(void)
+{
+	for (size_t i = 0; i < ldap_pool_size && ldap_queue.head; i++)
+	{
+		struct ldap_conn *const c = &ldap_pool[i];
+
+		if (c->job)
+			continue;
+
+		struct ldap_job *const job = ldap_queue.head->data;
+
+		(void) mowgli_node_delete(&job->node, &ldap_queue);
+		(void) ldap_job_start(c, job);
+	}
+}
+
+// No verification can be carried out any more; tell the callers that, rather than calling the passwords wrong
+static void
+ldap_fail_all(void)
+{
+	mowgli_node_t *n, *tn;
+
+	(void) ldap_requeue_all();
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, ldap_queue.head)
+	{
+		struct ldap_job *const job = n->data;
+
+		(void) mowgli_node_delete(&job->node, &ldap_queue);
+		(void) auth_request_complete(job->req, AUTH_VERDICT_UNAVAILABLE);
+		(void) ldap_job_free(job);
+	}
+}
+
+static bool
+ldap_config_load(void)
+{
+	char *p;
+
+	if (ldap_config.url == NULL)
+	{
+		slog(LG_ERROR, "ldap_config_ready(): ldap {} missing url definition");
+		return false;
+	}
+	if ((ldap_config.dnformat == NULL) && ((ldap_config.base == NULL) || (ldap_config.attribute == NULL)))
+	{
+		slog(LG_ERROR, "ldap_config_ready(): ldap {} block requires dnformat or base & attribute definition");
+		return false;
+	}
+	if (ldap_config.binddn != NULL && ldap_config.bindauth == NULL)
+	{
+		slog(LG_ERROR, "ldap_config_ready(): ldap{} block requires bindauth to be defined if binddn is defined");
+		return false;
+	}
+
+	if (ldap_config.dnformat != NULL)
+	{
+		ldap_config.useDN = true;
+		p = strchr(ldap_config.dnformat, '%');
+		if (p == NULL || p[1] != 's' || strchr(p + 1, '%'))
 		{
-			slog(LG_INFO, "ldap_auth_user(%s): ldap search failed: %s", entity(mu)->name, ldap_err2string(res));
+			slog(LG_ERROR, "ldap_config_ready(): dnformat must contain exactly one %%s and no other %%");
 			return false;
 		}
+	}
+	else
+		ldap_config.useDN = false;
 
-		cred.bv_len = strlen(password);
+	// Duration items have no bounds of their own
+	if (ldap_config.timeout < LDAP_TIMEOUT_MIN)
+		ldap_config.timeout = LDAP_TIMEOUT_MIN;
+	if (ldap_config.timeout > LDAP_TIMEOUT_MAX)
+		ldap_config.timeout = LDAP_TIMEOUT_MAX;
+	if (ldap_config.cache_ttl > LDAP_CACHE_TTL_MAX)
+		ldap_config.cache_ttl = LDAP_CACHE_TTL_MAX;
 
-		// sstrdup it to remove the const
-		cred.bv_val = sstrdup(password);
+	ldap_pool_size = ldap_config.poolsize;
+	ldap_pool = smalloc(ldap_pool_size * sizeof *ldap_pool);
+	ldap_config.valid = true;
 
-		for (entry = ldap_first_message(ldap_conn, message); entry && ldap_msgtype(entry) == LDAP_RES_SEARCH_ENTRY; entry = ldap_next_message(ldap_conn, entry))
-		{
+	// Forget cached verifications; the server or the way we ask it may have changed
+	(void) mowgli_patricia_destroy(ldap_cache, &ldap_cache_entry_free, NULL);
+	ldap_cache = mowgli_patricia_create(&irccasecanon);
 
-			res = ldap_sasl_bind_s(ldap_conn, ldap_get_dn(ldap_conn, entry), LDAP_SASL_SIMPLE, &cred, NULL, NULL, NULL);
-			if (res == LDAP_SUCCESS)
-			{
-				ldap_msgfree(message);
-				return true;
-			}
-		}
+	// Set up the synchronous connection now so that a bad URL is reported at startup
+	(void) ldap_conn_open(&ldap_sync);
 
-		ldap_msgfree(message);
-	}
+	return true;
+}
 
-	slog(LG_INFO, "ldap_auth_user(%s): ldap auth bind failed: %s", entity(mu)->name, ldap_err2string(res));
-	return false;
+static void
+ldap_config_ready(void ATHEME_VATTR_UNUSED *unused)
+{
+	/* Connections will be reopened with the new settings as needed, and
+	 * the verifications they were doing start over on them
+	 */
+	(void) ldap_requeue_all();
+	(void) sfree(ldap_pool);
+
+	ldap_pool = NULL;
+	ldap_pool_size = 0;
+	ldap_config.valid = false;
+
+	if (ldap_config_load())
+		(void) ldap_run_queue();
+	else
+		(void) ldap_fail_all();
 }
 
 static void
 mod_init(struct module ATHEME_VATTR_UNUSED *const restrict m)
 {
+	(void) atheme_random_buf(ldap_cache_key, sizeof ldap_cache_key);
+
+	ldap_cache = mowgli_patricia_create(&irccasecanon);
+	ldap_cache_timer = mowgli_timer_add(base_eventloop, "ldap_cache_expire", &ldap_cache_expire, NULL, 60);
+
 	hook_add_config_ready(ldap_config_ready);
 
 	add_subblock_top_conf("LDAP", &conf_ldap_table);
@@ -236,8 +915,13 @@ mod_init(struct module ATHEME_VATTR_UNUSED *const restrict m)
 	add_dupstr_conf_item("ATTRIBUTE", &conf_ldap_table, 0, &ldap_config.attribute, NULL);
 	add_dupstr_conf_item("BINDDN", &conf_ldap_table, 0, &ldap_config.binddn, NULL);
 	add_dupstr_conf_item("BINDAUTH", &conf_ldap_table, 0, &ldap_config.bindauth, NULL);
+	add_uint_conf_item("POOLSIZE", &conf_ldap_table, 0, &ldap_config.poolsize,
+	                   LDAP_POOLSIZE_MIN, LDAP_POOLSIZE_MAX, LDAP_POOLSIZE_DEF);
+	add_duration_conf_item("TIMEOUT", &conf_ldap_table, 0, &ldap_config.timeout, "s", LDAP_TIMEOUT_DEF);
+	add_duration_conf_item("CACHE_TTL", &conf_ldap_table, 0, &ldap_config.cache_ttl, "s", LDAP_CACHE_TTL_DEF);
 
 	auth_user_custom = &ldap_auth_user;
+	auth_user_custom_async = &ldap_auth_user_async;
 
 	auth_module_loaded = true;
 }
@@ -246,11 +930,16 @@ static void
 mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 {
 	auth_user_custom = NULL;
+	auth_user_custom_async = NULL;
 
 	auth_module_loaded = false;
 
-	if (ldap_conn != NULL)
-		ldap_unbind_ext_s(ldap_conn, NULL, NULL);
+	(void) ldap_fail_all();
+	(void) sfree(ldap_pool);
+
+	(void) mowgli_timer_destroy(base_eventloop, ldap_cache_timer);
+	(void) mowgli_patricia_destroy(ldap_cache, &ldap_cache_entry_free, NULL);
+	(void) smemzero(ldap_cache_key, sizeof ldap_cache_key);
 
 	hook_del_config_ready(ldap_config_ready);
 	del_conf_item("URL", &conf_ldap_table);
@@ -259,6 +948,9 @@ mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 	del_conf_item("ATTRIBUTE", &conf_ldap_table);
 	del_conf_item("BINDDN", &conf_ldap_table);
 	del_conf_item("BINDAUTH", &conf_ldap_table);
+	del_conf_item("POOLSIZE", &conf_ldap_table);
+	del_conf_item("TIMEOUT", &conf_ldap_table);
+	del_conf_item("CACHE_TTL", &conf_ldap_table);
 	del_top_conf("LDAP");
 }
 
@@ -32,24 +32,128 @@ static bool mdep_load_mdeps = true;
 static pid_t child_pid;
 #endif
 
-// write atheme.db (core fields)
+/* A sliced save serializes the database from the event loop a few
+ * milliseconds at a time instead of fork()ing. Accounts and channels are
+ * written as they were when the save started: each is written when its
+ * turn comes, or through db_modify() just before it first changes,
+ * whichever is earlier, and those registered since are left out. The
+ * groups are captured in memory at the start, as chanacs rows may only
+ * name groups that are in the file; the trailer and the db_write hooks are
+ * captured in memory one at a time over the first slices, and so are as
+ * they were when their turn came.
+ *
+ * Build with DB_SAVE_DEBUG to also copy every account and channel at the
+ * start and compare the copy with what gets written, to catch changes made
+ * without db_modifying(); the copy is written instead when they differ.
+ */
+// rows captured in memory, to be written out later
+struct corestorage_rows
+{
+	struct database_handle  db;
+	char *                  buf;
+	size_t                  len;
+	size_t                  size;
+	size_t                  pos;
+};
+
+struct corestorage_save
+{
+	struct database_handle *        db;
+	char *                          filename;
+	enum {
+		CS_SAVE_CAPTURE,
+		CS_SAVE_MYUSERS,
+		CS_SAVE_PRE_CA,
+		CS_SAVE_EARLY_MYCHANS,
+		CS_SAVE_MYCHANS,
+		CS_SAVE_TRAILER,
+	}                               phase;
+
+	unsigned int                    gen;            // db_save_gen of this save
+	char                            luid[IDLEN + 1];        // the last entity ID handed out before the start
+	mowgli_node_t *                 cursor;         // next in myuser_dblist or mychan_dblist to write
+
+	// db_write handlers, captured one per step after the trailer
+	hook_fn *                       handlers;
+	size_t                          handlers_count;
+	size_t                          capture_pos;
+
+	mowgli_patricia_t *             names;          // ID -> name at the start, for accounts renamed or dropped since
+
+	struct corestorage_rows         pre_ca;         // db_write_pre_ca rows
+	struct corestorage_rows         early_mychans;  // channels that changed before the groups were written
+	struct corestorage_rows         trailer;        // trailer and db_write rows
+
+#ifdef DB_SAVE_DEBUG
+	mowgli_patricia_t *             copies;         // address -> struct corestorage_rows *, accounts and channels at the start
+	struct corestorage_rows         scratch;
+#endif
+
+	bool                            resave;         // a save was requested meanwhile; save again
+	mowgli_eventloop_timer_t *      timer;
+	struct timeval                  started;
+	unsigned int                    slices;
+	unsigned long long              pause_max;
+	unsigned long long              pause_total;
+};
+
+// statistics about the last sliced save, for /STATS d
+struct corestorage_save_stats
+{
+	time_t                  finished;
+	unsigned int            slices;
+	unsigned long long      snapshot;
+	unsigned long long      pause_max;
+	unsigned long long      pause_total;
+	unsigned long long      elapsed;
+};
+
+static struct corestorage_save *cs_save = NULL;
+static struct corestorage_save_stats cs_save_stats;
+
+// how long saves take, by method (blocking, fork, sliced)
+static struct metric *cs_metric_save_duration = NULL;
+static const double cs_save_duration_bounds[] = { 0.01, 0.05, 0.1, 0.5, 1, 2.5, 5, 10, 30, 60 };
+
+#ifdef HAVE_FORK
+static struct timeval cs_fork_started;
+#endif
+
+// general::db_save_slice, in milliseconds; 0 means fork() where available
+static unsigned int db_save_slice = 0;
+
+#define CS_SAVE_DEFAULT_SLICE   5U
+
+static const char *
+corestorage_entity_name(const struct myentity *const restrict mt)
+{
+	const char *name;
+
+	if (cs_save && (name = mowgli_patricia_retrieve(cs_save->names, mt->id)))
+		return name;
+
+	return mt->name;
+}
+
+static const char *
+corestorage_uid_name(const char *const restrict uid)
+{
+	const struct myentity *mt;
+	const char *name;
+
+	if (cs_save && (name = mowgli_patricia_retrieve(cs_save->names, uid)))
+		return name;
+
+	if ((mt = myentity_find_uid(uid)))
+		return mt->name;
+
+	return NULL;
+}
+
 static void
-corestorage_db_save(struct database_handle *db)
+corestorage_db_save_header(struct database_handle *db)
 {
-	struct metadata *md;
-	struct myuser *mu;
-	struct myentity *ment;
-	struct myuser_name *mun;
-	struct mychan *mc;
-	struct chanacs *ca;
-	struct kline *k;
-	struct xline *x;
-	struct qline *q;
-	struct svsignore *svsignore;
-	struct soper *soper;
-	mowgli_node_t *n, *tn;
-	mowgli_patricia_iteration_state_t state;
-	struct myentity_iteration_state mestate;
+	mowgli_node_t *n;
 
 	errno = 0;
 
@@ -77,166 +181,166 @@ corestorage_db_save(struct database_handle *db)
 	db_start_row(db, "CF");
 	db_write_word(db, bitmask_to_flags(ca_all));
 	db_commit_row(db);
+}
 
-	slog(LG_DEBUG, "db_save(): saving myusers");
+static void
+corestorage_db_save_myuser(struct database_handle *db, struct myuser *mu)
+{
+	struct metadata *md;
+	mowgli_node_t *tn;
+	mowgli_patricia_iteration_state_t state;
+	const char *const name = corestorage_entity_name(entity(mu));
+
+	/* MU <name> <pass> <email> <registered> <lastlogin> <failnum*> <lastfail*>
+	 * <lastfailon*> <flags> <language>
+	 *
+	 *  * failnum, lastfail, and lastfailon are deprecated (moved to metadata)
+	 */
+	char *flags = gflags_tostr(mu_flags, MOWGLI_LIST_LENGTH(&mu->logins) ? mu->flags & ~MU_NOBURSTLOGIN : mu->flags);
+	db_start_row(db, "MU");
+	db_write_word(db, entity(mu)->id);
+	db_write_word(db, name);
+	db_write_word(db, mu->pass);
+	db_write_word(db, mu->email);
+	db_write_time(db, mu->registered);
+	db_write_time(db, mu->lastlogin);
+	db_write_word(db, flags);
+	db_write_word(db, language_get_name(mu->language));
+	db_commit_row(db);
 
-	MYENTITY_FOREACH_T(ment, &mestate, ENT_USER)
+	if (atheme_object(mu)->metadata)
 	{
-		mu = user(ment);
-		/* MU <name> <pass> <email> <registered> <lastlogin> <failnum*> <lastfail*>
-		 * <lastfailon*> <flags> <language>
-		 *
-		 *  * failnum, lastfail, and lastfailon are deprecated (moved to metadata)
-		 */
-		char *flags = gflags_tostr(mu_flags, MOWGLI_LIST_LENGTH(&mu->logins) ? mu->flags & ~MU_NOBURSTLOGIN : mu->flags);
-		db_start_row(db, "MU");
-		db_write_word(db, entity(mu)->id);
-		db_write_word(db, entity(mu)->name);
-		db_write_word(db, mu->pass);
-		db_write_word(db, mu->email);
-		db_write_time(db, mu->registered);
-		db_write_time(db, mu->lastlogin);
-		db_write_word(db, flags);
-		db_write_word(db, language_get_name(mu->language));
-		db_commit_row(db);
-
-		if (atheme_object(mu)->metadata)
+		MOWGLI_PATRICIA_FOREACH(md, &state, atheme_object(mu)->metadata)
 		{
-			MOWGLI_PATRICIA_FOREACH(md, &state, atheme_object(mu)->metadata)
-			{
-				db_start_row(db, "MDU");
-				db_write_word(db, entity(mu)->name);
-				db_write_word(db, md->name);
-				db_write_str(db, md->value);
-				db_commit_row(db);
-			}
-		}
-
-		MOWGLI_ITER_FOREACH(tn, mu->memos.head)
-		{
-			struct mymemo *mz = (struct mymemo *)tn->data;
-
-			db_start_row(db, "ME");
-			db_write_word(db, entity(mu)->name);
-			db_write_word(db, mz->sender);
-			db_write_time(db, mz->sent);
-			db_write_uint(db, mz->status);
-			db_write_str(db, mz->text);
+			db_start_row(db, "MDU");
+			db_write_word(db, name);
+			db_write_word(db, md->name);
+			db_write_str(db, md->value);
 			db_commit_row(db);
 		}
+	}
 
-		MOWGLI_ITER_FOREACH(tn, mu->memo_ignores.head)
-		{
-			db_start_row(db, "MI");
-			db_write_word(db, entity(mu)->name);
-			db_write_word(db, (char *)tn->data);
-			db_commit_row(db);
-		}
+	MOWGLI_ITER_FOREACH(tn, mu->memos.head)
+	{
+		struct mymemo *mz = (struct mymemo *)tn->data;
+
+		db_start_row(db, "ME");
+		db_write_word(db, name);
+		db_write_word(db, mz->sender);
+		db_write_time(db, mz->sent);
+		db_write_uint(db, mz->status);
+		db_write_str(db, mz->text);
+		db_commit_row(db);
+	}
 
-		MOWGLI_ITER_FOREACH(tn, mu->access_list.head)
-		{
-			db_start_row(db, "AC");
-			db_write_word(db, entity(mu)->name);
-			db_write_word(db, (char *)tn->data);
-			db_commit_row(db);
-		}
+	MOWGLI_ITER_FOREACH(tn, mu->memo_ignores.head)
+	{
+		db_start_row(db, "MI");
+		db_write_word(db, name);
+		db_write_word(db, (char *)tn->data);
+		db_commit_row(db);
+	}
 
-		MOWGLI_ITER_FOREACH(tn, mu->nicks.head)
-		{
-			struct mynick *mn = tn->data;
+	MOWGLI_ITER_FOREACH(tn, mu->access_list.head)
+	{
+		db_start_row(db, "AC");
+		db_write_word(db, name);
+		db_write_word(db, (char *)tn->data);
+		db_commit_row(db);
+	}
 
-			db_start_row(db, "MN");
-			db_write_word(db, entity(mu)->name);
-			db_write_word(db, mn->nick);
-			db_write_time(db, mn->registered);
-			db_write_time(db, mn->lastseen);
-			db_commit_row(db);
-		}
+	MOWGLI_ITER_FOREACH(tn, mu->nicks.head)
+	{
+		struct mynick *mn = tn->data;
 
-		MOWGLI_ITER_FOREACH(tn, mu->cert_fingerprints.head)
-		{
-			struct mycertfp *mcfp = tn->data;
+		db_start_row(db, "MN");
+		db_write_word(db, name);
+		db_write_word(db, mn->nick);
+		db_write_time(db, mn->registered);
+		db_write_time(db, mn->lastseen);
+		db_commit_row(db);
+	}
 
-			db_start_row(db, "MCFP");
-			db_write_word(db, entity(mu)->name);
-			db_write_word(db, mcfp->certfp);
-			db_commit_row(db);
-		}
+	MOWGLI_ITER_FOREACH(tn, mu->cert_fingerprints.head)
+	{
+		struct mycertfp *mcfp = tn->data;
+
+		db_start_row(db, "MCFP");
+		db_write_word(db, name);
+		db_write_word(db, mcfp->certfp);
+		db_commit_row(db);
 	}
+}
 
-	// XXX: groupserv hack.  remove when we have proper dependency resolution. --nenolod
-	hook_call_db_write_pre_ca(db);
+/* Whether a chanacs row for this entity can be written: the loader gives
+ * up on chanacs for targets it does not know. Every account and group that
+ * existed when a sliced save started is in it, and only those, so leave
+ * out entities registered since.
+ */
+static bool
+corestorage_db_save_want_entity(const struct myentity *const restrict mt)
+{
+	if (! cs_save)
+		return true;
 
-	slog(LG_DEBUG, "db_save(): saving mychans");
+	if (! isuser(mt) && ! isgroup(mt))
+		return true;
 
-	MOWGLI_PATRICIA_FOREACH(mc, &state, mclist)
-	{
-		mowgli_patricia_iteration_state_t state2;
+	return ! myentity_uid_after(mt->id, cs_save->luid);
+}
 
-		char *flags = gflags_tostr(mc_flags, mc->flags);
+static void
+corestorage_db_save_mychan(struct database_handle *db, struct mychan *mc)
+{
+	struct metadata *md;
+	struct chanacs *ca;
+	mowgli_node_t *tn;
+	mowgli_patricia_iteration_state_t state;
 
-		// find a founder
-		mu = NULL;
-		MOWGLI_ITER_FOREACH(tn, mc->chanacs.head)
-		{
-			ca = (struct chanacs *)tn->data;
-			if (ca->entity != NULL && ca->level & CA_FOUNDER)
-			{
-				mu = user(ca->entity);
-				break;
-			}
-		}
+	char *flags = gflags_tostr(mc_flags, mc->flags);
+
+	// MC <name> <registered> <used> <flags> <mlock_on> <mlock_off> <mlock_limit> [mlock_key]
+	db_start_row(db, "MC");
+	db_write_word(db, mc->name);
+	db_write_time(db, mc->registered);
+	db_write_time(db, mc->used);
+	db_write_word(db, flags);
+	db_write_uint(db, mc->mlock_on);
+	db_write_uint(db, mc->mlock_off);
+	db_write_uint(db, mc->mlock_limit);
+	db_write_word(db, mc->mlock_key ? mc->mlock_key : "");
+	db_commit_row(db);
 
-		// MC <name> <registered> <used> <flags> <mlock_on> <mlock_off> <mlock_limit> [mlock_key]
-		db_start_row(db, "MC");
-		db_write_word(db, mc->name);
-		db_write_time(db, mc->registered);
-		db_write_time(db, mc->used);
-		db_write_word(db, flags);
-		db_write_uint(db, mc->mlock_on);
-		db_write_uint(db, mc->mlock_off);
-		db_write_uint(db, mc->mlock_limit);
-		db_write_word(db, mc->mlock_key ? mc->mlock_key : "");
-		db_commit_row(db);
+	MOWGLI_ITER_FOREACH(tn, mc->chanacs.head)
+	{
+		const char *setter = NULL;
+		ca = (struct chanacs *)tn->data;
 
-		MOWGLI_ITER_FOREACH(tn, mc->chanacs.head)
-		{
-			struct myentity *setter = NULL;
-			ca = (struct chanacs *)tn->data;
+		if (ca->entity && ! corestorage_db_save_want_entity(ca->entity))
+			continue;
 
-			db_start_row(db, "CA");
-			db_write_word(db, ca->mychan->name);
-			db_write_word(db, ca->entity ? ca->entity->name : ca->host);
-			db_write_word(db, bitmask_to_flags(ca->level));
-			db_write_time(db, ca->tmodified);
+		const char *const target = ca->entity ? corestorage_entity_name(ca->entity) : ca->host;
 
-			if (*ca->setter_uid != '\0' && (setter = myentity_find_uid(ca->setter_uid)))
-				db_write_word(db, setter->name);
-			else
-				db_write_word(db, "*");
+		db_start_row(db, "CA");
+		db_write_word(db, ca->mychan->name);
+		db_write_word(db, target);
+		db_write_word(db, bitmask_to_flags(ca->level));
+		db_write_time(db, ca->tmodified);
 
-			db_commit_row(db);
+		if (*ca->setter_uid != '\0' && (setter = corestorage_uid_name(ca->setter_uid)))
+			db_write_word(db, setter);
+		else
+			db_write_word(db, "*");
 
-			if (atheme_object(ca)->metadata)
-			{
-				MOWGLI_PATRICIA_FOREACH(md, &state2, atheme_object(ca)->metadata)
-				{
-					db_start_row(db, "MDA");
-					db_write_word(db, ca->mychan->name);
-					db_write_word(db, (ca->entity) ? ca->entity->name : ca->host);
-					db_write_word(db, md->name);
-					db_write_str(db, md->value);
-					db_commit_row(db);
-				}
-			}
-		}
+		db_commit_row(db);
 
-		if (atheme_object(mc)->metadata)
+		if (atheme_object(ca)->metadata)
 		{
-			MOWGLI_PATRICIA_FOREACH(md, &state2, atheme_object(mc)->metadata)
+			MOWGLI_PATRICIA_FOREACH(md, &state, atheme_object(ca)->metadata)
 			{
-				db_start_row(db, "MDC");
-				db_write_word(db, mc->name);
+				db_start_row(db, "MDA");
+				db_write_word(db, ca->mychan->name);
+				db_write_word(db, target);
 				db_write_word(db, md->name);
 				db_write_str(db, md->value);
 				db_commit_row(db);
@@ -244,6 +348,32 @@ corestorage_db_save(struct database_handle *db)
 		}
 	}
 
+	if (atheme_object(mc)->metadata)
+	{
+		MOWGLI_PATRICIA_FOREACH(md, &state, atheme_object(mc)->metadata)
+		{
+			db_start_row(db, "MDC");
+			db_write_word(db, mc->name);
+			db_write_word(db, md->name);
+			db_write_str(db, md->value);
+			db_commit_row(db);
+		}
+	}
+}
+
+static void
+corestorage_db_save_trailer(struct database_handle *db)
+{
+	struct metadata *md;
+	struct myuser_name *mun;
+	struct kline *k;
+	struct xline *x;
+	struct qline *q;
+	struct svsignore *svsignore;
+	struct soper *soper;
+	mowgli_node_t *n;
+	mowgli_patricia_iteration_state_t state;
+
 	// Old names
 	MOWGLI_PATRICIA_FOREACH(mun, &state, oldnameslist)
 	{
@@ -294,9 +424,12 @@ corestorage_db_save(struct database_handle *db)
 		if (soper->flags & SOPER_CONF || soper->myuser == NULL)
 			continue;
 
+		if (! corestorage_db_save_want_entity(entity(soper->myuser)))
+			continue;
+
 		// SO <account> <operclass> <flags> [password]
 		db_start_row(db, "SO");
-		db_write_word(db, entity(soper->myuser)->name);
+		db_write_word(db, corestorage_entity_name(entity(soper->myuser)));
 		db_write_word(db, soper->classname);
 		db_write_word(db, flags);
 
@@ -369,6 +502,33 @@ corestorage_db_save(struct database_handle *db)
 	}
 }
 
+// write atheme.db (core fields)
+static void
+corestorage_db_save(struct database_handle *db)
+{
+	struct myentity *ment;
+	struct mychan *mc;
+	mowgli_patricia_iteration_state_t state;
+	struct myentity_iteration_state mestate;
+
+	corestorage_db_save_header(db);
+
+	slog(LG_DEBUG, "db_save(): saving myusers");
+
+	MYENTITY_FOREACH_T(ment, &mestate, ENT_USER)
+		corestorage_db_save_myuser(db, user(ment));
+
+	// XXX: groupserv hack.  remove when we have proper dependency resolution. --nenolod
+	hook_call_db_write_pre_ca(db);
+
+	slog(LG_DEBUG, "db_save(): saving mychans");
+
+	MOWGLI_PATRICIA_FOREACH(mc, &state, mclist)
+		corestorage_db_save_mychan(db, mc);
+
+	corestorage_db_save_trailer(db);
+}
+
 static void ATHEME_FATTR_NORETURN
 corestorage_h_unknown(struct database_handle *db, const char *type)
 {
@@ -1004,6 +1164,18 @@ corestorage_db_load(const char *filename)
 	db_close(db);
 }
 
+static void
+corestorage_observe_save(const char *const restrict method, const struct timeval *const restrict started)
+{
+	struct timeval tv;
+	char labels[BUFSIZE];
+
+	e_time(*started, &tv);
+
+	(void) metric_labels(labels, sizeof labels, "method", method, NULL);
+	(void) metric_observe(cs_metric_save_duration, labels, ((double) tv2us(&tv)) / 1000000.0);
+}
+
 static void
 corestorage_db_write_blocking(void *filename)
 {
@@ -1023,6 +1195,16 @@ corestorage_db_write_blocking(void *filename)
 	db_close(db);
 }
 
+static void
+corestorage_db_write_blocking_timed(void *filename)
+{
+	struct timeval tv_start;
+
+	s_time(&tv_start);
+	corestorage_db_write_blocking(filename);
+	corestorage_observe_save("blocking", &tv_start);
+}
+
 #ifdef HAVE_FORK
 static void
 corestorage_db_saved_cb(pid_t pid, int status, void *data)
@@ -1033,15 +1215,664 @@ corestorage_db_saved_cb(pid_t pid, int status, void *data)
 	{
 		child_pid = 0;
 		slog(LG_DEBUG, "db_save(): finished asynchronous DB write");
+
+		if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS)
+			corestorage_observe_save("fork", &cs_fork_started);
+	}
+}
+#endif
+
+static bool
+corestorage_rows_put(struct database_handle *const restrict db, const char tag, const void *const restrict data,
+                     const size_t len)
+{
+	struct corestorage_rows *const rows = db->priv;
+
+	if (rows->len + len + 1 > rows->size)
+	{
+		size_t size = rows->size ? rows->size : 4096;
+
+		while (size < rows->len + len + 1)
+			size *= 2;
+
+		rows->buf = srealloc(rows->buf, size);
+		rows->size = size;
+	}
+
+	rows->buf[rows->len++] = tag;
+
+	if (len)
+		(void) memcpy(rows->buf + rows->len, data, len);
+
+	rows->len += len;
+	return true;
+}
+
+static bool
+corestorage_rows_start_row(struct database_handle *const restrict db, const char *const restrict type)
+{
+	return corestorage_rows_put(db, 'R', type, strlen(type) + 1);
+}
+
+static bool
+corestorage_rows_write_word(struct database_handle *const restrict db, const char *const restrict word)
+{
+	return word ? corestorage_rows_put(db, 'w', word, strlen(word) + 1) : corestorage_rows_put(db, 'W', NULL, 0);
+}
+
+static bool
+corestorage_rows_write_str(struct database_handle *const restrict db, const char *const restrict str)
+{
+	return str ? corestorage_rows_put(db, 's', str, strlen(str) + 1) : corestorage_rows_put(db, 'S', NULL, 0);
+}
+
+static bool
+corestorage_rows_write_int(struct database_handle *const restrict db, const int num)
+{
+	return corestorage_rows_put(db, 'i', &num, sizeof num);
+}
+
+static bool
+corestorage_rows_write_uint(struct database_handle *const restrict db, const unsigned int num)
+{
+	return corestorage_rows_put(db, 'u', &num, sizeof num);
+}
+
+static bool
+corestorage_rows_write_time(struct database_handle *const restrict db, const time_t tm)
+{
+	return corestorage_rows_put(db, 't', &tm, sizeof tm);
+}
+
+static bool
+corestorage_rows_commit_row(struct database_handle *const restrict db)
+{
+	return corestorage_rows_put(db, 'C', NULL, 0);
+}
+
+static const struct database_vtable corestorage_rows_vt = {
+	.name = "memory",
+	.start_row = corestorage_rows_start_row,
+	.write_word = corestorage_rows_write_word,
+	.write_str = corestorage_rows_write_str,
+	.write_int = corestorage_rows_write_int,
+	.write_uint = corestorage_rows_write_uint,
+	.write_time = corestorage_rows_write_time,
+	.commit_row = corestorage_rows_commit_row,
+};
+
+static void
+corestorage_rows_init(struct corestorage_rows *const restrict rows)
+{
+	rows->db.priv = rows;
+	rows->db.vt = &corestorage_rows_vt;
+	rows->db.txn = DB_WRITE;
+}
+
+static bool
+corestorage_save_overdue(const struct timeval *const restrict tv_start, const unsigned long long budget)
+{
+	struct timeval tv;
+
+	e_time(*tv_start, &tv);
+
+	return tv2us(&tv) >= budget;
+}
+
+static bool
+corestorage_save_expired(const struct timeval *const restrict tv_start, const unsigned long long budget,
+                         unsigned int *const restrict rows)
+{
+	if ((++*rows % 32U) != 0)
+		return false;
+
+	return corestorage_save_overdue(tv_start, budget);
+}
+
+// write captured rows out until there are none left (true) or the deadline passes (false)
+static bool
+corestorage_rows_replay(struct corestorage_rows *const restrict rows, struct database_handle *const restrict db,
+                        const struct timeval *const restrict tv_start, const unsigned long long budget,
+                        unsigned int *const restrict count)
+{
+	while (rows->pos < rows->len)
+	{
+		const char tag = rows->buf[rows->pos++];
+		const char *const data = rows->buf + rows->pos;
+
+		switch (tag)
+		{
+			case 'R':
+				(void) db_start_row(db, data);
+				rows->pos += strlen(data) + 1;
+				break;
+
+			case 'w':
+				(void) db_write_word(db, data);
+				rows->pos += strlen(data) + 1;
+				break;
+
+			case 'W':
+				(void) db_write_word(db, NULL);
+				break;
+
+			case 's':
+				(void) db_write_str(db, data);
+				rows->pos += strlen(data) + 1;
+				break;
+
+			case 'S':
+				(void) db_write_str(db, NULL);
+				break;
+
+			case 'i':
+			{
+				int num;
+
+				(void) memcpy(&num, data, sizeof num);
+				(void) db_write_int(db, num);
+				rows->pos += sizeof num;
+				break;
+			}
+
+			case 'u':
+			{
+				unsigned int num;
+
+				(void) memcpy(&num, data, sizeof num);
+				(void) db_write_uint(db, num);
+				rows->pos += sizeof num;
+				break;
+			}
+
+			case 't':
+			{
+				time_t tm;
+
+				(void) memcpy(&tm, data, sizeof tm);
+				(void) db_write_time(db, tm);
+				rows->pos += sizeof tm;
+				break;
+			}
+
+			case 'C':
+				(void) db_commit_row(db);
+
+				if (corestorage_save_expired(tv_start, budget, count))
+					return false;
+
+				break;
+		}
+	}
+
+	return true;
+}
+
+#ifdef DB_SAVE_DEBUG
+static struct corestorage_rows *
+corestorage_save_copy(struct corestorage_save *const restrict cs, const void *const restrict obj, const bool take)
+{
+	char key[BUFSIZE];
+
+	(void) snprintf(key, sizeof key, "%p", obj);
+
+	if (take)
+		return mowgli_patricia_delete(cs->copies, key);
+
+	struct corestorage_rows *const rows = smalloc(sizeof *rows);
+
+	corestorage_rows_init(rows);
+	mowgli_patricia_add(cs->copies, key, rows);
+
+	return rows;
+}
+
+// write what was serialized into the scratch rows, or the copy from the start if they differ
+static void
+corestorage_save_check(struct corestorage_save *const restrict cs, struct database_handle *const restrict db,
+                       const void *const restrict obj, const char *const restrict what, const char *const restrict name)
+{
+	struct corestorage_rows *const copy = corestorage_save_copy(cs, obj, true);
+	struct corestorage_rows *rows = &cs->scratch;
+	struct timeval tv_start;
+	unsigned int count = 0;
+
+	if (copy && (copy->len != rows->len || memcmp(copy->buf, rows->buf, rows->len) != 0))
+	{
+		slog(LG_ERROR, "db_save(): %s %s changed without db_modifying() during a sliced save; writing it as it was",
+		     what, name);
+		rows = copy;
+	}
+
+	s_time(&tv_start);
+
+	rows->pos = 0;
+	(void) corestorage_rows_replay(rows, db, &tv_start, ULLONG_MAX, &count);
+
+	cs->scratch.len = 0;
+
+	if (copy)
+	{
+		sfree(copy->buf);
+		sfree(copy);
 	}
 }
+
+static void
+corestorage_save_copy_free(const char *ATHEME_VATTR_UNUSED key, void *data, void *ATHEME_VATTR_UNUSED privdata)
+{
+	struct corestorage_rows *const rows = data;
+
+	sfree(rows->buf);
+	sfree(rows);
+}
 #endif
 
+static void
+corestorage_save_write_myuser(struct corestorage_save *const restrict cs, struct myuser *const restrict mu)
+{
+	mu->db_gen = cs->gen;
+
+#ifdef DB_SAVE_DEBUG
+	corestorage_db_save_myuser(&cs->scratch.db, mu);
+	corestorage_save_check(cs, cs->db, mu, "account", entity(mu)->name);
+#else
+	corestorage_db_save_myuser(cs->db, mu);
+#endif
+}
+
+static void
+corestorage_save_write_mychan(struct corestorage_save *const restrict cs, struct mychan *const restrict mc)
+{
+	// the groups are not written yet, and chanacs rows must come after them
+	struct database_handle *const db = (cs->phase < CS_SAVE_MYCHANS) ? &cs->early_mychans.db : cs->db;
+
+	mc->db_gen = cs->gen;
+
+#ifdef DB_SAVE_DEBUG
+	corestorage_db_save_mychan(&cs->scratch.db, mc);
+	corestorage_save_check(cs, db, mc, "channel", mc->name);
+#else
+	corestorage_db_save_mychan(db, mc);
+#endif
+}
+
+// db_modify(): an account or channel is about to change, so write it out now if it is still due
+static void
+corestorage_save_modify(struct myuser *const restrict mu, struct mychan *const restrict mc)
+{
+	struct corestorage_save *const cs = cs_save;
+
+	if (! cs)
+		return;
+
+	// it may be about to go away, so do not leave the walk on it
+	if (mu && cs->cursor == &mu->dbnode)
+		cs->cursor = cs->cursor->next;
+
+	if (mc && cs->cursor == &mc->dbnode)
+		cs->cursor = cs->cursor->next;
+
+	if (mu && mu->db_gen != cs->gen)
+		corestorage_save_write_myuser(cs, mu);
+
+	if (mc && mc->db_gen != cs->gen)
+		corestorage_save_write_mychan(cs, mc);
+}
+
+static void
+corestorage_save_name_free(const char *ATHEME_VATTR_UNUSED key, void *data, void *ATHEME_VATTR_UNUSED privdata)
+{
+	sfree(data);
+}
+
+static void
+corestorage_save_free(struct corestorage_save *const restrict cs)
+{
+	mowgli_patricia_destroy(cs->names, corestorage_save_name_free, NULL);
+
+#ifdef DB_SAVE_DEBUG
+	mowgli_patricia_destroy(cs->copies, corestorage_save_copy_free, NULL);
+	sfree(cs->scratch.buf);
+#endif
+
+	sfree(cs->pre_ca.buf);
+	sfree(cs->early_mychans.buf);
+	sfree(cs->trailer.buf);
+	sfree(cs->handlers);
+	sfree(cs->filename);
+	sfree(cs);
+}
+
+// carry on with the save until done (true) or the deadline passes (false)
+static bool
+corestorage_save_run(struct corestorage_save *const restrict cs, const struct timeval *const restrict tv_start,
+                     const unsigned long long budget)
+{
+	unsigned int rows = 0;
+
+	for (;;)
+	{
+		switch (cs->phase)
+		{
+			case CS_SAVE_CAPTURE:
+				// one step at a time: the trailer, then each db_write handler
+				while (cs->capture_pos <= cs->handlers_count)
+				{
+					if (cs->capture_pos == 0)
+						corestorage_db_save_trailer(&cs->trailer.db);
+					else
+						hook_call_handler("db_write", cs->handlers[cs->capture_pos - 1], &cs->trailer.db);
+
+					cs->capture_pos++;
+
+					if (corestorage_save_overdue(tv_start, budget))
+						return false;
+				}
+
+				cs->cursor = myuser_dblist.head;
+				cs->phase = CS_SAVE_MYUSERS;
+				break;
+
+			case CS_SAVE_MYUSERS:
+				while (cs->cursor)
+				{
+					struct myuser *const mu = cs->cursor->data;
+
+					cs->cursor = cs->cursor->next;
+
+					if (mu->db_gen == cs->gen)
+						continue;
+
+					corestorage_save_write_myuser(cs, mu);
+
+					if (corestorage_save_expired(tv_start, budget, &rows))
+						return false;
+				}
+
+				cs->phase = CS_SAVE_PRE_CA;
+				break;
+
+			case CS_SAVE_MYCHANS:
+				while (cs->cursor)
+				{
+					struct mychan *const mc = cs->cursor->data;
+
+					cs->cursor = cs->cursor->next;
+
+					if (mc->db_gen == cs->gen)
+						continue;
+
+					corestorage_save_write_mychan(cs, mc);
+
+					if (corestorage_save_expired(tv_start, budget, &rows))
+						return false;
+				}
+
+				cs->phase = CS_SAVE_TRAILER;
+				break;
+
+			case CS_SAVE_PRE_CA:
+				if (! corestorage_rows_replay(&cs->pre_ca, cs->db, tv_start, budget, &rows))
+					return false;
+
+				cs->phase = CS_SAVE_EARLY_MYCHANS;
+				break;
+
+			case CS_SAVE_EARLY_MYCHANS:
+				if (! corestorage_rows_replay(&cs->early_mychans, cs->db, tv_start, budget, &rows))
+					return false;
+
+				cs->cursor = mychan_dblist.head;
+				cs->phase = CS_SAVE_MYCHANS;
+				break;
+
+			case CS_SAVE_TRAILER:
+				return corestorage_rows_replay(&cs->trailer, cs->db, tv_start, budget, &rows);
+		}
+	}
+}
+
+static unsigned long long
+corestorage_save_budget(void)
+{
+	return (db_save_slice ? db_save_slice : CS_SAVE_DEFAULT_SLICE) * 1000ULL;
+}
+
+static void
+corestorage_save_pause(struct corestorage_save *const restrict cs, const struct timeval *const restrict tv_start)
+{
+	struct timeval tv;
+
+	e_time(*tv_start, &tv);
+
+	const unsigned long long pause = tv2us(&tv);
+
+	cs->slices++;
+	cs->pause_total += pause;
+
+	if (pause > cs->pause_max)
+		cs->pause_max = pause;
+}
+
+static void corestorage_db_write(void *filename, enum db_save_strategy strategy);
+
+static void
+corestorage_save_finish(struct corestorage_save *const restrict cs)
+{
+	struct timeval tv;
+	char *const filename = cs->filename ? sstrdup(cs->filename) : NULL;
+	const bool resave = cs->resave;
+
+	db_close(cs->db);
+
+	e_time(cs->started, &tv);
+
+	cs_save_stats.finished = CURRTIME;
+	cs_save_stats.slices = cs->slices;
+	cs_save_stats.pause_max = cs->pause_max;
+	cs_save_stats.pause_total = cs->pause_total;
+	cs_save_stats.elapsed = tv2us(&tv);
+
+	corestorage_observe_save("sliced", &cs->started);
+
+	slog(LG_DEBUG, "db_save(): finished sliced DB write in %u slices over %llu ms (longest pause %llu us, "
+	               "snapshot %llu us)", cs->slices, cs_save_stats.elapsed / 1000ULL, cs->pause_max,
+	               cs_save_stats.snapshot);
+
+	if (cs->timer)
+		(void) mowgli_timer_destroy(base_eventloop, cs->timer);
+
+	cs_save = NULL;
+	corestorage_save_free(cs);
+
+	if (resave)
+	{
+		slog(LG_DEBUG, "db_save(): another save was requested meanwhile; saving again");
+		corestorage_db_write(filename, DB_SAVE_BG_REGULAR);
+	}
+
+	sfree(filename);
+}
+
+static void
+corestorage_save_slice(void *const restrict ATHEME_VATTR_UNUSED unused)
+{
+	struct corestorage_save *const cs = cs_save;
+	struct timeval tv_start;
+
+	return_if_fail(cs != NULL);
+
+	cs->timer = NULL;
+
+	s_time(&tv_start);
+
+	const bool done = corestorage_save_run(cs, &tv_start, corestorage_save_budget());
+
+	corestorage_save_pause(cs, &tv_start);
+
+	if (done)
+		corestorage_save_finish(cs);
+	else
+		cs->timer = mowgli_timer_add_once(base_eventloop, "corestorage_save_slice", &corestorage_save_slice, NULL, 0);
+}
+
+static void
+corestorage_save_start(const char *const restrict filename)
+{
+	struct corestorage_save *cs;
+	struct database_handle *db;
+	struct timeval tv_start;
+
+	s_time(&tv_start);
+
+	if (! (db = db_open(filename, DB_WRITE)))
+	{
+		slog(LG_ERROR, "db_save(): db_open() failed, aborting save");
+		return;
+	}
+
+	cs = smalloc(sizeof *cs);
+	cs->db = db;
+	cs->filename = filename ? sstrdup(filename) : NULL;
+	cs->phase = CS_SAVE_CAPTURE;
+	cs->started = tv_start;
+
+	// accounts and channels registered from now on get this too, so they are left out
+	cs->gen = ++db_save_gen;
+	(void) mowgli_strlcpy(cs->luid, myentity_get_last_uid(), sizeof cs->luid);
+
+	if ((cs->handlers_count = hook_get_handlers("db_write", NULL, 0)))
+	{
+		cs->handlers = smalloc(cs->handlers_count * sizeof *cs->handlers);
+		cs->handlers_count = hook_get_handlers("db_write", cs->handlers, cs->handlers_count);
+	}
+
+	cs->names = mowgli_patricia_create(noopcanon);
+
+	corestorage_rows_init(&cs->pre_ca);
+	corestorage_rows_init(&cs->early_mychans);
+	corestorage_rows_init(&cs->trailer);
+
+	cs_save = cs;
+
+	corestorage_db_save_header(db);
+
+	// XXX: groupserv hack.  remove when we have proper dependency resolution. --nenolod
+	hook_call_db_write_pre_ca(&cs->pre_ca.db);
+
+#ifdef DB_SAVE_DEBUG
+	mowgli_node_t *n;
+
+	cs->copies = mowgli_patricia_create(noopcanon);
+	corestorage_rows_init(&cs->scratch);
+
+	MOWGLI_ITER_FOREACH(n, myuser_dblist.head)
+		corestorage_db_save_myuser(&corestorage_save_copy(cs, n->data, false)->db, n->data);
+
+	MOWGLI_ITER_FOREACH(n, mychan_dblist.head)
+		corestorage_db_save_mychan(&corestorage_save_copy(cs, n->data, false)->db, n->data);
+#endif
+
+	corestorage_save_pause(cs, &tv_start);
+	cs_save_stats.snapshot = cs->pause_max;
+
+	cs->timer = mowgli_timer_add_once(base_eventloop, "corestorage_save_slice", &corestorage_save_slice, NULL, 0);
+}
+
+// finish a sliced save right now, e.g. before a blocking one
+static void
+corestorage_save_complete(void)
+{
+	struct corestorage_save *const cs = cs_save;
+	struct timeval tv_start;
+
+	s_time(&tv_start);
+
+	while (! corestorage_save_run(cs, &tv_start, ULLONG_MAX))
+		;
+
+	corestorage_save_pause(cs, &tv_start);
+
+	// the caller is about to save anyway
+	cs->resave = false;
+
+	corestorage_save_finish(cs);
+}
+
+// keep referring to an account by the name it had when the save started
+static void
+corestorage_save_remember_name(const char *const restrict id, const char *const restrict name)
+{
+	struct corestorage_save *const cs = cs_save;
+
+	if (! cs || myentity_uid_after(id, cs->luid) || mowgli_patricia_retrieve(cs->names, id))
+		return;
+
+	mowgli_patricia_add(cs->names, id, sstrdup(name));
+}
+
+static void
+corestorage_save_user_rename(struct hook_user_rename *const restrict data)
+{
+	corestorage_save_remember_name(entity(data->mu)->id, data->oldname);
+}
+
+static void
+corestorage_save_user_delete(struct myuser *const restrict mu)
+{
+	corestorage_save_remember_name(entity(mu)->id, entity(mu)->name);
+}
+
+static void
+corestorage_stats_request(struct hook_stats_req *const restrict req)
+{
+	if (req->req != 'D' && req->req != 'd')
+		return;
+
+	if (! has_priv_user(req->u, PRIV_SERVER_AUSPEX))
+		return;
+
+	if (cs_save)
+		(void) numeric_sts(me.me, 249, req->u, "d :Sliced save in progress (%u slices so far, longest pause %lluus)",
+		                   cs_save->slices, cs_save->pause_max);
+
+	if (! cs_save_stats.finished)
+		return;
+
+	(void) numeric_sts(me.me, 249, req->u, "d :Last sliced save %s ago: %u slices over %llums", time_ago(cs_save_stats.finished),
+	                   cs_save_stats.slices, cs_save_stats.elapsed / 1000ULL);
+	(void) numeric_sts(me.me, 249, req->u, "d :Pauses: snapshot %lluus, longest %lluus, average %lluus", cs_save_stats.snapshot,
+	                   cs_save_stats.pause_max, cs_save_stats.pause_total / cs_save_stats.slices);
+}
+
 static void
 corestorage_db_write(void *filename, enum db_save_strategy strategy)
 {
+	if (cs_save)
+	{
+		if (strategy == DB_SAVE_BG_REGULAR)
+		{
+			slog(LG_DEBUG, "db_save(): previous save unfinished, skipping save");
+			return;
+		}
+
+		if (strategy == DB_SAVE_BG_IMPORTANT)
+		{
+			slog(LG_DEBUG, "db_save(): previous save unfinished, saving again when it is done");
+			cs_save->resave = true;
+			return;
+		}
+
+		slog(LG_DEBUG, "db_save(): completing unfinished sliced save before blocking save");
+		corestorage_save_complete();
+	}
+
 #ifndef HAVE_FORK
-	corestorage_db_write_blocking(filename);
+	if (strategy == DB_SAVE_BLOCKING)
+		corestorage_db_write_blocking_timed(filename);
+	else
+		corestorage_save_start(filename);
 #else
 
 	if (child_pid && strategy == DB_SAVE_BG_REGULAR)
@@ -1062,16 +1893,24 @@ corestorage_db_write(void *filename, enum db_save_strategy strategy)
 
 	if (strategy == DB_SAVE_BLOCKING)
 	{
-		corestorage_db_write_blocking(filename);
+		corestorage_db_write_blocking_timed(filename);
 		return;
 	}
 
+	if (db_save_slice)
+	{
+		corestorage_save_start(filename);
+		return;
+	}
+
+	s_time(&cs_fork_started);
+
 	pid_t pid = fork();
 	switch (pid)
 	{
 		case -1:
-			slog(LG_ERROR, "db_save(): fork() failed; writing database synchronously");
-			corestorage_db_write_blocking(filename);
+			slog(LG_ERROR, "db_save(): fork() failed; writing database in slices");
+			corestorage_save_start(filename);
 			return;
 
 		case 0:
@@ -1091,6 +1930,7 @@ mod_init(struct module *const restrict m)
 {
 	db_load = &corestorage_db_load;
 	db_save = &corestorage_db_write;
+	db_modify = &corestorage_save_modify;
 
 	db_register_type_handler("DBV", corestorage_h_dbv);
 	db_register_type_handler("MDEP", corestorage_h_mdep);
@@ -1124,6 +1964,16 @@ mod_init(struct module *const restrict m)
 
 	db_register_type_handler("???", corestorage_h_unknown);
 
+	(void) add_uint_conf_item("DB_SAVE_SLICE", &conf_gi_table, 0, &db_save_slice, 0, 1000, 0);
+
+	(void) hook_add_user_rename(&corestorage_save_user_rename);
+	(void) hook_add_myuser_delete(&corestorage_save_user_delete);
+	(void) hook_add_stats_request(&corestorage_stats_request);
+
+	cs_metric_save_duration = metric_histogram_create("atheme_db_save_duration_seconds", "How long database "
+	                                                  "saves take, by method", cs_save_duration_bounds,
+	                                                  ARRAY_SIZE(cs_save_duration_bounds));
+
 	backend_loaded = true;
 
 	m->mflags |= MODFLAG_DBHANDLER;
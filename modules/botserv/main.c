@@ -990,8 +990,13 @@ bs_part(struct hook_channel_joinpart *hdata)
 
 	bot = bs_mychan_find_bot(mc);
 	if ((CURRTIME - mc->used) >= SECONDS_PER_HOUR)
+	{
 		if (chanacs_user_flags(mc, cu->user) & CA_USEDUPDATE)
+		{
+			db_modifying(mc);
 			mc->used = CURRTIME;
+		}
+	}
 
 	/*
 	 * When channel_part is fired, we haven't yet removed the
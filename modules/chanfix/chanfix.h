@@ -24,6 +24,11 @@
 #define CHANFIX_GATHER_INTERVAL (5U * SECONDS_PER_MINUTE)
 #define CHANFIX_EXPIRE_INTERVAL SECONDS_PER_HOUR
 
+/* Every channel is visited by the expiry sweep once per CHANFIX_EXPIRE_INTERVAL,
+ * a slice of them every CHANFIX_EXPIRE_SLICE seconds.
+ */
+#define CHANFIX_EXPIRE_SLICE    SECONDS_PER_MINUTE
+
 /* This value has been chosen such that the maximum score is about 8064,
  * which is the number of CHANFIX_GATHER_INTERVALs in CHANFIX_RETENTION_TIME.
  * Higher scores would decay more than they can gain (12 per hour).
@@ -34,9 +39,12 @@ struct chanfix_channel
 {
 	struct atheme_object parent;
 
+	mowgli_node_t node;
+
 	char *name;
 
 	mowgli_list_t oprecords;
+	mowgli_list_t opstates;
 	time_t ts;
 	time_t lastupdate;
 
@@ -59,7 +67,23 @@ struct chanfix_oprecord
 
 	time_t firstseen;
 	time_t lastevent;
+	time_t lastdecay;
 	unsigned int age;
+	unsigned int opcount;
+};
+
+/* A channel member who currently has ops, and is accruing score for the
+ * oprecord they were matched to when they were opped. The score is credited
+ * lazily whenever the record is read or their status changes.
+ */
+struct chanfix_opstate
+{
+	mowgli_node_t node;
+
+	struct chanuser *cu;
+	struct chanfix_oprecord *orec;
+
+	time_t since;
 };
 
 struct chanfix_persist_record
@@ -68,8 +92,10 @@ struct chanfix_persist_record
 
 	mowgli_heap_t *chanfix_channel_heap;
 	mowgli_heap_t *chanfix_oprecord_heap;
+	mowgli_heap_t *chanfix_opstate_heap;
 
 	mowgli_patricia_t *chanfix_channels;
+	mowgli_list_t *chanfix_expire_queue;
 };
 
 extern struct service *chanfix;
@@ -78,14 +104,15 @@ extern mowgli_patricia_t *chanfix_channels;
 void chanfix_gather_init(struct chanfix_persist_record *);
 void chanfix_gather_deinit(enum module_unload_intent, struct chanfix_persist_record *);
 
-void chanfix_oprecord_update(struct chanfix_channel *chan, struct user *u);
 void chanfix_oprecord_delete(struct chanfix_oprecord *orec);
 struct chanfix_oprecord *chanfix_oprecord_create(struct chanfix_channel *chan, struct user *u);
 struct chanfix_oprecord *chanfix_oprecord_find(struct chanfix_channel *chan, struct user *u);
 struct chanfix_channel *chanfix_channel_create(const char *name, struct channel *chan);
 struct chanfix_channel *chanfix_channel_find(const char *name);
 struct chanfix_channel *chanfix_channel_get(struct channel *chan);
-void chanfix_gather(void *unused);
+void chanfix_channel_refresh(struct chanfix_channel *chan);
+void chanfix_chanuser_sync(struct chanuser *cu);
+void chanfix_gather_channel(struct channel *ch);
 void chanfix_expire(void *unused);
 
 extern bool chanfix_do_autofix;
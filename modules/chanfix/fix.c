@@ -101,6 +101,7 @@ chanfix_lower_ts(struct chanfix_channel *chan)
 	{
 		struct chanuser *cu = n->data;
 		cu->modes = 0;
+		chanfix_chanuser_sync(cu);
 	}
 
 	chan_lowerts(ch, chanfix->me);
@@ -118,6 +119,8 @@ chanfix_get_highscore(struct chanfix_channel *chan)
 	unsigned int highscore = 0;
 	mowgli_node_t *n;
 
+	chanfix_channel_refresh(chan);
+
 	MOWGLI_ITER_FOREACH(n, chan->oprecords.head)
 	{
 		unsigned int score;
@@ -185,6 +188,7 @@ chanfix_fix_channel(struct chanfix_channel *chan)
 				join(chan->name, chanfix->me->nick);
 			modestack_mode_param(chanfix->me->nick, chan->chan, MTYPE_ADD, 'o', CLIENT_NAME(cu->user));
 			cu->modes |= CSTATUS_OP;
+			chanfix_chanuser_sync(cu);
 			opped++;
 		}
 	}
@@ -516,6 +520,8 @@ chanfix_cmd_scores(struct sourceinfo *si, int parc, char *parv[])
 		return;
 	}
 
+	chanfix_channel_refresh(chan);
+
 	// sort records by score.
 	mowgli_list_sort(&chan->oprecords, chanfix_compare_records, NULL);
 
@@ -580,6 +586,8 @@ chanfix_cmd_info(struct sourceinfo *si, int parc, char *parv[])
 		return;
 	}
 
+	chanfix_channel_refresh(chan);
+
 	// sort records by score.
 	mowgli_list_sort(&chan->oprecords, chanfix_compare_records, NULL);
 
@@ -16,9 +16,14 @@ static unsigned int loading_cfdbv = 0;
 
 static mowgli_heap_t *chanfix_channel_heap = NULL;
 static mowgli_heap_t *chanfix_oprecord_heap = NULL;
-static mowgli_eventloop_timer_t *chanfix_gather_timer = NULL;
+static mowgli_heap_t *chanfix_opstate_heap = NULL;
 static mowgli_eventloop_timer_t *chanfix_expire_timer = NULL;
 
+/* Channels in the order the expiry sweep will visit them; each visited
+ * channel is moved to the tail.
+ */
+static mowgli_list_t *chanfix_expire_queue = NULL;
+
 mowgli_patricia_t *chanfix_channels = NULL;
 
 struct chanfix_oprecord *
@@ -39,8 +44,10 @@ chanfix_oprecord_create(struct chanfix_channel *chan, struct user *u)
 
 	orec->firstseen = CURRTIME;
 	orec->lastevent = CURRTIME;
+	orec->lastdecay = CURRTIME;
 
 	orec->age = 1;
+	orec->opcount = 0;
 
 	if (u != NULL)
 	{
@@ -77,37 +84,221 @@ chanfix_oprecord_find(struct chanfix_channel *chan, struct user *u)
 	return NULL;
 }
 
+/* Applies the exponential decay that chanfix_expire() used to apply to every
+ * record once per CHANFIX_EXPIRE_INTERVAL, for all intervals that have passed
+ * since the record was last decayed.
+ */
+static void
+chanfix_oprecord_decay(struct chanfix_oprecord *orec)
+{
+	time_t intervals;
+
+	if (CURRTIME <= orec->lastdecay)
+		return;
+
+	intervals = (CURRTIME - orec->lastdecay) / CHANFIX_EXPIRE_INTERVAL;
+	orec->lastdecay += intervals * CHANFIX_EXPIRE_INTERVAL;
+
+	while (intervals-- > 0 && orec->age > 0)
+	{
+		/* Simple exponential decay, rounding the decay up
+		 * so that low scores expire sooner.
+		 */
+		orec->age -= (orec->age + CHANFIX_EXPIRE_DIVISOR - 1) /
+			CHANFIX_EXPIRE_DIVISOR;
+	}
+}
+
 void
-chanfix_oprecord_update(struct chanfix_channel *chan, struct user *u)
+chanfix_oprecord_delete(struct chanfix_oprecord *orec)
+{
+	mowgli_node_t *n, *tn;
+
+	return_if_fail(orec != NULL);
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, orec->chan->opstates.head)
+	{
+		struct chanfix_opstate *os = n->data;
+
+		if (os->orec != orec)
+			continue;
+
+		mowgli_node_delete(&os->node, &orec->chan->opstates);
+		mowgli_heap_free(chanfix_opstate_heap, os);
+	}
+
+	mowgli_node_delete(&orec->node, &orec->chan->oprecords);
+	mowgli_heap_free(chanfix_oprecord_heap, orec);
+}
+
+/* Credits an opped member's record with one point for every whole
+ * CHANFIX_GATHER_INTERVAL they have held ops since the last credit.
+ */
+static void
+chanfix_opstate_credit(struct chanfix_opstate *os)
+{
+	time_t intervals;
+
+	chanfix_oprecord_decay(os->orec);
+
+	os->orec->lastevent = CURRTIME;
+
+	if (CURRTIME <= os->since)
+		return;
+
+	intervals = (CURRTIME - os->since) / CHANFIX_GATHER_INTERVAL;
+	os->since += intervals * CHANFIX_GATHER_INTERVAL;
+	os->orec->age += intervals;
+}
+
+static struct chanfix_opstate *
+chanfix_opstate_find(struct chanfix_channel *chan, struct chanuser *cu)
 {
+	mowgli_node_t *n;
+
+	MOWGLI_ITER_FOREACH(n, chan->opstates.head)
+	{
+		struct chanfix_opstate *os = n->data;
+
+		if (os->cu == cu)
+			return os;
+	}
+
+	return NULL;
+}
+
+static void
+chanfix_opstate_start(struct chanfix_channel *chan, struct chanuser *cu)
+{
+	struct chanfix_opstate *os;
 	struct chanfix_oprecord *orec;
 
+	orec = chanfix_oprecord_find(chan, cu->user);
+	if (orec == NULL)
+	{
+		orec = chanfix_oprecord_create(chan, cu->user);
+		chan->lastupdate = CURRTIME;
+	}
+	else if (orec->entity == NULL && cu->user->myuser != NULL)
+		orec->entity = entity(cu->user->myuser);
+
+	chanfix_oprecord_decay(orec);
+	orec->lastevent = CURRTIME;
+	orec->opcount++;
+
+	os = mowgli_heap_alloc(chanfix_opstate_heap);
+	os->cu = cu;
+	os->orec = orec;
+	os->since = CURRTIME;
+
+	mowgli_node_add(os, &os->node, &chan->opstates);
+}
+
+static void
+chanfix_opstate_end(struct chanfix_channel *chan, struct chanfix_opstate *os)
+{
+	chanfix_opstate_credit(os);
+
+	os->orec->opcount--;
+
+	mowgli_node_delete(&os->node, &chan->opstates);
+	mowgli_heap_free(chanfix_opstate_heap, os);
+}
+
+static void
+chanfix_channel_end_opstates(struct chanfix_channel *chan)
+{
+	mowgli_node_t *n, *tn;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, chan->opstates.head)
+		chanfix_opstate_end(chan, n->data);
+}
+
+/*
+ * Brings a channel's records up to date: credits members who are still
+ * opped, stops tracking members whose ops were removed without an event
+ * we could see, and applies pending decay, deleting records that have
+ * decayed away or have not been seen for CHANFIX_RETENTION_TIME.
+ *
+ * Anything reading scores should call this first.
+ */
+void
+chanfix_channel_refresh(struct chanfix_channel *chan)
+{
+	mowgli_node_t *n, *tn;
+
 	return_if_fail(chan != NULL);
-	return_if_fail(u != NULL);
 
-	orec = chanfix_oprecord_find(chan, u);
-	if (orec != NULL)
+	if (chan->chan == NULL || mychan_find(chan->name) != NULL)
+		chanfix_channel_end_opstates(chan);
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, chan->opstates.head)
 	{
-		orec->age++;
-		orec->lastevent = CURRTIME;
+		struct chanfix_opstate *os = n->data;
 
-		if (orec->entity == NULL && u->myuser != NULL)
-			orec->entity = entity(u->myuser);
+		if (os->cu->modes & CSTATUS_OP)
+			chanfix_opstate_credit(os);
+		else
+			chanfix_opstate_end(chan, os);
+	}
 
-		return;
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, chan->oprecords.head)
+	{
+		struct chanfix_oprecord *orec = n->data;
+
+		chanfix_oprecord_decay(orec);
+
+		if (orec->opcount > 0)
+			continue;
+
+		if (orec->age > 0 && CURRTIME - orec->lastevent < CHANFIX_RETENTION_TIME)
+			continue;
+
+		chanfix_oprecord_delete(orec);
 	}
+}
+
+/*
+ * Starts or stops crediting a channel member, according to whether they
+ * currently have ops. Ops in registered channels are not tracked.
+ */
+void
+chanfix_chanuser_sync(struct chanuser *cu)
+{
+	struct chanfix_channel *chan;
+	struct chanfix_opstate *os;
+
+	return_if_fail(cu != NULL);
+
+	chan = chanfix_channel_get(cu->chan);
+	if (chan == NULL)
+		chan = chanfix_channel_create(cu->chan->name, cu->chan);
 
-	chanfix_oprecord_create(chan, u);
-	chan->lastupdate = CURRTIME;
+	os = chanfix_opstate_find(chan, cu);
+
+	if ((cu->modes & CSTATUS_OP) && mychan_find(cu->chan->name) == NULL)
+	{
+		if (os == NULL)
+			chanfix_opstate_start(chan, cu);
+	}
+	else if (os != NULL)
+		chanfix_opstate_end(chan, os);
 }
 
+/*
+ * Synchronises every member of a channel. This is only needed when the
+ * ircd may have changed many statuses at once without telling us about
+ * each one, such as on a TS change.
+ */
 void
-chanfix_oprecord_delete(struct chanfix_oprecord *orec)
+chanfix_gather_channel(struct channel *ch)
 {
-	return_if_fail(orec != NULL);
+	mowgli_node_t *n;
 
-	mowgli_node_delete(&orec->node, &orec->chan->oprecords);
-	mowgli_heap_free(chanfix_oprecord_heap, orec);
+	return_if_fail(ch != NULL);
+
+	MOWGLI_ITER_FOREACH(n, ch->members.head)
+		chanfix_chanuser_sync(n->data);
 }
 
 static void
@@ -118,6 +309,7 @@ chanfix_channel_delete(struct chanfix_channel *c)
 	return_if_fail(c != NULL);
 
 	mowgli_patricia_delete(chanfix_channels, c->name);
+	mowgli_node_delete(&c->node, chanfix_expire_queue);
 
 	MOWGLI_ITER_FOREACH_SAFE(n, tn, c->oprecords.head)
 	{
@@ -148,6 +340,7 @@ chanfix_channel_create(const char *name, struct channel *chan)
 		c->ts = c->chan->ts;
 
 	mowgli_patricia_add(chanfix_channels, c->name, c);
+	mowgli_node_add(c, &c->node, chanfix_expire_queue);
 
 	return c;
 }
@@ -191,6 +384,8 @@ chanfix_channel_delete_ev(struct channel *ch)
 
 	if ((chan = chanfix_channel_get(ch)) != NULL)
 	{
+		// any members still present are freed without a part event
+		chanfix_channel_end_opstates(chan);
 		chan->chan = NULL;
 		return;
 	}
@@ -198,68 +393,71 @@ chanfix_channel_delete_ev(struct channel *ch)
 	chanfix_channel_create(ch->name, NULL);
 }
 
-void
-chanfix_gather(void *unused)
+static void
+chanfix_join_ev(struct hook_channel_joinpart *hdata)
 {
-	struct channel *ch;
-	mowgli_patricia_iteration_state_t state;
-	unsigned int chans = 0, oprecords = 0;
+	if (hdata->cu == NULL)
+		return;
 
-	MOWGLI_PATRICIA_FOREACH(ch, &state, chanlist)
-	{
-		struct mychan *mc;
-		mowgli_node_t *n;
-		struct chanfix_channel *chan;
+	chanfix_chanuser_sync(hdata->cu);
+}
 
-		if ((mc = mychan_find(ch->name)) != NULL)
-			continue;
+static void
+chanfix_part_ev(struct hook_channel_joinpart *hdata)
+{
+	struct chanfix_channel *chan;
+	struct chanfix_opstate *os;
 
-		chan = chanfix_channel_get(ch);
-		if (chan == NULL)
-			chan = chanfix_channel_create(ch->name, ch);
+	if (hdata->cu == NULL)
+		return;
 
-		MOWGLI_ITER_FOREACH(n, ch->members.head)
-		{
-			struct chanuser *cu = n->data;
+	if ((chan = chanfix_channel_get(hdata->cu->chan)) == NULL)
+		return;
 
-			if (cu->modes & CSTATUS_OP)
-			{
-				chanfix_oprecord_update(chan, cu->user);
-				oprecords++;
-			}
-		}
+	if ((os = chanfix_opstate_find(chan, hdata->cu)) != NULL)
+		chanfix_opstate_end(chan, os);
+}
 
-		chans++;
-	}
+static void
+chanfix_status_change_ev(struct hook_channel_mode_change *hdata)
+{
+	if (hdata->mvalue != CSTATUS_OP)
+		return;
+
+	chanfix_chanuser_sync(hdata->cu);
+}
 
-	slog(LG_DEBUG, "chanfix_gather(): gathered %u channels and %u oprecords.", chans, oprecords);
+static void
+chanfix_tschange_ev(struct channel *ch)
+{
+	chanfix_gather_channel(ch);
 }
 
 void
 chanfix_expire(void *unused)
 {
-	struct chanfix_channel *chan;
-	mowgli_patricia_iteration_state_t state;
+	size_t count;
 
-	MOWGLI_PATRICIA_FOREACH(chan, &state, chanfix_channels)
-	{
-		mowgli_node_t *n, *tn;
+	/* Visit enough channels that the whole queue is swept once per
+	 * CHANFIX_EXPIRE_INTERVAL, so no single run blocks for long.
+	 */
+	count = MOWGLI_LIST_LENGTH(chanfix_expire_queue) * CHANFIX_EXPIRE_SLICE / CHANFIX_EXPIRE_INTERVAL + 1;
 
-		MOWGLI_ITER_FOREACH_SAFE(n, tn, chan->oprecords.head)
-		{
-			struct chanfix_oprecord *orec = n->data;
+	while (count-- > 0 && chanfix_expire_queue->head != NULL)
+	{
+		struct chanfix_channel *chan = chanfix_expire_queue->head->data;
 
-			/* Simple exponential decay, rounding the decay up
-			 * so that low scores expire sooner.
-			 */
-			orec->age -= (orec->age + CHANFIX_EXPIRE_DIVISOR - 1) /
-				CHANFIX_EXPIRE_DIVISOR;
+		mowgli_node_delete(&chan->node, chanfix_expire_queue);
+		mowgli_node_add(chan, &chan->node, chanfix_expire_queue);
 
-			if (orec->age > 0 && CURRTIME - orec->lastevent < CHANFIX_RETENTION_TIME)
-				continue;
+		/* Pick up any ops we were not told about (such as those
+		 * given by services, or ops in a channel that has just been
+		 * dropped) before crediting anything.
+		 */
+		if (chan->chan != NULL)
+			chanfix_gather_channel(chan->chan);
 
-			chanfix_oprecord_delete(orec);
-		}
+		chanfix_channel_refresh(chan);
 
 		if (MOWGLI_LIST_LENGTH(&chan->oprecords) > 0 &&
 				CURRTIME - chan->lastupdate < CHANFIX_RETENTION_TIME)
@@ -285,6 +483,8 @@ write_chanfixdb(struct database_handle *db)
 	{
 		mowgli_node_t *n;
 
+		chanfix_channel_refresh(chan);
+
 		db_start_row(db, "CFCHAN");
 		db_write_word(db, chan->name);
 		db_write_time(db, chan->ts);
@@ -382,6 +582,7 @@ db_h_cfop(struct database_handle *db, const char *type)
 
 	orec->firstseen = firstseen;
 	orec->lastevent = lastevent;
+	orec->lastdecay = CURRTIME;
 
 	orec->age = age;
 }
@@ -403,31 +604,45 @@ db_h_cfmd(struct database_handle *db, const char *type)
 void
 chanfix_gather_init(struct chanfix_persist_record *rec)
 {
+	struct channel *ch;
+	mowgli_patricia_iteration_state_t state;
+
 	hook_add_db_write(write_chanfixdb);
 	hook_add_channel_add(chanfix_channel_add_ev);
 	hook_add_channel_delete(chanfix_channel_delete_ev);
+	hook_add_channel_join(chanfix_join_ev);
+	hook_add_channel_part(chanfix_part_ev);
+	hook_add_channel_status_change(chanfix_status_change_ev);
+	hook_add_channel_tschange(chanfix_tschange_ev);
 
 	db_register_type_handler("CFDBV", db_h_cfdbv);
 	db_register_type_handler("CFCHAN", db_h_cfchan);
 	db_register_type_handler("CFOP", db_h_cfop);
 	db_register_type_handler("CFMD", db_h_cfmd);
 
+	chanfix_expire_timer = mowgli_timer_add(base_eventloop, "chanfix_expire", chanfix_expire, NULL, CHANFIX_EXPIRE_SLICE);
+
 	if (rec != NULL)
 	{
 		chanfix_channel_heap = rec->chanfix_channel_heap;
 		chanfix_oprecord_heap = rec->chanfix_oprecord_heap;
+		chanfix_opstate_heap = rec->chanfix_opstate_heap;
 
 		chanfix_channels = rec->chanfix_channels;
+		chanfix_expire_queue = rec->chanfix_expire_queue;
 		return;
 	}
 
 	chanfix_channel_heap = mowgli_heap_create(sizeof(struct chanfix_channel), 32, BH_LAZY);
 	chanfix_oprecord_heap = mowgli_heap_create(sizeof(struct chanfix_oprecord), 32, BH_LAZY);
+	chanfix_opstate_heap = mowgli_heap_create(sizeof(struct chanfix_opstate), 32, BH_LAZY);
 
 	chanfix_channels = mowgli_patricia_create(strcasecanon);
+	chanfix_expire_queue = mowgli_list_create();
 
-	chanfix_expire_timer = mowgli_timer_add(base_eventloop, "chanfix_expire", chanfix_expire, NULL, CHANFIX_EXPIRE_INTERVAL);
-	chanfix_gather_timer = mowgli_timer_add(base_eventloop, "chanfix_gather", chanfix_gather, NULL, CHANFIX_GATHER_INTERVAL);
+	// start tracking whoever is already opped
+	MOWGLI_PATRICIA_FOREACH(ch, &state, chanlist)
+		chanfix_gather_channel(ch);
 }
 
 void
@@ -436,28 +651,35 @@ chanfix_gather_deinit(const enum module_unload_intent intent, struct chanfix_per
 	hook_del_db_write(write_chanfixdb);
 	hook_del_channel_add(chanfix_channel_add_ev);
 	hook_del_channel_delete(chanfix_channel_delete_ev);
+	hook_del_channel_join(chanfix_join_ev);
+	hook_del_channel_part(chanfix_part_ev);
+	hook_del_channel_status_change(chanfix_status_change_ev);
+	hook_del_channel_tschange(chanfix_tschange_ev);
 
 	db_unregister_type_handler("CFDBV");
 	db_unregister_type_handler("CFCHAN");
 	db_unregister_type_handler("CFOP");
 
 	mowgli_timer_destroy(base_eventloop, chanfix_expire_timer);
-	mowgli_timer_destroy(base_eventloop, chanfix_gather_timer);
 
 	switch (intent)
 	{
 		case MODULE_UNLOAD_INTENT_RELOAD:
 			rec->chanfix_channel_heap = chanfix_channel_heap;
 			rec->chanfix_oprecord_heap = chanfix_oprecord_heap;
+			rec->chanfix_opstate_heap = chanfix_opstate_heap;
 
 			rec->chanfix_channels = chanfix_channels;
+			rec->chanfix_expire_queue = chanfix_expire_queue;
 			break;
 
 		case MODULE_UNLOAD_INTENT_PERM:
 			mowgli_patricia_destroy(chanfix_channels, NULL, NULL);
+			mowgli_list_free(chanfix_expire_queue);
 
 			mowgli_heap_destroy(chanfix_channel_heap);
 			mowgli_heap_destroy(chanfix_oprecord_heap);
+			mowgli_heap_destroy(chanfix_opstate_heap);
 			break;
 	}
 }
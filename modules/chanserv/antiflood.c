@@ -53,8 +53,8 @@ static struct chanban *(*place_quietmask)(struct channel *, int, const char *) =
 
 static enum antiflood_enforce_method antiflood_enforce_method = ANTIFLOOD_ENFORCE_QUIET;
 
-static mowgli_heap_t *msg_heap = NULL;
-static mowgli_heap_t *mqueue_heap = NULL;
+static struct sharedheap *msg_heap = NULL;
+static struct sharedheap *mqueue_heap = NULL;
 static mowgli_patricia_t *mqueue_trie = NULL;
 static mowgli_patricia_t **cs_set_cmdtree = NULL;
 static mowgli_eventloop_timer_t *mqueue_gc_timer = NULL;
@@ -70,7 +70,7 @@ msg_destroy(struct flood_message *mesg, struct flood_message_queue *mq)
 	strshare_unref(mesg->source);
 	mowgli_node_delete(&mesg->node, &mq->entries);
 
-	mowgli_heap_free(msg_heap, mesg);
+	sharedheap_free(msg_heap, mesg);
 }
 
 static struct flood_message *
@@ -78,7 +78,7 @@ msg_create(struct flood_message_queue *mq, struct user *u, const char *message)
 {
 	struct flood_message *mesg;
 
-	mesg = mowgli_heap_alloc(msg_heap);
+	mesg = sharedheap_alloc(msg_heap);
 	mesg->message = sstrdup(message);
 	mesg->time = CURRTIME;
 	mesg->source = u->uid != NULL ? strshare_ref(u->uid) : strshare_ref(u->nick);
@@ -100,7 +100,7 @@ mqueue_create(const char *name)
 {
 	struct flood_message_queue *mq;
 
-	mq = mowgli_heap_alloc(mqueue_heap);
+	mq = sharedheap_alloc(mqueue_heap);
 	mq->name = sstrdup(name);
 	mq->last_used = CURRTIME;
 	mq->max = antiflood_msg_count;
@@ -123,7 +123,7 @@ mqueue_free(struct flood_message_queue *mq)
 	}
 
 	sfree(mq->name);
-	mowgli_heap_free(mqueue_heap, mq);
+	sharedheap_free(mqueue_heap, mq);
 }
 
 static struct flood_message_queue *
@@ -409,6 +409,7 @@ cs_set_cmd_antiflood(struct sourceinfo *si, int parc, char *parv[])
 
 	if (!strcasecmp(parv[1], "OFF"))
 	{
+		db_modifying(mc);
 		mc->flags &= ~MC_ANTIFLOOD;
 		metadata_delete(mc, METADATA_KEY_ENFORCE_METHOD);
 
@@ -423,6 +424,7 @@ cs_set_cmd_antiflood(struct sourceinfo *si, int parc, char *parv[])
 			command_fail(si, fault_nochange, _("The \2%s\2 flag is already set for channel \2%s\2."), "ANTIFLOOD", mc->name);
 			return;
 		}
+		db_modifying(mc);
 		mc->flags |= MC_ANTIFLOOD;
 		metadata_delete(mc, METADATA_KEY_ENFORCE_METHOD);
 
@@ -432,6 +434,7 @@ cs_set_cmd_antiflood(struct sourceinfo *si, int parc, char *parv[])
 	}
 	else if (!strcasecmp(parv[1], "QUIET"))
 	{
+		db_modifying(mc);
 		mc->flags |= MC_ANTIFLOOD;
 		metadata_add(mc, METADATA_KEY_ENFORCE_METHOD, "QUIET");
 
@@ -441,6 +444,7 @@ cs_set_cmd_antiflood(struct sourceinfo *si, int parc, char *parv[])
 	}
 	else if (!strcasecmp(parv[1], "KICKBAN"))
 	{
+		db_modifying(mc);
 		mc->flags |= MC_ANTIFLOOD;
 		metadata_add(mc, METADATA_KEY_ENFORCE_METHOD, "KICKBAN");
 
@@ -452,6 +456,7 @@ cs_set_cmd_antiflood(struct sourceinfo *si, int parc, char *parv[])
 	{
 		if (has_priv(si, PRIV_AKILL))
 		{
+			db_modifying(mc);
 			mc->flags |= MC_ANTIFLOOD;
 			metadata_add(mc, METADATA_KEY_ENFORCE_METHOD, "AKILL");
 
@@ -513,9 +518,9 @@ mod_init(struct module *m)
 	hook_add_channel_message(on_channel_message);
 	hook_add_channel_drop(on_channel_drop);
 
-	msg_heap = sharedheap_get(sizeof(struct flood_message));
+	msg_heap = sharedheap_get("flood_message", sizeof(struct flood_message));
 
-	mqueue_heap = sharedheap_get(sizeof(struct flood_message_queue));
+	mqueue_heap = sharedheap_get("flood_message_queue", sizeof(struct flood_message_queue));
 	mqueue_trie = mowgli_patricia_create(irccasecanon);
 	mqueue_gc_timer = mowgli_timer_add(base_eventloop, "mqueue_gc", mqueue_gc, NULL, 5 * SECONDS_PER_MINUTE);
 
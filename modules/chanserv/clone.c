@@ -122,6 +122,7 @@ cs_cmd_clone(struct sourceinfo *si, int parc, char *parv[])
 	}
 
 	// Copy channel flags
+	db_modifying(mc2);
 	mc2->flags = mc->flags;
 
 	// Remove HOLD flag if it exists --shaynejellesma
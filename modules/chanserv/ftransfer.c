@@ -68,6 +68,7 @@ cs_cmd_ftransfer(struct sourceinfo *si, int parc, char *parv[])
 		if (ca->entity != NULL && ca->level & CA_FOUNDER)
 			chanacs_modify_simple(ca, CA_FLAGS, CA_FOUNDER, si->smu);
 	}
+	db_modifying(mc);
 	mc->used = CURRTIME;
 	chanacs_change_simple(mc, mt, NULL, CA_FOUNDER_0, 0, entity(si->smu));
 
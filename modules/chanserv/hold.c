@@ -43,6 +43,7 @@ cs_cmd_hold(struct sourceinfo *si, int parc, char *parv[])
 			return;
 		}
 
+		db_modifying(mc);
 		mc->flags |= MC_HOLD;
 
 		wallops("%s set the HOLD option for the channel \2%s\2.", get_oper_name(si), target);
@@ -57,6 +58,7 @@ cs_cmd_hold(struct sourceinfo *si, int parc, char *parv[])
 			return;
 		}
 
+		db_modifying(mc);
 		mc->flags &= ~MC_HOLD;
 
 		wallops("%s removed the HOLD option on the channel \2%s\2.", get_oper_name(si), target);
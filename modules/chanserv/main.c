@@ -446,7 +446,10 @@ cs_join(struct hook_channel_joinpart *hdata)
 	}
 
 	if (flags & CA_USEDUPDATE)
+	{
+		db_modifying(mc);
 		mc->used = CURRTIME;
+	}
 }
 
 static void
@@ -465,8 +468,13 @@ cs_part(struct hook_channel_joinpart *hdata)
 		return;
 
 	if ((CURRTIME - mc->used) >= SECONDS_PER_HOUR)
+	{
 		if (chanacs_user_flags(mc, cu->user) & CA_USEDUPDATE)
+		{
+			db_modifying(mc);
 			mc->used = CURRTIME;
+		}
+	}
 
 	/*
 	 * When channel_part is fired, we haven't yet removed the
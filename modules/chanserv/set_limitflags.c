@@ -46,6 +46,7 @@ cs_cmd_set_limitflags(struct sourceinfo *si, int parc, char *parv[])
 		logcommand(si, CMDLOG_SET, "SET:LIMITFLAGS:ON: \2%s\2", mc->name);
 		verbose(mc, "\2%s\2 enabled the LIMITFLAGS flag", get_source_name(si));
 
+		db_modifying(mc);
 		mc->flags |= MC_LIMITFLAGS;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been set for \2%s\2."), "LIMITFLAGS", mc->name);
@@ -64,6 +65,7 @@ cs_cmd_set_limitflags(struct sourceinfo *si, int parc, char *parv[])
 		logcommand(si, CMDLOG_SET, "SET:LIMITFLAGS:OFF: \2%s\2", mc->name);
 		verbose(mc, "\2%s\2 disabled the LIMITFLAGS flag", get_source_name(si));
 
+		db_modifying(mc);
 		mc->flags &= ~MC_LIMITFLAGS;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been removed for \2%s\2."), "LIMITFLAGS", mc->name);
@@ -206,6 +206,7 @@ cs_cmd_set_mlock(struct sourceinfo *si, int parc, char *parv[])
 	}
 
 	// save it to mychan, leave the modes in mask unchanged -- jilles
+	db_modifying(mc);
 	mc->mlock_on = (newlock_on & ~mask) | (mc->mlock_on & mask);
 	mc->mlock_off = (newlock_off & ~mask) | (mc->mlock_off & mask);
 
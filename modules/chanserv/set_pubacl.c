@@ -46,6 +46,7 @@ cs_cmd_set_pubacl(struct sourceinfo *si, int parc, char *parv[])
 		logcommand(si, CMDLOG_SET, "SET:PUBACL:ON: \2%s\2", mc->name);
 		verbose(mc, "\2%s\2 enabled the PUBACL flag", get_source_name(si));
 
+ 		db_modifying(mc);
  		mc->flags |= MC_PUBACL;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been set for channel \2%s\2."), "PUBACL", mc->name);
@@ -62,6 +63,7 @@ cs_cmd_set_pubacl(struct sourceinfo *si, int parc, char *parv[])
 		logcommand(si, CMDLOG_SET, "SET:PUBACL:OFF: \2%s\2", mc->name);
 		verbose(mc, "\2%s\2 disabled the PUBACL flag", get_source_name(si));
 
+		db_modifying(mc);
 		mc->flags &= ~MC_PUBACL;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been removed for channel \2%s\2."), "PUBACL", mc->name);
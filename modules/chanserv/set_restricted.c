@@ -92,6 +92,7 @@ cs_cmd_set_restricted(struct sourceinfo *si, int parc, char *parv[])
 		logcommand(si, CMDLOG_SET, "SET:RESTRICTED:ON: \2%s\2", mc->name);
 		verbose(mc, "\2%s\2 enabled the RESTRICTED flag", get_source_name(si));
 
+		db_modifying(mc);
 		mc->flags |= MC_RESTRICTED;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been set for channel \2%s\2."), "RESTRICTED", mc->name);
@@ -108,6 +109,7 @@ cs_cmd_set_restricted(struct sourceinfo *si, int parc, char *parv[])
 		logcommand(si, CMDLOG_SET, "SET:RESTRICTED:OFF: \2%s\2", mc->name);
 		verbose(mc, "\2%s\2 disabled the RESTRICTED flag", get_source_name(si));
 
+		db_modifying(mc);
 		mc->flags &= ~MC_RESTRICTED;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been removed for channel \2%s\2."), "RESTRICTED", mc->name);
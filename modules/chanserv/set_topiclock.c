@@ -46,6 +46,7 @@ cs_cmd_set_topiclock(struct sourceinfo *si, int parc, char *parv[])
 		logcommand(si, CMDLOG_SET, "SET:TOPICLOCK:ON: \2%s\2", mc->name);
 		verbose(mc, "\2%s\2 enabled the TOPICLOCK flag", get_source_name(si));
 
+		db_modifying(mc);
 		mc->flags |= MC_KEEPTOPIC | MC_TOPICLOCK;
 		topiclock_sts(mc->chan);
 
@@ -64,6 +65,7 @@ cs_cmd_set_topiclock(struct sourceinfo *si, int parc, char *parv[])
 		logcommand(si, CMDLOG_SET, "SET:TOPICLOCK:OFF: \2%s\2", mc->name);
 		verbose(mc, "\2%s\2 disabled the TOPICLOCK flag", get_source_name(si));
 
+		db_modifying(mc);
 		mc->flags &= ~MC_TOPICLOCK;
 		topiclock_sts(mc->chan);
 
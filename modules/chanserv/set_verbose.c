@@ -44,6 +44,7 @@ cs_cmd_set_verbose(struct sourceinfo *si, int parc, char *parv[])
 		}
 
 		logcommand(si, CMDLOG_SET, "SET:VERBOSE:ON: \2%s\2", mc->name);
+		db_modifying(mc);
 
  		mc->flags &= ~MC_VERBOSE_OPS;
  		mc->flags |= MC_VERBOSE;
@@ -62,6 +63,7 @@ cs_cmd_set_verbose(struct sourceinfo *si, int parc, char *parv[])
 		}
 
 		logcommand(si, CMDLOG_SET, "SET:VERBOSE:OPS: \2%s\2", mc->name);
+		db_modifying(mc);
 
 		if (mc->flags & MC_VERBOSE)
 		{
@@ -87,6 +89,7 @@ cs_cmd_set_verbose(struct sourceinfo *si, int parc, char *parv[])
 		}
 
 		logcommand(si, CMDLOG_SET, "SET:VERBOSE:OFF: \2%s\2", mc->name);
+		db_modifying(mc);
 
 		if (mc->flags & MC_VERBOSE)
 			verbose(mc, "\2%s\2 disabled the VERBOSE flag", get_source_name(si));
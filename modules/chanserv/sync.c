@@ -202,6 +202,7 @@ cs_cmd_set_nosync(struct sourceinfo *si, int parc, char *parv[])
 
 		logcommand(si, CMDLOG_SET, "SET:NOSYNC:ON: \2%s\2", mc->name);
 
+		db_modifying(mc);
 		mc->flags |= MC_NOSYNC;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been set for channel \2%s\2."), "NOSYNC", mc->name);
@@ -217,6 +218,7 @@ cs_cmd_set_nosync(struct sourceinfo *si, int parc, char *parv[])
 
 		logcommand(si, CMDLOG_SET, "SET:NOSYNC:OFF: \2%s\2", mc->name);
 
+		db_modifying(mc);
 		mc->flags &= ~MC_NOSYNC;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been removed for channel \2%s\2."), "NOSYNC", mc->name);
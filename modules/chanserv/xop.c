@@ -173,6 +173,7 @@ cs_xop_do_del(struct sourceinfo *si, struct mychan *mc, struct myentity *mt, cha
 		req.ca = ca;
 		req.oldlevel = ca->level;
 
+		db_modifying(mc);
 		ca->level = 0;
 
 		req.newlevel = ca->level;
@@ -195,6 +196,7 @@ cs_xop_do_del(struct sourceinfo *si, struct mychan *mc, struct myentity *mt, cha
 	req.ca = ca;
 	req.oldlevel = ca->level;
 
+	db_modifying(mc);
 	ca->level = 0;
 
 	req.newlevel = ca->level;
@@ -66,7 +66,7 @@ gs_cmd_fflags(struct sourceinfo *si, int parc, char *parv[])
 	}
 
 	if (ga != NULL && flags != 0)
-		ga->flags = flags;
+		groupacs_modify(ga, flags);
 	else if (ga != NULL)
 	{
 		groupacs_delete(mg, mt);
@@ -100,7 +100,7 @@ gs_cmd_flags(struct sourceinfo *si, int parc, char *parv[])
 		return;
 	}
 
-	if (isuser(mt) && (MU_NEVERGROUP & user(mt)->flags) && (groupacs_find(mg, mt, 0, true) == NULL))
+	if (isuser(mt) && (MU_NEVERGROUP & user(mt)->flags) && !groupacs_has_member(mg, mt, 0))
 	{
 		command_fail(si, fault_noprivs, _("\2%s\2 does not wish to have flags in any groups."), parv[1]);
 		return;
@@ -158,7 +158,7 @@ no_founder:
 	if (ga != NULL && flags != 0)
 	{
 		if (ga->flags != flags)
-			ga->flags = flags;
+			groupacs_modify(ga, flags);
 		else
 		{
 			command_fail(si, fault_nochange, _("Group \2%s\2 access for \2%s\2 unchanged."), entity(mg)->name, mt->name);
@@ -27,6 +27,8 @@ unsigned int (*myentity_count_group_flag)(struct myentity *mu, unsigned int flag
 struct groupacs * (*groupacs_add)(struct mygroup *mg, struct myentity *mt, unsigned int flags);
 struct groupacs * (*groupacs_find)(struct mygroup *mg, struct myentity *mt, unsigned int flags, bool allow_recurse);
 void (*groupacs_delete)(struct mygroup *mg, struct myentity *mt);
+void (*groupacs_modify)(struct groupacs *ga, unsigned int flags);
+bool (*groupacs_has_member)(struct mygroup *mg, struct myentity *mt, unsigned int flags);
 
 bool (*groupacs_sourceinfo_has_flag)(struct mygroup *mg, struct sourceinfo *si, unsigned int flag);
 unsigned int (*groupacs_sourceinfo_flags)(struct mygroup *mg, struct sourceinfo *si);
@@ -48,6 +50,8 @@ static inline void use_groupserv_main_symbols(struct module *m)
     MODULE_TRY_REQUEST_SYMBOL(m, groupacs_add, "groupserv/main", "groupacs_add");
     MODULE_TRY_REQUEST_SYMBOL(m, groupacs_find, "groupserv/main", "groupacs_find");
     MODULE_TRY_REQUEST_SYMBOL(m, groupacs_delete, "groupserv/main", "groupacs_delete");
+    MODULE_TRY_REQUEST_SYMBOL(m, groupacs_modify, "groupserv/main", "groupacs_modify");
+    MODULE_TRY_REQUEST_SYMBOL(m, groupacs_has_member, "groupserv/main", "groupacs_has_member");
     MODULE_TRY_REQUEST_SYMBOL(m, groupacs_sourceinfo_has_flag, "groupserv/main", "groupacs_sourceinfo_has_flag");
     MODULE_TRY_REQUEST_SYMBOL(m, groupacs_sourceinfo_flags, "groupserv/main", "groupacs_sourceinfo_flags");
 
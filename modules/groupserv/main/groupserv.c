@@ -28,13 +28,123 @@ mygroups_deinit(void)
 	mowgli_heap_destroy(groupacs_heap);
 }
 
+/*
+ * Marks the transitive membership set of a group, and of every group that
+ * contains it (directly or through other groups), as needing to be rebuilt.
+ */
+static void
+mygroup_members_invalidate(struct mygroup *mg)
+{
+	mowgli_node_t *n;
+
+	if (mg->visited)
+		return;
+
+	mg->visited = true;
+	mg->members_stale = true;
+
+	MOWGLI_ITER_FOREACH(n, myentity_get_membership_list(entity(mg))->head)
+	{
+		struct groupacs *ga = n->data;
+
+		mygroup_members_invalidate(ga->mg);
+	}
+
+	mg->visited = false;
+}
+
+static void
+mygroup_members_collect(struct mygroup *root, struct mygroup *mg)
+{
+	mowgli_node_t *n;
+
+	mg->visited = true;
+
+	MOWGLI_ITER_FOREACH(n, mg->acs.head)
+	{
+		struct groupacs *ga = n->data;
+
+		// a cycle back to the group being rebuilt does not make it its own member
+		if (ga->mt == entity(root))
+			continue;
+
+		if (isgroup(ga->mt) && !(group(ga->mt)->visited))
+			mygroup_members_collect(root, group(ga->mt));
+		else
+		{
+			/* The flags are stored directly in the value pointer, rather than in
+			 * a separate allocation for every member of every group. Membership
+			 * is the presence of the element, since a member may have no flags.
+			 */
+			mowgli_patricia_elem_t *elem = mowgli_patricia_elem_find(root->members, ga->mt->id);
+
+			if (elem != NULL)
+				mowgli_patricia_elem_set_data(elem, (void *) ((uintptr_t) mowgli_patricia_elem_get_data(elem) | ga->flags));
+			else
+				mowgli_patricia_add(root->members, ga->mt->id, (void *) ((uintptr_t) ga->flags));
+		}
+	}
+
+	mg->visited = false;
+}
+
+static void
+mygroup_members_rebuild(struct mygroup *mg)
+{
+	if (mg->members != NULL)
+		mowgli_patricia_destroy(mg->members, NULL, NULL);
+
+	mg->members = mowgli_patricia_create(noopcanon);
+	mygroup_members_collect(mg, mg);
+	mg->members_stale = false;
+}
+
+/*
+ * Returns whether an entity is a member of a group, either directly or through
+ * any of the groups that are members of it, with any of the given flags (or
+ * with any flags at all, if none are given).
+ *
+ * This gives the same answer as groupacs_find() with allow_recurse set, but
+ * only walks the nested groups when their membership has changed.
+ */
+bool
+groupacs_has_member(struct mygroup *mg, struct myentity *mt, unsigned int flags)
+{
+	mowgli_patricia_elem_t *elem;
+
+	return_val_if_fail(mg != NULL, false);
+	return_val_if_fail(mt != NULL, false);
+
+	if (mg->members == NULL || mg->members_stale)
+		mygroup_members_rebuild(mg);
+
+	if ((elem = mowgli_patricia_elem_find(mg->members, mt->id)) == NULL)
+		return false;
+
+	if (flags)
+		return ((uintptr_t) mowgli_patricia_elem_get_data(elem) & flags) != 0;
+
+	return true;
+}
+
 static void
 mygroup_delete(struct mygroup *mg)
 {
 	mowgli_node_t *n, *tn;
+	mowgli_list_t *l;
 
 	myentity_del(entity(mg));
 
+	// remove the group from any groups it is a member of, so they do not keep a dangling entry
+	l = myentity_get_membership_list(entity(mg));
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, l->head)
+	{
+		struct groupacs *ga = n->data;
+
+		groupacs_delete(ga->mg, ga->mt);
+	}
+
 	MOWGLI_ITER_FOREACH_SAFE(n, tn, mg->acs.head)
 	{
 		struct groupacs *ga = n->data;
@@ -44,6 +154,12 @@ mygroup_delete(struct mygroup *mg)
 		atheme_object_unref(ga);
 	}
 
+	privatedata_delete(mg, "groupserv:membership");
+	mowgli_list_free(l);
+
+	if (mg->members != NULL)
+		mowgli_patricia_destroy(mg->members, NULL, NULL);
+
 	metadata_delete_all(mg);
 	strshare_unref(entity(mg)->name);
 	mowgli_heap_free(mygroup_heap, mg);
@@ -81,6 +197,8 @@ mygroup_add_id(const char *id, const char *name)
 	mygroup_set_entity_vtable(entity(mg));
 
 	mg->regtime = CURRTIME;
+	mg->members = NULL;
+	mg->members_stale = true;
 
 	return mg;
 }
@@ -124,9 +242,24 @@ groupacs_add(struct mygroup *mg, struct myentity *mt, unsigned int flags)
 	mowgli_node_add(ga, &ga->gnode, &mg->acs);
 	mowgli_node_add(ga, &ga->unode, myentity_get_membership_list(mt));
 
+	mygroup_members_invalidate(mg);
+
 	return ga;
 }
 
+void
+groupacs_modify(struct groupacs *ga, unsigned int flags)
+{
+	return_if_fail(ga != NULL);
+
+	if (ga->flags == flags)
+		return;
+
+	ga->flags = flags;
+
+	mygroup_members_invalidate(ga->mg);
+}
+
 struct groupacs *
 groupacs_find(struct mygroup *mg, struct myentity *mt, unsigned int flags, bool allow_recurse)
 {
@@ -182,13 +315,15 @@ groupacs_delete(struct mygroup *mg, struct myentity *mt)
 		mowgli_node_delete(&ga->gnode, &mg->acs);
 		mowgli_node_delete(&ga->unode, myentity_get_membership_list(mt));
 		atheme_object_unref(ga);
+
+		mygroup_members_invalidate(mg);
 	}
 }
 
 bool
 groupacs_sourceinfo_has_flag(struct mygroup *mg, struct sourceinfo *si, unsigned int flag)
 {
-	return groupacs_find(mg, entity(si->smu), flag, true) != NULL;
+	return groupacs_has_member(mg, entity(si->smu), flag);
 }
 
 unsigned int
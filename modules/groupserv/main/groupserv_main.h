@@ -24,6 +24,8 @@ struct mygroup *mygroup_find(const char *name);
 struct groupacs *groupacs_add(struct mygroup *mg, struct myentity *mt, unsigned int flags);
 struct groupacs *groupacs_find(struct mygroup *mg, struct myentity *mt, unsigned int flags, bool allow_recurse);
 void groupacs_delete(struct mygroup *mg, struct myentity *mt);
+void groupacs_modify(struct groupacs *ga, unsigned int flags);
+bool groupacs_has_member(struct mygroup *mg, struct myentity *mt, unsigned int flags);
 
 bool groupacs_sourceinfo_has_flag(struct mygroup *mg, struct sourceinfo *si, unsigned int flag);
 unsigned int groupacs_sourceinfo_flags(struct mygroup *mg, struct sourceinfo *si);
@@ -22,7 +22,7 @@ mygroup_match_entity(struct myentity *self, struct myentity *mt)
 	if (!isuser(mt))
 		return false;
 
-	return groupacs_find(mg, mt, GA_CHANACS, true) != NULL;
+	return groupacs_has_member(mg, mt, GA_CHANACS);
 }
 
 static bool
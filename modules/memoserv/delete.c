@@ -84,6 +84,7 @@ ms_cmd_delete(struct sourceinfo *si, int parc, char *parv[])
 				si->smu->memoct_new--;
 
 			// Free to node pool, remove from chain
+			db_modifying(si->smu);
 			mowgli_node_delete(n, &si->smu->memos);
 			mowgli_node_free(n);
 
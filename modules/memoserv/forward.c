@@ -139,6 +139,7 @@ ms_cmd_forward(struct sourceinfo *si, int parc, char *parv[])
 
 			// Create node, add to their linked list of memos
 			temp = mowgli_node_create();
+			db_modifying(tmu);
 			mowgli_node_add(newmemo, temp, &tmu->memos);
 			tmu->memoct_new++;
 
@@ -79,6 +79,7 @@ ms_cmd_ignore_add(struct sourceinfo *si, int parc, char *parv[])
 
 	// Add to ignore list
 	temp = sstrdup(newnick);
+	db_modifying(si->smu);
 	mowgli_node_add(temp, mowgli_node_create(), &si->smu->memo_ignores);
 	logcommand(si, CMDLOG_SET, "IGNORE:ADD: \2%s\2", newnick);
 	command_success_nodata(si, _("Account \2%s\2 added to your ignore list."), newnick);
@@ -109,6 +110,7 @@ ms_cmd_ignore_del(struct sourceinfo *si, int parc, char *parv[])
 		{
 			logcommand(si, CMDLOG_SET, "IGNORE:DEL: \2%s\2", temp);
 			command_success_nodata(si, _("Account \2%s\2 removed from ignore list."), temp);
+			db_modifying(si->smu);
 			mowgli_node_delete(n, &si->smu->memo_ignores);
 			mowgli_node_free(n);
 			sfree(temp);
@@ -132,6 +134,8 @@ ms_cmd_ignore_clear(struct sourceinfo *si, int parc, char *parv[])
 		return;
 	}
 
+	db_modifying(si->smu);
+
 	MOWGLI_ITER_FOREACH_SAFE(n, tn, si->smu->memo_ignores.head)
 	{
 		sfree(n->data);
@@ -67,6 +67,7 @@ ms_cmd_read(struct sourceinfo *si, int parc, char *parv[])
 
 			if (!(memo->status & MEMO_READ))
 			{
+				db_modifying(si->smu);
 				memo->status |= MEMO_READ;
 				si->smu->memoct_new--;
 				tmu = myuser_find(memo->sender);
@@ -90,6 +91,7 @@ ms_cmd_read(struct sourceinfo *si, int parc, char *parv[])
 
 						// Attach to their linked list
 						n = mowgli_node_create();
+						db_modifying(tmu);
 						mowgli_node_add(receipt, n, &tmu->memos);
 						tmu->memoct_new++;
 					}
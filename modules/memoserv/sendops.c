@@ -138,6 +138,7 @@ ms_cmd_sendops(struct sourceinfo *si, int parc, char *parv[])
 
 		// Create a linked list node and add to memos
 		n = mowgli_node_create();
+		db_modifying(tmu);
 		mowgli_node_add(memo, n, &tmu->memos);
 		tmu->memoct_new++;
 
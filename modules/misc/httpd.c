@@ -9,7 +9,14 @@
 
 #include <atheme.h>
 
-#define REQUEST_MAX 65536 // maximum size of one call
+#ifdef __linux__
+#  include <sys/sendfile.h>
+#endif
+
+#define REQUEST_MAX     65536           // maximum size of one call
+#define HEADERS_MAX     8192            // maximum size of the headers of one request
+#define SENDQ_PAUSE     (64 * 1024)     // stop reading requests while this much is queued
+#define SENDFILE_CHUNK  (256 * 1024)    // maximum to hand to sendfile(2) at a time
 
 static struct connection *listener = NULL;
 static mowgli_eventloop_timer_t *httpd_checkidle_timer = NULL;
@@ -23,15 +30,69 @@ static struct {
 	unsigned int port;
 } httpd_config;
 
-// Imported by modules/transport/*rpc/*rpc.so */
-extern mowgli_list_t httpd_path_handlers;
-mowgli_list_t httpd_path_handlers;
+/* Handlers are registered by other modules through httpd_path_handler_add(),
+ * and found by path through httpd_path_index, which is rebuilt from this
+ * list whenever it changes.
+ */
+static mowgli_list_t httpd_path_handlers;
+static mowgli_patricia_t *httpd_path_index = NULL;
+
+static void httpd_recvqhandler(struct connection *cptr);
+
+static void
+httpd_path_index_rebuild(void)
+{
+	mowgli_node_t *n;
+
+	if (httpd_path_index != NULL)
+		mowgli_patricia_destroy(httpd_path_index, NULL, NULL);
+
+	httpd_path_index = mowgli_patricia_create(NULL);
+
+	MOWGLI_ITER_FOREACH(n, httpd_path_handlers.head)
+	{
+		struct path_handler *ph = n->data;
+
+		if (ph->path == NULL)
+			continue;
+
+		if (!mowgli_patricia_add(httpd_path_index, ph->path, ph))
+			slog(LG_ERROR, "httpd_path_index_rebuild(): more than one handler for %s", ph->path);
+	}
+}
+
+// Imported by the RPC transports and misc/metrics; call it again after changing ph->path
+extern void httpd_path_handler_add(struct path_handler *ph);
+void
+httpd_path_handler_add(struct path_handler *ph)
+{
+	if (!mowgli_node_find(ph, &httpd_path_handlers))
+		mowgli_node_add(ph, mowgli_node_create(), &httpd_path_handlers);
+
+	httpd_path_index_rebuild();
+}
+
+extern void httpd_path_handler_del(struct path_handler *ph);
+void
+httpd_path_handler_del(struct path_handler *ph)
+{
+	mowgli_node_t *n;
+
+	if ((n = mowgli_node_find(ph, &httpd_path_handlers)) != NULL)
+	{
+		mowgli_node_delete(n, &httpd_path_handlers);
+		mowgli_node_free(n);
+	}
+
+	httpd_path_index_rebuild();
+}
 
 static void
 clear_httpddata(struct httpddata *hd)
 {
 	hd->method[0] = '\0';
 	hd->filename[0] = '\0';
+	hd->header_bytes = 0;
 	if (hd->requestbuf != NULL)
 	{
 		sfree(hd->requestbuf);
@@ -47,6 +108,20 @@ clear_httpddata(struct httpddata *hd)
 	hd->correct_content_type = false;
 	hd->expect_100_continue = false;
 	hd->sent_reply = false;
+	hd->http10 = false;
+	hd->keep_alive = false;
+}
+
+static void
+close_file(struct httpddata *hd)
+{
+	if (hd->file_fd == -1)
+		return;
+
+	close(hd->file_fd);
+	hd->file_fd = -1;
+	hd->file_offset = 0;
+	hd->file_remaining = 0;
 }
 
 static int
@@ -86,6 +161,10 @@ process_header(struct connection *cptr, char *line)
 				slog(LG_DEBUG, "process_header(): Connection: close requested by fd %d", cptr->fd);
 				hd->connection_close = true;
 			}
+			else if (!strcasecmp(p, "keep-alive") && hd->http10)
+				/* HTTP/1.1 connections are persistent anyway;
+				 * HTTP/1.0 ones only if the client asks */
+				hd->keep_alive = true;
 			p = strtok(NULL, ", \t");
 		}
 	}
@@ -117,7 +196,7 @@ check_close(struct connection *cptr)
 static void
 send_error(struct connection *cptr, unsigned int errorcode, const char *text, bool sendentity)
 {
-	char buf1[300];
+	char buf1[400];
 	char buf2[700];
 
 	if (errorcode < 100 || errorcode > 999)
@@ -133,16 +212,29 @@ send_error(struct connection *cptr, unsigned int errorcode, const char *text, bo
 	         "Server: %s/%s\r\n"
 	         "Content-Type: text/plain\r\n"
 	         "Content-Length: %zu\r\n"
+	         "%s"
 	         "\r\n"
 	         "%s",
 	         errorcode, text,
 	         PACKAGE_TARNAME, PACKAGE_VERSION,
 	         strlen(buf2),
+	         httpd_connection_header(cptr->userdata),
 	         buf2);
 
 	sendq_add(cptr, buf1, strlen(buf1));
 }
 
+// For errors after which the rest of the request cannot be made sense of
+static void
+send_error_close(struct connection *cptr, unsigned int errorcode, const char *text)
+{
+	struct httpddata *hd = cptr->userdata;
+
+	hd->connection_close = true;
+	send_error(cptr, errorcode, text, true);
+	sendq_add_eof(cptr);
+}
+
 static const char *
 content_type(const char *filename)
 {
@@ -168,49 +260,232 @@ content_type(const char *filename)
 	return "application/octet-stream";
 }
 
+/* Like recvq_put() does, hands the receive queue to httpd_recvqhandler()
+ * until it consumes nothing more; used to pick up pipelined requests that
+ * arrived while a reply was being sent.
+ */
 static void
-httpd_recvqhandler(struct connection *cptr)
+httpd_process(struct connection *cptr)
+{
+	int l, ll;
+
+	l = recvq_length(cptr);
+	while (l != 0 && cptr->recvq_handler != NULL)
+	{
+		httpd_recvqhandler(cptr);
+		ll = l;
+		l = recvq_length(cptr);
+		if (ll == l)
+			break;
+	}
+}
+
+/* Write handler while further requests are held back: sends the sendq,
+ * then the file being sent, if any, then goes back to reading requests.
+ * Reading is also turned back on when the connection dies, so that
+ * recvq_put() gets to close it.
+ */
+static void
+httpd_writehandler(struct connection *cptr)
+{
+	struct httpddata *hd = cptr->userdata;
+
+	if (sendq_nonempty(cptr))
+	{
+		sendq_flush(cptr);
+		if (cptr->flags & (CF_DEAD | CF_SEND_DEAD))
+		{
+			connection_setselect_read(cptr, recvq_put);
+			return;
+		}
+		if (sendq_nonempty(cptr))
+		{
+			connection_setselect_write(cptr, httpd_writehandler);
+			return;
+		}
+	}
+
+#ifdef __linux__
+	if (hd->file_fd != -1)
+	{
+		size_t len = hd->file_remaining > SENDFILE_CHUNK ? SENDFILE_CHUNK : (size_t) hd->file_remaining;
+		ssize_t l = sendfile(cptr->fd, hd->file_fd, &hd->file_offset, len);
+
+		if (l == -1 && mowgli_eventloop_ignore_errno(ioerrno()))
+		{
+			connection_setselect_write(cptr, httpd_writehandler);
+			return;
+		}
+		if (l <= 0)
+		{
+			// l == 0 means the file was truncated while we were sending it
+			slog(LG_INFO, "httpd_writehandler(): disconnecting fd %d (%s), sendfile failed: %s", cptr->fd, cptr->hbuf, l == 0 ? "unexpected end of file" : strerror(ioerrno()));
+			close_file(hd);
+			connection_setselect_write(cptr, NULL);
+			connection_setselect_read(cptr, recvq_put);
+			cptr->flags |= CF_DEAD;
+			return;
+		}
+
+		hd->file_remaining -= l;
+		if (hd->file_remaining > 0)
+		{
+			connection_setselect_write(cptr, httpd_writehandler);
+			return;
+		}
+
+		close_file(hd);
+		if (hd->connection_close)
+		{
+			sendq_add_eof(cptr);
+			connection_setselect_read(cptr, recvq_put);
+			return;
+		}
+	}
+#endif
+
+	connection_setselect_write(cptr, NULL);
+	connection_setselect_read(cptr, recvq_put);
+	hd->paused = false;
+	httpd_process(cptr);
+}
+
+/* Called once a request has been answered. If a lot of the reply is still
+ * queued, or it is a file still to be sent, we stop reading from the client
+ * until it has gone out; whatever was already read waits in the receive
+ * queue. That keeps the replies to pipelined requests in order, and a
+ * client cannot make us queue more than one read's worth of requests
+ * behind a reply.
+ */
+static void
+request_done(struct connection *cptr)
+{
+	struct httpddata *hd = cptr->userdata;
+
+	clear_httpddata(hd);
+
+	if (hd->file_fd == -1 && (hd->connection_close || sendq_length(cptr) < SENDQ_PAUSE))
+		return;
+
+	hd->paused = true;
+	connection_setselect_read(cptr, NULL);
+	connection_setselect_write(cptr, httpd_writehandler);
+}
+
+static void
+send_file(struct connection *cptr, bool is_get)
 {
-	char buf[BUFSIZE * 2];
 	char outbuf[BUFSIZE * 2];
-	int count;
 	struct httpddata *hd;
-	char *p;
-	int in;
 	struct stat sb;
-	off_t count1;
-	mowgli_node_t *n;
-	struct path_handler *ph = NULL;
-	bool is_get, is_post, handling_done = false;
+	int in;
 
 	hd = cptr->userdata;
 
-	MOWGLI_ITER_FOREACH(n, httpd_path_handlers.head)
+	in = open_file(hd->filename);
+	if (in == -1 || fstat(in, &sb) == -1 || !S_ISREG(sb.st_mode))
 	{
-		ph = (struct path_handler *)n->data;
-		handling_done = !strcmp(hd->filename, ph->path);
+		if (in != -1)
+			close(in);
+		slog(LG_DEBUG, "httpd_recvqhandler(): 404 for \2%s\2", hd->filename);
+		send_error(cptr, 404, "Not Found", is_get);
+		check_close(cptr);
+		request_done(cptr);
+		return;
+	}
+	slog(LG_INFO, "httpd_recvqhandler(): 200 for %s", hd->filename);
 
-		if (handling_done)
-			break;
+	snprintf(outbuf, sizeof outbuf,
+	         "HTTP/1.1 200 OK\r\n"
+	         "Server: %s/%s\r\n"
+	         "Content-Type: %s\r\n"
+	         "Content-Length: %lu\r\n"
+	         "%s"
+	         "\r\n",
+	         PACKAGE_TARNAME, PACKAGE_VERSION,
+	         content_type(hd->filename),
+	         (unsigned long) sb.st_size,
+	         httpd_connection_header(hd));
+
+	sendq_add(cptr, outbuf, strlen(outbuf));
+
+	if (!is_get || sb.st_size == 0)
+	{
+		close(in);
+		check_close(cptr);
+		request_done(cptr);
+		return;
 	}
 
-	if (handling_done)
+#ifdef __linux__
+	// sent straight from the file by httpd_writehandler(), after the headers
+	hd->file_fd = in;
+	hd->file_offset = 0;
+	hd->file_remaining = sb.st_size;
+	request_done(cptr);
+#else
+	off_t count1 = sb.st_size;
+	while (count1 > 0)
 	{
-		if (hd->requestbuf != NULL)
-		{
-			count = recvq_get(cptr, hd->requestbuf + hd->lengthdone, hd->length - hd->lengthdone);
-			if (count <= 0)
-				return;
-			hd->lengthdone += count;
-			if (hd->lengthdone != hd->length)
-				return;
-			hd->requestbuf[hd->length] = '\0';
+		ssize_t count = sizeof outbuf;
+		if (count > count1)
+			count = count1;
+		count = read(in, outbuf, count);
+		if (count <= 0)
+			break;
+		sendq_add(cptr, outbuf, count);
+		count1 -= count;
+	}
+	close(in);
+	if (count1 > 0)
+	{
+		slog(LG_INFO, "httpd_recvqhandler(): disconnecting fd %d (%s), read failed on %s", cptr->fd, cptr->hbuf, hd->filename);
+		cptr->flags |= CF_DEAD;
+		return;
+	}
+	check_close(cptr);
+	request_done(cptr);
+#endif
+}
 
-			ph->handler(cptr, hd->requestbuf);
+static void
+httpd_recvqhandler(struct connection *cptr)
+{
+	char buf[BUFSIZE * 2];
+	char outbuf[BUFSIZE * 2];
+	int count;
+	struct httpddata *hd;
+	char *p;
+	struct path_handler *ph;
+	bool is_get, is_post;
+
+	hd = cptr->userdata;
+
+	// the reply to the previous request is still being sent
+	if (hd->paused)
+		return;
 
-			clear_httpddata(hd);
+	if (hd->requestbuf != NULL)
+	{
+		count = recvq_get(cptr, hd->requestbuf + hd->lengthdone, hd->length - hd->lengthdone);
+		if (count <= 0)
+			return;
+		hd->lengthdone += count;
+		if (hd->lengthdone != hd->length)
 			return;
+		hd->requestbuf[hd->length] = '\0';
+
+		// looked up again, in case the module went away while the body was arriving
+		if ((ph = mowgli_patricia_retrieve(httpd_path_index, hd->filename)) != NULL)
+			ph->handler(cptr, hd->requestbuf);
+		else
+		{
+			send_error(cptr, 404, "Not Found", true);
+			check_close(cptr);
 		}
+
+		request_done(cptr);
+		return;
 	}
 
 	count = recvq_getline(cptr, buf, sizeof buf - 1);
@@ -219,8 +494,7 @@ httpd_recvqhandler(struct connection *cptr)
 	if (cptr->flags & CF_NONEWLINE)
 	{
 		slog(LG_INFO, "httpd_recvqhandler(): throwing out fd %d (%s) for excessive line length", cptr->fd, cptr->hbuf);
-		send_error(cptr, 400, "Bad request", true);
-		sendq_add_eof(cptr);
+		send_error_close(cptr, 400, "Bad request");
 		return;
 	}
 
@@ -246,8 +520,7 @@ httpd_recvqhandler(struct connection *cptr)
 			return;
 		mowgli_strlcpy(hd->filename, p, sizeof hd->filename);
 		p = strtok(NULL, "");
-		if (p == NULL || !strcmp(p, "HTTP/1.0"))
-			hd->connection_close = true;
+		hd->http10 = p == NULL || !strcmp(p, "HTTP/1.0");
 		slog(LG_DEBUG, "httpd_recvqhandler(): request %s for %s", hd->method, hd->filename);
 	}
 	else if (count == 0)
@@ -257,94 +530,69 @@ httpd_recvqhandler(struct connection *cptr)
 
 		if (!is_post && !is_get)
 		{
-			send_error(cptr, 501, "Method Not Implemented", true);
-			sendq_add_eof(cptr);
+			send_error_close(cptr, 501, "Method Not Implemented");
 			return;
 		}
 
+		if (hd->http10 && !hd->keep_alive)
+			hd->connection_close = true;
+
 		hd->method[0] = '\0';
 
-		if (!handling_done)
+		if ((ph = mowgli_patricia_retrieve(httpd_path_index, hd->filename)) == NULL)
 		{
-			in = open_file(hd->filename);
-			if (in == -1 || fstat(in, &sb) == -1 || !S_ISREG(sb.st_mode))
-			{
-				if (in != -1)
-					close(in);
-				slog(LG_DEBUG, "httpd_recvqhandler(): 404 for \2%s\2", hd->filename);
-				send_error(cptr, 404, "Not Found", is_get);
-				check_close(cptr);
-				return;
-			}
-			slog(LG_INFO, "httpd_recvqhandler(): 200 for %s", hd->filename);
+			// the body of a request for a file is not read, so it must not be taken for the next request
+			if (hd->length > 0)
+				hd->connection_close = true;
+			send_file(cptr, is_get);
+			return;
+		}
+
+		if (is_get && ph->allow_get)
+		{
+			char emptybuf[] = "";
 
+			ph->handler(cptr, emptybuf);
+			request_done(cptr);
+			return;
+		}
+		if (hd->length <= 0)
+		{
+			send_error_close(cptr, 411, "Length Required");
+			return;
+		}
+		if (hd->length > REQUEST_MAX)
+		{
+			send_error_close(cptr, 413, "Request Entity Too Large");
+			return;
+		}
+		if (!hd->correct_content_type)
+		{
+			send_error_close(cptr, 415, "Unsupported Media Type");
+			return;
+		}
+		if (hd->expect_100_continue)
+		{
 			snprintf(outbuf, sizeof outbuf,
-			         "HTTP/1.1 200 OK\r\n"
+			         "HTTP/1.1 100 Continue\r\n"
 			         "Server: %s/%s\r\n"
-			         "Content-Type: %s\r\n"
-			         "Content-Length: %lu\r\n"
 			         "\r\n",
-			         PACKAGE_TARNAME, PACKAGE_VERSION,
-			         content_type(hd->filename),
-			         (unsigned long) sb.st_size);
+			         PACKAGE_TARNAME, PACKAGE_VERSION);
 
 			sendq_add(cptr, outbuf, strlen(outbuf));
-			count1 = is_get ? sb.st_size : 0;
-			while (count1 > 0)
-			{
-				count = sizeof outbuf;
-				if (count > count1)
-					count = count1;
-				count = read(in, outbuf, count);
-				if (count <= 0)
-					break;
-				sendq_add(cptr, outbuf, count);
-				count1 -= count;
-			}
-			close(in);
-			if (count1 > 0)
-			{
-				slog(LG_INFO, "httpd_recvqhandler(): disconnecting fd %d (%s), read failed on %s", cptr->fd, cptr->hbuf, hd->filename);
-				cptr->flags |= CF_DEAD;
-			}
-			else
-				check_close(cptr);
-		}
-		else
-		{
-			if (hd->length <= 0)
-			{
-				send_error(cptr, 411, "Length Required", true);
-				sendq_add_eof(cptr);
-				return;
-			}
-			if (hd->length > REQUEST_MAX)
-			{
-				send_error(cptr, 413, "Request Entity Too Large", true);
-				sendq_add_eof(cptr);
-				return;
-			}
-			if (!hd->correct_content_type)
-			{
-				send_error(cptr, 415, "Unsupported Media Type", true);
-				sendq_add_eof(cptr);
-				return;
-			}
-			if (hd->expect_100_continue)
-			{
-				snprintf(outbuf, sizeof outbuf,
-				         "HTTP/1.1 100 Continue\r\n"
-				         "Server: %s/%s\r\n"
-				         "\r\n",
-				         PACKAGE_TARNAME, PACKAGE_VERSION);
-
-				sendq_add(cptr, outbuf, strlen(outbuf));
-			}
-			hd->requestbuf = smalloc(hd->length + 1);
 		}
+		hd->requestbuf = smalloc(hd->length + 1);
 	}
 	else
+	{
+		hd->header_bytes += count;
+		if (hd->header_bytes > HEADERS_MAX)
+		{
+			send_error_close(cptr, 431, "Request Header Fields Too Large");
+			return;
+		}
 		process_header(cptr, buf);
+	}
 }
 
 static void
@@ -356,6 +604,7 @@ httpd_closehandler(struct connection *cptr)
 	hd = cptr->userdata;
 	if (hd != NULL)
 	{
+		close_file(hd);
 		sfree(hd->requestbuf);
 		sfree(hd);
 	}
@@ -372,6 +621,7 @@ do_listen(struct connection *cptr)
 
 	struct httpddata *const hd = smalloc(sizeof *hd);
 	hd->connection_close = false;
+	hd->file_fd = -1;
 	clear_httpddata(hd);
 	newptr->userdata = hd;
 	newptr->recvq_handler = httpd_recvqhandler;
@@ -392,7 +642,9 @@ httpd_checkidle(void *arg)
 		cptr = n->data;
 		if (cptr->listener == listener && cptr->last_recv + 300 < CURRTIME)
 		{
-			if (sendq_nonempty(cptr))
+			struct httpddata *hd = cptr->userdata;
+
+			if (sendq_nonempty(cptr) || (hd != NULL && hd->file_fd != -1))
 				cptr->last_recv = CURRTIME;
 			else
 				/* from a timeout function,
@@ -426,6 +678,8 @@ mod_init(struct module ATHEME_VATTR_UNUSED *const restrict m)
 {
 	httpd_checkidle_timer = mowgli_timer_add(base_eventloop, "httpd_checkidle", httpd_checkidle, NULL, SECONDS_PER_MINUTE);
 
+	httpd_path_index_rebuild();
+
 	// This module needs a rehash to initialize fully if loaded at run time
 	hook_add_config_ready(httpd_config_ready);
 
@@ -446,6 +700,9 @@ mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 	del_conf_item("WWW_ROOT", &conf_httpd_table);
 	del_conf_item("PORT", &conf_httpd_table);
 	del_top_conf("HTTPD");
+
+	mowgli_patricia_destroy(httpd_path_index, NULL, NULL);
+	httpd_path_index = NULL;
 }
 
 SIMPLE_DECLARE_MODULE_V1("misc/httpd", MODULE_UNLOAD_CAPABILITY_OK)
@@ -0,0 +1,74 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Serves the metrics registry at /metrics, in the Prometheus text
+ * exposition format.
+ */
+
+#include <atheme.h>
+
+#define METRICS_PATH            "/metrics"
+#define METRICS_CONTENT_TYPE    "text/plain; version=0.0.4; charset=utf-8"
+
+static void (*httpd_path_handler_add)(struct path_handler *) = NULL;
+static void (*httpd_path_handler_del)(struct path_handler *) = NULL;
+
+static void
+metrics_emit(const char *const restrict buf, const size_t len, void *const restrict privdata)
+{
+	(void) mowgli_string_append(privdata, buf, len);
+}
+
+static void
+handle_request(struct connection *const restrict cptr, void ATHEME_VATTR_UNUSED *const restrict requestbuf)
+{
+	const struct httpddata *const hd = cptr->userdata;
+	mowgli_string_t *const body = mowgli_string_create();
+	char header[300];
+
+	(void) metrics_render(&metrics_emit, body);
+
+	(void) snprintf(header, sizeof header,
+	                "HTTP/1.1 200 OK\r\n"
+	                "Server: %s/%s\r\n"
+	                "Content-Type: %s\r\n"
+	                "Content-Length: %zu\r\n"
+	                "%s"
+	                "\r\n",
+	                PACKAGE_TARNAME, PACKAGE_VERSION,
+	                METRICS_CONTENT_TYPE,
+	                body->pos,
+	                httpd_connection_header(hd));
+
+	(void) sendq_add(cptr, header, strlen(header));
+
+	if (body->pos)
+		(void) sendq_add(cptr, body->str, body->pos);
+
+	if (hd->connection_close)
+		(void) sendq_add_eof(cptr);
+
+	(void) mowgli_string_destroy(body);
+}
+
+static struct path_handler handle_metrics = { METRICS_PATH, &handle_request, true };
+
+static void
+mod_init(struct module *const restrict m)
+{
+	MODULE_TRY_REQUEST_SYMBOL(m, httpd_path_handler_add, "misc/httpd", "httpd_path_handler_add")
+	MODULE_TRY_REQUEST_SYMBOL(m, httpd_path_handler_del, "misc/httpd", "httpd_path_handler_del")
+
+	(void) httpd_path_handler_add(&handle_metrics);
+}
+
+static void
+mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
+{
+	(void) httpd_path_handler_del(&handle_metrics);
+}
+
+SIMPLE_DECLARE_MODULE_V1("misc/metrics", MODULE_UNLOAD_CAPABILITY_OK)
@@ -46,10 +46,14 @@ log_enforce_victim_out(struct user *u, struct myuser *mu)
 	if (u->myuser == NULL || u->myuser != mu)
 		return false;
 
+	db_modifying(u->myuser);
 	u->myuser->lastlogin = CURRTIME;
 
 	if ((mn = mynick_find(u->nick)) != NULL)
+	{
+		db_modifying(mn->owner);
 		mn->lastseen = CURRTIME;
+	}
 
 	if (!ircd_logout_or_kill(u, entity(u->myuser)->name))
 	{
@@ -530,6 +534,7 @@ ns_cmd_regain(struct sourceinfo *si, int parc, char *parv[])
 				if (ircd_logout_or_kill(si->su, entity(si->smu)->name))
 					// logout killed the user...
 					return;
+				db_modifying(si->smu);
 				si->smu->lastlogin = CURRTIME;
 				MOWGLI_ITER_FOREACH_SAFE(n, tn, si->smu->logins.head)
 				{
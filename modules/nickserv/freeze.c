@@ -85,6 +85,8 @@ ns_cmd_freeze(struct sourceinfo *si, int parc, char *parv[])
 		metadata_add(mu, "private:freeze:reason", reason);
 		metadata_add(mu, "private:freeze:timestamp", number_to_string(CURRTIME));
 
+		db_modifying(mu);
+
 		// log them out
 		MOWGLI_ITER_FOREACH_SAFE(n, tn, mu->logins.head)
 		{
@@ -92,9 +92,15 @@ ns_cmd_ghost(struct sourceinfo *si, int parc, char *parv[])
 		 * Perhaps the ghosted nick belonged to someone else, but we were identified to it?
 		 * Try this first. */
 		if (target_u->myuser && target_u->myuser == si->smu)
+		{
+			db_modifying(target_u->myuser);
 			target_u->myuser->lastlogin = CURRTIME;
+		}
 		else
+		{
+			db_modifying(mu);
 			mu->lastlogin = CURRTIME;
+		}
 
 		return;
 	}
@@ -47,6 +47,7 @@ ns_cmd_hold(struct sourceinfo *si, int parc, char *parv[])
 			return;
 		}
 
+		db_modifying(mu);
 		mu->flags |= MU_HOLD;
 
 		wallops("%s set the HOLD option for the account \2%s\2.", get_oper_name(si), entity(mu)->name);
@@ -61,6 +62,7 @@ ns_cmd_hold(struct sourceinfo *si, int parc, char *parv[])
 			return;
 		}
 
+		db_modifying(mu);
 		mu->flags &= ~MU_HOLD;
 
 		wallops("%s removed the HOLD option on the account \2%s\2.", get_oper_name(si), entity(mu)->name);
@@ -95,6 +97,7 @@ mod_init(struct module *const restrict m)
 	static struct list_param hold;
 	hold.opttype = OPT_BOOL;
 	hold.is_match = is_held;
+	hold.mu_flag = MU_HOLD;
 
 	list_register("hold", &hold);
 	list_register("held", &hold);
@@ -20,15 +20,90 @@
 #define COMMAND_DESC	N_("Identifies to services for a nickname.")
 #endif
 
+static void
+ns_login_verified(struct sourceinfo *si, struct myuser *mu, enum auth_verdict verdict, void ATHEME_VATTR_UNUSED *priv)
+{
+	struct user *u = si->su;
+	mowgli_node_t *n, *tn;
+	char lau[BUFSIZE];
+
+	if (verdict == AUTH_VERDICT_UNAVAILABLE)
+	{
+		logcommand(si, CMDLOG_LOGIN, "failed " COMMAND_UC " to \2%s\2 (verification unavailable)", entity(mu)->name);
+
+		command_fail(si, fault_internalerror, _("Your password could not be checked right now. Please try again later."));
+		return;
+	}
+
+	if (verdict != AUTH_VERDICT_VERIFIED)
+	{
+		logcommand(si, CMDLOG_LOGIN, "failed " COMMAND_UC " to \2%s\2 (bad password)", entity(mu)->name);
+
+		command_fail(si, fault_authfail, _("Invalid password for \2%s\2."), entity(mu)->name);
+		bad_password(si, mu);
+		return;
+	}
+
+	// The password may have been checked by a remote server; things can change in the meantime
+	if (u->myuser == mu)
+	{
+		command_fail(si, fault_nochange, _("You are already logged in as \2%s\2."), entity(u->myuser)->name);
+		return;
+	}
+
+	if (MOWGLI_LIST_LENGTH(&mu->logins) >= me.maxlogins)
+	{
+		command_fail(si, fault_toomany, _("There are already \2%zu\2 sessions logged in to \2%s\2 (maximum allowed: %u)."), MOWGLI_LIST_LENGTH(&mu->logins), entity(mu)->name, me.maxlogins);
+		lau[0] = '\0';
+		MOWGLI_ITER_FOREACH(n, mu->logins.head)
+		{
+			if (lau[0] != '\0')
+				mowgli_strlcat(lau, ", ", sizeof lau);
+			mowgli_strlcat(lau, ((struct user *)n->data)->nick, sizeof lau);
+		}
+		command_fail(si, fault_toomany, _("Logged in nicks are: %s"), lau);
+		logcommand(si, CMDLOG_LOGIN, "failed " COMMAND_UC " to \2%s\2 (too many logins)", entity(mu)->name);
+		return;
+	}
+
+	// if they are identified to another account, nuke their session first
+	if (u->myuser)
+	{
+		command_success_nodata(si, _("You have been logged out of \2%s\2."), entity(u->myuser)->name);
+
+		if (ircd_on_logout(u, entity(u->myuser)->name))
+			// logout killed the user...
+			return;
+	        db_modifying(u->myuser);
+	        u->myuser->lastlogin = CURRTIME;
+	        MOWGLI_ITER_FOREACH_SAFE(n, tn, u->myuser->logins.head)
+	        {
+		        if (n->data == u)
+	                {
+	                        mowgli_node_delete(n, &u->myuser->logins);
+	                        mowgli_node_free(n);
+	                        break;
+	                }
+	        }
+	        u->myuser = NULL;
+	}
+
+	command_success_nodata(si, nicksvs.no_nick_ownership ? _("You are now logged in as \2%s\2.") : _("You are now identified for \2%s\2."), entity(mu)->name);
+
+	if (!(mu->flags & MU_CRYPTPASS))
+		(void) command_success_nodata(si, _("Warning: Your password is not encrypted."));
+
+	myuser_login(si->service, u, mu, true);
+	logcommand(si, CMDLOG_LOGIN, COMMAND_UC);
+}
+
 static void
 ns_cmd_login(struct sourceinfo *si, int parc, char *parv[])
 {
 	struct user *u = si->su;
 	struct myuser *mu;
-	mowgli_node_t *n, *tn;
 	const char *target = parv[0];
 	const char *password = parv[1];
-	char lau[BUFSIZE];
 
 	if (si->su == NULL)
 	{
@@ -118,59 +193,13 @@ ns_cmd_login(struct sourceinfo *si, int parc, char *parv[])
 		return;
 	}
 
-	if (verify_password(mu, password))
+	if (auth_request_pending(u))
 	{
-		if (MOWGLI_LIST_LENGTH(&mu->logins) >= me.maxlogins)
-		{
-			command_fail(si, fault_toomany, _("There are already \2%zu\2 sessions logged in to \2%s\2 (maximum allowed: %u)."), MOWGLI_LIST_LENGTH(&mu->logins), entity(mu)->name, me.maxlogins);
-			lau[0] = '\0';
-			MOWGLI_ITER_FOREACH(n, mu->logins.head)
-			{
-				if (lau[0] != '\0')
-					mowgli_strlcat(lau, ", ", sizeof lau);
-				mowgli_strlcat(lau, ((struct user *)n->data)->nick, sizeof lau);
-			}
-			command_fail(si, fault_toomany, _("Logged in nicks are: %s"), lau);
-			logcommand(si, CMDLOG_LOGIN, "failed " COMMAND_UC " to \2%s\2 (too many logins)", entity(mu)->name);
-			return;
-		}
-
-		// if they are identified to another account, nuke their session first
-		if (u->myuser)
-		{
-			command_success_nodata(si, _("You have been logged out of \2%s\2."), entity(u->myuser)->name);
-
-			if (ircd_on_logout(u, entity(u->myuser)->name))
-				// logout killed the user...
-				return;
-		        u->myuser->lastlogin = CURRTIME;
-		        MOWGLI_ITER_FOREACH_SAFE(n, tn, u->myuser->logins.head)
-		        {
-			        if (n->data == u)
-		                {
-		                        mowgli_node_delete(n, &u->myuser->logins);
-		                        mowgli_node_free(n);
-		                        break;
-		                }
-		        }
-		        u->myuser = NULL;
-		}
-
-		command_success_nodata(si, nicksvs.no_nick_ownership ? _("You are now logged in as \2%s\2.") : _("You are now identified for \2%s\2."), entity(mu)->name);
-
-		if (!(mu->flags & MU_CRYPTPASS))
-			(void) command_success_nodata(si, _("Warning: Your password is not encrypted."));
-
-		myuser_login(si->service, u, mu, true);
-		logcommand(si, CMDLOG_LOGIN, COMMAND_UC);
-
+		command_fail(si, fault_toomany, _("You already have a login in progress; please wait for it to complete."));
 		return;
 	}
 
-	logcommand(si, CMDLOG_LOGIN, "failed " COMMAND_UC " to \2%s\2 (bad password)", entity(mu)->name);
-
-	command_fail(si, fault_authfail, _("Invalid password for \2%s\2."), entity(mu)->name);
-	bad_password(si, mu);
+	(void) verify_password_async(si, mu, password, &ns_login_verified, NULL);
 }
 
 static struct command ns_login = {
@@ -194,6 +223,9 @@ static void
 mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 {
 	service_named_unbind_command("nickserv", &ns_login);
+
+	// the auth module may still answer logins that are in progress
+	(void) auth_cancel_callback(&ns_login_verified);
 }
 
 SIMPLE_DECLARE_MODULE_V1("nickserv/" COMMAND_LC, MODULE_UNLOAD_CAPABILITY_OK)
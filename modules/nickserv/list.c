@@ -16,8 +16,47 @@
 extern void list_register(const char *, struct list_param *);
 extern void list_unregister(const char *);
 
+#define LIST_MAX_CRITERIA 10
+
+// A "pattern" argument, split into its nick and host parts once per query
+struct list_pattern
+{
+	char buf[512];
+	const char *nick;
+	const char *host;
+};
+
+struct list_criterion
+{
+	const struct list_param *param;
+	const void *arg;
+	union {
+		bool b;
+		int i;
+		time_t age;
+		struct list_pattern pattern;
+	} val;
+};
+
+// One LIST command, parsed
+struct list_query
+{
+	struct sourceinfo *si;
+	struct list_criterion criteria[LIST_MAX_CRITERIA];
+	size_t count;
+	unsigned int mu_flags;          // flags every matching account must have
+	unsigned int matches;
+};
+
 static mowgli_patricia_t *list_params;
 
+static struct list_param list_email;
+static struct list_param list_lastlogin;
+static struct list_param list_pattern;
+static struct list_param list_registered;
+static struct list_param list_primary;
+static struct list_param list_waitauth;
+
 static bool
 email_match(const struct mynick *mn, const void *arg)
 {
@@ -39,46 +78,24 @@ lastlogin_match(const struct mynick *mn, const void *arg)
 static bool
 pattern_match(const struct mynick *mn, const void *arg)
 {
-	const char *pattern = (const char*)arg;
-
-	char pat[512], *nickpattern = NULL, *hostpattern = NULL, *p;
+	const struct list_pattern *pattern = arg;
 	struct metadata *md;
 
 	bool hostmatch;
 
 	struct myuser *mu = mn->owner;
 
-	if (pattern != NULL)
-	{
-		mowgli_strlcpy(pat, pattern, sizeof pat);
-		p = strrchr(pat, ' ');
-		if (p == NULL)
-			p = strrchr(pat, '!');
-		if (p != NULL)
-		{
-			*p++ = '\0';
-			nickpattern = pat;
-			hostpattern = p;
-		}
-		else if (strchr(pat, '@'))
-			hostpattern = pat;
-		else
-			nickpattern = pat;
-		if (nickpattern && !strcmp(nickpattern, "*"))
-			nickpattern = NULL;
-	}
-
-	if (nickpattern && match(nickpattern, mn->nick))
+	if (pattern->nick && match(pattern->nick, mn->nick))
 		return false;
 
-	if (hostpattern)
+	if (pattern->host)
 	{
 		hostmatch = false;
 		md = metadata_find(mu, "private:host:actual");
-		if (md != NULL && !match(hostpattern, md->value))
+		if (md != NULL && !match(pattern->host, md->value))
 			hostmatch = true;
 		md = metadata_find(mu, "private:host:vhost");
-		if (md != NULL && !match(hostpattern, md->value))
+		if (md != NULL && !match(pattern->host, md->value))
 			hostmatch = true;
 		if (!hostmatch)
 			return false;
@@ -204,109 +221,237 @@ list_one(struct sourceinfo *si, struct myuser *mu, struct mynick *mn)
 }
 
 static void
-ns_cmd_list(struct sourceinfo *si, int parc, char *parv[])
+split_pattern(struct list_pattern *pattern, const char *arg)
 {
-	char criteriastr[BUFSIZE];
+	char *p;
 
-	mowgli_patricia_iteration_state_t state;
-	struct myentity_iteration_state mestate;
-	struct mynick *mn;
+	mowgli_strlcpy(pattern->buf, arg, sizeof pattern->buf);
+	pattern->nick = NULL;
+	pattern->host = NULL;
 
-	unsigned int matches = 0;
+	p = strrchr(pattern->buf, ' ');
+	if (p == NULL)
+		p = strrchr(pattern->buf, '!');
+	if (p != NULL)
+	{
+		*p++ = '\0';
+		pattern->nick = pattern->buf;
+		pattern->host = p;
+	}
+	else if (strchr(pattern->buf, '@'))
+		pattern->host = pattern->buf;
+	else
+		pattern->nick = pattern->buf;
+	if (pattern->nick && !strcmp(pattern->nick, "*"))
+		pattern->nick = NULL;
+}
 
+/* Resolves every criterion and its argument once. Flag criteria are folded
+ * into a mask; everything else is kept to be tested against each nick.
+ */
+static bool
+list_parse(struct sourceinfo *si, int parc, char *parv[], struct list_query *query)
+{
 	int i;
-	bool error = false;
-	bool found;
 
-	MOWGLI_PATRICIA_FOREACH(mn, &state, nicklist)
+	for (i = 0; i < parc; i++)
 	{
-		found = true;
+		const struct list_param *param = mowgli_patricia_retrieve(list_params, parv[i]);
+		struct list_criterion *crit;
 
-		for (i = 0; i < parc; i++)
+		if (param == NULL)
 		{
-			struct list_param *param = mowgli_patricia_retrieve(list_params, parv[i]);
+			command_fail(si, fault_badparams, _("\2%s\2 is not a recognized LIST criterion"), parv[i]);
+			return false;
+		}
+
+		if (param->opttype == OPT_FLAG)
+			continue;
+
+		if (param->opttype == OPT_BOOL && param->mu_flag != 0)
+		{
+			query->mu_flags |= param->mu_flag;
+			continue;
+		}
+
+		if (param->opttype != OPT_BOOL && i + 1 >= parc)
+		{
+			command_fail(si, fault_needmoreparams, STR_INSUFFICIENT_PARAMS, parv[i]);
+			return false;
+		}
 
-			if (param == NULL) {
-				command_fail(si, fault_badparams, _("\2%s\2 is not a recognized LIST criterion"), parv[i]);
-				error = true;
+		crit = &query->criteria[query->count++];
+		crit->param = param;
+
+		switch (param->opttype)
+		{
+			case OPT_BOOL:
+				crit->val.b = true;
+				crit->arg = &crit->val.b;
 				break;
-			}
 
-			if (param->opttype == OPT_BOOL) {
-				bool arg = true;
+			case OPT_INT:
+				crit->val.i = atoi(parv[++i]);
+				crit->arg = &crit->val.i;
+				break;
 
-				if (!param->is_match(mn, &arg)) {
-					found = false;
-					break;
-				}
-			} else if (param->opttype == OPT_INT) {
-				if (i + 1 < parc) {
-					int arg = atoi(parv[++i]);
-
-					if (!param->is_match (mn, &arg)) {
-						found = false;
-						break;
-					}
-				} else {
-					command_fail(si, fault_needmoreparams, STR_INSUFFICIENT_PARAMS, parv[i]);
-					error = true;
-					break;
-				}
-			} else if (param->opttype == OPT_STRING) {
-				if (i + 1 < parc) {
-					if (!param->is_match (mn, parv[++i])) {
-						found = false;
-						break;
-					}
-				} else {
-					command_fail(si, fault_needmoreparams, STR_INSUFFICIENT_PARAMS, parv[i]);
-					error = true;
-					break;
-				}
-			}
-			else if (param->opttype == OPT_AGE) {
-				if (i + 1 < parc)
+			case OPT_STRING:
+				if (param == &list_pattern)
 				{
-					time_t age = parse_age(parv[++i]);
-
-					if (!param->is_match (mn, &age)) {
-						found = false;
-						break;
-					}
-				} else {
-					command_fail(si, fault_needmoreparams, STR_INSUFFICIENT_PARAMS, parv[i]);
-					error = true;
-					break;
+					split_pattern(&crit->val.pattern, parv[++i]);
+					crit->arg = &crit->val.pattern;
 				}
-			}
-		} //for (i = 0; i < parc; i++)
+				else
+					crit->arg = parv[++i];
+				break;
+
+			case OPT_AGE:
+				crit->val.age = parse_age(parv[++i]);
+				crit->arg = &crit->val.age;
+				break;
+
+			case OPT_FLAG:
+				break;
+		}
+	}
+
+	return true;
+}
+
+static int
+list_account(struct myuser *mu, void *privdata)
+{
+	struct list_query *query = privdata;
+	mowgli_node_t *n;
+	size_t i;
+
+	if ((mu->flags & query->mu_flags) != query->mu_flags)
+		return 0;
+
+	MOWGLI_ITER_FOREACH(n, mu->nicks.head)
+	{
+		struct mynick *mn = n->data;
+
+		for (i = 0; i < query->count; i++)
+			if (!query->criteria[i].param->is_match(mn, query->criteria[i].arg))
+				break;
+
+		if (i < query->count)
+			continue;
+
+		list_one(query->si, NULL, mn);
+		query->matches++;
+	}
+
+	return 0;
+}
+
+static int
+list_account_foreach_cb(struct myentity *mt, void *privdata)
+{
+	return list_account(user(mt), privdata);
+}
+
+/* Picks the cheapest way to enumerate the accounts that can match: the
+ * accounts with a given email address, the accounts registered or last
+ * seen before some time, or failing those, all of them.
+ */
+static void
+list_run(struct list_query *query)
+{
+	const struct list_criterion *age_crit = NULL;
+	enum myuser_index_order age_order = MYUSER_INDEX_REGISTERED;
+	const mowgli_list_t *email_accounts = NULL;
+	bool by_email = false;
+	size_t best = cnt.myuser;
+	size_t i;
+
+	for (i = 0; i < query->count && !by_email; i++)
+	{
+		const struct list_criterion *crit = &query->criteria[i];
+
+		if (crit->param == &list_email && email_pattern_is_literal(crit->arg))
+		{
+			stringref email_canonical = canonicalize_email(crit->arg);
+
+			email_accounts = myuser_index_email(email_canonical);
+			strshare_unref(email_canonical);
 
-		if (error) {
-			break;
+			by_email = true;
 		}
+	}
 
-		if (found) {
-			list_one(si, NULL, mn);
-			matches++;
+	if (by_email)
+	{
+		mowgli_node_t *n;
+
+		if (email_accounts != NULL)
+			MOWGLI_ITER_FOREACH(n, email_accounts->head)
+				(void) list_account(n->data, query);
+
+		return;
+	}
+
+	for (i = 0; i < query->count; i++)
+	{
+		const struct list_criterion *crit = &query->criteria[i];
+		enum myuser_index_order order;
+		size_t estimate;
+
+		if (crit->param == &list_registered)
+			order = MYUSER_INDEX_REGISTERED;
+		else if (crit->param == &list_lastlogin)
+			order = MYUSER_INDEX_LASTLOGIN;
+		else
+			continue;
+
+		// only count as far as the best candidate so far
+		estimate = myuser_index_count_before(order, CURRTIME - crit->val.age, best);
+
+		if (estimate < best)
+		{
+			best = estimate;
+			age_crit = crit;
+			age_order = order;
 		}
-	} //MOWGLI_PATRICIA_FOREACH(mn, &state, nicklist)
+	}
+
+	if (age_crit != NULL)
+		myuser_index_foreach_before(age_order, CURRTIME - age_crit->val.age, &list_account, query);
+	else
+		myentity_foreach_t(ENT_USER, &list_account_foreach_cb, query);
+}
+
+static void
+ns_cmd_list(struct sourceinfo *si, int parc, char *parv[])
+{
+	char criteriastr[BUFSIZE];
+	struct list_query query;
+
+	(void) memset(&query, 0x00, sizeof query);
+	query.si = si;
+
+	if (!list_parse(si, parc, parv, &query))
+		return;
+
+	list_run(&query);
 
 	build_criteriastr(criteriastr, parc, parv);
 
-	logcommand(si, CMDLOG_ADMIN, "LIST: \2%s\2 (\2%u\2 matches)", criteriastr, matches);
-	if (matches == 0)
+	logcommand(si, CMDLOG_ADMIN, "LIST: \2%s\2 (\2%u\2 matches)", criteriastr, query.matches);
+	if (query.matches == 0)
 		command_success_nodata(si, _("No nicknames matched criteria \2%s\2"), criteriastr);
 	else
 		command_success_nodata(si, ngettext(N_("\2%u\2 match for criteria \2%s\2."),
-		                                    N_("\2%u\2 matches for criteria \2%s\2."), matches),
-		                                    matches, criteriastr);
+		                                    N_("\2%u\2 matches for criteria \2%s\2."), query.matches),
+		                                    query.matches, criteriastr);
 }
 
 static struct command ns_list = {
 	.name           = "LIST",
 	.desc           = N_("Lists nicknames registered matching a given pattern."),
 	.access         = PRIV_USER_AUSPEX,
-	.maxparc        = 10,
+	.maxparc        = LIST_MAX_CRITERIA,
 	.cmd            = &ns_cmd_list,
 	.help           = { .path = "nickserv/list" },
 };
@@ -320,39 +465,34 @@ mod_init(struct module *const restrict m)
 	service_named_bind_command("nickserv", &ns_list);
 
 	// list email
-	static struct list_param email;
-	email.opttype = OPT_STRING;
-	email.is_match = email_match;
+	list_email.opttype = OPT_STRING;
+	list_email.is_match = email_match;
 
-	static struct list_param lastlogin;
-	lastlogin.opttype = OPT_AGE;
-	lastlogin.is_match = lastlogin_match;
+	list_lastlogin.opttype = OPT_AGE;
+	list_lastlogin.is_match = lastlogin_match;
 
-	static struct list_param pattern;
-	pattern.opttype = OPT_STRING;
-	pattern.is_match = pattern_match;
+	list_pattern.opttype = OPT_STRING;
+	list_pattern.is_match = pattern_match;
 
-	static struct list_param registered;
-	registered.opttype = OPT_AGE;
-	registered.is_match = registered_match;
+	list_registered.opttype = OPT_AGE;
+	list_registered.is_match = registered_match;
 
-	static struct list_param primary;
-	primary.opttype = OPT_BOOL;
-	primary.is_match = primary_match;
+	list_primary.opttype = OPT_BOOL;
+	list_primary.is_match = primary_match;
 
-	list_register("email", &email);
-	list_register("lastlogin", &lastlogin);
-	list_register("mail", &email);
+	list_register("email", &list_email);
+	list_register("lastlogin", &list_lastlogin);
+	list_register("mail", &list_email);
 
-	list_register("pattern", &pattern);
-	list_register("registered", &registered);
-	list_register("primary", &primary);
+	list_register("pattern", &list_pattern);
+	list_register("registered", &list_registered);
+	list_register("primary", &list_primary);
 
-	static struct list_param waitauth;
-	waitauth.opttype = OPT_BOOL;
-	waitauth.is_match = has_waitauth;
+	list_waitauth.opttype = OPT_BOOL;
+	list_waitauth.is_match = has_waitauth;
+	list_waitauth.mu_flag = MU_WAITAUTH;
 
-	list_register("waitauth", &waitauth);
+	list_register("waitauth", &list_waitauth);
 }
 
 static void
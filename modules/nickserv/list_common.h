@@ -25,6 +25,12 @@ struct list_param
 {
 	enum list_opttype opttype;
 	bool (*is_match)(const struct mynick *mn, const void *arg);
+
+	/* For OPT_BOOL parameters that only test for an account flag: the flag
+	 * (MU_*). LIST then tests all of them in one go instead of calling
+	 * is_match for every nick. Leave it zero otherwise.
+	 */
+	unsigned int mu_flag;
 };
 
 #endif /* !ATHEME_MOD_NICKSERV_LIST_COMMON_H */
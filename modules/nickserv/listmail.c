@@ -53,7 +53,21 @@ ns_cmd_listmail(struct sourceinfo *si, int parc, char *parv[])
 	state.pattern = email;
 	state.email_canonical = canonicalize_email(email);
 	state.origin = si;
-	myentity_foreach_t(ENT_USER, listmail_foreach_cb, &state);
+
+	if (email_pattern_is_literal(email))
+	{
+		/* without wildcards, every match has the same canonical address
+		 * (and the other way around), so only those accounts need a look */
+		const mowgli_list_t *accounts = myuser_index_email(state.email_canonical);
+		mowgli_node_t *n;
+
+		if (accounts != NULL)
+			MOWGLI_ITER_FOREACH(n, accounts->head)
+				(void) listmail_foreach_cb(entity(n->data), &state);
+	}
+	else
+		myentity_foreach_t(ENT_USER, listmail_foreach_cb, &state);
+
 	strshare_unref(state.email_canonical);
 
 	logcommand(si, CMDLOG_ADMIN, "LISTMAIL: \2%s\2 (\2%u\2 matches)", email, state.matches);
@@ -93,6 +93,7 @@ ns_cmd_logout(struct sourceinfo *si, int parc, char *parv[])
 		command_success_nodata(si, _("You have been logged out."));
 	}
 
+	db_modifying(u->myuser);
 	u->myuser->lastlogin = CURRTIME;
 	mn = mynick_find(u->nick);
 	if (mn != NULL && mn->owner == u->myuser)
@@ -65,6 +65,7 @@ nickserv_handle_nickchange(struct user *u)
 
 	if (u->myuser == mn->owner)
 	{
+		db_modifying(mn->owner);
 		mn->lastseen = CURRTIME;
 		return;
 	}
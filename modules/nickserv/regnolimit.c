@@ -47,6 +47,7 @@ ns_cmd_regnolimit(struct sourceinfo *si, int parc, char *parv[])
 			return;
 		}
 
+		db_modifying(mu);
 		mu->flags |= MU_REGNOLIMIT;
 
 		wallops("%s set the REGNOLIMIT option for the account \2%s\2.", get_oper_name(si), entity(mu)->name);
@@ -61,6 +62,7 @@ ns_cmd_regnolimit(struct sourceinfo *si, int parc, char *parv[])
 			return;
 		}
 
+		db_modifying(mu);
 		mu->flags &= ~MU_REGNOLIMIT;
 
 		wallops("%s removed the REGNOLIMIT option on the account \2%s\2.", get_oper_name(si), entity(mu)->name);
@@ -95,6 +97,7 @@ mod_init(struct module *const restrict m)
 	static struct list_param regnolimit;
 	regnolimit.opttype = OPT_BOOL;
 	regnolimit.is_match = has_regnolimit;
+	regnolimit.mu_flag = MU_REGNOLIMIT;
 
 	list_register("regnolimit", &regnolimit);
 }
@@ -71,6 +71,8 @@ ns_cmd_return(struct sourceinfo *si, int parc, char *parv[])
 	metadata_delete(mu, "private:sendpass:sender");
 	metadata_delete(mu, "private:sendpass:timestamp");
 
+	db_modifying(mu);
+
 	// log them out
 	MOWGLI_ITER_FOREACH_SAFE(n, tn, mu->logins.head)
 	{
@@ -44,6 +44,7 @@ ns_cmd_set_hidemail(struct sourceinfo *si, int parc, char *parv[])
 
 		logcommand(si, CMDLOG_SET, "SET:HIDEMAIL:ON");
 
+		db_modifying(si->smu);
 		si->smu->flags |= MU_HIDEMAIL;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been set for account \2%s\2."), "HIDEMAIL" ,entity(si->smu)->name);
@@ -60,6 +61,7 @@ ns_cmd_set_hidemail(struct sourceinfo *si, int parc, char *parv[])
 
 		logcommand(si, CMDLOG_SET, "SET:HIDEMAIL:OFF");
 
+		db_modifying(si->smu);
 		si->smu->flags &= ~MU_HIDEMAIL;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been removed for account \2%s\2."), "HIDEMAIL", entity(si->smu)->name);
@@ -94,6 +96,7 @@ mod_init(struct module *const restrict m)
 	static struct list_param hidemail;
 	hidemail.opttype = OPT_BOOL;
 	hidemail.is_match = has_hidemail;
+	hidemail.mu_flag = MU_HIDEMAIL;
 
 	list_register("hidemail", &hidemail);
 }
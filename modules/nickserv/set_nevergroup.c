@@ -44,6 +44,7 @@ ns_cmd_set_nevergroup(struct sourceinfo *si, int parc, char *parv[])
 
 		logcommand(si, CMDLOG_SET, "SET:NEVERGROUP:ON");
 
+		db_modifying(si->smu);
 		si->smu->flags |= MU_NEVERGROUP;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been set for account \2%s\2."), "NEVERGROUP", entity(si->smu)->name);
@@ -61,6 +62,7 @@ ns_cmd_set_nevergroup(struct sourceinfo *si, int parc, char *parv[])
 
 		logcommand(si, CMDLOG_SET, "SET:NEVERGROUP:OFF");
 
+		db_modifying(si->smu);
 		si->smu->flags &= ~MU_NEVERGROUP;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been removed for account \2%s\2."), "NEVERGROUP", entity(si->smu)->name);
@@ -96,6 +98,7 @@ mod_init(struct module *const restrict m)
 	static struct list_param nevergroup;
 	nevergroup.opttype = OPT_BOOL;
 	nevergroup.is_match = has_nevergroup;
+	nevergroup.mu_flag = MU_NEVERGROUP;
 
 	list_register("nevergroup", &nevergroup);
 }
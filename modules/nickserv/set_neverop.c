@@ -44,6 +44,7 @@ ns_cmd_set_neverop(struct sourceinfo *si, int parc, char *parv[])
 
 		logcommand(si, CMDLOG_SET, "SET:NEVEROP:ON");
 
+		db_modifying(si->smu);
 		si->smu->flags |= MU_NEVEROP;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been set for account \2%s\2."), "NEVEROP", entity(si->smu)->name);
@@ -61,6 +62,7 @@ ns_cmd_set_neverop(struct sourceinfo *si, int parc, char *parv[])
 
 		logcommand(si, CMDLOG_SET, "SET:NEVEROP:OFF");
 
+		db_modifying(si->smu);
 		si->smu->flags &= ~MU_NEVEROP;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been removed for account \2%s\2."), "NEVEROP", entity(si->smu)->name);
@@ -96,6 +98,7 @@ mod_init(struct module *const restrict m)
 	static struct list_param neverop;
 	neverop.opttype = OPT_BOOL;
 	neverop.is_match = has_neverop;
+	neverop.mu_flag = MU_NEVEROP;
 
 	list_register("neverop", &neverop);
 }
@@ -44,6 +44,7 @@ ns_cmd_set_noop(struct sourceinfo *si, int parc, char *parv[])
 
 		logcommand(si, CMDLOG_SET, "SET:NOOP:ON");
 
+		db_modifying(si->smu);
 		si->smu->flags |= MU_NOOP;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been set for account \2%s\2."), "NOOP", entity(si->smu)->name);
@@ -60,6 +61,7 @@ ns_cmd_set_noop(struct sourceinfo *si, int parc, char *parv[])
 
 		logcommand(si, CMDLOG_SET, "SET:NOOP:OFF");
 
+		db_modifying(si->smu);
 		si->smu->flags &= ~MU_NOOP;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been removed for account \2%s\2."), "NOOP", entity(si->smu)->name);
@@ -95,6 +97,7 @@ mod_init(struct module *const restrict m)
 	static struct list_param noop;
 	noop.opttype = OPT_BOOL;
 	noop.is_match = has_noop;
+	noop.mu_flag = MU_NOOP;
 
 	list_register("noop", &noop);
 }
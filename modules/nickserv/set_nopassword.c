@@ -49,6 +49,7 @@ ns_cmd_set_nopassword(struct sourceinfo *si, int parc, char *parv[])
 
 		logcommand(si, CMDLOG_SET, "SET:NOPASSWORD:ON");
 
+		db_modifying(si->smu);
 		si->smu->flags |= MU_NOPASSWORD;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been set for account \2%s\2."), "NOPASSWORD" ,entity(si->smu)->name);
@@ -65,6 +66,7 @@ ns_cmd_set_nopassword(struct sourceinfo *si, int parc, char *parv[])
 
 		logcommand(si, CMDLOG_SET, "SET:NOPASSWORD:OFF");
 
+		db_modifying(si->smu);
 		si->smu->flags &= ~MU_NOPASSWORD;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been removed for account \2%s\2."), "NOPASSWORD", entity(si->smu)->name);
@@ -99,6 +101,7 @@ mod_init(struct module *const restrict m)
 	static struct list_param nopassword;
 	nopassword.opttype = OPT_BOOL;
 	nopassword.is_match = has_nopassword;
+	nopassword.mu_flag = MU_NOPASSWORD;
 
 	list_register("nopassword", &nopassword);
 }
@@ -43,6 +43,7 @@ ns_cmd_set_private(struct sourceinfo *si, int parc, char *parv[])
 
 		logcommand(si, CMDLOG_SET, "SET:PRIVATE:ON");
 
+		db_modifying(si->smu);
 		si->smu->flags |= MU_PRIVATE;
 		si->smu->flags |= MU_HIDEMAIL;
 
@@ -60,6 +61,7 @@ ns_cmd_set_private(struct sourceinfo *si, int parc, char *parv[])
 
 		logcommand(si, CMDLOG_SET, "SET:PRIVATE:OFF");
 
+		db_modifying(si->smu);
 		si->smu->flags &= ~MU_PRIVATE;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been removed for \2%s\2."), "PRIVATE", entity(si->smu)->name);
@@ -94,6 +96,7 @@ mod_init(struct module *const restrict m)
 	static struct list_param private;
 	private.opttype = OPT_BOOL;
 	private.is_match = has_private;
+	private.mu_flag = MU_PRIVATE;
 
 	list_register("private", &private);
 }
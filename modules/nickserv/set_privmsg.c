@@ -43,6 +43,7 @@ ns_cmd_set_privmsg(struct sourceinfo *si, int parc, char *parv[])
 
 		logcommand(si, CMDLOG_SET, "SET:PRIVMSG:ON");
 
+		db_modifying(si->smu);
 		si->smu->flags |= MU_USE_PRIVMSG;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been set for \2%s\2."), "PRIVMSG" ,entity(si->smu)->name);
@@ -59,6 +60,7 @@ ns_cmd_set_privmsg(struct sourceinfo *si, int parc, char *parv[])
 
 		logcommand(si, CMDLOG_SET, "SET:PRIVMSG:OFF");
 
+		db_modifying(si->smu);
 		si->smu->flags &= ~MU_USE_PRIVMSG;
 
 		command_success_nodata(si, _("The \2%s\2 flag has been removed for \2%s\2."), "PRIVMSG", entity(si->smu)->name);
@@ -95,6 +97,7 @@ mod_init(struct module *const restrict m)
 	static struct list_param use_privmsg;
 	use_privmsg.opttype = OPT_BOOL;
 	use_privmsg.is_match = uses_privmsg;
+	use_privmsg.mu_flag = MU_USE_PRIVMSG;
 
 	list_register("use-privmsg", &use_privmsg);
 	list_register("use_privmsg", &use_privmsg);
@@ -78,6 +78,7 @@ ns_cmd_setpass(struct sourceinfo *si, int parc, char *parv[])
 
 	if (mu->flags & MU_NOPASSWORD)
 	{
+		db_modifying(mu);
 		mu->flags &= ~MU_NOPASSWORD;
 		command_success_nodata(si, _("The \2%s\2 flag has been removed for account \2%s\2."), "NOPASSWORD", entity(mu)->name);
 	}
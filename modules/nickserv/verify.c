@@ -43,6 +43,7 @@ ns_cmd_verify(struct sourceinfo *si, int parc, char *parv[])
 
 		if (!strcasecmp(key, md->value))
 		{
+			db_modifying(mu);
 			mu->flags &= ~MU_WAITAUTH;
 
 			logcommand(si, CMDLOG_SET, "VERIFY:REGISTER: \2%s\2 (email: \2%s\2)", get_source_name(si), mu->email);
@@ -160,6 +161,7 @@ ns_cmd_fverify(struct sourceinfo *si, int parc, char *parv[])
 			return;
 		}
 
+		db_modifying(mu);
 		mu->flags &= ~MU_WAITAUTH;
 
 		logcommand(si, CMDLOG_REGISTER, "FVERIFY:REGISTER: \2%s\2 (email: \2%s\2)", entity(mu)->name, mu->email);
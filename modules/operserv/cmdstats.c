@@ -0,0 +1,182 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * This file contains code for OS CMDSTATS, which shows the commands that
+ * take the longest to run, from the statistics kept by command_exec().
+ */
+
+#include <atheme.h>
+
+#define CMDSTATS_DEFAULT_COUNT  10U
+#define CMDSTATS_MAX_COUNT      100U
+
+enum cmdstats_order
+{
+	CMDSTATS_BY_P99         = 0,
+	CMDSTATS_BY_MAX         = 1,
+	CMDSTATS_BY_TOTAL       = 2,
+	CMDSTATS_BY_CALLS       = 3,
+};
+
+struct cmdstats_entry
+{
+	const struct command *  cmd;
+	unsigned long long      key;
+};
+
+struct cmdstats_collect
+{
+	enum cmdstats_order     order;
+	struct cmdstats_entry * entries;
+	size_t                  count;
+	size_t                  size;
+};
+
+static int
+cmdstats_collect_cb(struct command *const restrict c, void *const restrict privdata)
+{
+	struct cmdstats_collect *const cs = privdata;
+	unsigned long long key;
+
+	switch (cs->order)
+	{
+		case CMDSTATS_BY_P99:
+			key = command_stats_percentile(&c->stats, 990U);
+			break;
+		case CMDSTATS_BY_MAX:
+			key = c->stats.usec_max;
+			break;
+		case CMDSTATS_BY_TOTAL:
+			key = c->stats.usec_total;
+			break;
+		case CMDSTATS_BY_CALLS:
+		default:
+			key = c->stats.calls;
+			break;
+	}
+
+	if (cs->count == cs->size)
+	{
+		cs->size = cs->size ? (cs->size * 2U) : 64U;
+		cs->entries = sreallocarray(cs->entries, cs->size, sizeof *cs->entries);
+	}
+
+	cs->entries[cs->count].cmd = c;
+	cs->entries[cs->count].key = key;
+	cs->count++;
+
+	return 0;
+}
+
+static int
+cmdstats_entry_cmp(const void *const a, const void *const b)
+{
+	const unsigned long long ka = ((const struct cmdstats_entry *) a)->key;
+	const unsigned long long kb = ((const struct cmdstats_entry *) b)->key;
+
+	// descending
+	return (ka < kb) - (ka > kb);
+}
+
+static const char *
+cmdstats_duration(const unsigned long long usec, char *const restrict buf, const size_t bufsize)
+{
+	if (usec < 1000ULL)
+		(void) snprintf(buf, bufsize, "%lluus", usec);
+	else if (usec < 1000000ULL)
+		(void) snprintf(buf, bufsize, "%llu.%llums", usec / 1000ULL, (usec % 1000ULL) / 100ULL);
+	else
+		(void) snprintf(buf, bufsize, "%llu.%02llus", usec / 1000000ULL, (usec % 1000000ULL) / 10000ULL);
+
+	return buf;
+}
+
+static void
+os_cmd_cmdstats_func(struct sourceinfo *const restrict si, const int parc, char **const restrict parv)
+{
+	struct cmdstats_collect cs = { .order = CMDSTATS_BY_P99 };
+	unsigned int count = CMDSTATS_DEFAULT_COUNT;
+
+	for (int i = 0; i < parc; i++)
+	{
+		if (! strcasecmp(parv[i], "P99"))
+			cs.order = CMDSTATS_BY_P99;
+		else if (! strcasecmp(parv[i], "MAX"))
+			cs.order = CMDSTATS_BY_MAX;
+		else if (! strcasecmp(parv[i], "TOTAL"))
+			cs.order = CMDSTATS_BY_TOTAL;
+		else if (! strcasecmp(parv[i], "CALLS"))
+			cs.order = CMDSTATS_BY_CALLS;
+		else if (! string_to_uint(parv[i], &count) || ! count || count > CMDSTATS_MAX_COUNT)
+		{
+			(void) command_fail(si, fault_badparams, STR_INVALID_PARAMS, "CMDSTATS");
+			(void) command_fail(si, fault_badparams, _("Syntax: CMDSTATS [P99|MAX|TOTAL|CALLS] [count]"));
+			return;
+		}
+	}
+
+	(void) command_stats_foreach(&cmdstats_collect_cb, &cs);
+
+	if (! cs.count)
+	{
+		(void) command_success_nodata(si, _("No commands have been run yet."));
+		(void) logcommand(si, CMDLOG_GET, "CMDSTATS");
+		return;
+	}
+
+	(void) qsort(cs.entries, cs.count, sizeof *cs.entries, &cmdstats_entry_cmp);
+
+	for (size_t i = 0; i < cs.count && i < count; i++)
+	{
+		const struct command_stats *const stats = &cs.entries[i].cmd->stats;
+		const struct command_stats_worst *worst;
+		char p50[32], p99[32], max[32], total[32], worstbuf[32];
+
+		(void) command_success_nodata(si, _("%zu: \2%s %s\2: %llu calls, p50 %s, p99 %s, max %s, total %s"),
+		                              i + 1, stats->service, stats->name, stats->calls,
+		                              cmdstats_duration(command_stats_percentile(stats, 500U), p50, sizeof p50),
+		                              cmdstats_duration(command_stats_percentile(stats, 990U), p99, sizeof p99),
+		                              cmdstats_duration(stats->usec_max, max, sizeof max),
+		                              cmdstats_duration(stats->usec_total, total, sizeof total));
+
+		if ((worst = command_stats_worst(stats)) == NULL)
+			continue;
+
+		(void) command_success_nodata(si, _("    slowest recent: %s by %s, %s ago"),
+		                              cmdstats_duration(worst->usec, worstbuf, sizeof worstbuf),
+		                              worst->source, time_ago(worst->time));
+	}
+
+	(void) command_success_nodata(si, _("End of list (%zu commands have been run)."), cs.count);
+	(void) logcommand(si, CMDLOG_GET, "CMDSTATS");
+
+	(void) sfree(cs.entries);
+}
+
+static struct command os_cmd_cmdstats = {
+	.name           = "CMDSTATS",
+	.desc           = N_("Shows the commands that take the longest to run."),
+	.access         = PRIV_SERVER_AUSPEX,
+	.maxparc        = 2,
+	.cmd            = &os_cmd_cmdstats_func,
+	.help           = { .path = "oservice/cmdstats" },
+};
+
+static void
+mod_init(struct module *const restrict m)
+{
+	MODULE_TRY_REQUEST_DEPENDENCY(m, "operserv/main")
+
+	(void) service_named_bind_command("operserv", &os_cmd_cmdstats);
+}
+
+static void
+mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
+{
+	(void) service_named_unbind_command("operserv", &os_cmd_cmdstats);
+}
+
+SIMPLE_DECLARE_MODULE_V1("operserv/cmdstats", MODULE_UNLOAD_CAPABILITY_OK)
@@ -5,11 +5,64 @@
  * Copyright (C) 2007-2009 Jilles Tjoelker
  *
  * Searches through the logs.
+ *
+ * A search runs from the event loop in short slices, one day's log file
+ * after another, and each day's results are sent as soon as that file is
+ * done. Searches from RPC sources, which cannot receive anything after the
+ * command returns, still run to completion straight away.
+ *
+ * Rotated (older) log files do not change, so the first search that reads
+ * one also writes a sidecar index next to it (<file>.idx) listing the
+ * offsets of the lines for each service and each account. Later searches
+ * for a service, or for a pattern that starts with an account name, only
+ * read those lines.
  */
 
 #include <atheme.h>
 
-#define MAXMATCHES 100
+#define MAXMATCHES              100
+#define GREPLOG_SLICE_US        5000ULL
+#define GREPLOG_INDEX_VERSION   1U
+#define GREPLOG_INDEX_PERLINE   32U
+
+// Offsets of the lines belonging to one key, ascending
+struct greplog_postings
+{
+	char *          key;
+	long *          offsets;
+	size_t          count;
+	size_t          alloc;
+};
+
+struct greplog_job
+{
+	mowgli_node_t           node;
+	struct sourceinfo *     si;
+	char                    service[NICKLEN + 1];
+	char                    pattern[BUFSIZE];
+	char                    account[NICKLEN * 4 + 1];   // from the pattern, canonicalised, or empty
+	char                    baselog[256];
+	char                    logfile[256];
+	unsigned int            day;
+	unsigned int            days;
+	unsigned int            matches;
+	unsigned int            matches_sv;
+	unsigned int            lines;
+	unsigned int            linesv;
+	FILE *                  in;
+	long                    offset;         // of the next line in an unindexed read
+	struct stat             in_stat;
+	struct greplog_postings wanted;         // lines to read, if the file is indexed
+	size_t                  wanted_pos;
+	bool                    indexed;
+	mowgli_patricia_t *     build_services; // being collected for a new index
+	mowgli_patricia_t *     build_accounts;
+	mowgli_list_t           loglines;
+	bool                    cancelled;
+};
+
+static mowgli_list_t greplog_jobs = { NULL, NULL, 0 };
+static mowgli_eventloop_timer_t *greplog_timer = NULL;
 
 static const char *
 get_logfile(const unsigned int *masks)
@@ -52,22 +105,570 @@ get_account_log(void)
 	return get_logfile(masks);
 }
 
-// GREPLOG <service> <mask>
 static void
-os_cmd_greplog(struct sourceinfo *si, int parc, char *parv[])
+postings_add(struct greplog_postings *const p, const long offset)
+{
+	if (p->count == p->alloc)
+	{
+		p->alloc = p->alloc ? (p->alloc * 2U) : 64U;
+		p->offsets = sreallocarray(p->offsets, p->alloc, sizeof *p->offsets);
+	}
+
+	p->offsets[p->count++] = offset;
+}
+
+static void
+postings_clear(struct greplog_postings *const p)
+{
+	sfree(p->offsets);
+	p->offsets = NULL;
+	p->count = 0;
+	p->alloc = 0;
+}
+
+static void
+postings_destroy_cb(const char ATHEME_VATTR_UNUSED *key, void *data, void ATHEME_VATTR_UNUSED *privdata)
+{
+	struct greplog_postings *const p = data;
+
+	postings_clear(p);
+	sfree(p->key);
+	sfree(p);
+}
+
+static void
+postings_add_key(mowgli_patricia_t *const tree, const char *const key, const long offset)
+{
+	struct greplog_postings *p;
+
+	if ((p = mowgli_patricia_retrieve(tree, key)) == NULL)
+	{
+		p = smalloc(sizeof *p);
+		p->key = sstrdup(key);
+		mowgli_patricia_add(tree, p->key, p);
+	}
+
+	postings_add(p, offset);
+}
+
+/* Finds the service name in a log line ("[date time] service source ...").
+ * Returns a pointer to it and sets service_end to the space after it, or
+ * returns NULL if the line is not in the expected format.
+ */
+static char *
+split_line(char *str, char **service_end)
 {
-	const char *service, *pattern, *baselog;
-	unsigned int matches = 0, matches_sv = 0;
-	unsigned int day, days, maxdays, lines, linesv;
-	FILE *in;
-	char str[1024];
 	char *p, *q;
-	char logfile[256];
+
+	p = *str == '[' ? strchr(str, ']') : NULL;
+	if (p == NULL)
+		return NULL;
+	p++;
+	if (*p++ != ' ')
+		return NULL;
+	q = strchr(p, ' ');
+	if (q == NULL)
+		return NULL;
+
+	*service_end = q;
+	return p;
+}
+
+/* The account part of a logged source ("account/id:nick!user@host[ip]" or
+ * "account:type(...)[...]"), canonicalised; empty if there was none.
+ */
+static void
+account_of(const char *source, char *buf, size_t bufsize)
+{
+	size_t len = strcspn(source, "/: ");
+
+	if (len >= bufsize)
+		len = bufsize - 1;
+
+	memcpy(buf, source, len);
+	buf[len] = '\0';
+	irccasecanon(buf);
+}
+
+/* If every line the pattern can match must start with a given account
+ * name, returns it (canonicalised) in buf.
+ */
+static void
+account_of_pattern(const char *pattern, char *buf, size_t bufsize)
+{
+	const size_t len = strcspn(pattern, "*?&#%\\/:");
+
+	buf[0] = '\0';
+
+	if (len == 0 || (pattern[len] != '/' && pattern[len] != ':'))
+		return;
+
+	account_of(pattern, buf, bufsize);
+}
+
+static void
+index_path(const char *logfile, char *buf, size_t bufsize)
+{
+	snprintf(buf, bufsize, "%s.idx", logfile);
+}
+
+static void
+index_write_tree(FILE *out, const char type, mowgli_patricia_t *tree)
+{
+	mowgli_patricia_iteration_state_t state;
+	struct greplog_postings *p;
+
+	MOWGLI_PATRICIA_FOREACH(p, &state, tree)
+	{
+		for (size_t i = 0; i < p->count; i++)
+		{
+			if ((i % GREPLOG_INDEX_PERLINE) == 0)
+				fprintf(out, "%s%c %s", i ? "\n" : "", type, p->key);
+
+			fprintf(out, " %ld", p->offsets[i]);
+		}
+
+		if (p->count)
+			fprintf(out, "\n");
+	}
+}
+
+static void
+index_write(struct greplog_job *job)
+{
+	char path[sizeof job->logfile + 8];
+	char tmppath[sizeof path + 4];
+	FILE *out;
+
+	index_path(job->logfile, path, sizeof path);
+	snprintf(tmppath, sizeof tmppath, "%s.new", path);
+
+	if ((out = fopen(tmppath, "w")) == NULL)
+	{
+		slog(LG_DEBUG, "greplog: cannot write index %s: %s", tmppath, strerror(errno));
+		return;
+	}
+
+	fprintf(out, "GREPLOGIDX %u %lld %lld\n", GREPLOG_INDEX_VERSION,
+	        (long long) job->in_stat.st_size, (long long) job->in_stat.st_mtime);
+	index_write_tree(out, 'S', job->build_services);
+	index_write_tree(out, 'A', job->build_accounts);
+
+	bool failed = ferror(out) != 0;
+
+	if (fclose(out) != 0)
+		failed = true;
+
+	if (failed || srename(tmppath, path) != 0)
+	{
+		slog(LG_DEBUG, "greplog: cannot write index %s: %s", path, strerror(errno));
+		(void) unlink(tmppath);
+	}
+}
+
+static void
+index_read_offsets(char *rest, struct greplog_postings *p)
+{
+	char *tok;
+
+	while ((tok = strtok(rest, " \n")) != NULL)
+	{
+		rest = NULL;
+		postings_add(p, atol(tok));
+	}
+}
+
+/* Loads the lines this search needs from an up-to-date index of the
+ * current file. Returns false if the index is missing or stale, or
+ * cannot narrow the search down.
+ */
+static bool
+index_load(struct greplog_job *job)
+{
+	char path[sizeof job->logfile + 8];
+	char str[1024];
+	struct greplog_postings by_service = { NULL, NULL, 0, 0 };
+	struct greplog_postings by_account = { NULL, NULL, 0, 0 };
+	unsigned int version;
+	long long size, mtime;
+	bool want_service = strcmp(job->service, "*") != 0;
+	bool want_account = job->account[0] != '\0';
+	char service[sizeof job->service];
+	FILE *in;
+
+	if (!want_service && !want_account)
+		return false;
+
+	mowgli_strlcpy(service, job->service, sizeof service);
+	strcasecanon(service);
+
+	index_path(job->logfile, path, sizeof path);
+
+	if ((in = fopen(path, "r")) == NULL)
+		return false;
+
+	if (fgets(str, sizeof str, in) == NULL ||
+	    sscanf(str, "GREPLOGIDX %u %lld %lld", &version, &size, &mtime) != 3 ||
+	    version != GREPLOG_INDEX_VERSION || size != (long long) job->in_stat.st_size ||
+	    mtime != (long long) job->in_stat.st_mtime)
+	{
+		fclose(in);
+		return false;
+	}
+
+	while (fgets(str, sizeof str, in) != NULL)
+	{
+		char *key, *rest;
+
+		if ((str[0] != 'S' && str[0] != 'A') || str[1] != ' ')
+			continue;
+
+		key = str + 2;
+		if ((rest = strchr(key, ' ')) == NULL)
+			continue;
+		*rest++ = '\0';
+
+		if (str[0] == 'S' && want_service && !strcmp(key, service))
+			index_read_offsets(rest, &by_service);
+		else if (str[0] == 'A' && want_account && !strcmp(key, job->account))
+			index_read_offsets(rest, &by_account);
+	}
+
+	fclose(in);
+
+	if (want_service && want_account)
+	{
+		// both are ascending
+		size_t i = 0, j = 0;
+
+		while (i < by_service.count && j < by_account.count)
+		{
+			if (by_service.offsets[i] < by_account.offsets[j])
+				i++;
+			else if (by_service.offsets[i] > by_account.offsets[j])
+				j++;
+			else
+			{
+				postings_add(&job->wanted, by_service.offsets[i]);
+				i++, j++;
+			}
+		}
+
+		postings_clear(&by_service);
+		postings_clear(&by_account);
+	}
+	else if (want_service)
+		job->wanted = by_service;
+	else
+		job->wanted = by_account;
+
+	return true;
+}
+
+static void
+job_print_day(struct greplog_job *job)
+{
+	mowgli_node_t *n, *tn;
+
+	job->matches = job->matches_sv;
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, job->loglines.head)
+	{
+		job->matches++;
+		command_success_nodata(job->si, "[%u] %s", job->matches, (const char *) n->data);
+		mowgli_node_delete(n, &job->loglines);
+		sfree(n->data);
+		mowgli_node_free(n);
+	}
+}
+
+static void
+job_close_day(struct greplog_job *job)
+{
+	if (job->in != NULL)
+	{
+		fclose(job->in);
+		job->in = NULL;
+	}
+
+	if (job->build_services != NULL)
+	{
+		mowgli_patricia_destroy(job->build_services, &postings_destroy_cb, NULL);
+		mowgli_patricia_destroy(job->build_accounts, &postings_destroy_cb, NULL);
+		job->build_services = NULL;
+		job->build_accounts = NULL;
+	}
+
+	postings_clear(&job->wanted);
+	job->wanted_pos = 0;
+	job->indexed = false;
+}
+
+static void
+job_free(struct greplog_job *job)
+{
+	mowgli_node_t *n, *tn;
+
+	job_close_day(job);
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, job->loglines.head)
+	{
+		mowgli_node_delete(n, &job->loglines);
+		sfree(n->data);
+		mowgli_node_free(n);
+	}
+
+	atheme_object_unref(job->si);
+	sfree(job);
+}
+
+// Opens the file for job->day. Returns false if it could not be opened.
+static bool
+job_open_day(struct greplog_job *job)
+{
 	time_t t;
 	struct tm *tm;
-	mowgli_list_t loglines = { NULL, NULL, 0 };
+
+	if (job->day == 0)
+		mowgli_strlcpy(job->logfile, job->baselog, sizeof job->logfile);
+	else
+	{
+		t = CURRTIME - (job->day * SECONDS_PER_DAY);
+		tm = localtime(&t);
+		snprintf(job->logfile, sizeof job->logfile, "%s.%04u%02u%02u",
+				job->baselog, (unsigned int) (tm->tm_year + 1900),
+				(unsigned int) (tm->tm_mon + 1), (unsigned int) tm->tm_mday);
+	}
+
+	job->in = fopen(job->logfile, "r");
+	if (job->in == NULL)
+		return false;
+
+	job->matches_sv = job->matches;
+	job->lines = job->linesv = 0;
+	job->offset = 0;
+
+	if (fstat(fileno(job->in), &job->in_stat) != 0)
+		memset(&job->in_stat, 0, sizeof job->in_stat);
+
+	// today's file is still being written to
+	if (job->day == 0)
+		return true;
+
+	if (index_load(job))
+		job->indexed = true;
+	else
+	{
+		job->build_services = mowgli_patricia_create(noopcanon);
+		job->build_accounts = mowgli_patricia_create(noopcanon);
+	}
+
+	return true;
+}
+
+static void
+job_line(struct greplog_job *job, char *str, long offset)
+{
+	char *p, *q;
+	mowgli_node_t *n;
+
+	p = strchr(str, '\n');
+	if (p != NULL)
+		*p = '\0';
+	job->lines++;
+	if ((p = split_line(str, &q)) == NULL)
+		return;
+	job->linesv++;
+	*q = '\0';
+
+	if (job->build_services != NULL)
+	{
+		char key[BUFSIZE];
+
+		mowgli_strlcpy(key, p, sizeof key);
+		strcasecanon(key);
+		postings_add_key(job->build_services, key, offset);
+
+		account_of(q + 1, key, NICKLEN * 4 + 1);
+		if (key[0] != '\0')
+			postings_add_key(job->build_accounts, key, offset);
+	}
+
+	if (strcmp(job->service, "*") && strcasecmp(job->service, p))
+		return;
+	*q++ = ' ';
+	if (match(job->pattern, q))
+		return;
+	job->matches++;
+	mowgli_node_add_head(sstrdup(str), mowgli_node_create(), &job->loglines);
+	if (job->matches > MAXMATCHES)
+	{
+		n = job->loglines.tail;
+		mowgli_node_delete(n, &job->loglines);
+		sfree(n->data);
+		mowgli_node_free(n);
+	}
+}
+
+/* Reads lines of the current file until it ends or the time is up.
+ * Returns true at the end of the file.
+ */
+static bool
+job_read(struct greplog_job *job, const struct timeval *tv_start, unsigned long long budget)
+{
+	char str[1024];
+	struct timeval tv;
+	unsigned int count = 0;
+
+	for (;;)
+	{
+		long offset;
+
+		if (budget && (++count % 64U) == 0)
+		{
+			e_time(*tv_start, &tv);
+			if (tv2us(&tv) >= budget)
+				return false;
+		}
+
+		if (job->indexed)
+		{
+			if (job->wanted_pos >= job->wanted.count)
+				return true;
+
+			offset = job->wanted.offsets[job->wanted_pos++];
+			if (fseek(job->in, offset, SEEK_SET) != 0)
+				return true;
+		}
+		else
+			offset = job->offset;
+
+		if (fgets(str, sizeof str, job->in) == NULL)
+			return true;
+
+		job->offset += (long) strlen(str);
+
+		job_line(job, str, offset);
+	}
+}
+
+static void
+job_finish(struct greplog_job *job)
+{
+	logcommand(job->si, CMDLOG_ADMIN, "GREPLOG: \2%s\2 \2%s\2 (\2%u\2 matches)", job->service, job->pattern, job->matches);
+	if (job->matches == 0)
+		command_success_nodata(job->si, _("No lines matched pattern \2%s\2"), job->pattern);
+	else if (job->matches > 0)
+		command_success_nodata(job->si, ngettext(N_("\2%u\2 match for pattern \2%s\2"),
+						    N_("\2%u\2 matches for pattern \2%s\2"), job->matches), job->matches, job->pattern);
+}
+
+/* Advances a search for at most budget microseconds (0: no limit).
+ * Returns true when it is finished.
+ */
+static bool
+job_run(struct greplog_job *job, const struct timeval *tv_start, unsigned long long budget)
+{
+	while (job->day <= job->days)
+	{
+		if (job->in == NULL && !job_open_day(job))
+		{
+			command_success_nodata(job->si, _("Failed to open log file %s"), job->logfile);
+			job->day++;
+			continue;
+		}
+
+		if (!job_read(job, tv_start, budget))
+			return false;
+
+		if (job->build_services != NULL && !ferror(job->in))
+			index_write(job);
+
+		job_close_day(job);
+		job_print_day(job);
+
+		if (job->matches == 0 && job->lines > job->linesv && job->lines > 0)
+			command_success_nodata(job->si, _("Log file may be corrupted, %u/%u unexpected lines"), job->lines - job->linesv, job->lines);
+		if (job->matches >= MAXMATCHES)
+		{
+			command_success_nodata(job->si, _("Too many matches, halting search"));
+			break;
+		}
+
+		job->day++;
+	}
+
+	job_finish(job);
+	return true;
+}
+
+static void
+greplog_slice(void ATHEME_VATTR_UNUSED *unused)
+{
+	struct timeval tv_start;
 	mowgli_node_t *n, *tn;
 
+	greplog_timer = NULL;
+
+	s_time(&tv_start);
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, greplog_jobs.head)
+	{
+		struct greplog_job *job = n->data;
+
+		if (!job->cancelled && !job_run(job, &tv_start, GREPLOG_SLICE_US))
+		{
+			// out of time; let the others go first next time
+			mowgli_node_delete(&job->node, &greplog_jobs);
+			mowgli_node_add(job, &job->node, &greplog_jobs);
+			break;
+		}
+
+		mowgli_node_delete(&job->node, &greplog_jobs);
+		job_free(job);
+	}
+
+	if (MOWGLI_LIST_LENGTH(&greplog_jobs))
+		greplog_timer = mowgli_timer_add_once(base_eventloop, "greplog_slice", &greplog_slice, NULL, 0);
+}
+
+static void
+greplog_user_delete(struct user *u)
+{
+	mowgli_node_t *n;
+
+	MOWGLI_ITER_FOREACH(n, greplog_jobs.head)
+	{
+		struct greplog_job *job = n->data;
+
+		if (job->si->su == u)
+			job->cancelled = true;
+	}
+}
+
+static bool
+greplog_pending(const struct user *u)
+{
+	mowgli_node_t *n;
+
+	MOWGLI_ITER_FOREACH(n, greplog_jobs.head)
+	{
+		const struct greplog_job *job = n->data;
+
+		if (job->si->su == u && !job->cancelled)
+			return true;
+	}
+
+	return false;
+}
+
+// GREPLOG <service> <mask>
+static void
+os_cmd_greplog(struct sourceinfo *si, int parc, char *parv[])
+{
+	const char *service, *pattern, *baselog;
+	unsigned int days, maxdays;
+	struct greplog_job *job;
+
 	// require user, channel and server auspex (channel auspex checked via in struct command)
 	if (!has_priv(si, PRIV_USER_AUSPEX))
 	{
@@ -109,84 +710,32 @@ os_cmd_greplog(struct sourceinfo *si, int parc, char *parv[])
 		return;
 	}
 
-	for (day = 0; day <= days; day++)
+	if (si->su != NULL && greplog_pending(si->su))
 	{
-		if (day == 0)
-			mowgli_strlcpy(logfile, baselog, sizeof logfile);
-		else
-		{
-			t = CURRTIME - (day * SECONDS_PER_DAY);
-			tm = localtime(&t);
-			snprintf(logfile, sizeof logfile, "%s.%04u%02u%02u",
-					baselog, (unsigned int) (tm->tm_year + 1900),
-					(unsigned int) (tm->tm_mon + 1), (unsigned int) tm->tm_mday);
-		}
-		in = fopen(logfile, "r");
-		if (in == NULL)
-		{
-			command_success_nodata(si, _("Failed to open log file %s"), logfile);
-			continue;
-		}
-		matches_sv = matches;
-		lines = linesv = 0;
-		while (fgets(str, sizeof str, in) != NULL)
-		{
-			p = strchr(str, '\n');
-			if (p != NULL)
-				*p = '\0';
-			lines++;
-			p = *str == '[' ? strchr(str, ']') : NULL;
-			if (p == NULL)
-				continue;
-			p++;
-			if (*p++ != ' ')
-				continue;
-			q = strchr(p, ' ');
-			if (q == NULL)
-				continue;
-			linesv++;
-			*q = '\0';
-			if (strcmp(service, "*") && strcasecmp(service, p))
-				continue;
-			*q++ = ' ';
-			if (match(pattern, q))
-				continue;
-			matches++;
-			mowgli_node_add_head(sstrdup(str), mowgli_node_create(), &loglines);
-			if (matches > MAXMATCHES)
-			{
-				n = loglines.tail;
-				mowgli_node_delete(n, &loglines);
-				sfree(n->data);
-				mowgli_node_free(n);
-			}
-		}
-		fclose(in);
-		matches = matches_sv;
-		MOWGLI_ITER_FOREACH_SAFE(n, tn, loglines.head)
-		{
-			p = n->data;
-			matches++;
-			command_success_nodata(si, "[%u] %s", matches, p);
-			mowgli_node_delete(n, &loglines);
-			sfree(n->data);
-			mowgli_node_free(n);
-		}
-		if (matches == 0 && lines > linesv && lines > 0)
-			command_success_nodata(si, _("Log file may be corrupted, %u/%u unexpected lines"), lines - linesv, lines);
-		if (matches >= MAXMATCHES)
-		{
-			command_success_nodata(si, _("Too many matches, halting search"));
-			break;
-		}
+		command_fail(si, fault_toomany, _("Your previous GREPLOG is still running."));
+		return;
 	}
 
-	logcommand(si, CMDLOG_ADMIN, "GREPLOG: \2%s\2 \2%s\2 (\2%u\2 matches)", service, pattern, matches);
-	if (matches == 0)
-		command_success_nodata(si, _("No lines matched pattern \2%s\2"), pattern);
-	else if (matches > 0)
-		command_success_nodata(si, ngettext(N_("\2%u\2 match for pattern \2%s\2"),
-						    N_("\2%u\2 matches for pattern \2%s\2"), matches), matches, pattern);
+	job = smalloc(sizeof *job);
+	job->si = atheme_object_ref(si);
+	job->days = days;
+	mowgli_strlcpy(job->service, service, sizeof job->service);
+	mowgli_strlcpy(job->pattern, pattern, sizeof job->pattern);
+	mowgli_strlcpy(job->baselog, baselog, sizeof job->baselog);
+	account_of_pattern(pattern, job->account, sizeof job->account);
+
+	// RPC sources cannot be answered later
+	if (si->su == NULL)
+	{
+		(void) job_run(job, NULL, 0);
+		job_free(job);
+		return;
+	}
+
+	mowgli_node_add(job, &job->node, &greplog_jobs);
+
+	if (greplog_timer == NULL)
+		greplog_timer = mowgli_timer_add_once(base_eventloop, "greplog_slice", &greplog_slice, NULL, 0);
 }
 
 static struct command os_greplog = {
@@ -204,12 +753,29 @@ mod_init(struct module *const restrict m)
 	MODULE_TRY_REQUEST_DEPENDENCY(m, "operserv/main")
 
 	service_named_bind_command("operserv", &os_greplog);
+
+	hook_add_user_delete(greplog_user_delete);
 }
 
 static void
 mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 {
+	mowgli_node_t *n, *tn;
+
 	service_named_unbind_command("operserv", &os_greplog);
+
+	hook_del_user_delete(greplog_user_delete);
+
+	if (greplog_timer != NULL)
+		mowgli_timer_destroy(base_eventloop, greplog_timer);
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, greplog_jobs.head)
+	{
+		struct greplog_job *job = n->data;
+
+		mowgli_node_delete(&job->node, &greplog_jobs);
+		job_free(job);
+	}
 }
 
 SIMPLE_DECLARE_MODULE_V1("operserv/greplog", MODULE_UNLOAD_CAPABILITY_OK)
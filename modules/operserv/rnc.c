@@ -5,79 +5,212 @@
  * Copyright (C) 2006 Robin Burchell <surreal.w00t@gmail.com>
  *
  * This file contains functionality implementing OperServ RNC.
+ *
+ * The number of users with each realname is kept up to date as users
+ * connect and quit. Realnames are grouped into buckets of equal count,
+ * kept in ascending order, so a user coming or going only ever moves its
+ * realname into a neighbouring bucket, and the most common realnames are
+ * simply the ones in the last buckets.
  */
 
 #include <atheme.h>
 
+#define RNC_PRIVATEDATA_KEY     "operserv:rnc"
+
+struct rnc_bucket
+{
+	unsigned int    count;
+	mowgli_list_t   entries;        // struct rnc_entry
+	mowgli_node_t   node;           // in rnc_buckets
+};
+
 struct rnc
 {
-	const char *gecos;
-	unsigned int count;
+	stringref               gecos;
+	struct rnc_bucket *     bucket;
+	mowgli_node_t           node;   // in bucket->entries
+	bool                    alerted;
 };
 
+static struct service *serviceinfo = NULL;
+static mowgli_patricia_t *realnames = NULL;
+static mowgli_list_t rnc_buckets = { NULL, NULL, 0 };
+static unsigned int rnc_alert = 0;
+
+static struct rnc_bucket *
+rnc_bucket_create(const unsigned int count)
+{
+	struct rnc_bucket *const bucket = smalloc(sizeof *bucket);
+
+	bucket->count = count;
+
+	return bucket;
+}
+
 static void
-os_cmd_rnc(struct sourceinfo *si, int parc, char *parv[])
+rnc_bucket_release(struct rnc_bucket *const bucket)
 {
-	char *param = parv[0];
-	unsigned int count = 20;
+	if (MOWGLI_LIST_LENGTH(&bucket->entries))
+		return;
 
-	if (param && ! string_to_uint(param, &count))
-		count = 20;
+	mowgli_node_delete(&bucket->node, &rnc_buckets);
+	sfree(bucket);
+}
 
-	struct user *u;
-	struct rnc *rnc, *biggest;
-	mowgli_patricia_t *realnames;
-	unsigned int i, found = 0;
-	mowgli_patricia_iteration_state_t state;
+static void
+rnc_move(struct rnc *const rnc, struct rnc_bucket *const bucket)
+{
+	struct rnc_bucket *const old = rnc->bucket;
 
-	realnames = mowgli_patricia_create(noopcanon);
+	if (old != NULL)
+		mowgli_node_delete(&rnc->node, &old->entries);
 
-	MOWGLI_PATRICIA_FOREACH(u, &state, userlist)
+	mowgli_node_add(rnc, &rnc->node, &bucket->entries);
+	rnc->bucket = bucket;
+
+	if (old != NULL)
+		rnc_bucket_release(old);
+}
+
+static void
+rnc_check_alert(struct rnc *const rnc, const struct user *const u)
+{
+	const unsigned int count = rnc->bucket->count;
+
+	if (! rnc_alert)
+		return;
+
+	// don't repeat the alert while the count hovers around the threshold
+	if (rnc->alerted)
 	{
-		rnc = mowgli_patricia_retrieve(realnames, u->gecos);
-		if (rnc != NULL)
-			rnc->count++;
-		else
+		if (count < (rnc_alert / 2U))
+			rnc->alerted = false;
+
+		return;
+	}
+
+	if (count < rnc_alert || u == NULL)
+		return;
+
+	rnc->alerted = true;
+
+	(void) slog(LG_INFO, "RNC: \2%u\2 users with realname \2%s\2 (latest %s!%s@%s)",
+	            count, rnc->gecos, u->nick, u->user, u->host);
+}
+
+static void
+rnc_user_add(struct hook_user_nick *const data)
+{
+	struct user *const u = data->u;
+	struct rnc_bucket *bucket;
+	struct rnc *rnc;
+
+	// If the user has been killed, don't do anything.
+	if (! u)
+		return;
+
+	if ((rnc = mowgli_patricia_retrieve(realnames, u->gecos)) == NULL)
+	{
+		rnc = smalloc(sizeof *rnc);
+		rnc->gecos = strshare_ref(u->gecos);
+		(void) mowgli_patricia_add(realnames, rnc->gecos, rnc);
+
+		bucket = (rnc_buckets.head != NULL) ? rnc_buckets.head->data : NULL;
+
+		if (bucket == NULL || bucket->count != 1U)
 		{
-			rnc = smalloc(sizeof *rnc);
-			rnc->gecos = u->gecos;
-			rnc->count = 1;
-			mowgli_patricia_add(realnames, rnc->gecos, rnc);
+			bucket = rnc_bucket_create(1U);
+			mowgli_node_add_head(bucket, &bucket->node, &rnc_buckets);
 		}
 	}
-
-	// this is ugly to the max :P
-	for (i = 1; i <= count; i++)
+	else
 	{
-		found = 0;
-		biggest = NULL;
-		MOWGLI_PATRICIA_FOREACH(rnc, &state, realnames)
+		const mowgli_node_t *const next = rnc->bucket->node.next;
+
+		bucket = (next != NULL) ? next->data : NULL;
+
+		if (bucket == NULL || bucket->count != rnc->bucket->count + 1U)
 		{
-			if (rnc->count > found)
-			{
-				found = rnc->count;
-				biggest = rnc;
-			}
+			bucket = rnc_bucket_create(rnc->bucket->count + 1U);
+			mowgli_node_add_after(bucket, &bucket->node, &rnc_buckets, &rnc->bucket->node);
 		}
+	}
 
-		if (biggest == NULL)
-			break;
+	(void) rnc_move(rnc, bucket);
+	(void) privatedata_set(u, RNC_PRIVATEDATA_KEY, rnc);
+	(void) rnc_check_alert(rnc, u);
+}
+
+static void
+rnc_user_delete(struct user *const u)
+{
+	struct rnc *const rnc = privatedata_get(u, RNC_PRIVATEDATA_KEY);
+	struct rnc_bucket *bucket;
+
+	// Killed by another user_add hook before ours saw them
+	if (rnc == NULL)
+		return;
 
-		command_success_nodata(si, ngettext(N_("\2%u\2: \2%u\2 match for realname \2%s\2"),
-		                                    N_("\2%u\2: \2%u\2 matches for realname \2%s\2"),
-		                                    biggest->count), i, biggest->count, biggest->gecos);
+	(void) mowgli_patricia_delete(atheme_object(u)->privatedata, RNC_PRIVATEDATA_KEY);
+
+	if (rnc->bucket->count == 1U)
+	{
+		bucket = rnc->bucket;
 
-		mowgli_patricia_delete(realnames, biggest->gecos);
-		sfree(biggest);
+		mowgli_node_delete(&rnc->node, &bucket->entries);
+		(void) rnc_bucket_release(bucket);
+
+		(void) mowgli_patricia_delete(realnames, rnc->gecos);
+		(void) strshare_unref(rnc->gecos);
+		(void) sfree(rnc);
+		return;
 	}
 
-	// cleanup
-	MOWGLI_PATRICIA_FOREACH(rnc, &state, realnames)
+	const mowgli_node_t *const prev = rnc->bucket->node.prev;
+
+	bucket = (prev != NULL) ? prev->data : NULL;
+
+	if (bucket == NULL || bucket->count != rnc->bucket->count - 1U)
 	{
-		mowgli_patricia_delete(realnames, rnc->gecos);
-		sfree(rnc);
+		bucket = rnc_bucket_create(rnc->bucket->count - 1U);
+		mowgli_node_add_before(bucket, &bucket->node, &rnc_buckets, &rnc->bucket->node);
+	}
+
+	(void) rnc_move(rnc, bucket);
+	(void) rnc_check_alert(rnc, NULL);
+}
+
+static void
+os_cmd_rnc(struct sourceinfo *si, int parc, char *parv[])
+{
+	char *param = parv[0];
+	unsigned int count = 20;
+
+	if (param && ! string_to_uint(param, &count))
+		count = 20;
+
+	mowgli_node_t *bn, *n;
+	unsigned int i = 0;
+
+	MOWGLI_ITER_FOREACH_PREV(bn, rnc_buckets.tail)
+	{
+		const struct rnc_bucket *const bucket = bn->data;
+
+		MOWGLI_ITER_FOREACH(n, bucket->entries.head)
+		{
+			const struct rnc *const rnc = n->data;
+
+			if (i++ >= count)
+				break;
+
+			command_success_nodata(si, ngettext(N_("\2%u\2: \2%u\2 match for realname \2%s\2"),
+			                                    N_("\2%u\2: \2%u\2 matches for realname \2%s\2"),
+			                                    bucket->count), i, bucket->count, rnc->gecos);
+		}
+
+		if (i >= count)
+			break;
 	}
-	mowgli_patricia_destroy(realnames, NULL, NULL);
 
 	logcommand(si, CMDLOG_ADMIN, "RNC: \2%u\2", count);
 }
@@ -96,13 +229,53 @@ mod_init(struct module *const restrict m)
 {
 	MODULE_TRY_REQUEST_DEPENDENCY(m, "operserv/main")
 
-	service_named_bind_command("operserv", &os_rnc);
+	if (! (serviceinfo = service_find("operserv")))
+	{
+		(void) slog(LG_ERROR, "%s: cannot find OperServ (BUG?)", m->name);
+
+		m->mflags |= MODFLAG_FAIL;
+		return;
+	}
+
+	if (! (realnames = mowgli_patricia_create(&noopcanon)))
+	{
+		(void) slog(LG_ERROR, "%s: mowgli_patricia_create() failed", m->name);
+
+		m->mflags |= MODFLAG_FAIL;
+		return;
+	}
+
+	(void) hook_add_user_add(&rnc_user_add);
+	(void) hook_add_user_delete(&rnc_user_delete);
+
+	(void) add_uint_conf_item("RNC_ALERT", &serviceinfo->conf_table, 0, &rnc_alert, 0, INT_MAX, 0);
+
+	(void) service_named_bind_command("operserv", &os_rnc);
+
+	// count everyone who is already connected
+	struct user *u;
+	mowgli_patricia_iteration_state_t state;
+	MOWGLI_PATRICIA_FOREACH(u, &state, userlist)
+		(void) rnc_user_add(&(struct hook_user_nick){ .u = u });
 }
 
 static void
 mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 {
-	service_named_unbind_command("operserv", &os_rnc);
+	struct user *u;
+	mowgli_patricia_iteration_state_t state;
+
+	(void) service_named_unbind_command("operserv", &os_rnc);
+
+	(void) del_conf_item("RNC_ALERT", &serviceinfo->conf_table);
+
+	(void) hook_del_user_add(&rnc_user_add);
+	(void) hook_del_user_delete(&rnc_user_delete);
+
+	MOWGLI_PATRICIA_FOREACH(u, &state, userlist)
+		(void) rnc_user_delete(u);
+
+	(void) mowgli_patricia_destroy(realnames, NULL, NULL);
 }
 
 SIMPLE_DECLARE_MODULE_V1("operserv/rnc", MODULE_UNLOAD_CAPABILITY_OK)
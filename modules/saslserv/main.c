@@ -17,14 +17,34 @@
 #define ASASL_OUTFLAGS_WIPE_FREE_BUF    (ASASL_OUTFLAG_WIPE_BUF | ASASL_OUTFLAG_FREE_BUF)
 #define LOGIN_CANCELLED_STR             "There was a problem logging you in; login cancelled"
 
+// Number of recent mechanism step latencies to keep for the median calculation
+#define SASL_STEP_LATENCY_SAMPLES       128U
+
+struct sasl_mechanism_stats
+{
+	char            name[SASL_MECHANISM_MAXLEN];
+	unsigned int    started;                                // Sessions that selected this mechanism
+	unsigned int    succeeded;                              // Sessions that logged in successfully
+	unsigned int    failed;                                 // Sessions that were aborted or failed
+	unsigned int    timedout;                               // Sessions removed by sasl_delete_stale()
+	unsigned int    step_usec[SASL_STEP_LATENCY_SAMPLES];   // Ring buffer of recent step latencies
+	unsigned int    step_count;                             // Total number of steps recorded
+};
+
 static mowgli_list_t sasl_sessions;
+static mowgli_patricia_t *sasl_sessions_by_uid = NULL;
 static mowgli_list_t sasl_mechanisms;
+static mowgli_patricia_t *sasl_mechanism_stats = NULL;
 static char sasl_mechlist_string[SASL_S2S_MAXLEN_ATONCE_B64];
 static bool sasl_hide_server_names;
 
 static mowgli_eventloop_timer_t *sasl_delete_stale_timer = NULL;
 static struct service *saslsvs = NULL;
 
+static struct metric *sasl_metric_sessions = NULL;
+static struct metric *sasl_metric_started = NULL;
+static struct metric *sasl_metric_outcomes = NULL;
+
 static const char *
 sasl_format_sourceinfo(struct sourceinfo *const restrict si, const bool full)
 {
@@ -108,17 +128,7 @@ sasl_session_find(const char *const restrict uid)
 	if (! uid || ! *uid)
 		return NULL;
 
-	mowgli_node_t *n;
-
-	MOWGLI_ITER_FOREACH(n, sasl_sessions.head)
-	{
-		struct sasl_session *const p = n->data;
-
-		if (strcmp(p->uid, uid) == 0)
-			return p;
-	}
-
-	return NULL;
+	return mowgli_patricia_retrieve(sasl_sessions_by_uid, uid);
 }
 
 static struct sasl_session *
@@ -134,6 +144,7 @@ sasl_session_find_or_make(const struct sasl_message *const restrict smsg)
 
 		(void) mowgli_strlcpy(p->uid, smsg->uid, sizeof p->uid);
 		(void) mowgli_node_add(p, &p->node, &sasl_sessions);
+		(void) mowgli_patricia_add(sasl_sessions_by_uid, p->uid, p);
 	}
 
 	return p;
@@ -157,6 +168,105 @@ sasl_mechanism_find(const char *const restrict name)
 	return NULL;
 }
 
+static struct sasl_mechanism_stats *
+sasl_mechanism_stats_find(const struct sasl_mechanism *const restrict mech)
+{
+	return_val_if_fail(mech != NULL, NULL);
+
+	return mowgli_patricia_retrieve(sasl_mechanism_stats, mech->name);
+}
+
+static void
+sasl_mechanism_stats_add_step(const struct sasl_mechanism *const restrict mech, const struct timeval *const restrict tv)
+{
+	struct sasl_mechanism_stats *const ms = sasl_mechanism_stats_find(mech);
+
+	if (! ms)
+		return;
+
+	const unsigned long long usec = tv2us(tv);
+
+	ms->step_usec[ms->step_count % SASL_STEP_LATENCY_SAMPLES] = (unsigned int) MINIMUM(usec, UINT_MAX);
+	ms->step_count++;
+}
+
+static int
+sasl_step_latency_cmp(const void *const restrict a, const void *const restrict b)
+{
+	const unsigned int x = *((const unsigned int *) a);
+	const unsigned int y = *((const unsigned int *) b);
+
+	return (x > y) - (x < y);
+}
+
+static unsigned int
+sasl_mechanism_stats_median_step(const struct sasl_mechanism_stats *const restrict ms)
+{
+	const unsigned int count = MINIMUM(ms->step_count, SASL_STEP_LATENCY_SAMPLES);
+
+	if (! count)
+		return 0;
+
+	unsigned int samples[SASL_STEP_LATENCY_SAMPLES];
+
+	(void) memcpy(samples, ms->step_usec, count * sizeof samples[0]);
+	(void) qsort(samples, count, sizeof samples[0], &sasl_step_latency_cmp);
+
+	if (count % 2)
+		return samples[count / 2];
+
+	return (samples[(count / 2) - 1] + samples[count / 2]) / 2;
+}
+
+static void
+sasl_session_count_outcome(struct sasl_session *const restrict p, const bool success, const bool timedout)
+{
+	if (! p->mechptr || (p->flags & ASASL_SFLAG_OUTCOME_COUNTED))
+		return;
+
+	p->flags |= ASASL_SFLAG_OUTCOME_COUNTED;
+
+	char labels[BUFSIZE];
+
+	(void) metric_labels(labels, sizeof labels, "mechanism", p->mechptr->name,
+	                     "outcome", success ? "success" : (timedout ? "timeout" : "failure"), NULL);
+	(void) metric_add(sasl_metric_outcomes, labels, 1);
+
+	struct sasl_mechanism_stats *const ms = sasl_mechanism_stats_find(p->mechptr);
+
+	if (! ms)
+		return;
+
+	if (success)
+		ms->succeeded++;
+	else if (timedout)
+		ms->timedout++;
+	else
+		ms->failed++;
+}
+
+static void
+sasl_stats_request(struct hook_stats_req *const restrict req)
+{
+	if (req->req != 'S' && req->req != 's')
+		return;
+
+	if (! has_priv_user(req->u, PRIV_SERVER_AUSPEX))
+		return;
+
+	(void) numeric_sts(me.me, 249, req->u, "S :%-24s %9s %9s %9s %9s %12s", "Mechanism", "Started",
+	                   "Succeeded", "Failed", "Timed out", "Median step");
+
+	mowgli_patricia_iteration_state_t state;
+	const struct sasl_mechanism_stats *ms;
+
+	MOWGLI_PATRICIA_FOREACH(ms, &state, sasl_mechanism_stats)
+		(void) numeric_sts(me.me, 249, req->u, "S :%-24s %9u %9u %9u %9u %10uus", ms->name, ms->started,
+		                   ms->succeeded, ms->failed, ms->timedout, sasl_mechanism_stats_median_step(ms));
+
+	(void) numeric_sts(me.me, 249, req->u, "S :%zu sessions in progress", MOWGLI_LIST_LENGTH(&sasl_sessions));
+}
+
 static void
 sasl_server_eob(struct server ATHEME_VATTR_UNUSED *const restrict s)
 {
@@ -320,6 +430,7 @@ sasl_user_can_login(struct sasl_session *const restrict p)
 	 */
 	if (ircd->flags & IRCD_SASL_USE_PUID)
 	{
+		db_modifying(target_mu);
 		target_mu->flags &= ~MU_NOBURSTLOGIN;
 		target_mu->flags |= MU_PENDINGLOGIN;
 	}
@@ -334,16 +445,12 @@ sasl_user_can_login(struct sasl_session *const restrict p)
 static void
 sasl_session_destroy(struct sasl_session *const restrict p)
 {
-	mowgli_node_t *n;
+	(void) sasl_session_count_outcome(p, false, false);
 
-	MOWGLI_ITER_FOREACH(n, sasl_sessions.head)
-	{
-		if (n == &p->node && n->data == p)
-		{
-			(void) mowgli_node_delete(n, &sasl_sessions);
-			break;
-		}
-	}
+	if (mowgli_patricia_retrieve(sasl_sessions_by_uid, p->uid) == p)
+		(void) mowgli_patricia_delete(sasl_sessions_by_uid, p->uid);
+
+	(void) mowgli_node_delete(&p->node, &sasl_sessions);
 
 	if (p->mechptr && p->mechptr->mech_finish)
 		(void) p->mechptr->mech_finish(p);
@@ -385,6 +492,7 @@ sasl_session_success(struct sasl_session *const restrict p, struct myuser *const
 	}
 
 	(void) sasl_sts(p->uid, 'D', "S");
+	(void) sasl_session_count_outcome(p, true, false);
 
 	if (destroy)
 		(void) sasl_session_destroy(p);
@@ -437,6 +545,7 @@ sasl_handle_login(struct sasl_session *const restrict p, struct user *const u, s
 			{
 				if (n->data == u)
 				{
+					db_modifying(u->myuser);
 					(void) mowgli_node_delete(n, &u->myuser->logins);
 					(void) mowgli_node_free(n);
 					break;
@@ -459,6 +568,7 @@ sasl_handle_login(struct sasl_session *const restrict p, struct user *const u, s
 		else
 		{
 			// Otherwise, just update login time ...
+			db_modifying(mu);
 			mu->lastlogin = CURRTIME;
 			(void) logcommand_user(saslsvs, u, CMDLOG_LOGIN, "REAUTHENTICATE (%s)", p->mechptr->name);
 		}
@@ -589,6 +699,8 @@ sasl_process_packet(struct sasl_session *const restrict p, char *const restrict
 
 	enum sasl_mechanism_result rc;
 	bool have_responded = false;
+	struct timeval step_start;
+	struct timeval step_time;
 
 	if (! p->mechptr && ! len)
 	{
@@ -601,8 +713,23 @@ sasl_process_packet(struct sasl_session *const restrict p, char *const restrict
 
 		(void) sasl_sourceinfo_recreate(p);
 
+		struct sasl_mechanism_stats *const ms = sasl_mechanism_stats_find(p->mechptr);
+
+		if (ms)
+			ms->started++;
+
+		char labels[BUFSIZE];
+
+		(void) metric_labels(labels, sizeof labels, "mechanism", p->mechptr->name, NULL);
+		(void) metric_add(sasl_metric_started, labels, 1);
+
 		if (p->mechptr->mech_start)
+		{
+			(void) s_time(&step_start);
 			rc = p->mechptr->mech_start(p, &outbuf);
+			(void) e_time(step_start, &step_time);
+			(void) sasl_mechanism_stats_add_step(p->mechptr, &step_time);
+		}
 		else
 			rc = ASASL_MRESULT_CONTINUE;
 	}
@@ -613,7 +740,10 @@ sasl_process_packet(struct sasl_session *const restrict p, char *const restrict
 	}
 	else
 	{
+		(void) s_time(&step_start);
 		rc = sasl_process_input(p, buf, len, &outbuf);
+		(void) e_time(step_start, &step_time);
+		(void) sasl_mechanism_stats_add_step(p->mechptr, &step_time);
 	}
 
 	if (outbuf.buf && outbuf.len)
@@ -907,7 +1037,10 @@ sasl_delete_stale(void ATHEME_VATTR_UNUSED *const restrict vptr)
 		struct sasl_session *const p = n->data;
 
 		if (p->flags & ASASL_SFLAG_MARKED_FOR_DELETION)
+		{
+			(void) sasl_session_count_outcome(p, false, true);
 			(void) sasl_session_destroy(p);
+		}
 		else
 			p->flags |= ASASL_SFLAG_MARKED_FOR_DELETION;
 	}
@@ -924,6 +1057,15 @@ sasl_mech_register(const struct sasl_mechanism *const restrict mech)
 
 	(void) slog(LG_DEBUG, "%s: registering %s", MOWGLI_FUNC_NAME, mech->name);
 
+	// Statistics are kept across unregistration so that reloading a mechanism module does not reset them
+	if (! mowgli_patricia_retrieve(sasl_mechanism_stats, mech->name))
+	{
+		struct sasl_mechanism_stats *const ms = smalloc(sizeof *ms);
+
+		(void) mowgli_strlcpy(ms->name, mech->name, sizeof ms->name);
+		(void) mowgli_patricia_add(sasl_mechanism_stats, ms->name, ms);
+	}
+
 	mowgli_node_t *const node = mowgli_node_create();
 
 	if (! node)
@@ -1079,12 +1221,42 @@ saslserv_message_handler(struct sourceinfo *const restrict si, const int parc, c
 	                                         "to the network. It has no public interface."));
 }
 
+static void
+sasl_mechanism_stats_destroy_cb(const char ATHEME_VATTR_UNUSED *const restrict key, void *const restrict data,
+                                void ATHEME_VATTR_UNUSED *const restrict privdata)
+{
+	(void) sfree(data);
+}
+
+static void
+sasl_metric_sessions_collect(struct metric *const restrict m, void ATHEME_VATTR_UNUSED *const restrict privdata)
+{
+	(void) metric_set(m, NULL, MOWGLI_LIST_LENGTH(&sasl_sessions));
+}
+
 static void
 mod_init(struct module *const restrict m)
 {
+	if (! (sasl_sessions_by_uid = mowgli_patricia_create(&noopcanon)))
+	{
+		(void) slog(LG_ERROR, "%s: mowgli_patricia_create() failed", m->name);
+		m->mflags |= MODFLAG_FAIL;
+		return;
+	}
+
+	if (! (sasl_mechanism_stats = mowgli_patricia_create(&noopcanon)))
+	{
+		(void) slog(LG_ERROR, "%s: mowgli_patricia_create() failed", m->name);
+		(void) mowgli_patricia_destroy(sasl_sessions_by_uid, NULL, NULL);
+		m->mflags |= MODFLAG_FAIL;
+		return;
+	}
+
 	if (! (saslsvs = service_add("saslserv", &saslserv_message_handler)))
 	{
 		(void) slog(LG_ERROR, "%s: service_add() failed", m->name);
+		(void) mowgli_patricia_destroy(sasl_mechanism_stats, NULL, NULL);
+		(void) mowgli_patricia_destroy(sasl_sessions_by_uid, NULL, NULL);
 		m->mflags |= MODFLAG_FAIL;
 		return;
 	}
@@ -1092,11 +1264,20 @@ mod_init(struct module *const restrict m)
 	(void) hook_add_sasl_input(&sasl_input);
 	(void) hook_add_user_add(&sasl_user_add);
 	(void) hook_add_server_eob(&sasl_server_eob);
+	(void) hook_add_stats_request(&sasl_stats_request);
 
 	sasl_delete_stale_timer = mowgli_timer_add(base_eventloop, "sasl_delete_stale", &sasl_delete_stale, NULL, SECONDS_PER_MINUTE / 2);
 	authservice_loaded++;
 
 	(void) add_bool_conf_item("HIDE_SERVER_NAMES", &saslsvs->conf_table, 0, &sasl_hide_server_names, false);
+
+	sasl_metric_sessions = metric_create("atheme_sasl_sessions", "SASL sessions in progress", METRIC_GAUGE);
+	sasl_metric_started = metric_create("atheme_sasl_sessions_started_total", "SASL sessions started, by "
+	                                    "mechanism", METRIC_COUNTER);
+	sasl_metric_outcomes = metric_create("atheme_sasl_outcomes_total", "SASL sessions finished, by mechanism "
+	                                     "and outcome", METRIC_COUNTER);
+
+	(void) metric_set_collector(sasl_metric_sessions, &sasl_metric_sessions_collect, NULL);
 }
 
 static void
@@ -1105,17 +1286,25 @@ mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 	(void) hook_del_sasl_input(&sasl_input);
 	(void) hook_del_user_add(&sasl_user_add);
 	(void) hook_del_server_eob(&sasl_server_eob);
+	(void) hook_del_stats_request(&sasl_stats_request);
 
 	(void) mowgli_timer_destroy(base_eventloop, sasl_delete_stale_timer);
 
 	(void) del_conf_item("HIDE_SERVER_NAMES", &saslsvs->conf_table);
 	(void) service_delete(saslsvs);
 
+	(void) metric_destroy(sasl_metric_sessions);
+	(void) metric_destroy(sasl_metric_started);
+	(void) metric_destroy(sasl_metric_outcomes);
+
 	authservice_loaded--;
 
 	if (sasl_sessions.head)
 		(void) slog(LG_ERROR, "saslserv/main: shutting down with a non-empty session list; "
 		                      "a mechanism did not unregister itself! (BUG)");
+
+	(void) mowgli_patricia_destroy(sasl_sessions_by_uid, NULL, NULL);
+	(void) mowgli_patricia_destroy(sasl_mechanism_stats, &sasl_mechanism_stats_destroy_cb, NULL);
 }
 
 SIMPLE_DECLARE_MODULE_V1("saslserv/main", MODULE_UNLOAD_CAPABILITY_OK)
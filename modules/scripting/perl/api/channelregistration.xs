@@ -53,6 +53,7 @@ CODE:
 			chanacs_modify_simple(ca, CA_FLAGS, CA_FOUNDER, si->smu);
 	}
 
+	db_modifying(self);
 	self->used = CURRTIME;
 	chanacs_change_simple(self, user, NULL, CA_FOUNDER_0, 0, entity(si->smu));
 
@@ -70,7 +71,10 @@ unsigned int
 flags (Atheme_ChannelRegistration self, unsigned int newflags = 0)
 CODE:
     if (items > 1)
+    {
+        db_modifying(self);
         self->flags = newflags;
+    }
     RETVAL = self->flags;
 OUTPUT:
     RETVAL
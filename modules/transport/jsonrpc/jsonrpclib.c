@@ -10,36 +10,38 @@
 #include <atheme.h>
 #include "jsonrpclib.h"
 
-void
-jsonrpc_process(char *buffer, void *userdata)
+/* State of the batch being processed, if any. Replies are collected here
+ * and sent as one array once every request in it has been handled, and the
+ * last authcookie that was validated is remembered so that a batch which
+ * does everything as one account only looks it up once.
+ */
+struct jsonrpc_batch
 {
-	if (!buffer)
-	{
-		return;
-	}
+	void *conn;
+	mowgli_string_t *replies;
+	unsigned int count;
 
-	mowgli_json_t *parsed = mowgli_json_parse_string(buffer);
+	struct myuser *auth_mu;
+	char *auth_cookie;
+	bool auth_valid;
+};
 
-	if (parsed == NULL) {
-		return;
-	}
+static struct jsonrpc_batch *current_batch = NULL;
 
+static bool
+jsonrpc_process_one(mowgli_json_t *parsed, void *userdata)
+{
 	mowgli_json_tag_t tag = MOWGLI_JSON_TAG(parsed);
 
 	//JSON RPC works with JSON objects only, anything else can't be correct.
 
 	if (tag != MOWGLI_JSON_TAG_OBJECT)
 	{
-		return;
+		return false;
 	}
 
 	mowgli_patricia_t *obj = MOWGLI_JSON_OBJECT(parsed);
 
-	if (parsed == NULL)
-	{
-		return;
-	}
-
 	mowgli_json_t *method = mowgli_patricia_retrieve(obj, "method");
 	mowgli_json_t *params = mowgli_patricia_retrieve(obj, "params");
 	mowgli_json_t *id = mowgli_patricia_retrieve(obj, "id");
@@ -49,14 +51,14 @@ jsonrpc_process(char *buffer, void *userdata)
 
 	if (id == NULL || params == NULL || method == NULL)
 	{
-		return;
+		return false;
 	}
 
 	if (MOWGLI_JSON_TAG(method) != MOWGLI_JSON_TAG_STRING ||
 			MOWGLI_JSON_TAG(id) != MOWGLI_JSON_TAG_STRING ||
 			MOWGLI_JSON_TAG(params) != MOWGLI_JSON_TAG_ARRAY)
 	{
-		return;
+		return false;
 	}
 
 	method_str = MOWGLI_JSON_STRING_STR(method);
@@ -64,7 +66,7 @@ jsonrpc_process(char *buffer, void *userdata)
 	params_list = MOWGLI_JSON_ARRAY(params);
 
 	mowgli_json_t *param;
-	mowgli_node_t *n;
+	mowgli_node_t *n, *tn;
 
 	jsonrpc_method_fn call_method = get_json_method(method_str);
 
@@ -73,9 +75,14 @@ jsonrpc_process(char *buffer, void *userdata)
 		param = n->data;
 
 		if (MOWGLI_JSON_TAG(param) != MOWGLI_JSON_TAG_STRING) {
-			continue;
+			jsonrpc_failure_string(userdata, fault_badparams, "Invalid parameters", id_str);
+			return true;
 		}
+	}
 
+	if (call_method == NULL) {
+		jsonrpc_failure_string(userdata, fault_badparams, "Invalid command", id_str);
+		return true;
 	}
 
 	mowgli_list_t *params_str = mowgli_list_create();
@@ -88,13 +95,143 @@ jsonrpc_process(char *buffer, void *userdata)
 		mowgli_node_add(param_str, mowgli_node_create(), params_str);
 	}
 
-	if (call_method != NULL) {
-		call_method(userdata, params_str, id_str);
-	} else {
-		jsonrpc_failure_string(userdata, fault_badparams, "Invalid command", id_str);
+	call_method(userdata, params_str, id_str);
+
+	MOWGLI_LIST_FOREACH_SAFE(n, tn, params_str->head)
+	{
+		mowgli_node_delete(n, params_str);
+		mowgli_node_free(n);
+	}
+
+	mowgli_list_free(params_str);
+
+	return true;
+}
+
+/* A batch is an array of requests. Every request in it gets its own reply,
+ * with its own error code if it fails, and the replies go back together as
+ * one array in one HTTP response.
+ */
+static void
+jsonrpc_process_batch(mowgli_list_t *requests, void *userdata)
+{
+	struct jsonrpc_batch batch;
+	mowgli_node_t *n;
+
+	if (MOWGLI_LIST_LENGTH(requests) == 0)
+	{
+		jsonrpc_failure_string(userdata, fault_badparams, "Empty batch", NULL);
+		return;
+	}
+
+	memset(&batch, 0, sizeof batch);
+	batch.conn = userdata;
+	batch.replies = mowgli_string_create();
+
+	mowgli_string_append_char(batch.replies, '[');
+
+	current_batch = &batch;
+
+	MOWGLI_LIST_FOREACH(n, requests->head)
+	{
+		if (!jsonrpc_process_one(n->data, userdata))
+			jsonrpc_failure_string(userdata, fault_badparams, "Invalid request", NULL);
+	}
+
+	current_batch = NULL;
+
+	mowgli_string_append_char(batch.replies, ']');
+
+	jsonrpc_send_data(userdata, batch.replies->str);
+
+	mowgli_string_destroy(batch.replies);
+	sfree(batch.auth_cookie);
+}
+
+void
+jsonrpc_process(char *buffer, void *userdata)
+{
+	if (!buffer)
+	{
 		return;
 	}
 
+	mowgli_json_t *parsed = mowgli_json_parse_string(buffer);
+
+	if (parsed == NULL) {
+		return;
+	}
+
+	if (MOWGLI_JSON_TAG(parsed) == MOWGLI_JSON_TAG_ARRAY)
+	{
+		jsonrpc_process_batch(MOWGLI_JSON_ARRAY(parsed), userdata);
+		return;
+	}
+
+	(void) jsonrpc_process_one(parsed, userdata);
+}
+
+/* Called by jsonrpc_send_data() with every reply. While a batch is being
+ * processed on this connection the reply is added to the batch instead of
+ * being sent, and true is returned.
+ */
+bool
+jsonrpc_batch_add(void *conn, const char *str)
+{
+	if (current_batch == NULL || current_batch->conn != conn)
+		return false;
+
+	if (current_batch->count++)
+		mowgli_string_append_char(current_batch->replies, ',');
+
+	mowgli_string_append(current_batch->replies, str, strlen(str));
+
+	return true;
+}
+
+/* Methods validate authcookies through this. Within a batch, a cookie that
+ * has been checked for an account is not looked up again for that account,
+ * until jsonrpc_batch_forget() is called.
+ */
+bool
+jsonrpc_authcookie_validate(const char *cookie, struct myuser *mu)
+{
+	struct jsonrpc_batch *const batch = current_batch;
+
+	if (batch != NULL && batch->auth_mu == mu && batch->auth_cookie != NULL &&
+			strcmp(batch->auth_cookie, cookie) == 0)
+		return batch->auth_valid;
+
+	bool valid = authcookie_validate(cookie, mu);
+
+	if (batch != NULL)
+	{
+		sfree(batch->auth_cookie);
+		batch->auth_mu = mu;
+		batch->auth_cookie = sstrdup(cookie);
+		batch->auth_valid = valid;
+	}
+
+	return valid;
+}
+
+/* Drops a remembered authcookie validation for an account. Called from the
+ * authcookie_destroy hook, so that a cookie destroyed part way through a
+ * batch (by LOGOUT, or by FREEZE or RETURN through authcookie_destroy_all())
+ * is not accepted by the requests after it, and when the account goes away.
+ */
+void
+jsonrpc_batch_forget(struct myuser *mu)
+{
+	struct jsonrpc_batch *const batch = current_batch;
+
+	if (batch == NULL || batch->auth_mu != mu)
+		return;
+
+	sfree(batch->auth_cookie);
+	batch->auth_mu = NULL;
+	batch->auth_cookie = NULL;
+	batch->auth_valid = false;
 }
 
 void
@@ -118,6 +255,26 @@ jsonrpc_success_string(void *conn, const char *result, const char *id)
 	jsonrpc_send_data(conn, str->str);
 }
 
+void
+jsonrpc_success_object(void *conn, mowgli_json_t *result, const char *id)
+{
+	mowgli_json_t *obj = mowgli_json_create_object();
+
+	mowgli_patricia_t *patricia = MOWGLI_JSON_OBJECT(obj);
+
+	mowgli_json_t *idobj = mowgli_json_create_string(id);
+
+	mowgli_patricia_add(patricia, "result", result);
+	mowgli_patricia_add(patricia, "id", idobj);
+	mowgli_patricia_add(patricia, "error", mowgli_json_null);
+
+	mowgli_string_t *str = mowgli_string_create();
+
+	mowgli_json_serialize_to_string(obj, str, 0);
+
+	jsonrpc_send_data(conn, str->str);
+}
+
 void
 jsonrpc_failure_string(void *conn, int code, const char *error, const char *id)
 {
@@ -131,7 +288,7 @@ jsonrpc_failure_string(void *conn, int code, const char *error, const char *id)
 
 	patricia = MOWGLI_JSON_OBJECT(obj);
 
-	mowgli_json_t *idobj = mowgli_json_create_string(id);
+	mowgli_json_t *idobj = id != NULL ? mowgli_json_create_string(id) : mowgli_json_null;
 
 	mowgli_patricia_add(patricia, "result", mowgli_json_null);
 	mowgli_patricia_add(patricia, "id", idobj);
@@ -29,6 +29,13 @@ void jsonrpc_register_method(const char *method_name, bool (*method)(void *conn,
 void jsonrpc_unregister_method(const char *method_name);
 void jsonrpc_send_data(void *conn, char *str);
 void jsonrpc_success_string(void *conn, const char *str, const char *id);
+void jsonrpc_success_object(void *conn, mowgli_json_t *result, const char *id);
 void jsonrpc_failure_string(void *conn, int code, const char *str, const char *id);
+bool jsonrpc_batch_add(void *conn, const char *str);
+bool jsonrpc_authcookie_validate(const char *cookie, struct myuser *mu) ATHEME_FATTR_WUR;
+void jsonrpc_batch_forget(struct myuser *mu);
+
+void jsonrpc_query_register(void);
+void jsonrpc_query_unregister(void);
 
 #endif /* !ATHEME_MOD_TRANSPORT_JSONRPC_JSONRPCLIB_H */
@@ -10,7 +10,8 @@
 #include <atheme.h>
 #include "jsonrpclib.h"
 
-static mowgli_list_t *httpd_path_handlers = NULL;
+static void (*httpd_path_handler_add)(struct path_handler *) = NULL;
+static void (*httpd_path_handler_del)(struct path_handler *) = NULL;
 static mowgli_patricia_t *json_methods = NULL;
 
 void
@@ -185,6 +186,7 @@ jsonrpcmethod_login(void *conn, mowgli_list_t *params, char *id)
 		return false;
 	}
 
+	db_modifying(mu);
 	mu->lastlogin = CURRTIME;
 
 	ac = authcookie_create(mu);
@@ -234,7 +236,7 @@ jsonrpcmethod_logout(void *conn, mowgli_list_t *params, char *id)
 		return false;
 	}
 
-	if (authcookie_validate(cookie, mu) == false)
+	if (jsonrpc_authcookie_validate(cookie, mu) == false)
 	{
 		jsonrpc_failure_string(conn, fault_badauthcookie, "Invalid authcookie for this account.", id);
 		return false;
@@ -303,6 +305,11 @@ jsonrpcmethod_command(void *conn, mowgli_list_t *params, char *id)
 		return 0;
 	}
 
+	// a batch can run several commands in one request
+	sfree(hd->replybuf);
+	hd->replybuf = NULL;
+	hd->sent_reply = false;
+
 	if (*accountname != '\0' && strlen(cookie) > 1)
 	{
 		if ((mu = myuser_find(accountname)) == NULL)
@@ -311,7 +318,7 @@ jsonrpcmethod_command(void *conn, mowgli_list_t *params, char *id)
 			return 0;
 		}
 
-		if (authcookie_validate(cookie, mu) == false)
+		if (jsonrpc_authcookie_validate(cookie, mu) == false)
 		{
 			jsonrpc_failure_string(conn, fault_badauthcookie, "Invalid authcookie for this account.", id);
 			return 0;
@@ -422,7 +429,7 @@ jsonrpcmethod_privset(void *conn, mowgli_list_t *params, char *id)
 			return 0;
 		}
 
-		if (authcookie_validate(cookie, mu) == false)
+		if (jsonrpc_authcookie_validate(cookie, mu) == false)
 		{
 			jsonrpc_failure_string(conn, fault_badauthcookie, "Invalid authcookie for this account.", id);
 			return 0;
@@ -491,20 +498,7 @@ jsonrpcmethod_ison(void *conn, mowgli_list_t *params, char *id)
 		mowgli_patricia_add(patricia, "online", mowgli_json_false);
 		mowgli_patricia_add(patricia, "accountname", mowgli_json_create_string("*"));
 
-		mowgli_json_t *obj = mowgli_json_create_object();
-		patricia = MOWGLI_JSON_OBJECT(obj);
-
-		mowgli_json_t *idobj = mowgli_json_create_string(id);
-
-		mowgli_patricia_add(patricia, "result", resultobj);
-		mowgli_patricia_add(patricia, "id", idobj);
-		mowgli_patricia_add(patricia, "error", mowgli_json_null);
-
-		mowgli_string_t *str = mowgli_string_create();
-
-		mowgli_json_serialize_to_string(obj, str, 0);
-
-		jsonrpc_send_data(conn, str->str);
+		jsonrpc_success_object(conn, resultobj, id);
 
 		return 0;
 	}
@@ -515,20 +509,7 @@ jsonrpcmethod_ison(void *conn, mowgli_list_t *params, char *id)
 	mowgli_patricia_add(patricia, "online", mowgli_json_true);
 	mowgli_patricia_add(patricia, "accountname",  mowgli_json_create_string(u->myuser != NULL ? entity(u->myuser)->name : "*"));
 
-	mowgli_json_t *obj = mowgli_json_create_object();
-	patricia = MOWGLI_JSON_OBJECT(obj);
-
-	mowgli_json_t *idobj = mowgli_json_create_string(id);
-
-	mowgli_patricia_add(patricia, "result", resultobj);
-	mowgli_patricia_add(patricia, "id", idobj);
-	mowgli_patricia_add(patricia, "error", mowgli_json_null);
-
-	mowgli_string_t *str = mowgli_string_create();
-
-	mowgli_json_serialize_to_string(obj, str, 0);
-
-	jsonrpc_send_data(conn, str->str);
+	jsonrpc_success_object(conn, resultobj, id);
 
 	return 0;
 }
@@ -620,6 +601,9 @@ jsonrpc_send_data(void *conn, char *str)
 
 	char buf[300];
 
+	if (jsonrpc_batch_add(conn, str))
+		return;
+
 	size_t len = strlen(str);
 
 	snprintf(buf, sizeof buf,
@@ -631,7 +615,7 @@ jsonrpc_send_data(void *conn, char *str)
 	         "\r\n",
 	         PACKAGE_TARNAME, PACKAGE_VERSION,
 	         len,
-	         hd->connection_close ? "Connection: close\r\n" : "");
+	         httpd_connection_header(hd));
 
 	sendq_add((struct connection *)conn, buf, strlen(buf));
 	sendq_add((struct connection *)conn, str, len);
@@ -649,18 +633,34 @@ handle_request(struct connection *cptr, void *requestbuf)
 	return;
 }
 
+static void
+jsonrpc_authcookie_destroy(struct authcookie *ac)
+{
+	jsonrpc_batch_forget(ac->myuser);
+}
+
+static void
+jsonrpc_myuser_delete(struct myuser *mu)
+{
+	jsonrpc_batch_forget(mu);
+}
+
 static struct path_handler handle_jsonrpc = { NULL, handle_request };
 
 static void
 mod_init(struct module *const restrict m)
 {
-	MODULE_TRY_REQUEST_SYMBOL(m, httpd_path_handlers, "misc/httpd", "httpd_path_handlers")
+	MODULE_TRY_REQUEST_SYMBOL(m, httpd_path_handler_add, "misc/httpd", "httpd_path_handler_add")
+	MODULE_TRY_REQUEST_SYMBOL(m, httpd_path_handler_del, "misc/httpd", "httpd_path_handler_del")
 
 	handle_jsonrpc.path = "/jsonrpc";
-	mowgli_node_add(&handle_jsonrpc, mowgli_node_create(), httpd_path_handlers);
+	httpd_path_handler_add(&handle_jsonrpc);
 
 	json_methods = mowgli_patricia_create(strcasecanon);
 
+	hook_add_authcookie_destroy(jsonrpc_authcookie_destroy);
+	hook_add_myuser_delete(jsonrpc_myuser_delete);
+
 	jsonrpc_register_method("atheme.login", jsonrpcmethod_login);
 	jsonrpc_register_method("atheme.logout", jsonrpcmethod_logout);
 	jsonrpc_register_method("atheme.command", jsonrpcmethod_command);
@@ -669,13 +669,12 @@ mod_init(struct module *const restrict m)
 	jsonrpc_register_method("atheme.ison", jsonrpcmethod_ison);
 	jsonrpc_register_method("atheme.metadata", jsonrpcmethod_metadata);
 
+	jsonrpc_query_register();
 }
 
 static void
 mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 {
-	mowgli_node_t *n;
-
 	jsonrpc_unregister_method("atheme.login");
 	jsonrpc_unregister_method("atheme.logout");
 	jsonrpc_unregister_method("atheme.command");
@@ -684,11 +683,12 @@ mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 	jsonrpc_unregister_method("atheme.ison");
 	jsonrpc_unregister_method("atheme.metadata");
 
-	if ((n = mowgli_node_find(&handle_jsonrpc, httpd_path_handlers)) != NULL)
-	{
-		mowgli_node_delete(n, httpd_path_handlers);
-		mowgli_node_free(n);
-	}
+	jsonrpc_query_unregister();
+
+	hook_del_authcookie_destroy(jsonrpc_authcookie_destroy);
+	hook_del_myuser_delete(jsonrpc_myuser_delete);
+
+	httpd_path_handler_del(&handle_jsonrpc);
 }
 
 SIMPLE_DECLARE_MODULE_V1("transport/jsonrpc", MODULE_UNLOAD_CAPABILITY_OK)
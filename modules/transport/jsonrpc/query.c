@@ -0,0 +1,495 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * JSONRPC query methods
+ *
+ * These answer the questions that web frontends would otherwise ask by
+ * running NickServ INFO or ChanServ FLAGS through atheme.command and
+ * parsing the output. They read the account and channel structures
+ * directly and return JSON, without creating a sourceinfo.
+ */
+
+#include <atheme.h>
+#include "jsonrpclib.h"
+
+#define QUERY_DEFAULT_LIMIT     50U
+#define QUERY_MAX_LIMIT         500U
+
+// The account flags NickServ INFO shows to anyone
+#define QUERY_PUBLIC_MU_FLAGS   (MU_HOLD | MU_NEVEROP | MU_NOOP | MU_WAITAUTH | MU_HIDEMAIL | MU_NOMEMO | \
+                                 MU_EMAILMEMOS | MU_PRIVATE | MU_NOGREET | MU_REGNOLIMIT | MU_NEVERGROUP | \
+                                 MU_NOPASSWORD)
+
+struct query_page
+{
+	unsigned int offset;
+	unsigned int limit;
+	unsigned int total;
+	mowgli_json_t *items;
+};
+
+static bool
+query_check_params(void *conn, mowgli_list_t *params, size_t needed, char *id)
+{
+	mowgli_node_t *n;
+
+	MOWGLI_LIST_FOREACH(n, params->head)
+	{
+		char *param = n->data;
+
+		if (*param == '\0' || strchr(param, '\r') || strchr(param, '\n'))
+		{
+			jsonrpc_failure_string(conn, fault_badparams, "Invalid parameters.", id);
+			return false;
+		}
+	}
+
+	if (MOWGLI_LIST_LENGTH(params) < needed)
+	{
+		jsonrpc_failure_string(conn, fault_needmoreparams, "Insufficient parameters.", id);
+		return false;
+	}
+
+	return true;
+}
+
+// The first two parameters of every query are an authcookie and the account it belongs to.
+static struct myuser *
+query_login(void *conn, mowgli_list_t *params, char *id)
+{
+	char *cookie = mowgli_node_nth_data(params, 0);
+	char *accountname = mowgli_node_nth_data(params, 1);
+	struct myuser *mu;
+
+	if ((mu = myuser_find(accountname)) == NULL)
+	{
+		jsonrpc_failure_string(conn, fault_nosuch_source, "Unknown user.", id);
+		return NULL;
+	}
+
+	if (jsonrpc_authcookie_validate(cookie, mu) == false)
+	{
+		jsonrpc_failure_string(conn, fault_badauthcookie, "Invalid authcookie for this account.", id);
+		return NULL;
+	}
+
+	return mu;
+}
+
+// The optional offset and limit parameters start at index first.
+static bool
+query_page_init(void *conn, mowgli_list_t *params, size_t first, char *id, struct query_page *page)
+{
+	char *offset = mowgli_node_nth_data(params, first);
+	char *limit = mowgli_node_nth_data(params, first + 1);
+
+	page->offset = 0;
+	page->limit = QUERY_DEFAULT_LIMIT;
+	page->total = 0;
+
+	if ((offset != NULL && !string_to_uint(offset, &page->offset)) ||
+	    (limit != NULL && (!string_to_uint(limit, &page->limit) || page->limit == 0 || page->limit > QUERY_MAX_LIMIT)))
+	{
+		jsonrpc_failure_string(conn, fault_badparams, "Invalid offset or limit.", id);
+		return false;
+	}
+
+	page->items = mowgli_json_create_array();
+
+	return true;
+}
+
+// Counts an item, and returns whether it is on the requested page.
+static inline bool
+query_page_want(struct query_page *page)
+{
+	const unsigned int index = page->total++;
+
+	return index >= page->offset && index - page->offset < page->limit;
+}
+
+static inline void
+query_page_add(struct query_page *page, mowgli_json_t *item)
+{
+	mowgli_node_add(item, mowgli_node_create(), MOWGLI_JSON_ARRAY(page->items));
+}
+
+static void
+query_page_send(void *conn, struct query_page *page, char *id)
+{
+	mowgli_json_t *result = mowgli_json_create_object();
+	mowgli_patricia_t *patricia = MOWGLI_JSON_OBJECT(result);
+
+	mowgli_patricia_add(patricia, "total", mowgli_json_create_integer((int) page->total));
+	mowgli_patricia_add(patricia, "offset", mowgli_json_create_integer((int) page->offset));
+	mowgli_patricia_add(patricia, "items", page->items);
+
+	jsonrpc_success_object(conn, result, id);
+}
+
+static inline void
+query_add_string(mowgli_patricia_t *patricia, const char *key, const char *value)
+{
+	mowgli_patricia_add(patricia, key, value != NULL ? mowgli_json_create_string(value) : mowgli_json_null);
+}
+
+static inline void
+query_add_time(mowgli_patricia_t *patricia, const char *key, time_t value)
+{
+	mowgli_patricia_add(patricia, key, mowgli_json_create_integer((int) value));
+}
+
+/* atheme.query.account
+ *
+ * JSON inputs:
+ *       authcookie, account name, account to look up
+ *
+ * JSON outputs:
+ *       fault 1 - insufficient parameters
+ *       fault 3 - unknown user
+ *       fault 4 - no such account
+ *       fault 15 - validation failed
+ *       default - an object with the following properties:
+ *       name, uid: strings
+ *       registered: integer timestamp
+ *       lastlogin: integer timestamp, or null if the account is private
+ *       online: boolean, or null if the account is private
+ *       email: string, or null if it is hidden
+ *       flags: string, as in the database; only the flags NickServ INFO
+ *              shows, unless the account itself asks
+ *       nicks: array of strings, empty if the account is private
+ *
+ *       The account itself and opers with user:auspex see everything.
+ */
+static bool
+jsonrpcmethod_query_account(void *conn, mowgli_list_t *params, char *id)
+{
+	struct myuser *mu, *tmu;
+	mowgli_node_t *n;
+
+	if (!query_check_params(conn, params, 3, id) || (mu = query_login(conn, params, id)) == NULL)
+		return false;
+
+	if ((tmu = myuser_find_ext(mowgli_node_nth_data(params, 2))) == NULL)
+	{
+		jsonrpc_failure_string(conn, fault_nosuch_target, "No account was found for this accountname or UID.", id);
+		return false;
+	}
+
+	const bool privileged = mu == tmu || has_priv_myuser(mu, PRIV_USER_AUSPEX);
+	const bool hide_info = (tmu->flags & MU_PRIVATE) && !privileged;
+	const bool hide_mail = (tmu->flags & MU_HIDEMAIL) && !privileged;
+
+	mowgli_json_t *result = mowgli_json_create_object();
+	mowgli_patricia_t *patricia = MOWGLI_JSON_OBJECT(result);
+	mowgli_json_t *nicks = mowgli_json_create_array();
+
+	query_add_string(patricia, "name", entity(tmu)->name);
+	query_add_string(patricia, "uid", entity(tmu)->id);
+	query_add_time(patricia, "registered", tmu->registered);
+	query_add_string(patricia, "email", hide_mail ? NULL : tmu->email);
+	query_add_string(patricia, "flags", gflags_tostr(mu_flags, privileged ? tmu->flags : (tmu->flags & QUERY_PUBLIC_MU_FLAGS)));
+
+	if (hide_info)
+	{
+		mowgli_patricia_add(patricia, "lastlogin", mowgli_json_null);
+		mowgli_patricia_add(patricia, "online", mowgli_json_null);
+	}
+	else
+	{
+		query_add_time(patricia, "lastlogin", tmu->lastlogin);
+		mowgli_patricia_add(patricia, "online", MOWGLI_LIST_LENGTH(&tmu->logins) ? mowgli_json_true : mowgli_json_false);
+
+		MOWGLI_ITER_FOREACH(n, tmu->nicks.head)
+		{
+			struct mynick *mn = n->data;
+
+			mowgli_node_add(mowgli_json_create_string(mn->nick), mowgli_node_create(), MOWGLI_JSON_ARRAY(nicks));
+		}
+	}
+
+	mowgli_patricia_add(patricia, "nicks", nicks);
+
+	jsonrpc_success_object(conn, result, id);
+
+	return true;
+}
+
+/* atheme.query.chanaccess
+ *
+ * JSON inputs:
+ *       authcookie, account name, channel name, offset (optional),
+ *       limit (optional, default 50, at most 500)
+ *
+ * JSON outputs:
+ *       fault 1 - insufficient parameters
+ *       fault 2 - invalid offset or limit
+ *       fault 3 - unknown user
+ *       fault 4 - the channel is not registered
+ *       fault 6 - the account may not view the access list
+ *       fault 15 - validation failed
+ *       default - an object with the following properties:
+ *       total: integer, the number of entries in the access list
+ *       offset: integer
+ *       items: array of objects with the following properties:
+ *              entity: string, an entity name or a hostmask
+ *              uid: string, or null for a hostmask
+ *              flags: string, as shown by ChanServ FLAGS
+ *              modified: integer timestamp
+ *              setter: string, or null if unknown
+ *
+ *       This needs the same access as ChanServ FLAGS with no arguments.
+ */
+static bool
+jsonrpcmethod_query_chanaccess(void *conn, mowgli_list_t *params, char *id)
+{
+	struct myuser *mu;
+	struct mychan *mc;
+	struct query_page page;
+	mowgli_node_t *n;
+
+	if (!query_check_params(conn, params, 3, id) || (mu = query_login(conn, params, id)) == NULL)
+		return false;
+
+	if ((mc = mychan_find(mowgli_node_nth_data(params, 2))) == NULL)
+	{
+		jsonrpc_failure_string(conn, fault_nosuch_target, "No channel registration was found for the provided channel name.", id);
+		return false;
+	}
+
+	if (!(mc->flags & MC_PUBACL) && !(chanacs_entity_flags(mc, entity(mu)) & CA_ACLVIEW))
+	{
+		if (!has_priv_myuser(mu, PRIV_CHAN_AUSPEX))
+		{
+			jsonrpc_failure_string(conn, fault_noprivs, "You are not authorized to perform this operation.", id);
+			return false;
+		}
+
+		logcommand_external(chansvs.me, "jsonrpc", conn, NULL, mu, CMDLOG_ADMIN, "FLAGS: \2%s\2 (oper override)", mc->name);
+	}
+
+	if (!query_page_init(conn, params, 3, id, &page))
+		return false;
+
+	MOWGLI_ITER_FOREACH(n, mc->chanacs.head)
+	{
+		struct chanacs *ca = n->data;
+		struct myentity *setter;
+
+		if (!query_page_want(&page))
+			continue;
+
+		mowgli_json_t *item = mowgli_json_create_object();
+		mowgli_patricia_t *patricia = MOWGLI_JSON_OBJECT(item);
+
+		setter = *ca->setter_uid != '\0' ? myentity_find_uid(ca->setter_uid) : NULL;
+
+		query_add_string(patricia, "entity", ca->entity != NULL ? ca->entity->name : ca->host);
+		query_add_string(patricia, "uid", ca->entity != NULL ? ca->entity->id : NULL);
+		query_add_string(patricia, "flags", bitmask_to_flags(ca->level));
+		query_add_time(patricia, "modified", ca->tmodified);
+		query_add_string(patricia, "setter", setter != NULL ? setter->name : NULL);
+
+		query_page_add(&page, item);
+	}
+
+	query_page_send(conn, &page, id);
+
+	return true;
+}
+
+/* atheme.query.groups
+ *
+ * JSON inputs:
+ *       authcookie, account name, account to look up, offset (optional),
+ *       limit (optional, default 50, at most 500)
+ *
+ * JSON outputs:
+ *       fault 1 - insufficient parameters
+ *       fault 2 - invalid offset or limit
+ *       fault 3 - unknown user
+ *       fault 4 - no such account
+ *       fault 6 - the account may not view these memberships
+ *       fault 15 - validation failed
+ *       default - an object with the following properties:
+ *       total: integer, the number of groups the account is a member of
+ *       offset: integer
+ *       items: array of objects with the following properties:
+ *              group: string
+ *              flags: string, as shown by GroupServ FLAGS
+ *
+ *       Accounts can look up their own memberships, and opers with
+ *       group:auspex those of any account. The list is empty if
+ *       groupserv/main is not loaded.
+ */
+static bool
+jsonrpcmethod_query_groups(void *conn, mowgli_list_t *params, char *id)
+{
+	struct myuser *mu, *tmu;
+	struct query_page page;
+	mowgli_list_t *l;
+	mowgli_node_t *n;
+
+	if (!query_check_params(conn, params, 3, id) || (mu = query_login(conn, params, id)) == NULL)
+		return false;
+
+	if ((tmu = myuser_find_ext(mowgli_node_nth_data(params, 2))) == NULL)
+	{
+		jsonrpc_failure_string(conn, fault_nosuch_target, "No account was found for this accountname or UID.", id);
+		return false;
+	}
+
+	if (mu != tmu && !has_priv_myuser(mu, PRIV_GROUP_AUSPEX))
+	{
+		jsonrpc_failure_string(conn, fault_noprivs, "You are not authorized to perform this operation.", id);
+		return false;
+	}
+
+	if (!query_page_init(conn, params, 3, id, &page))
+		return false;
+
+	// kept up to date by groupserv/main
+	if ((l = privatedata_get(entity(tmu), "groupserv:membership")) != NULL)
+	{
+		MOWGLI_ITER_FOREACH(n, l->head)
+		{
+			struct groupacs *ga = n->data;
+
+			if (!query_page_want(&page))
+				continue;
+
+			mowgli_json_t *item = mowgli_json_create_object();
+			mowgli_patricia_t *patricia = MOWGLI_JSON_OBJECT(item);
+
+			query_add_string(patricia, "group", entity(ga->mg)->name);
+			query_add_string(patricia, "flags", gflags_tostr(ga_flags, ga->flags));
+
+			query_page_add(&page, item);
+		}
+	}
+
+	query_page_send(conn, &page, id);
+
+	return true;
+}
+
+/* atheme.query.metadata
+ *
+ * JSON inputs:
+ *       authcookie, account name, entity name, UID or channel name,
+ *       offset (optional), limit (optional, default 50, at most 500)
+ *
+ * JSON outputs:
+ *       fault 1 - insufficient parameters
+ *       fault 2 - invalid offset or limit
+ *       fault 3 - unknown user
+ *       fault 4 - no such entity or channel
+ *       fault 6 - the channel is private and the account may not view it
+ *       fault 15 - validation failed
+ *       default - an object with the following properties:
+ *       total: integer, the number of visible metadata entries
+ *       offset: integer
+ *       items: array of objects with name and value string properties
+ *
+ *       Entries starting with "private:" are only visible to opers with
+ *       user:auspex (for entities) or chan:auspex (for channels). As with
+ *       ChanServ TAXONOMY, a private channel's metadata needs the +A flag
+ *       or chan:auspex.
+ */
+static bool
+jsonrpcmethod_query_metadata(void *conn, mowgli_list_t *params, char *id)
+{
+	mowgli_patricia_iteration_state_t state;
+	struct atheme_object *target;
+	struct query_page page;
+	struct metadata *md;
+	struct myuser *mu;
+	bool show_private;
+
+	if (!query_check_params(conn, params, 3, id) || (mu = query_login(conn, params, id)) == NULL)
+		return false;
+
+	char *name = mowgli_node_nth_data(params, 2);
+
+	if (*name == '#')
+	{
+		struct mychan *mc;
+
+		if ((mc = mychan_find(name)) == NULL)
+		{
+			jsonrpc_failure_string(conn, fault_nosuch_target, "No channel registration was found for the provided channel name.", id);
+			return false;
+		}
+
+		show_private = has_priv_myuser(mu, PRIV_CHAN_AUSPEX);
+
+		if ((mc->flags & MC_PRIVATE) && !(chanacs_entity_flags(mc, entity(mu)) & CA_ACLVIEW) && !show_private)
+		{
+			jsonrpc_failure_string(conn, fault_noprivs, "You are not authorized to perform this operation.", id);
+			return false;
+		}
+
+		target = atheme_object(mc);
+	}
+	else
+	{
+		struct myentity *mt;
+
+		if ((mt = myentity_find(name)) == NULL && (mt = myentity_find_uid(name)) == NULL)
+		{
+			jsonrpc_failure_string(conn, fault_nosuch_target, "No account was found for this accountname or UID.", id);
+			return false;
+		}
+
+		target = atheme_object(mt);
+		show_private = has_priv_myuser(mu, PRIV_USER_AUSPEX);
+	}
+
+	if (!query_page_init(conn, params, 3, id, &page))
+		return false;
+
+	if (target->metadata != NULL)
+	{
+		MOWGLI_PATRICIA_FOREACH(md, &state, target->metadata)
+		{
+			if (!show_private && !strncmp(md->name, "private:", 8))
+				continue;
+
+			if (!query_page_want(&page))
+				continue;
+
+			mowgli_json_t *item = mowgli_json_create_object();
+			mowgli_patricia_t *patricia = MOWGLI_JSON_OBJECT(item);
+
+			query_add_string(patricia, "name", md->name);
+			query_add_string(patricia, "value", md->value);
+
+			query_page_add(&page, item);
+		}
+	}
+
+	query_page_send(conn, &page, id);
+
+	return true;
+}
+
+void
+jsonrpc_query_register(void)
+{
+	jsonrpc_register_method("atheme.query.account", jsonrpcmethod_query_account);
+	jsonrpc_register_method("atheme.query.chanaccess", jsonrpcmethod_query_chanaccess);
+	jsonrpc_register_method("atheme.query.groups", jsonrpcmethod_query_groups);
+	jsonrpc_register_method("atheme.query.metadata", jsonrpcmethod_query_metadata);
+}
+
+void
+jsonrpc_query_unregister(void)
+{
+	jsonrpc_unregister_method("atheme.query.account");
+	jsonrpc_unregister_method("atheme.query.chanaccess");
+	jsonrpc_unregister_method("atheme.query.groups");
+	jsonrpc_unregister_method("atheme.query.metadata");
+}
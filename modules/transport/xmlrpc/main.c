@@ -16,13 +16,14 @@ static struct {
 
 static struct connection *current_cptr = NULL; // XXX: Hack: src/xmlrpc.c requires us to do this
 
-static mowgli_list_t *httpd_path_handlers = NULL;
+static void (*httpd_path_handler_add)(struct path_handler *) = NULL;
+static void (*httpd_path_handler_del)(struct path_handler *) = NULL;
 
 // Configuration
 static mowgli_list_t conf_xmlrpc_table;
 
-static char *
-dump_buffer(char *buf, int length)
+static void
+xmlrpc_output_begin(size_t length)
 {
 	struct httpddata *hd;
 	char buf1[300];
@@ -33,22 +34,37 @@ dump_buffer(char *buf, int length)
 	         "HTTP/1.1 200 OK\r\n"
 	         "Server: %s/%s\r\n"
 	         "Content-Type: text/xml\r\n"
-	         "Content-Length: %d\r\n"
+	         "Content-Length: %zu\r\n"
 	         "%s"
 	         "\r\n",
 	         PACKAGE_TARNAME, PACKAGE_VERSION,
 	         length,
-	         hd->connection_close ? "Connection: close\r\n" : "");
+	         httpd_connection_header(hd));
 
 	sendq_add(current_cptr, buf1, strlen(buf1));
-	sendq_add(current_cptr, buf, length);
+}
+
+static void
+xmlrpc_output_write(const char *data, size_t length)
+{
+	sendq_add(current_cptr, (char *) data, length);
+}
+
+static void
+xmlrpc_output_end(void)
+{
+	struct httpddata *hd = current_cptr->userdata;
 
 	if (hd->connection_close)
 		sendq_add_eof(current_cptr);
-
-	return buf;
 }
 
+static const struct xmlrpc_output xmlrpc_output = {
+	.begin = xmlrpc_output_begin,
+	.write = xmlrpc_output_write,
+	.end = xmlrpc_output_end,
+};
+
 static void
 handle_request(struct connection *cptr, void *requestbuf)
 {
@@ -70,12 +86,8 @@ xmlrpc_config_ready(void *vptr)
 	handle_xmlrpc.path = xmlrpc_config.path;
 
 	if (handle_xmlrpc.handler != NULL)
-	{
-		if (mowgli_node_find(&handle_xmlrpc, httpd_path_handlers))
-			return;
-
-		mowgli_node_add(&handle_xmlrpc, mowgli_node_create(), httpd_path_handlers);
-	}
+		// also picks up a changed path
+		httpd_path_handler_add(&handle_xmlrpc);
 	else
 		slog(LG_ERROR, "xmlrpc_config_ready(): xmlrpc {} block missing or invalid");
 }
@@ -217,6 +229,7 @@ xmlrpcmethod_login(void *conn, int parc, char *parv[])
 		return 0;
 	}
 
+	db_modifying(mu);
 	mu->lastlogin = CURRTIME;
 
 	ac = authcookie_create(mu);
@@ -315,6 +328,11 @@ xmlrpcmethod_command(void *conn, int parc, char *parv[])
 		return 0;
 	}
 
+	// system.multicall can run several commands in one request
+	sfree(hd->replybuf);
+	hd->replybuf = NULL;
+	hd->sent_reply = false;
+
 	if (*parv[1] != '\0' && strlen(parv[0]) > 1)
 	{
 		if ((mu = myuser_find(parv[1])) == NULL)
@@ -562,7 +580,8 @@ xmlrpcmethod_metadata(void *conn, int parc, char *parv[])
 static void
 mod_init(struct module *const restrict m)
 {
-	MODULE_TRY_REQUEST_SYMBOL(m, httpd_path_handlers, "misc/httpd", "httpd_path_handlers")
+	MODULE_TRY_REQUEST_SYMBOL(m, httpd_path_handler_add, "misc/httpd", "httpd_path_handler_add")
+	MODULE_TRY_REQUEST_SYMBOL(m, httpd_path_handler_del, "misc/httpd", "httpd_path_handler_del")
 
 	hook_add_config_ready(xmlrpc_config_ready);
 
@@ -571,7 +590,7 @@ mod_init(struct module *const restrict m)
 	add_subblock_top_conf("XMLRPC", &conf_xmlrpc_table);
 	add_dupstr_conf_item("PATH", &conf_xmlrpc_table, 0, &xmlrpc_config.path, NULL);
 
-	xmlrpc_set_buffer(dump_buffer);
+	xmlrpc_set_output(&xmlrpc_output);
 	xmlrpc_set_options(XMLRPC_HTTP_HEADER, XMLRPC_OFF);
 	xmlrpc_register_method("atheme.login", xmlrpcmethod_login);
 	xmlrpc_register_method("atheme.logout", xmlrpcmethod_logout);
@@ -584,8 +603,6 @@ mod_init(struct module *const restrict m)
 static void
 mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 {
-	mowgli_node_t *n;
-
 	xmlrpc_unregister_method("atheme.login");
 	xmlrpc_unregister_method("atheme.logout");
 	xmlrpc_unregister_method("atheme.command");
@@ -593,11 +610,7 @@ mod_deinit(const enum module_unload_intent ATHEME_VATTR_UNUSED intent)
 	xmlrpc_unregister_method("atheme.ison");
 	xmlrpc_unregister_method("atheme.metadata");
 
-	if ((n = mowgli_node_find(&handle_xmlrpc, httpd_path_handlers)) != NULL)
-	{
-		mowgli_node_delete(n, httpd_path_handlers);
-		mowgli_node_free(n);
-	}
+	httpd_path_handler_del(&handle_xmlrpc);
 
 	del_conf_item("PATH", &conf_xmlrpc_table);
 	del_top_conf("XMLRPC");
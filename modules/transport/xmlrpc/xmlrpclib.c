@@ -23,204 +23,580 @@ struct XMLRPCCmd_ {
 };
 
 static struct {
-	char *(*setbuffer)(char *, int);
+	const struct xmlrpc_output *output;
 	char *encode;
 	int httpheader;
 	char *inttagstart;
 	char *inttagend;
+	mowgli_string_t *multicall;	// replies to the calls of a system.multicall so far
+	bool replied;			// the current call has been answered
 } xmlrpc;
 
 static int xmlrpc_error_code;
 
 static mowgli_patricia_t *XMLRPCCMD = NULL;
 
+#define XMLRPC_MAX_DEPTH	32
+#define XMLRPC_MAX_ELEMENTS	(XMLRPC_MAX_DEPTH * 3 + 8)	// <value><array><data> per level, and some
+
+enum xmlrpc_node_type
+{
+	XMLRPC_NODE_SCALAR,
+	XMLRPC_NODE_ARRAY,
+	XMLRPC_NODE_STRUCT,
+};
+
+/* A value in a request. Scalars of every type are kept as the decoded text
+ * between their tags; arrays and structs have an empty text. All strings
+ * point into the request buffer.
+ */
+struct xmlrpc_node
+{
+	enum xmlrpc_node_type type;
+	char *name;		// member name, for the members of a struct
+	char *text;
+	size_t first;		// first child, or 0
+	size_t last;		// last child, or 0
+	size_t next;		// next sibling, or 0
+	size_t count;		// number of children
+};
+
+struct xmlrpc_request
+{
+	char *method;
+	struct xmlrpc_node *nodes;	// nodes[0] holds the parameters
+	size_t count;
+	size_t size;
+};
+
+// produces a reply twice, first to work out its length and then for real
+struct xmlrpc_writer
+{
+	bool counting;
+	size_t length;
+};
+
 int
 xmlrpc_getlast_error(void)
 {
 	return xmlrpc_error_code;
 }
 
-/**
- * Parse Data down to just the <xml> without any \r\n or \t
- * @param buffer Incoming data buffer
- * @return cleaned up buffer
- */
+static void
+xmlrpc_normalize(char *buf)
+{
+	int i, j = 0;
+
+	for (i = 0; buf[i] != '\0'; i++)
+	{
+		switch (buf[i])
+		{
+			  // ctrl char
+		  case 1:
+			  break;
+			  // Bold ctrl char
+		  case 2:
+			  break;
+			  // Color ctrl char
+		  case 3:
+			  // If the next character is a digit, its also removed
+			  if (isdigit((unsigned char)buf[i + 1]))
+			  {
+				  i++;
+
+				  /* not the best way to remove colors
+				   * which are two digit but no worse then
+				   * how the Unreal does with +S - TSL
+				   */
+				  if (isdigit((unsigned char)buf[i + 1]))
+				  {
+					  i++;
+				  }
+
+				  /* Check for background color code
+				   * and remove it as well
+				   */
+				  if (buf[i + 1] == ',')
+				  {
+					  i++;
+
+					  if (isdigit((unsigned char)buf[i + 1]))
+					  {
+						  i++;
+					  }
+
+					  /* not the best way to remove colors
+					   * which are two digit but no worse then
+					   * how the Unreal does with +S - TSL
+					   */
+					  if (isdigit((unsigned char)buf[i + 1]))
+					  {
+						  i++;
+					  }
+				  }
+			  }
+
+			  break;
+			  // tabs char
+		  case 9:
+			  break;
+			  // line feed char
+		  case 10:
+			  break;
+			  // carrage returns char
+		  case 13:
+			  break;
+			  // Reverse ctrl char
+		  case 22:
+			  break;
+			  // Underline ctrl char
+		  case 31:
+			  break;
+			  // A valid char gets copied back into the buffer
+		  default:
+			  // All valid <32 characters are handled above.
+			  if (buf[i] > 31)
+			  {
+				buf[j] = buf[i];
+				j++;
+			  }
+		}
+	}
+
+	// Terminate the string
+	buf[j] = 0;
+}
+
+// The text between two tags, which has been terminated already, cleaned up and decoded in place.
 static char *
-xmlrpc_parse(char *buffer)
+xmlrpc_text(char *text)
 {
-	char *tmp = NULL;
+	xmlrpc_normalize(text);
+
+	return xmlrpc_decode_string(text);
+}
+
+static size_t
+xmlrpc_node_add(struct xmlrpc_request *req, size_t parent, char *name, char *text)
+{
+	if (req->count == req->size)
+	{
+		req->size *= 2;
+		req->nodes = sreallocarray(req->nodes, req->size, sizeof *req->nodes);
+	}
+
+	const size_t idx = req->count++;
+	struct xmlrpc_node *const node = &req->nodes[idx];
+	struct xmlrpc_node *const up = &req->nodes[parent];
+
+	memset(node, 0, sizeof *node);
+	node->type = XMLRPC_NODE_SCALAR;
+	node->name = name;
+	node->text = text;
+
+	if (up->last)
+		req->nodes[up->last].next = idx;
+	else
+		up->first = idx;
+
+	up->last = idx;
+	up->count++;
+
+	return idx;
+}
+
+static bool
+xmlrpc_is_scalar_tag(const char *tag)
+{
+	return !stricmp(tag, "string") || !stricmp(tag, "i4") || !stricmp(tag, "int") ||
+	       !stricmp(tag, "boolean") || !stricmp(tag, "double") || !stricmp(tag, "base64") ||
+	       !stricmp(tag, "dateTime.iso8601") || !stricmp(tag, "nil");
+}
+
+/* Parses a request in a single pass over the buffer, which is modified:
+ * every tag is cut out and the text between tags is decoded where it is.
+ * Element names are matched without regard to case and attributes are
+ * ignored, as are elements we do not know about, but every element has to
+ * be closed in order and the document has to be a single <methodCall>.
+ * Comments and processing instructions are cut out of the text around
+ * them.
+ */
+static bool
+xmlrpc_parse(char *buffer, struct xmlrpc_request *req)
+{
+	size_t stack[XMLRPC_MAX_DEPTH];	// open arrays and structs, stack[0] is the parameter list
+	size_t depth = 0;
+	const char *open[XMLRPC_MAX_ELEMENTS];	// names of the open elements
+	size_t nopen = 0;
+	bool done = false;		// the root element has been closed
+	size_t value = 0;		// the <value> being read, if any
+	char *member = NULL;		// name of the struct member being read
+	char *text = NULL;		// where the text after the last tag starts
+	char *text_end = NULL;		// where it ends, if comments have been cut out of it
+	char *p;
+
+	req->method = NULL;
+	req->count = 1;
+	req->size = 16;
+	req->nodes = smalloc(sizeof *req->nodes * req->size);
+	req->nodes[0].type = XMLRPC_NODE_ARRAY;
 
 	/*
 	   Okay since the buffer could contain
 	   HTTP header information, lets break
 	   off at the point that the <?xml?> starts
 	 */
-	tmp = strstr(buffer, "<?xml");
+	if ((p = strstr(buffer, "<?xml")) == NULL)
+		return false;
 
-	// check if its xml doc
-	if (tmp)
+	stack[0] = 0;
+
+	while ((p = strchr(p, '<')) != NULL)
 	{
-		// get all the odd characters out of the data
-		return xmlrpc_normalizeBuffer(tmp);
+		char *const lt = p;
+		char *tag = p + 1;
+		char *end;
+		bool closing = false, empty = false;
+
+		// comments, processing instructions and declarations
+		if (*tag == '?' || *tag == '!')
+		{
+			if (!strncmp(tag, "!--", 3))
+				end = strstr(tag + 3, "-->");
+			else
+				end = strchr(tag, '>');
+
+			if (end == NULL)
+				return false;
+
+			p = end + (*end == '-' ? 3 : 1);
+
+			// pull the text that follows up over it, so that it is left out of the text it is in
+			if (text != NULL)
+			{
+				char *const dst = text_end != NULL ? text_end : lt;
+				const size_t len = strcspn(p, "<");
+
+				memmove(dst, p, len);
+				text_end = dst + len;
+				p += len;
+			}
+
+			continue;
+		}
+
+		if ((end = strchr(tag, '>')) == NULL)
+			return false;
+
+		p = end + 1;
+
+		if (end > tag && end[-1] == '/')
+		{
+			empty = true;
+			end--;
+		}
+
+		if (*tag == '/')
+		{
+			closing = true;
+			tag++;
+		}
+
+		*end = '\0';
+		tag[strcspn(tag, " \t\r\n")] = '\0';
+
+		if (closing)
+		{
+			if (!nopen || stricmp(open[nopen - 1], tag))
+				return false;
+
+			done = (--nopen == 0);
+		}
+		else
+		{
+			// a single root element, which is not empty
+			if (done || nopen == XMLRPC_MAX_ELEMENTS || (!nopen && (empty || stricmp(tag, "methodCall"))))
+				return false;
+
+			if (!empty)
+				open[nopen++] = tag;
+		}
+
+		// ends the text before this tag; lt is an empty string from now on
+		char *const body = text != NULL ? text : lt;
+
+		if (text_end != NULL)
+			*text_end = '\0';
+
+		*lt = '\0';
+		text = p;
+		text_end = NULL;
+
+		if (!stricmp(tag, "methodName"))
+		{
+			if (closing)
+				req->method = xmlrpc_text(body);
+		}
+		else if (!stricmp(tag, "value"))
+		{
+			if (!closing)
+			{
+				if (value)
+					return false;
+
+				char *const name = req->nodes[stack[depth]].type == XMLRPC_NODE_STRUCT ? member : NULL;
+
+				if (req->nodes[stack[depth]].type == XMLRPC_NODE_STRUCT && name == NULL)
+					return false;
+
+				value = xmlrpc_node_add(req, stack[depth], name, empty ? lt : NULL);
+				member = NULL;
+
+				if (empty)
+					value = 0;
+			}
+			else
+			{
+				if (!value)
+					return false;
+
+				// a value without a type is a string
+				if (req->nodes[value].text == NULL)
+					req->nodes[value].text = xmlrpc_text(body);
+
+				value = 0;
+			}
+		}
+		else if (xmlrpc_is_scalar_tag(tag))
+		{
+			if (!value)
+				return false;
+
+			if (empty)
+				req->nodes[value].text = lt;
+			else if (closing)
+				req->nodes[value].text = xmlrpc_text(body);
+		}
+		else if (!stricmp(tag, "array") || !stricmp(tag, "struct"))
+		{
+			const enum xmlrpc_node_type type = !stricmp(tag, "array") ? XMLRPC_NODE_ARRAY : XMLRPC_NODE_STRUCT;
+
+			if (!closing)
+			{
+				if (!value || depth + 1 >= XMLRPC_MAX_DEPTH)
+					return false;
+
+				req->nodes[value].type = type;
+				req->nodes[value].text = lt;
+
+				if (!empty)
+				{
+					stack[++depth] = value;
+					value = 0;
+				}
+			}
+			else
+			{
+				if (!depth || value || req->nodes[stack[depth]].type != type)
+					return false;
+
+				value = stack[depth--];
+				member = NULL;
+			}
+		}
+		else if (!stricmp(tag, "name"))
+		{
+			if (closing)
+				member = xmlrpc_text(body);
+			else if (empty)
+				member = lt;
+		}
 	}
-	return NULL;
+
+	// every value has to be complete, and so does the document
+	return done && value == 0 && depth == 0;
 }
 
-static char *
-xmlrpc_method(char *buffer)
+static void
+xmlrpc_request_free(struct xmlrpc_request *req)
 {
-	char *data, *p, *name;
-	int namelen;
+	sfree(req->nodes);
+}
+
+static struct xmlrpc_node *
+xmlrpc_struct_member(struct xmlrpc_request *req, struct xmlrpc_node *node, const char *name)
+{
+	for (size_t i = node->first; i != 0; i = req->nodes[i].next)
+		if (!stricmp(req->nodes[i].name, name))
+			return &req->nodes[i];
 
-	data = strstr(buffer, "<methodName>");
-	if (data)
-	{
-		data += 12;
-		p = strchr(data, '<');
-		if (p == NULL)
-			return NULL;
-		namelen = p - data;
-		name = smalloc(namelen + 1);
-		memcpy(name, data, namelen);
-		return name;
-	}
 	return NULL;
 }
 
-/* Splits up a series of values into an array of strings.
- * The given buffer is modified and the pointers in the array point to
- * parts of the buffer. The array itself is dynamically allocated.
- * Returns the number of values placed in the array.
- * Largely rewritten by jilles 20080803
- */
-static int
-xmlrpc_split_buf(char *buffer, char ***argv)
+// The children of an array as the strings a method gets. Arrays and structs are passed as empty strings.
+static char **
+xmlrpc_argv(struct xmlrpc_request *req, struct xmlrpc_node *node)
 {
-	int ac = 0;
-	int argvsize = 8;
-	char *data, *str;
-	char *nexttag = NULL;
-	char *p;
-	int tagtype = 0;
+	char **const av = smalloc(sizeof *av * (node->count + 1));
+	size_t ac = 0;
 
-	data = buffer;
-	*argv = smalloc(sizeof(char *) * argvsize);
-	while ((data = strstr(data, "<value>")))
-	{
-		data += 7;
-		nexttag = strchr(data, '<');
-		if (nexttag == NULL)
-			break;
-		nexttag++;
-		p = strchr(nexttag, '>');
-		if (p == NULL)
-			break;
-		*p++ = '\0';
-
-		// strings
-		if (!stricmp("string", nexttag))
-			tagtype = 1;
-		else
-			tagtype = 0;
-		str = p;
-		p = strchr(str, '<');
-		if (p == NULL)
-			break;
-		*p++ = '\0';
-		if (ac >= argvsize)
-		{
-			argvsize *= 2;
-			*argv = sreallocarray(*argv, argvsize, sizeof(char *));
-		}
-		if (tagtype == 1)
-			(*argv)[ac++] = xmlrpc_decode_string(str);
-		else
-			(*argv)[ac++] = str;
-		data = p;
-	}			// while
-	return ac;
+	for (size_t i = node->first; i != 0; i = req->nodes[i].next)
+		av[ac++] = req->nodes[i].text;
+
+	return av;
 }
 
-void
-xmlrpc_process(char *buffer, void *userdata)
+static void
+xmlrpc_call(const char *name, void *userdata, int ac, char **av)
 {
-	int retVal = 0;
 	XMLRPCCmd *current = NULL;
 	XMLRPCCmd *xml;
-	char *tmp;
-	int ac;
-	char **av = NULL;
-	char *name = NULL;
-
-	xmlrpc_error_code = 0;
-
-	if (!buffer)
-	{
-		xmlrpc_error_code = -1;
-		return;
-	}
+	int retVal = 0;
 
-	tmp = xmlrpc_parse(buffer);
-	if (tmp)
+	xml = mowgli_patricia_retrieve(XMLRPCCMD, name);
+	if (xml)
 	{
-		name = xmlrpc_method(tmp);
-		if (name)
+		if (xml->func)
 		{
-			xml = mowgli_patricia_retrieve(XMLRPCCMD, name);
-			if (xml)
+			retVal = xml->func(userdata, ac, av);
+			if (retVal == XMLRPC_CONT)
 			{
-				ac = xmlrpc_split_buf(tmp, &av);
-				if (xml->func)
-				{
-					retVal = xml->func(userdata, ac, av);
-					if (retVal == XMLRPC_CONT)
-					{
-						current = xml->next;
-						while (current && current->func && retVal == XMLRPC_CONT)
-						{
-							retVal = current->func(userdata, ac, av);
-							current = current->next;
-						}
-					}
-					else
-					{	// we assume that XMLRPC_STOP means the handler has given no output
-						xmlrpc_error_code = -7;
-						xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: First eligible function returned XMLRPC_STOP");
-					}
-				}
-				else
+				current = xml->next;
+				while (current && current->func && retVal == XMLRPC_CONT)
 				{
-					xmlrpc_error_code = -6;
-					xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Method has no registered function");
+					retVal = current->func(userdata, ac, av);
+					current = current->next;
 				}
 			}
 			else
-			{
-				xmlrpc_error_code = -4;
-				xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Unknown routine called");
+			{	// we assume that XMLRPC_STOP means the handler has given no output
+				xmlrpc_error_code = -7;
+				xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: First eligible function returned XMLRPC_STOP");
 			}
 		}
 		else
 		{
-			xmlrpc_error_code = -3;
-			xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Missing methodRequest or methodName.");
+			xmlrpc_error_code = -6;
+			xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Method has no registered function");
 		}
 	}
 	else
+	{
+		xmlrpc_error_code = -4;
+		xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Unknown routine called");
+	}
+}
+
+static void xmlrpc_send_multicall(mowgli_string_t *replies);
+
+/* system.multicall takes an array of structs, each with a methodName and a
+ * params array, and returns an array with the reply to each call: a fault
+ * struct, or an array holding the call's return values.
+ */
+static void
+xmlrpc_multicall(struct xmlrpc_request *req, void *userdata)
+{
+	struct xmlrpc_node *const calls = req->nodes[0].first ? &req->nodes[req->nodes[0].first] : NULL;
+
+	if (calls == NULL || calls->type != XMLRPC_NODE_ARRAY)
+	{
+		xmlrpc_error_code = -9;
+		xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: system.multicall needs an array of calls");
+		return;
+	}
+
+	mowgli_string_t *const replies = mowgli_string_create();
+
+	xmlrpc.multicall = replies;
+
+	for (size_t i = calls->first; i != 0; i = req->nodes[i].next)
+	{
+		struct xmlrpc_node *const call = &req->nodes[i];
+		struct xmlrpc_node *name, *params;
+
+		xmlrpc.replied = false;
+
+		if (call->type != XMLRPC_NODE_STRUCT ||
+		    (name = xmlrpc_struct_member(req, call, "methodName")) == NULL || name->type != XMLRPC_NODE_SCALAR ||
+		    ((params = xmlrpc_struct_member(req, call, "params")) != NULL && params->type != XMLRPC_NODE_ARRAY))
+		{
+			xmlrpc_error_code = -10;
+			xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Invalid call in system.multicall");
+			continue;
+		}
+
+		if (!stricmp(name->text, "system.multicall"))
+		{
+			xmlrpc_error_code = -11;
+			xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: system.multicall cannot be nested");
+			continue;
+		}
+
+		char **const av = params != NULL ? xmlrpc_argv(req, params) : smalloc(sizeof *av);
+		const int ac = params != NULL ? (int) params->count : 0;
+
+		xmlrpc_call(name->text, userdata, ac, av);
+
+		if (!xmlrpc.replied)
+		{
+			xmlrpc_error_code = -12;
+			xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Method did not return a result");
+		}
+
+		sfree(av);
+	}
+
+	xmlrpc.multicall = NULL;
+	xmlrpc.replied = false;
+
+	xmlrpc_send_multicall(replies);
+
+	mowgli_string_destroy(replies);
+}
+
+void
+xmlrpc_process(char *buffer, void *userdata)
+{
+	struct xmlrpc_request req;
+	char **av;
+
+	xmlrpc_error_code = 0;
+	xmlrpc.replied = false;
+
+	if (!buffer)
+	{
+		xmlrpc_error_code = -1;
+		return;
+	}
+
+	if (!xmlrpc_parse(buffer, &req))
 	{
 		xmlrpc_error_code = -2;
 		xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Invalid document end at line 1");
 	}
-	sfree(av);
-	sfree(tmp);
-	sfree(name);
+	else if (req.method == NULL)
+	{
+		xmlrpc_error_code = -3;
+		xmlrpc_generic_error(xmlrpc_error_code, "XMLRPC error: Missing methodRequest or methodName.");
+	}
+	else if (!stricmp(req.method, "system.multicall"))
+		xmlrpc_multicall(&req, userdata);
+	else
+	{
+		av = xmlrpc_argv(&req, &req.nodes[0]);
+		xmlrpc_call(req.method, userdata, (int) req.nodes[0].count, av);
+		sfree(av);
+	}
+
+	xmlrpc_request_free(&req);
 }
 
 void
-xmlrpc_set_buffer(char *(*func) (char *buffer, int len))
+xmlrpc_set_output(const struct xmlrpc_output *output)
 {
-	return_if_fail(func != NULL);
-	xmlrpc.setbuffer = func;
+	return_if_fail(output != NULL);
+	return_if_fail(output->write != NULL);
+	xmlrpc.output = output;
 }
 
 static XMLRPCCmd * ATHEME_FATTR_MALLOC
@@ -265,123 +641,229 @@ xmlrpc_unregister_method(const char *method)
 	return XMLRPC_ERR_OK;
 }
 
-static char *
-xmlrpc_write_header(int length)
+static void
+xmlrpc_write_header(char *buf, size_t bufsize, size_t length)
 {
-	char buf[512];
 	time_t ts;
 	char timebuf[64];
 	struct tm *tm;
 
-	*buf = '\0';
-
 	ts = time(NULL);
 	tm = localtime(&ts);
 	strftime(timebuf, sizeof timebuf, "%Y-%m-%d %H:%M:%S", tm);
 
-	snprintf(buf, sizeof buf,
+	snprintf(buf, bufsize,
 	         "HTTP/1.1 200 OK\r\n"
 	         "Date: %s\r\n"
 	         "Server: %s/%s\r\n"
 	         "Content-Type: text/xml\r\n"
-	         "Content-Length: %d\r\n"
+	         "Content-Length: %zu\r\n"
 	         "Connection: close\r\n"
 	         "\r\n",
 	         timebuf,
 	         PACKAGE_TARNAME, PACKAGE_VERSION,
 	         length);
+}
 
-	return sstrdup(buf);
+static void
+xmlrpc_emit(struct xmlrpc_writer *w, const char *data, size_t len)
+{
+	if (w->counting)
+		w->length += len;
+	else if (xmlrpc.multicall != NULL)
+		mowgli_string_append(xmlrpc.multicall, data, len);
+	else
+		xmlrpc.output->write(data, len);
+}
+
+static inline void
+xmlrpc_emit_str(struct xmlrpc_writer *w, const char *str)
+{
+	xmlrpc_emit(w, str, strlen(str));
 }
 
 static void
-xmlrpc_append_char_encode(mowgli_string_t *s, const char *s1)
+xmlrpc_emit_encoded(struct xmlrpc_writer *w, const char *s1)
 {
-	long unsigned int i;
+	const char *run = s1;
 	unsigned char c;
 	char buf2[15];
 
-	if ((!(s1) || (*(s1) == '\0')))
-	{
+	if (s1 == NULL)
 		return;
-	}
 
-	for (i = 0; s1[i] != '\0'; i++)
+	for (; *s1 != '\0'; s1++)
 	{
-		c = s1[i];
+		const char *entity;
+
+		c = *s1;
 		if (c > 127)
 		{
 			snprintf(buf2, sizeof buf2, "&#%d;", c);
-			s->append(s, buf2, strlen(buf2));
+			entity = buf2;
 		}
 		else if (c == '&')
-		{
-			s->append(s, "&amp;", 5);
-		}
+			entity = "&amp;";
 		else if (c == '<')
-		{
-			s->append(s, "&lt;", 4);
-		}
+			entity = "&lt;";
 		else if (c == '>')
-		{
-			s->append(s, "&gt;", 4);
-		}
+			entity = "&gt;";
 		else if (c == '"')
-		{
-			s->append(s, "&quot;", 6);
-		}
+			entity = "&quot;";
 		else
-		{
-			s->append_char(s, c);
-		}
+			continue;
+
+		xmlrpc_emit(w, run, s1 - run);
+		xmlrpc_emit_str(w, entity);
+		run = s1 + 1;
 	}
+
+	xmlrpc_emit(w, run, s1 - run);
 }
 
-void
-xmlrpc_generic_error(int code, const char *string)
+/* Starts a reply to the current call. Only the first reply to a call is
+ * sent; a method that tries to answer twice loses the second one.
+ */
+static bool
+xmlrpc_reply_begin(struct xmlrpc_writer *w)
+{
+	if (xmlrpc.replied || xmlrpc.output == NULL)
+		return false;
+
+	xmlrpc.replied = true;
+
+	// replies collected for system.multicall are written once, directly
+	w->counting = xmlrpc.multicall == NULL;
+	w->length = 0;
+
+	return true;
+}
+
+/* Called after each pass over a reply. After the first pass the length is
+ * known, so the headers go out and true is returned for the second pass,
+ * which writes the reply to the connection piece by piece.
+ */
+static bool
+xmlrpc_reply_next(struct xmlrpc_writer *w)
+{
+	if (!w->counting)
+	{
+		if (xmlrpc.multicall == NULL && xmlrpc.output->end != NULL)
+			xmlrpc.output->end();
+
+		return false;
+	}
+
+	w->counting = false;
+
+	if (xmlrpc.httpheader)
+	{
+		char header[512];
+
+		xmlrpc_write_header(header, sizeof header, w->length);
+		xmlrpc.output->write(header, strlen(header));
+	}
+	else if (xmlrpc.output->begin != NULL)
+		xmlrpc.output->begin(w->length);
+
+	return true;
+}
+
+static void
+xmlrpc_emit_declaration(struct xmlrpc_writer *w)
 {
 	char buf[1024];
-	const char *ss;
-	mowgli_string_t *s = mowgli_string_create();
-	char *s2;
-	int len;
 
 	if (xmlrpc.encode)
-	{
 		snprintf(buf, sizeof buf, "<?xml version=\"1.0\" encoding=\"%s\" ?>\r\n<methodResponse>\r\n", xmlrpc.encode);
-	}
 	else
-	{
 		snprintf(buf, sizeof buf, "<?xml version=\"1.0\"?>\r\n<methodResponse>\r\n");
+
+	xmlrpc_emit_str(w, buf);
+}
+
+// Inside system.multicall, the return values of a call are an array.
+static void
+xmlrpc_emit_params_start(struct xmlrpc_writer *w)
+{
+	if (xmlrpc.multicall != NULL)
+		xmlrpc_emit_str(w, "<value><array><data>\r\n");
+	else
+	{
+		xmlrpc_emit_declaration(w);
+		xmlrpc_emit_str(w, "<params>\r\n");
 	}
-	s->append(s, buf, strlen(buf));
+}
 
-	ss = " <fault>\r\n  <value>\r\n   <struct>\r\n    <member>\r\n     <name>faultCode</name>\r\n     <value><int>";
-	s->append(s, ss, strlen(ss));
-	snprintf(buf, sizeof buf, "%d", code);
-	s->append(s, buf, strlen(buf));
-	ss = "</int></value>\r\n    </member>\r\n    <member>\r\n     <name>faultString</name>\r\n     <value><string>";
-	s->append(s, ss, strlen(ss));
-	xmlrpc_append_char_encode(s, string);
-	ss = "</string></value>\r\n    </member>\r\n   </struct>\r\n  </value>\r\n </fault>\r\n</methodResponse>";
-	s->append(s, ss, strlen(ss));
+static void
+xmlrpc_emit_params_end(struct xmlrpc_writer *w)
+{
+	if (xmlrpc.multicall != NULL)
+		xmlrpc_emit_str(w, "</data></array></value>\r\n");
+	else
+		xmlrpc_emit_str(w, "</params>\r\n</methodResponse>");
+}
 
-	len = s->pos;
+static void
+xmlrpc_emit_param_start(struct xmlrpc_writer *w)
+{
+	if (xmlrpc.multicall != NULL)
+		xmlrpc_emit_str(w, " <value>");
+	else
+		xmlrpc_emit_str(w, " <param>\r\n  <value>\r\n   ");
+}
 
-	if (xmlrpc.httpheader)
+static void
+xmlrpc_emit_param_end(struct xmlrpc_writer *w)
+{
+	if (xmlrpc.multicall != NULL)
+		xmlrpc_emit_str(w, "</value>\r\n");
+	else
+		xmlrpc_emit_str(w, "\r\n  </value>\r\n </param>\r\n");
+}
+
+static void
+xmlrpc_reset_encode(void)
+{
+	if (xmlrpc.encode)
 	{
-		char *header = xmlrpc_write_header(len);
-		s2 = smalloc(strlen(header) + len + 1);
-		strcpy(s2, header);
-		memcpy(s2 + strlen(header), s->str, len);
-		xmlrpc.setbuffer(s2, len + strlen(header));
-		sfree(header);
-		sfree(s2);
+		sfree(xmlrpc.encode);
+		xmlrpc.encode = NULL;
 	}
-	else
-		xmlrpc.setbuffer(s->str, len);
+}
 
-	s->destroy(s);
+void
+xmlrpc_generic_error(int code, const char *string)
+{
+	struct xmlrpc_writer w;
+	char buf[32];
+
+	if (!xmlrpc_reply_begin(&w))
+		return;
+
+	snprintf(buf, sizeof buf, "%d", code);
+
+	do
+	{
+		if (xmlrpc.multicall != NULL)
+			xmlrpc_emit_str(&w, "<value>\r\n   <struct>\r\n");
+		else
+		{
+			xmlrpc_emit_declaration(&w);
+			xmlrpc_emit_str(&w, " <fault>\r\n  <value>\r\n   <struct>\r\n");
+		}
+
+		xmlrpc_emit_str(&w, "    <member>\r\n     <name>faultCode</name>\r\n     <value><int>");
+		xmlrpc_emit_str(&w, buf);
+		xmlrpc_emit_str(&w, "</int></value>\r\n    </member>\r\n    <member>\r\n     <name>faultString</name>\r\n     <value><string>");
+		xmlrpc_emit_encoded(&w, string);
+		xmlrpc_emit_str(&w, "</string></value>\r\n    </member>\r\n   </struct>\r\n");
+
+		if (xmlrpc.multicall != NULL)
+			xmlrpc_emit_str(&w, "</value>\r\n");
+		else
+			xmlrpc_emit_str(&w, "  </value>\r\n </fault>\r\n</methodResponse>");
+	} while (xmlrpc_reply_next(&w));
 }
 
 int
@@ -408,119 +890,75 @@ xmlrpc_about(void *userdata, int ac, char **av)
 void
 xmlrpc_send(int argc, ...)
 {
+	struct xmlrpc_writer w;
 	va_list va;
-	int idx = 0;
-	int len;
-	char buf[1024];
-	const char *ss;
-	mowgli_string_t *s = mowgli_string_create();
-	char *s2;
-	char *header;
+	int idx;
 
-	if (xmlrpc.encode)
-	{
-		snprintf(buf, sizeof buf, "<?xml version=\"1.0\" encoding=\"%s\" ?>\r\n<methodResponse>\r\n<params>\r\n", xmlrpc.encode);
-	}
-	else
-	{
-		snprintf(buf, sizeof buf, "<?xml version=\"1.0\"?>\r\n<methodResponse>\r\n<params>\r\n");
-	}
-	s->append(s, buf, strlen(buf));
+	if (!xmlrpc_reply_begin(&w))
+		return;
 
-	va_start(va, argc);
-	for (idx = 0; idx < argc; idx++)
+	do
 	{
-		ss = " <param>\r\n  <value>\r\n   ";
-		s->append(s, ss, strlen(ss));
-		ss = va_arg(va, const char *);
-		s->append(s, ss, strlen(ss));
-		ss = "\r\n  </value>\r\n </param>\r\n";
-		s->append(s, ss, strlen(ss));
-	}
-	va_end(va);
+		xmlrpc_emit_params_start(&w);
 
-	ss = "</params>\r\n</methodResponse>";
-	s->append(s, ss, strlen(ss));
-
-	len = s->pos;
+		va_start(va, argc);
+		for (idx = 0; idx < argc; idx++)
+		{
+			xmlrpc_emit_param_start(&w);
+			xmlrpc_emit_str(&w, va_arg(va, const char *));
+			xmlrpc_emit_param_end(&w);
+		}
+		va_end(va);
 
-	if (xmlrpc.httpheader)
-	{
-		header = xmlrpc_write_header(len);
-		s2 = smalloc(strlen(header) + len + 1);
-		strcpy(s2, header);
-		memcpy(s2 + strlen(header), s->str, len);
-		xmlrpc.setbuffer(s2, len + strlen(header));
-		sfree(header);
-		sfree(s2);
-		xmlrpc.httpheader = 1;
-	}
-	else
-	{
-		xmlrpc.setbuffer(s->str, len);
-	}
-	if (xmlrpc.encode)
-	{
-		sfree(xmlrpc.encode);
-		xmlrpc.encode = NULL;
-	}
+		xmlrpc_emit_params_end(&w);
+	} while (xmlrpc_reply_next(&w));
 
-	s->destroy(s);
+	xmlrpc_reset_encode();
 }
 
 void
 xmlrpc_send_string(const char *value)
 {
-	int len;
-	char buf[1024];
-	const char *ss;
-	mowgli_string_t *s = mowgli_string_create();
-	char *s2;
-	char *header;
+	struct xmlrpc_writer w;
 
-	if (xmlrpc.encode)
-	{
-		snprintf(buf, sizeof buf, "<?xml version=\"1.0\" encoding=\"%s\" ?>\r\n<methodResponse>\r\n<params>\r\n", xmlrpc.encode);
-	}
-	else
-	{
-		snprintf(buf, sizeof buf, "<?xml version=\"1.0\"?>\r\n<methodResponse>\r\n<params>\r\n");
-	}
-	s->append(s, buf, strlen(buf));
+	if (!xmlrpc_reply_begin(&w))
+		return;
 
-	ss = " <param>\r\n  <value>\r\n   <string>";
-	s->append(s, ss, strlen(ss));
-	xmlrpc_append_char_encode(s, value);
-	ss = "</string>\r\n  </value>\r\n </param>\r\n";
-	s->append(s, ss, strlen(ss));
+	do
+	{
+		xmlrpc_emit_params_start(&w);
+		xmlrpc_emit_param_start(&w);
+		xmlrpc_emit_str(&w, "<string>");
+		xmlrpc_emit_encoded(&w, value);
+		xmlrpc_emit_str(&w, "</string>");
+		xmlrpc_emit_param_end(&w);
+		xmlrpc_emit_params_end(&w);
+	} while (xmlrpc_reply_next(&w));
+
+	xmlrpc_reset_encode();
+}
 
-	ss = "</params>\r\n</methodResponse>";
-	s->append(s, ss, strlen(ss));
+// The reply to system.multicall: one array, with the replies to the calls as its values.
+static void
+xmlrpc_send_multicall(mowgli_string_t *replies)
+{
+	struct xmlrpc_writer w;
 
-	len = s->pos;
+	if (!xmlrpc_reply_begin(&w))
+		return;
 
-	if (xmlrpc.httpheader)
-	{
-		header = xmlrpc_write_header(len);
-		s2 = smalloc(strlen(header) + len + 1);
-		strcpy(s2, header);
-		memcpy(s2 + strlen(header), s->str, len);
-		xmlrpc.setbuffer(s2, len + strlen(header));
-		sfree(header);
-		sfree(s2);
-		xmlrpc.httpheader = 1;
-	}
-	else
-	{
-		xmlrpc.setbuffer(s->str, len);
-	}
-	if (xmlrpc.encode)
+	do
 	{
-		sfree(xmlrpc.encode);
-		xmlrpc.encode = NULL;
-	}
-
-	s->destroy(s);
+		xmlrpc_emit_params_start(&w);
+		xmlrpc_emit_param_start(&w);
+		xmlrpc_emit_str(&w, "<array>\r\n<data>\r\n");
+		xmlrpc_emit(&w, replies->str, replies->pos);
+		xmlrpc_emit_str(&w, "</data>\r\n</array>");
+		xmlrpc_emit_param_end(&w);
+		xmlrpc_emit_params_end(&w);
+	} while (xmlrpc_reply_next(&w));
+
+	xmlrpc_reset_encode();
 }
 
 char *
@@ -623,92 +1061,11 @@ xmlrpc_array(int argc, ...)
 char *
 xmlrpc_normalizeBuffer(const char *buf)
 {
-	char *newbuf;
-	int i, len, j = 0;
+	char *newbuf = sstrdup(buf);
 
-	len = strlen(buf);
-	newbuf = smalloc(sizeof(char) * len + 1);
+	xmlrpc_normalize(newbuf);
 
-	for (i = 0; i < len; i++)
-	{
-		switch (buf[i])
-		{
-			  // ctrl char
-		  case 1:
-			  break;
-			  // Bold ctrl char
-		  case 2:
-			  break;
-			  // Color ctrl char
-		  case 3:
-			  // If the next character is a digit, its also removed
-			  if (isdigit((unsigned char)buf[i + 1]))
-			  {
-				  i++;
-
-				  /* not the best way to remove colors
-				   * which are two digit but no worse then
-				   * how the Unreal does with +S - TSL
-				   */
-				  if (isdigit((unsigned char)buf[i + 1]))
-				  {
-					  i++;
-				  }
-
-				  /* Check for background color code
-				   * and remove it as well
-				   */
-				  if (buf[i + 1] == ',')
-				  {
-					  i++;
-
-					  if (isdigit((unsigned char)buf[i + 1]))
-					  {
-						  i++;
-					  }
-
-					  /* not the best way to remove colors
-					   * which are two digit but no worse then
-					   * how the Unreal does with +S - TSL
-					   */
-					  if (isdigit((unsigned char)buf[i + 1]))
-					  {
-						  i++;
-					  }
-				  }
-			  }
-
-			  break;
-			  // tabs char
-		  case 9:
-			  break;
-			  // line feed char
-		  case 10:
-			  break;
-			  // carrage returns char
-		  case 13:
-			  break;
-			  // Reverse ctrl char
-		  case 22:
-			  break;
-			  // Underline ctrl char
-		  case 31:
-			  break;
-			  // A valid char gets copied into the new buffer
-		  default:
-			  // All valid <32 characters are handled above.
-			  if (buf[i] > 31)
-			  {
-				newbuf[j] = buf[i];
-				j++;
-			  }
-		}
-	}
-
-	// Terminate the string
-	newbuf[j] = 0;
-
-	return (newbuf);
+	return newbuf;
 }
 
 int
@@ -754,7 +1111,7 @@ xmlrpc_char_encode(char *outbuffer, const char *s1)
 	long unsigned int i;
 	unsigned char c;
 	char buf2[15];
-	mowgli_string_t *s = mowgli_string_create();
+	mowgli_string_t *s;
 	*buf2 = '\0';
 	*outbuffer = '\0';
 
@@ -763,6 +1120,8 @@ xmlrpc_char_encode(char *outbuffer, const char *s1)
 		return;
 	}
 
+	s = mowgli_string_create();
+
 	for (i = 0; s1[i] != '\0'; i++)
 	{
 		c = s1[i];
@@ -795,6 +1154,8 @@ xmlrpc_char_encode(char *outbuffer, const char *s1)
 	s->append_char(s, 0);
 
 	strncpy(outbuffer, s->str, XMLRPC_BUFSIZE);
+
+	mowgli_string_destroy(s);
 }
 
 /* In-place decode of some entities
@@ -57,6 +57,17 @@
 
 typedef int (*XMLRPCMethodFunc)(void *userdata, int ac, char **av);
 
+/* Where replies go. begin() is called with the length of the reply before
+ * any of it is written, unless the library writes its own HTTP headers, and
+ * end() after all of it; either may be NULL.
+ */
+struct xmlrpc_output
+{
+	void (*begin)(size_t length);
+	void (*write)(const char *data, size_t length);
+	void (*end)(void);
+};
+
 int xmlrpc_getlast_error(void);
 void xmlrpc_process(char *buffer, void *userdata);
 int xmlrpc_register_method(const char *name, XMLRPCMethodFunc func);
@@ -70,7 +81,7 @@ char *xmlrpc_integer(char *buf, int value);
 char *xmlrpc_time2date(char *buf, time_t t);
 
 int xmlrpc_set_options(int type, const char *value);
-void xmlrpc_set_buffer(char *(*func)(char *buffer, int len));
+void xmlrpc_set_output(const struct xmlrpc_output *output);
 void xmlrpc_generic_error(int code, const char *string);
 void xmlrpc_send(int argc, ...);
 void xmlrpc_send_string(const char *value);
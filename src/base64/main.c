@@ -3,41 +3,287 @@
  * SPDX-URL: https://spdx.org/licenses/ISC.html
  *
  * Copyright (C) 2011 William Pitcock <nenolod@dereferenced.org>
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Base64 codec self-test and throughput benchmark.
  */
 
 #include <atheme.h>
 #include <atheme/libathemecore.h>
+#include <ext/getopt_long.h>
 
-int
-main(int argc, const char *argv)
+#define B64TEST_BENCH_SECONDS   0.5L
+#define B64TEST_FUZZ_ROUNDS     2000U
+#define B64TEST_FUZZ_MAXLEN     600U
+
+static const char *const b64test_alphabets[] = {
+
+	BASE64_ALPHABET_RFC4648,
+	BASE64_ALPHABET_RFC4648_NOPAD,
+	BASE64_ALPHABET_CRYPT3,
+	BASE64_ALPHABET_CRYPT3_BLOWFISH,
+};
+
+// Typical SASL PLAIN / SCRAM message, an AUTHENTICATE-sized chunk, and larger RPC payloads
+static const size_t b64test_sizes[] = { 48, 300, 4096, 65536 };
+
+static void
+b64test_print_usage(const char *const restrict progname)
 {
-	if (! libathemecore_early_init())
-		return EXIT_FAILURE;
+	(void) fprintf(stderr,
+		"Usage: %s [-b] [-h]\n"
+		"\n"
+		"  -b  Benchmark every usable kernel instead of running the self-test\n"
+		"\n"
+		"The self-test checks every usable kernel against the portable code.\n", progname);
+}
+
+static long double
+b64test_elapsed(const struct timespec *const restrict begin)
+{
+	struct timespec end;
 
-	char b64[] = "Q2hyaXNUZXN0AENocmlzVGVzdABwbXpqZ3VseGF5ZWJjcGJ3cXFkaA==";
-	char b64out[BUFSIZE];
-	char b64pristine[] = "ChrisTest\0ChrisTest\0pmzjgulxayebcpbwqqdh";
+	(void) clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return ((long double) (end.tv_sec - begin->tv_sec)) +
+	       (((long double) (end.tv_nsec - begin->tv_nsec)) / 1000000000.0L);
+}
+
+static bool
+b64test_known_answer(void)
+{
+	static const char b64[] = "Q2hyaXNUZXN0AENocmlzVGVzdABwbXpqZ3VseGF5ZWJjcGJ3cXFkaA==";
+	static const char pristine[] = "ChrisTest\0ChrisTest\0pmzjgulxayebcpbwqqdh";
+
+	char out[BUFSIZE];
+	char enc[BUFSIZE];
+
+	const size_t rc = base64_decode(b64, out, sizeof out);
+
+	if (rc != (sizeof pristine - 1U) || memcmp(out, pristine, rc) != 0)
+		return false;
+
+	if (base64_encode(pristine, sizeof pristine - 1U, enc, sizeof enc) != (sizeof b64 - 1U))
+		return false;
+
+	return (strcmp(enc, b64) == 0);
+}
 
-	size_t rc = base64_decode(b64, b64out, sizeof b64out);
+/* Encode and decode random data of random lengths with every alphabet, then mangle the encoding
+ * (whitespace, invalid characters, early padding, truncation) and decode it again. Every result,
+ * including the failures, must match what the portable code does with the same input.
+ */
+static bool
+b64test_fuzz(const enum base64_kernel kernel)
+{
+	unsigned char raw[B64TEST_FUZZ_MAXLEN];
+	char enc_ref[BASE64_SIZE_STR(B64TEST_FUZZ_MAXLEN) * 2U];
+	char enc_ker[sizeof enc_ref];
+	unsigned char dec_ref[B64TEST_FUZZ_MAXLEN];
+	unsigned char dec_ker[B64TEST_FUZZ_MAXLEN];
 
-	if (rc == (size_t) -1)
+	for (unsigned int round = 0; round < B64TEST_FUZZ_ROUNDS; round++)
 	{
-		fprintf(stderr, "Failed to decode data!\n");
-		return EXIT_FAILURE;
+		const char *const alphabet = b64test_alphabets[round % ARRAY_SIZE(b64test_alphabets)];
+		const size_t len = atheme_random_uniform(B64TEST_FUZZ_MAXLEN + 1U);
+
+		(void) atheme_random_buf(raw, len);
+
+		(void) base64_use_kernel(BASE64_KERNEL_PORTABLE);
+		const size_t elen_ref = base64_encode_table(raw, len, enc_ref, sizeof enc_ref, alphabet);
+		(void) base64_use_kernel(kernel);
+		const size_t elen_ker = base64_encode_table(raw, len, enc_ker, sizeof enc_ker, alphabet);
+
+		if (elen_ref != elen_ker || strcmp(enc_ref, enc_ker) != 0)
+		{
+			(void) fprintf(stderr, "Encoding mismatch (%zu bytes, alphabet '%s')\n", len, alphabet);
+			return false;
+		}
+
+		switch (round % 5U)
+		{
+			case 1:
+			{
+				// Insert a line break or a space
+				const size_t pos = atheme_random_uniform((uint32_t) elen_ref + 1U);
+
+				(void) memmove(enc_ref + pos + 1U, enc_ref + pos, elen_ref - pos + 1U);
+				enc_ref[pos] = (atheme_random_uniform(2) ? '\n' : ' ');
+				break;
+			}
+
+			case 2:
+				// Replace a character with something that is probably not in the alphabet
+				if (elen_ref)
+					enc_ref[atheme_random_uniform((uint32_t) elen_ref)] = (char) atheme_random_uniform(0x100);
+				break;
+
+			case 3:
+				// Truncate
+				enc_ref[atheme_random_uniform((uint32_t) elen_ref + 1U)] = 0x00;
+				break;
+
+			case 4:
+				// Pad early
+				if (elen_ref)
+					enc_ref[atheme_random_uniform((uint32_t) elen_ref)] = '=';
+				break;
+		}
+
+		// Also try a too-short output buffer now and then
+		const size_t dlen = ((round % 7U) == 0 && len) ? atheme_random_uniform((uint32_t) len) : len;
+
+		(void) memset(dec_ref, 0x00, sizeof dec_ref);
+		(void) memset(dec_ker, 0x00, sizeof dec_ker);
+
+		(void) base64_use_kernel(BASE64_KERNEL_PORTABLE);
+		const size_t dres_ref = base64_decode_table(enc_ref, dec_ref, dlen, alphabet);
+		(void) base64_use_kernel(kernel);
+		const size_t dres_ker = base64_decode_table(enc_ref, dec_ker, dlen, alphabet);
+
+		if (dres_ref != dres_ker || (dres_ref != BASE64_FAIL && memcmp(dec_ref, dec_ker, dres_ref) != 0))
+		{
+			(void) fprintf(stderr, "Decoding mismatch (%zu bytes, alphabet '%s', round %u)\n",
+			               len, alphabet, round);
+			return false;
+		}
+
+		if ((round % 5U) == 0 && dlen == len && (dres_ref != len || memcmp(dec_ref, raw, len) != 0))
+		{
+			(void) fprintf(stderr, "Round trip failed (%zu bytes, alphabet '%s')\n", len, alphabet);
+			return false;
+		}
 	}
 
-	printf("decode: %d sz: %zu\n", rc, sizeof(b64pristine));
-	printf("b64pri: %s:%s:%s\n", b64pristine, b64pristine + 10, b64pristine + 20);
-	printf("b64out: %s:%s:%s\n", b64out, b64out + 10, b64out + 20);
+	return true;
+}
+
+static void
+b64test_benchmark(const enum base64_kernel kernel)
+{
+	(void) printf("%-8s", base64_kernel_name(kernel));
 
-	if (memcmp(b64out, b64pristine, sizeof(b64pristine)))
+	for (size_t i = 0; i < ARRAY_SIZE(b64test_sizes); i++)
 	{
-		printf("FAIL.\n");
+		const size_t len = b64test_sizes[i];
+		const size_t elen = BASE64_SIZE_STR(len);
+
+		unsigned char *const raw = smalloc(len);
+		char *const enc = smalloc(elen);
+
+		(void) atheme_random_buf(raw, len);
+		(void) base64_use_kernel(kernel);
+
+		unsigned long long int bytes = 0;
+		struct timespec begin;
+		long double elapsed;
+
+		(void) clock_gettime(CLOCK_MONOTONIC, &begin);
+
+		do
+		{
+			for (unsigned int j = 0; j < 64U; j++)
+				if (base64_encode(raw, len, enc, elen) == BASE64_FAIL)
+					abort();
+
+			bytes += (64U * len);
+
+		} while ((elapsed = b64test_elapsed(&begin)) < B64TEST_BENCH_SECONDS);
+
+		const long double enc_rate = (((long double) bytes) / elapsed) / 1048576.0L;
+
+		bytes = 0;
+
+		(void) clock_gettime(CLOCK_MONOTONIC, &begin);
+
+		do
+		{
+			for (unsigned int j = 0; j < 64U; j++)
+				if (base64_decode(enc, raw, len) != len)
+					abort();
+
+			bytes += (64U * len);
+
+		} while ((elapsed = b64test_elapsed(&begin)) < B64TEST_BENCH_SECONDS);
+
+		const long double dec_rate = (((long double) bytes) / elapsed) / 1048576.0L;
+
+		(void) printf("  %8.0Lf %8.0Lf", enc_rate, dec_rate);
+		(void) fflush(stdout);
+
+		(void) sfree(raw);
+		(void) sfree(enc);
+	}
+
+	(void) printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+	const mowgli_getopt_option_t long_opts[] = {
+		{      "benchmark",       no_argument, NULL, 'b', 0 },
+		{           "help",       no_argument, NULL, 'h', 0 },
+		{             NULL,                 0, NULL,  0 , 0 },
+	};
+
+	bool benchmark = false;
+	int r;
+
+	if (! libathemecore_early_init())
 		return EXIT_FAILURE;
+
+	while ((r = mowgli_getopt_long(argc, argv, "bh", long_opts, NULL)) != -1)
+	{
+		switch (r)
+		{
+			case 'b':
+				benchmark = true;
+				break;
+
+			case 'h':
+				(void) b64test_print_usage(argv[0]);
+				return EXIT_SUCCESS;
+
+			default:
+				(void) b64test_print_usage(argv[0]);
+				return EXIT_FAILURE;
+		}
 	}
-	else
+
+	const enum base64_kernel selected = base64_get_kernel();
+
+	(void) printf("Selected kernel: %s\n", base64_kernel_name(selected));
+
+	if (benchmark)
 	{
-		printf("PASS.\n");
+		(void) printf("\nThroughput in MiB/s of raw data (encode, decode):\n\n%-8s", "");
+
+		for (size_t i = 0; i < ARRAY_SIZE(b64test_sizes); i++)
+			(void) printf("  %8zu %8s", b64test_sizes[i], "bytes");
+
+		(void) printf("\n");
+
+		for (unsigned int k = 0; k < BASE64_KERNEL_COUNT; k++)
+			if (base64_use_kernel((enum base64_kernel) k))
+				(void) b64test_benchmark((enum base64_kernel) k);
+
 		return EXIT_SUCCESS;
 	}
+
+	bool passed = true;
+
+	for (unsigned int k = 0; k < BASE64_KERNEL_COUNT; k++)
+	{
+		if (! base64_use_kernel((enum base64_kernel) k))
+			continue;
+
+		const bool ok = b64test_known_answer() && b64test_fuzz((enum base64_kernel) k);
+
+		(void) printf("%-8s %s\n", base64_kernel_name((enum base64_kernel) k), ok ? "PASS" : "FAIL");
+
+		passed = (passed && ok);
+	}
+
+	return (passed ? EXIT_SUCCESS : EXIT_FAILURE);
 }
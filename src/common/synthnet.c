@@ -0,0 +1,331 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * A synthetic network for the measuring tools (footprint, microbench).
+ */
+
+#include <atheme.h>
+#include <atheme/libathemecore.h>
+
+#include "synthnet.h"
+
+// A crypt(3)-style digest of typical length; the password is never checked
+#define SYNTHNET_PASSWORD       "$pbkdf2-v2$6$64000$MTIzNDU2Nzg5MDEyMzQ1Njc4OTAxMjM0$" \
+                                "QUJDREVGR0hJSktMTU5PUFFSU1RVVldYWVphYmNkZWZnaGlqa2xtbm9w"
+
+const char *const synthnet_metadata_names[SYNTHNET_METADATA_NAMES] = {
+
+	"private:host:actual",
+	"private:host:vhost",
+	"private:usercloak",
+	"private:freeze:freezer",
+	"private:mark:setter",
+	"private:loginfail:failnum",
+	"private:lastquit:message",
+	"private:setpass:key",
+};
+
+static struct ircd synthnet_ircd = {
+
+	.ircdname       = "synthnet",
+	.tldprefix      = "$$",
+	.uses_uid       = true,
+	.uses_vhost     = true,
+	.ban_like_modes = "b",
+	.flags          = IRCD_CIDR_BANS,
+};
+
+static const struct cmode synthnet_prefix_modes[] = {
+
+	{ '@', CSTATUS_OP },
+	{ '\0', 0 },
+};
+
+bool ATHEME_FATTR_WUR
+synthnet_option(const char *const restrict arg, unsigned int *const restrict value, const unsigned int max)
+{
+	if (string_to_uint(arg, value) && *value <= max)
+		return true;
+
+	(void) fprintf(stderr, "Invalid number '%s' (must be at most %u)\n", arg, max);
+	return false;
+}
+
+unsigned int
+synthnet_rand(struct synthnet *const restrict net, const unsigned int range)
+{
+	// xorshift64*; deterministic for a given seed, unlike atheme_random_uniform()
+	net->rng_state ^= net->rng_state >> 12;
+	net->rng_state ^= net->rng_state << 25;
+	net->rng_state ^= net->rng_state >> 27;
+
+	return (unsigned int) (((net->rng_state * 0x2545F4914F6CDD1DULL) >> 32) % range);
+}
+
+/* Starts libathemecore as a services instance with no uplink, logging to
+ * <tool>.log, and sets aside room for the network described by net.
+ */
+void
+synthnet_init(struct synthnet *const restrict net, char *const restrict progname, const char *const restrict tool)
+{
+	char buf[BUFSIZE];
+
+	if (! net->servers)
+		net->servers = 1U + (net->users / 5000U);
+
+	if (net->mychans > net->channels)
+		net->mychans = net->channels;
+
+	if (net->joins > net->channels)
+		net->joins = net->channels;
+
+	net->rng_state = 0x9E3779B97F4A7C15ULL ^ net->seed;
+
+	(void) snprintf(buf, sizeof buf, "%s/%s.log", LOGDIR, tool);
+
+	(void) atheme_bootstrap();
+	(void) atheme_init(progname, buf);
+	(void) atheme_setup();
+
+	ircd = &synthnet_ircd;
+	prefix_mode_list = synthnet_prefix_modes;
+	runflags |= RF_STARTING;
+
+	(void) snprintf(buf, sizeof buf, "services.%s.example.net", tool);
+
+	me.me = server_add(buf, 0, NULL, "000", "Synthetic network services");
+
+	net->server_list = scalloc(net->servers, sizeof *net->server_list);
+	net->user_list = scalloc(net->users ? net->users : 1U, sizeof *net->user_list);
+	net->channel_list = scalloc(net->channels ? net->channels : 1U, sizeof *net->channel_list);
+	net->account_list = scalloc(net->accounts ? net->accounts : 1U, sizeof *net->account_list);
+	net->mychan_list = scalloc(net->mychans ? net->mychans : 1U, sizeof *net->mychan_list);
+}
+
+unsigned int
+synthnet_build_servers(struct synthnet *const restrict net)
+{
+	char name[HOSTLEN + 1];
+	char sid[IDLEN + 1];
+
+	for (unsigned int i = 0; i < net->servers; i++)
+	{
+		(void) snprintf(name, sizeof name, "irc%u.synthnet.example.net", i);
+		(void) snprintf(sid, sizeof sid, "%03u", i + 1U);
+
+		net->server_list[i] = server_add(name, 1, me.me, sid, "Synthetic network server");
+	}
+
+	return net->servers;
+}
+
+unsigned int
+synthnet_build_accounts(struct synthnet *const restrict net)
+{
+	char name[NICKLEN + 1];
+	char email[EMAILLEN + 1];
+
+	for (unsigned int i = 0; i < net->accounts; i++)
+	{
+		(void) snprintf(name, sizeof name, "Account%u", i);
+		(void) snprintf(email, sizeof email, "account%u@mail%u.example.org", i, synthnet_rand(net, 100U));
+
+		net->account_list[i] = myuser_add(name, SYNTHNET_PASSWORD, email, MU_CRYPTPASS);
+
+		(void) mynick_add(net->account_list[i], name);
+	}
+
+	return net->accounts;
+}
+
+unsigned int
+synthnet_build_metadata(struct synthnet *const restrict net)
+{
+	char name[32];
+	char value[64];
+
+	for (unsigned int i = 0; i < net->accounts; i++)
+	{
+		for (unsigned int j = 0; j < net->metadata; j++)
+		{
+			if (j < SYNTHNET_METADATA_NAMES)
+				(void) mowgli_strlcpy(name, synthnet_metadata_names[j], sizeof name);
+			else
+				(void) snprintf(name, sizeof name, "private:synthnet:%u", j);
+
+			(void) snprintf(value, sizeof value, "%u %lu synthetic value", i, (unsigned long) CURRTIME);
+			(void) metadata_add(net->account_list[i], name, value);
+		}
+	}
+
+	return net->accounts * net->metadata;
+}
+
+unsigned int
+synthnet_build_users(struct synthnet *const restrict net)
+{
+	char nick[NICKLEN + 1];
+	char user[USERLEN + 1];
+	char host[HOSTLEN + 1];
+	char vhost[HOSTLEN + 1];
+	char ip[HOSTIPLEN + 1];
+	char uid[IDLEN + 1];
+	char gecos[GECOSLEN + 1];
+
+	for (unsigned int i = 0; i < net->users; i++)
+	{
+		struct server *const s = net->server_list[i % net->servers];
+		const unsigned int isp = synthnet_rand(net, 200U);
+
+		(void) snprintf(nick, sizeof nick, "User%u|%c", i, 'A' + (char) synthnet_rand(net, 26U));
+		(void) snprintf(user, sizeof user, "%s%u", synthnet_rand(net, 4U) ? "~u" : "u", i % 10000U);
+		(void) snprintf(host, sizeof host, "host-%u.pool%u.isp%u.example.com", i, i % 64U, isp);
+		(void) snprintf(vhost, sizeof vhost, "user/account%u", i % (net->accounts ? net->accounts : 1U));
+		(void) snprintf(ip, sizeof ip, "10.%u.%u.%u", isp, (i >> 8) & 0xFFU, i & 0xFFU);
+		(void) snprintf(uid, sizeof uid, "%s%06X", s->sid, i);
+		(void) snprintf(gecos, sizeof gecos, "Synthetic network user %u", i);
+
+		// half of the users are logged in, and are cloaked
+		const bool login = net->accounts && (i % 2U) == 0;
+
+		net->user_list[i] = user_add(nick, user, host, login ? vhost : NULL, ip, uid, gecos, s, CURRTIME);
+
+		if (login)
+		{
+			struct myuser *const mu = net->account_list[i % net->accounts];
+
+			net->user_list[i]->myuser = mu;
+			(void) mowgli_node_add(net->user_list[i], mowgli_node_create(), &mu->logins);
+		}
+	}
+
+	return net->users;
+}
+
+unsigned int
+synthnet_build_channels(struct synthnet *const restrict net)
+{
+	char name[CHANNELLEN + 1];
+
+	for (unsigned int i = 0; i < net->channels; i++)
+	{
+		(void) snprintf(name, sizeof name, "#Channel-%u", i);
+
+		net->channel_list[i] = channel_add(name, CURRTIME, net->server_list[i % net->servers]);
+	}
+
+	return net->channels;
+}
+
+unsigned int
+synthnet_build_chanusers(struct synthnet *const restrict net)
+{
+	char target[IDLEN + 2];
+	unsigned int count = 0;
+
+	for (unsigned int i = 0; i < net->users; i++)
+	{
+		for (unsigned int j = 0; j < net->joins; j++)
+		{
+			// spread users over the channels, and make one member in ten an op
+			const unsigned int c = ((i * 7U) + (j * 7919U)) % net->channels;
+
+			(void) snprintf(target, sizeof target, "%s%s", ((i + j) % 10U) ? "" : "@", net->user_list[i]->uid);
+
+			if (chanuser_add(net->channel_list[c], target))
+				count++;
+		}
+	}
+
+	return count;
+}
+
+unsigned int
+synthnet_build_mychans(struct synthnet *const restrict net)
+{
+	for (unsigned int i = 0; i < net->mychans; i++)
+		net->mychan_list[i] = mychan_add(net->channel_list[i]->name);
+
+	return net->mychans;
+}
+
+unsigned int
+synthnet_build_chanacs(struct synthnet *const restrict net)
+{
+	char host[HOSTLEN + 1];
+	unsigned int count = 0;
+
+	for (unsigned int i = 0; i < net->mychans; i++)
+	{
+		for (unsigned int j = 0; j < net->chanacs; j++)
+		{
+			struct chanacs *ca = NULL;
+
+			// one entry in five is a hostmask, as on most networks
+			if ((j % 5U) == 4U)
+			{
+				(void) snprintf(host, sizeof host, "*!*@*.isp%u.example.com", synthnet_rand(net, 200U));
+				ca = chanacs_add_host(net->mychan_list[i], host, CA_AUTOVOICE, CURRTIME, NULL);
+			}
+			else if (net->accounts)
+			{
+				struct myuser *const mu = net->account_list[synthnet_rand(net, net->accounts)];
+
+				ca = chanacs_add(net->mychan_list[i], entity(mu), j ? (CA_OP | CA_AUTOOP) : CA_FOUNDER, CURRTIME,
+				                 NULL);
+			}
+
+			if (ca)
+				count++;
+		}
+	}
+
+	return count;
+}
+
+unsigned int
+synthnet_build_klines(struct synthnet *const restrict net)
+{
+	char host[HOSTLEN + 1];
+
+	for (unsigned int i = 0; i < net->klines; i++)
+	{
+		// most K-lines do not match anyone, so a lookup usually walks the whole list
+		switch (i % 4U)
+		{
+			case 0:
+				(void) snprintf(host, sizeof host, "*.dsl%u.example.net", i);
+				break;
+			case 1:
+				(void) snprintf(host, sizeof host, "192.168.%u.*", i % 256U);
+				break;
+			case 2:
+				(void) snprintf(host, sizeof host, "172.16.%u.0/24", i % 256U);
+				break;
+			default:
+				(void) snprintf(host, sizeof host, "spam%u.example.org", i);
+				break;
+		}
+
+		(void) kline_add((i % 8U) ? "*" : "~*", host, "Synthetic network K-line", (i % 2U) ? 0 : 86400, "synthnet");
+	}
+
+	return net->klines;
+}
+
+void
+synthnet_build(struct synthnet *const restrict net)
+{
+	(void) synthnet_build_servers(net);
+	(void) synthnet_build_accounts(net);
+	(void) synthnet_build_metadata(net);
+	(void) synthnet_build_users(net);
+	(void) synthnet_build_channels(net);
+	(void) synthnet_build_chanusers(net);
+	(void) synthnet_build_mychans(net);
+	(void) synthnet_build_chanacs(net);
+	(void) synthnet_build_klines(net);
+}
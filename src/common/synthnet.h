@@ -0,0 +1,64 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * A synthetic network for the measuring tools, built from a fixed seed with
+ * the same calls the protocol and database code use.
+ */
+
+#ifndef ATHEME_SRC_COMMON_SYNTHNET_H
+#define ATHEME_SRC_COMMON_SYNTHNET_H 1
+
+#include <atheme/attributes.h>      // ATHEME_FATTR_WUR
+#include <atheme/stdheaders.h>      // bool
+
+#define SYNTHNET_METADATA_NAMES     8U      // realistic names; further entries get made-up ones
+
+struct synthnet
+{
+	// What to build; set these before synthnet_init()
+	unsigned int            servers;        // 0 for one per 5000 users
+	unsigned int            users;
+	unsigned int            channels;
+	unsigned int            joins;          // channels each user is in
+	unsigned int            accounts;       // each with a registered nick
+	unsigned int            metadata;       // metadata entries on each account
+	unsigned int            mychans;
+	unsigned int            chanacs;        // access entries on each registered channel
+	unsigned int            klines;
+	unsigned int            seed;
+
+	// What was built, in order
+	struct server **        server_list;
+	struct user **          user_list;
+	struct channel **       channel_list;
+	struct myuser **        account_list;
+	struct mychan **        mychan_list;
+
+	unsigned long long      rng_state;
+};
+
+extern const char *const synthnet_metadata_names[SYNTHNET_METADATA_NAMES];
+
+bool synthnet_option(const char *arg, unsigned int *value, unsigned int max) ATHEME_FATTR_WUR;
+void synthnet_init(struct synthnet *net, char *progname, const char *tool);
+unsigned int synthnet_rand(struct synthnet *net, unsigned int range);
+
+/* Each of these builds one kind of object and returns how many it made.
+ * Accounts come before users (half of whom are logged in), channels before
+ * joins and registered channels, and registered channels before access.
+ */
+unsigned int synthnet_build_servers(struct synthnet *net);
+unsigned int synthnet_build_accounts(struct synthnet *net);
+unsigned int synthnet_build_metadata(struct synthnet *net);
+unsigned int synthnet_build_users(struct synthnet *net);
+unsigned int synthnet_build_channels(struct synthnet *net);
+unsigned int synthnet_build_chanusers(struct synthnet *net);
+unsigned int synthnet_build_mychans(struct synthnet *net);
+unsigned int synthnet_build_chanacs(struct synthnet *net);
+unsigned int synthnet_build_klines(struct synthnet *net);
+void synthnet_build(struct synthnet *net);
+
+#endif /* !ATHEME_SRC_COMMON_SYNTHNET_H */
@@ -16,6 +16,7 @@
 #include <atheme/digest.h>          // digest_oneshot_pbkdf2()
 #include <atheme/i18n.h>            // _() (gettext)
 #include <atheme/libathemecore.h>   // libathemecore_early_init()
+#include <atheme/memory.h>          // sreallocarray()
 #include <atheme/pbkdf2.h>          // PBKDF2_*
 #include <atheme/random.h>          // atheme_random_*()
 #include <atheme/scrypt.h>          // ATHEME_SCRYPT_*
@@ -124,12 +125,12 @@ argon2_print_rowstats(const argon2_type type, const size_t memcost, const size_t
 	                       memory_power2k_to_str(memcost), timecost, threads, elapsed);
 }
 
-bool ATHEME_FATTR_WUR
-benchmark_argon2(const argon2_type type, const size_t memcost, const size_t timecost, const size_t threadcount,
-                 long double *const restrict elapsed)
+static bool ATHEME_FATTR_WUR
+argon2_compute(const argon2_type type, const size_t memcost, const size_t timecost, const size_t threadcount,
+               unsigned char *const restrict out)
 {
 	argon2_context ctx = {
-		.out            = hashbuf,
+		.out            = out,
 		.outlen         = ATHEME_ARGON2_HASHLEN_DEF,
 		.pwd            = (void *) passbuf,
 		.pwdlen         = PASSLEN,
@@ -142,9 +143,23 @@ benchmark_argon2(const argon2_type type, const size_t memcost, const size_t time
 		.version        = ARGON2_VERSION_NUMBER,
 	};
 
+	int ret;
+
+	if ((ret = argon2_ctx(&ctx, type)) != (int) ARGON2_OK)
+	{
+		(void) bench_print("argon2_ctx(): %s", argon2_error_message(ret));
+		return false;
+	}
+
+	return true;
+}
+
+bool ATHEME_FATTR_WUR
+benchmark_argon2(const argon2_type type, const size_t memcost, const size_t timecost, const size_t threadcount,
+                 long double *const restrict elapsed)
+{
 	struct timespec begin;
 	struct timespec end;
-	int ret;
 
 	(void) memset(&begin, 0x00, sizeof begin);
 	(void) memset(&end, 0x00, sizeof end);
@@ -154,11 +169,9 @@ benchmark_argon2(const argon2_type type, const size_t memcost, const size_t time
 		(void) perror("clock_gettime(2)");
 		return false;
 	}
-	if ((ret = argon2_ctx(&ctx, type)) != (int) ARGON2_OK)
-	{
-		(void) bench_print("argon2_ctx(): %s", argon2_error_message(ret));
+	if (! argon2_compute(type, memcost, timecost, threadcount, hashbuf))
+		// This function logs error messages on failure
 		return false;
-	}
 	if (clock_gettime(CLOCK_MONOTONIC, &end) != 0)
 	{
 		(void) perror("clock_gettime(2)");
@@ -196,11 +209,23 @@ scrypt_print_rowstats(const size_t memlimit, const size_t opslimit, const long d
 	(void) bench_print(_("%10s %14zu %13LFs"), memory_power2k_to_str(memlimit), opslimit, elapsed);
 }
 
-bool ATHEME_FATTR_WUR
-benchmark_scrypt(const size_t memlimit, const size_t opslimit, long double *const restrict elapsed)
+static bool ATHEME_FATTR_WUR
+scrypt_compute(const size_t memlimit, const size_t opslimit, unsigned char *const restrict out)
 {
 	const size_t memlimit_real = ((1ULL << memlimit) * 1024ULL);
 
+	if (crypto_pwhash_scryptsalsa208sha256_str((void *) out, passbuf, PASSLEN, opslimit, memlimit_real) != 0)
+	{
+		(void) perror("crypto_pwhash_scryptsalsa208sha256_str(3)");
+		return false;
+	}
+
+	return true;
+}
+
+bool ATHEME_FATTR_WUR
+benchmark_scrypt(const size_t memlimit, const size_t opslimit, long double *const restrict elapsed)
+{
 	struct timespec begin;
 	struct timespec end;
 
@@ -212,11 +237,9 @@ benchmark_scrypt(const size_t memlimit, const size_t opslimit, long double *cons
 		(void) perror("clock_gettime(2)");
 		return false;
 	}
-	if (crypto_pwhash_scryptsalsa208sha256_str((void *) hashbuf, passbuf, PASSLEN, opslimit, memlimit_real) != 0)
-	{
-		(void) perror("crypto_pwhash_scryptsalsa208sha256_str(3)");
+	if (! scrypt_compute(memlimit, opslimit, hashbuf))
+		// This function logs error messages on failure
 		return false;
-	}
 	if (clock_gettime(CLOCK_MONOTONIC, &end) != 0)
 	{
 		(void) perror("clock_gettime(2)");
@@ -252,6 +275,18 @@ bcrypt_print_rowstats(const unsigned int rounds, const long double elapsed)
 	(void) bench_print(_("%10u %13LFs"), rounds, elapsed);
 }
 
+static bool ATHEME_FATTR_WUR
+bcrypt_compute(const unsigned int rounds, unsigned char *const restrict out)
+{
+	if (! atheme_eks_bf_compute(passbuf, ATHEME_BCRYPT_VERSION_MINOR, rounds, saltbuf, out))
+	{
+		(void) bench_print("atheme_bcrypt_compute() failed");
+		return false;
+	}
+
+	return true;
+}
+
 bool ATHEME_FATTR_WUR
 benchmark_bcrypt(const unsigned int rounds, long double *const restrict elapsed)
 {
@@ -266,11 +301,9 @@ benchmark_bcrypt(const unsigned int rounds, long double *const restrict elapsed)
 		(void) perror("clock_gettime(2)");
 		return false;
 	}
-	if (! atheme_eks_bf_compute(passbuf, ATHEME_BCRYPT_VERSION_MINOR, rounds, saltbuf, hashbuf))
-	{
-		(void) bench_print("atheme_bcrypt_compute() failed");
+	if (! bcrypt_compute(rounds, hashbuf))
+		// This function logs error messages on failure
 		return false;
-	}
 	if (clock_gettime(CLOCK_MONOTONIC, &end) != 0)
 	{
 		(void) perror("clock_gettime(2)");
@@ -362,23 +395,13 @@ pbkdf2_print_rowstats(const enum digest_algorithm digest, const size_t iteration
 	(void) bench_print(_("%16s %14zu %13LFs"), md_digest_to_name(digest, with_sasl_scram), iterations, elapsed);
 }
 
-bool ATHEME_FATTR_WUR
-benchmark_pbkdf2(const enum digest_algorithm digest, const size_t itercount, const bool with_sasl_scram,
-                 long double *const restrict elapsed)
+static bool ATHEME_FATTR_WUR
+pbkdf2_compute(const enum digest_algorithm digest, const size_t itercount, const bool with_sasl_scram,
+               unsigned char *const restrict out)
 {
 	const size_t mdlen = digest_size_alg(digest);
-	struct timespec begin;
-	struct timespec end;
 
-	(void) memset(&begin, 0x00, sizeof begin);
-	(void) memset(&end, 0x00, sizeof end);
-
-	if (clock_gettime(CLOCK_MONOTONIC, &begin) != 0)
-	{
-		(void) perror("clock_gettime(2)");
-		return false;
-	}
-	if (! digest_oneshot_pbkdf2(digest, passbuf, PASSLEN, saltbuf, PBKDF2_SALTLEN_DEF, itercount, hashbuf, mdlen))
+	if (! digest_oneshot_pbkdf2(digest, passbuf, PASSLEN, saltbuf, PBKDF2_SALTLEN_DEF, itercount, out, mdlen))
 	{
 		(void) bench_print("digest_oneshot_pbkdf2() failed");
 		return false;
@@ -391,12 +414,12 @@ benchmark_pbkdf2(const enum digest_algorithm digest, const size_t itercount, con
 		unsigned char ClientKey[DIGEST_MDLEN_MAX];
 		unsigned char StoredKey[DIGEST_MDLEN_MAX];
 
-		if (! digest_oneshot_hmac(digest, hashbuf, mdlen, ServerKeyConstant, 10U, ServerKey, NULL))
+		if (! digest_oneshot_hmac(digest, out, mdlen, ServerKeyConstant, 10U, ServerKey, NULL))
 		{
 			(void) bench_print("digest_oneshot_hmac(ServerKey) failed");
 			return false;
 		}
-		if (! digest_oneshot_hmac(digest, hashbuf, mdlen, ClientKeyConstant, 10U, ClientKey, NULL))
+		if (! digest_oneshot_hmac(digest, out, mdlen, ClientKeyConstant, 10U, ClientKey, NULL))
 		{
 			(void) bench_print("digest_oneshot_hmac(ClientKey) failed");
 			return false;
@@ -407,6 +430,28 @@ benchmark_pbkdf2(const enum digest_algorithm digest, const size_t itercount, con
 			return false;
 		}
 	}
+
+	return true;
+}
+
+bool ATHEME_FATTR_WUR
+benchmark_pbkdf2(const enum digest_algorithm digest, const size_t itercount, const bool with_sasl_scram,
+                 long double *const restrict elapsed)
+{
+	struct timespec begin;
+	struct timespec end;
+
+	(void) memset(&begin, 0x00, sizeof begin);
+	(void) memset(&end, 0x00, sizeof end);
+
+	if (clock_gettime(CLOCK_MONOTONIC, &begin) != 0)
+	{
+		(void) perror("clock_gettime(2)");
+		return false;
+	}
+	if (! pbkdf2_compute(digest, itercount, with_sasl_scram, hashbuf))
+		// This function logs error messages on failure
+		return false;
 	if (clock_gettime(CLOCK_MONOTONIC, &end) != 0)
 	{
 		(void) perror("clock_gettime(2)");
@@ -423,3 +468,428 @@ benchmark_pbkdf2(const enum digest_algorithm digest, const size_t itercount, con
 	(void) pbkdf2_print_rowstats(digest, itercount, with_sasl_scram, duration);
 	return true;
 }
+
+/* Throughput mode: every configuration is hashed continuously by several
+ * worker processes at once, so that memory-hard algorithms compete for
+ * cache and memory bandwidth the way concurrent logins do. Workers are
+ * forked rather than threaded so that wait4(2) hands back the peak
+ * resident set size of each one individually.
+ */
+
+struct bench_tp_params
+{
+	unsigned int            alg;        // BENCH_RUN_OPTIONS_*
+#ifdef HAVE_LIBARGON2
+	argon2_type             type;
+#endif
+	enum digest_algorithm   digest;
+	size_t                  cost;       // Argon2 memcost, scrypt memlimit, bcrypt rounds, PBKDF2 iterations
+	size_t                  ops;        // Argon2 timecost, scrypt opslimit
+	size_t                  threads;    // Argon2 threads
+	bool                    with_sasl_scram;
+};
+
+struct bench_tp_report
+{
+	size_t                  count;
+	long double             span;
+};
+
+static size_t tp_workers = 0;
+static long double tp_duration = BENCH_TP_DURATION_DEF;
+
+static inline bool ATHEME_FATTR_WUR
+bench_tp_now(long double *const restrict now)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+	{
+		(void) perror("clock_gettime(2)");
+		return false;
+	}
+
+	*now = ((long double) ts.tv_sec) + (((long double) ts.tv_nsec) / nsec_per_sec);
+	return true;
+}
+
+static int
+bench_tp_sample_cmp(const void *const restrict a, const void *const restrict b)
+{
+	const long double la = *((const long double *) a);
+	const long double lb = *((const long double *) b);
+
+	return (la > lb) - (la < lb);
+}
+
+static bool ATHEME_FATTR_WUR
+bench_tp_compute(const struct bench_tp_params *const restrict params, unsigned char *const restrict out)
+{
+	switch (params->alg)
+	{
+#ifdef HAVE_LIBARGON2
+		case BENCH_RUN_OPTIONS_ARGON2:
+			return argon2_compute(params->type, params->cost, params->ops, params->threads, out);
+#endif
+#ifdef HAVE_LIBSODIUM_SCRYPT
+		case BENCH_RUN_OPTIONS_SCRYPT:
+			return scrypt_compute(params->cost, params->ops, out);
+#endif
+		case BENCH_RUN_OPTIONS_BCRYPT:
+			return bcrypt_compute((unsigned int) params->cost, out);
+
+		case BENCH_RUN_OPTIONS_PBKDF2:
+			return pbkdf2_compute(params->digest, params->cost, params->with_sasl_scram, out);
+	}
+
+	return false;
+}
+
+static bool ATHEME_FATTR_WUR
+bench_tp_write(const int fd, const void *const restrict buf, const size_t len)
+{
+	const unsigned char *ptr = buf;
+	size_t done = 0;
+
+	while (done < len)
+	{
+		const ssize_t ret = write(fd, ptr + done, len - done);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+
+		if (ret <= 0)
+			return false;
+
+		done += (size_t) ret;
+	}
+
+	return true;
+}
+
+static bool ATHEME_FATTR_WUR
+bench_tp_read(const int fd, void *const restrict buf, const size_t len)
+{
+	unsigned char *ptr = buf;
+	size_t done = 0;
+
+	while (done < len)
+	{
+		const ssize_t ret = read(fd, ptr + done, len - done);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+
+		if (ret <= 0)
+			return false;
+
+		done += (size_t) ret;
+	}
+
+	return true;
+}
+
+static void ATHEME_FATTR_NORETURN
+bench_tp_worker(const struct bench_tp_params *const restrict params, const int gofd, const int outfd)
+{
+	struct bench_tp_report report = { .count = 0 };
+	unsigned char out[BUFSIZE];
+	long double *samples = NULL;
+	size_t samples_max = 0;
+	long double begin;
+	long double now;
+	char dummy;
+
+	// Block until the parent closes the other end, releasing every worker at once
+	while (read(gofd, &dummy, 1) < 0 && errno == EINTR)
+		continue;
+
+	if (! bench_tp_now(&begin))
+		_exit(EXIT_FAILURE);
+
+	now = begin;
+
+	do
+	{
+		const long double start = now;
+
+		if (report.count == samples_max)
+		{
+			samples_max = BENCH_MAX(64U, samples_max * 2U);
+
+			if (! (samples = sreallocarray(samples, samples_max, sizeof *samples)))
+			{
+				(void) perror("sreallocarray()");
+				_exit(EXIT_FAILURE);
+			}
+		}
+		if (! bench_tp_compute(params, out))
+			// This function logs error messages on failure
+			_exit(EXIT_FAILURE);
+
+		if (! bench_tp_now(&now))
+			_exit(EXIT_FAILURE);
+
+		samples[report.count++] = (now - start);
+
+	} while ((now - begin) < tp_duration);
+
+	report.span = (now - begin);
+
+	if (! bench_tp_write(outfd, &report, sizeof report))
+		_exit(EXIT_FAILURE);
+
+	if (! bench_tp_write(outfd, samples, report.count * sizeof *samples))
+		_exit(EXIT_FAILURE);
+
+	_exit(EXIT_SUCCESS);
+}
+
+static bool ATHEME_FATTR_WUR
+bench_tp_run(const struct bench_tp_params *const restrict params, struct bench_tp_result *const restrict result)
+{
+	pid_t pids[BENCH_TP_WORKERS_MAX];
+	int fds[BENCH_TP_WORKERS_MAX];
+	long double *samples = NULL;
+	size_t samples_count = 0;
+	size_t started = 0;
+	bool retval = true;
+	int gofds[2];
+
+	(void) memset(result, 0x00, sizeof *result);
+
+	if (pipe(gofds) != 0)
+	{
+		(void) perror("pipe(2)");
+		return false;
+	}
+
+	// Don't let every worker inherit (and later flush) whatever we have buffered
+	(void) fflush(NULL);
+
+	for (started = 0; started < tp_workers; started++)
+	{
+		int outfds[2];
+
+		if (pipe(outfds) != 0)
+		{
+			(void) perror("pipe(2)");
+			retval = false;
+			break;
+		}
+
+		const pid_t pid = fork();
+
+		if (pid < 0)
+		{
+			(void) perror("fork(2)");
+			(void) close(outfds[0]);
+			(void) close(outfds[1]);
+			retval = false;
+			break;
+		}
+		if (pid == 0)
+		{
+			(void) close(gofds[1]);
+			(void) close(outfds[0]);
+			(void) bench_tp_worker(params, gofds[0], outfds[1]);
+		}
+
+		(void) close(outfds[1]);
+
+		pids[started] = pid;
+		fds[started] = outfds[0];
+	}
+
+	// Start the workers (if something went wrong above, let the ones we have finish and reap them)
+	(void) close(gofds[0]);
+	(void) close(gofds[1]);
+
+	for (size_t i = 0; i < started; i++)
+	{
+		struct bench_tp_report report;
+		struct rusage usage;
+		int status = 0;
+
+		(void) memset(&usage, 0x00, sizeof usage);
+
+		if (bench_tp_read(fds[i], &report, sizeof report) && report.count && report.span > 0)
+		{
+			if ((samples = sreallocarray(samples, samples_count + report.count, sizeof *samples)) &&
+			    bench_tp_read(fds[i], samples + samples_count, report.count * sizeof *samples))
+			{
+				samples_count += report.count;
+				result->hashes += report.count;
+				result->rate += (report.count / report.span);
+			}
+			else
+				retval = false;
+		}
+		else
+			retval = false;
+
+		(void) close(fds[i]);
+
+		while (wait4(pids[i], &status, 0, &usage) < 0)
+		{
+			if (errno != EINTR)
+			{
+				(void) perror("wait4(2)");
+				retval = false;
+				break;
+			}
+		}
+
+		if (! WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+			retval = false;
+
+#ifdef __APPLE__
+		// Darwin reports this in bytes rather than KiB
+		usage.ru_maxrss /= 1024;
+#endif
+		result->maxrss = BENCH_MAX(result->maxrss, (size_t) usage.ru_maxrss);
+	}
+
+	if (! retval)
+	{
+		(void) bench_print(_("One or more throughput workers failed"));
+		(void) free(samples);
+		return false;
+	}
+
+	(void) qsort(samples, samples_count, sizeof *samples, &bench_tp_sample_cmp);
+
+	result->workers = started;
+	result->p50 = samples[((samples_count - 1U) * 50U) / 100U];
+	result->p99 = samples[((samples_count - 1U) * 99U) / 100U];
+
+	(void) free(samples);
+	return true;
+}
+
+void
+bench_tp_configure(const size_t workers, const long double duration)
+{
+	tp_workers = workers;
+	tp_duration = duration;
+}
+
+size_t
+bench_tp_workers(void)
+{
+	return tp_workers;
+}
+
+void
+bench_tp_print_colheaders(void)
+{
+	(void) bench_print(_(""
+		"\n"
+		"Parameters                     Workers    Hashes/s       p50            p99            PeakRSS/Worker\n"
+		"------------------------------ ---------- -------------- -------------- -------------- --------------"
+	));
+}
+
+void
+bench_tp_print_rowstats(const char *const restrict label, const struct bench_tp_result *const restrict result)
+{
+	(void) bench_print(_("%-30s %10zu %14.2LF %13LFs %13LFs %10.1LF MiB"), label, result->workers, result->rate,
+	                       result->p50, result->p99, ((long double) result->maxrss) / 1024.0L);
+}
+
+#ifdef HAVE_LIBARGON2
+
+bool ATHEME_FATTR_WUR
+benchmark_argon2_tp(const argon2_type type, const size_t memcost, const size_t timecost, const size_t threadcount,
+                    struct bench_tp_result *const restrict result)
+{
+	const struct bench_tp_params params = {
+		.alg            = BENCH_RUN_OPTIONS_ARGON2,
+		.type           = type,
+		.cost           = memcost,
+		.ops            = timecost,
+		.threads        = threadcount,
+	};
+
+	char label[BUFSIZE];
+
+	if (! bench_tp_run(&params, result))
+		// This function logs error messages on failure
+		return false;
+
+	(void) snprintf(label, sizeof label, "%s m=%s t=%zu p=%zu", argon2_type2string(type, 1),
+	                memory_power2k_to_str(memcost), timecost, threadcount);
+
+	(void) bench_tp_print_rowstats(label, result);
+	return true;
+}
+
+#endif /* HAVE_LIBARGON2 */
+
+#ifdef HAVE_LIBSODIUM_SCRYPT
+
+bool ATHEME_FATTR_WUR
+benchmark_scrypt_tp(const size_t memlimit, const size_t opslimit, struct bench_tp_result *const restrict result)
+{
+	const struct bench_tp_params params = {
+		.alg            = BENCH_RUN_OPTIONS_SCRYPT,
+		.cost           = memlimit,
+		.ops            = opslimit,
+	};
+
+	char label[BUFSIZE];
+
+	if (! bench_tp_run(&params, result))
+		// This function logs error messages on failure
+		return false;
+
+	(void) snprintf(label, sizeof label, "scrypt m=%s ops=%zu", memory_power2k_to_str(memlimit), opslimit);
+
+	(void) bench_tp_print_rowstats(label, result);
+	return true;
+}
+
+#endif /* HAVE_LIBSODIUM_SCRYPT */
+
+bool ATHEME_FATTR_WUR
+benchmark_bcrypt_tp(const unsigned int rounds, struct bench_tp_result *const restrict result)
+{
+	const struct bench_tp_params params = {
+		.alg            = BENCH_RUN_OPTIONS_BCRYPT,
+		.cost           = rounds,
+	};
+
+	char label[BUFSIZE];
+
+	if (! bench_tp_run(&params, result))
+		// This function logs error messages on failure
+		return false;
+
+	(void) snprintf(label, sizeof label, "bcrypt rounds=%u", rounds);
+
+	(void) bench_tp_print_rowstats(label, result);
+	return true;
+}
+
+bool ATHEME_FATTR_WUR
+benchmark_pbkdf2_tp(const enum digest_algorithm digest, const size_t itercount, const bool with_sasl_scram,
+                    struct bench_tp_result *const restrict result)
+{
+	const struct bench_tp_params params = {
+		.alg                = BENCH_RUN_OPTIONS_PBKDF2,
+		.digest             = digest,
+		.cost               = itercount,
+		.with_sasl_scram    = with_sasl_scram,
+	};
+
+	char label[BUFSIZE];
+
+	if (! bench_tp_run(&params, result))
+		// This function logs error messages on failure
+		return false;
+
+	(void) snprintf(label, sizeof label, "%s i=%zu", md_digest_to_name(digest, with_sasl_scram), itercount);
+
+	(void) bench_tp_print_rowstats(label, result);
+	return true;
+}
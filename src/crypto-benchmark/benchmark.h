@@ -32,13 +32,35 @@
 #define BENCH_RUN_OPTIONS_BCRYPT    0x0010U
 #define BENCH_RUN_OPTIONS_PBKDF2    0x0020U
 
+#define BENCH_TP_WORKERS_MIN        1U
+#define BENCH_TP_WORKERS_MAX        1024U
+
+#define BENCH_TP_DURATION_MIN       1.00L
+#define BENCH_TP_DURATION_DEF       3.00L
+#define BENCH_TP_DURATION_MAX       60.00L
+
 #if defined(HAVE_LIBARGON2) || defined(HAVE_LIBSODIUM_SCRYPT)
 #  define HAVE_ANY_MEMORY_HARD_ALGORITHM 1
 #endif
 
+struct bench_tp_result
+{
+	size_t          workers;
+	size_t          hashes;         // Completed by all workers together
+	long double     rate;           // Aggregate hashes per second
+	long double     p50;            // Per-hash latency under load, in seconds
+	long double     p99;
+	size_t          maxrss;         // Peak resident set size of the largest worker, in KiB
+};
+
 void bench_print(const char *, ...) ATHEME_FATTR_PRINTF(1, 2);
 bool benchmark_init(void) ATHEME_FATTR_WUR;
 
+void bench_tp_configure(size_t, long double);
+size_t bench_tp_workers(void);
+void bench_tp_print_colheaders(void);
+void bench_tp_print_rowstats(const char *, const struct bench_tp_result *);
+
 #ifdef HAVE_ANY_MEMORY_HARD_ALGORITHM
 const char *memory_power2k_to_str(size_t);
 #endif
@@ -48,22 +70,26 @@ argon2_type argon2_name_to_type(const char *);
 void argon2_print_colheaders(void);
 void argon2_print_rowstats(argon2_type, size_t, size_t, size_t, long double);
 bool benchmark_argon2(argon2_type, size_t, size_t, size_t, long double *) ATHEME_FATTR_WUR;
+bool benchmark_argon2_tp(argon2_type, size_t, size_t, size_t, struct bench_tp_result *) ATHEME_FATTR_WUR;
 #endif
 
 #ifdef HAVE_LIBSODIUM_SCRYPT
 void scrypt_print_colheaders(void);
 void scrypt_print_rowstats(size_t, size_t, long double);
 bool benchmark_scrypt(size_t, size_t, long double *) ATHEME_FATTR_WUR;
+bool benchmark_scrypt_tp(size_t, size_t, struct bench_tp_result *) ATHEME_FATTR_WUR;
 #endif
 
 void bcrypt_print_colheaders(void);
 void bcrypt_print_rowstats(unsigned int, long double);
 bool benchmark_bcrypt(unsigned int, long double *) ATHEME_FATTR_WUR;
+bool benchmark_bcrypt_tp(unsigned int, struct bench_tp_result *) ATHEME_FATTR_WUR;
 
 enum digest_algorithm md_name_to_digest(const char *);
 const char *md_digest_to_name(enum digest_algorithm, bool);
 void pbkdf2_print_colheaders(void);
 void pbkdf2_print_rowstats(enum digest_algorithm, size_t, bool, long double);
 bool benchmark_pbkdf2(enum digest_algorithm, size_t, bool, long double *) ATHEME_FATTR_WUR;
+bool benchmark_pbkdf2_tp(enum digest_algorithm, size_t, bool, struct bench_tp_result *) ATHEME_FATTR_WUR;
 
 #endif /* !ATHEME_SRC_CRYPTO_BENCHMARK_BENCHMARK_H */
@@ -32,6 +32,9 @@
 #define BENCH_CLOCKTIME_DEF         0.25L
 #define BENCH_CLOCKTIME_MAX         1.00L
 
+#define BENCH_THROUGHPUT_MIN        0.01L
+#define BENCH_THROUGHPUT_MAX        1000000.00L
+
 #define BENCH_MEMLIMIT_MIN          BENCH_MAX(ATHEME_ARGON2_MEMCOST_MIN, ATHEME_SCRYPT_MEMLIMIT_MIN)
 #define BENCH_MEMLIMIT_DEF          BENCH_MAX(ATHEME_ARGON2_MEMCOST_DEF, ATHEME_SCRYPT_MEMLIMIT_DEF)
 #define BENCH_MEMLIMIT_MAX          BENCH_MIN(ATHEME_ARGON2_MEMCOST_MAX, ATHEME_SCRYPT_MEMLIMIT_MAX)
@@ -85,6 +88,10 @@ static unsigned int optimal_memlimit = BENCH_MEMLIMIT_DEF;
 static bool optimal_memlimit_given = false;
 static bool with_sasl_scram = false;
 
+static unsigned int throughput_workers = 0;
+static long double throughput_duration = BENCH_TP_DURATION_DEF;
+static long double optimal_throughput = 0L;
+
 static unsigned int run_options = BENCH_RUN_OPTIONS_NONE;
 
 static const mowgli_getopt_option_t bench_long_opts[] = {
@@ -95,6 +102,7 @@ static const mowgli_getopt_option_t bench_long_opts[] = {
 
 	{   "run-optimal-benchmarks",       no_argument, NULL, 'o', 0 },
 	{      "optimal-clock-limit", required_argument, NULL, 'g', 0 },
+	{  "optimal-throughput-goal", required_argument, NULL, 'q', 0 },
 #ifdef HAVE_ANY_MEMORY_HARD_ALGORITHM
 	{     "optimal-memory-limit", required_argument, NULL, 'l', 0 },
 #endif
@@ -119,6 +127,9 @@ static const mowgli_getopt_option_t bench_long_opts[] = {
 	{        "pbkdf2-iterations", required_argument, NULL, 'c', 0 },
 	{ "pbkdf2-digest-algorithms", required_argument, NULL, 'd', 0 },
 
+	{       "throughput-workers", required_argument, NULL, 'j', 0 },
+	{      "throughput-duration", required_argument, NULL, 'w', 0 },
+
 	{ NULL, 0, NULL, 0, 0 },
 };
 
@@ -141,6 +152,9 @@ print_usage(void)
 		"  -o/--run-optimal-benchmarks  Perform an automatic parameter tuning benchmark:\n"
 		"  -g/--optimal-clock-limit       Wall clock time limit for optimal benchmarks\n"
 		"                                   (in seconds, fractional values accepted)\n"
+		"                                   With -j, this limits the p99 latency\n"
+		"  -q/--optimal-throughput-goal   Aggregate hashes per second to sustain\n"
+		"                                   (fractional values accepted; implies -j)\n"
 		"  -l/--optimal-memory-limit      Memory limit for optimal benchmarking\n"
 		"                                   (as a power of 2, in KiB)\n"
 		"                                   For example, '-l 16' means 2^16 KiB; 64 MiB\n"
@@ -164,6 +178,14 @@ print_usage(void)
 		"  -c/--pbkdf2-iterations         Comma-separated iteration counts\n"
 		"  -d/--pbkdf2-digests            Comma-separated digest algorithms\n"
 		"\n"
+		"  -j/--throughput-workers      Hash with this many concurrent workers and\n"
+		"                                 report aggregate hashes per second, p50/p99\n"
+		"                                 latency and peak memory per worker instead\n"
+		"                                 of single-hash latency (with -o/-a/-s/-b/-k)\n"
+		"                                 '-j 0' means one per online CPU\n"
+		"  -w/--throughput-duration       Seconds each configuration is run for\n"
+		"                                   (fractional values accepted)\n"
+		"\n"
 		"  Valid Argon2 types are: Argon2d, Argon2i, Argon2id (case-insensitive)\n"
 		"  Valid PBKDF2 digests are: MD5, SHA1, SHA2-256, SHA2-512 (case-insensitive)\n"
 		"\n"
@@ -210,6 +232,41 @@ process_uint_option(const int sw, const char *const restrict val, size_t **const
 	return true;
 }
 
+static inline bool
+process_decimal_option(const int sw, const char *const restrict val, long double *const restrict out,
+                       const long double val_min, const long double val_max)
+{
+	char *end = NULL;
+
+	errno = 0;
+
+	const long double ret = strtold(val, &end);
+
+	if (! ret || (end && *end) || errno != 0 || ret < val_min || ret > val_max)
+	{
+		(void) bench_print(_(""
+			"'%s' is not a valid value for decimal option '%c'\n"
+			"range of valid values: %LF to %LF (inclusive)\n"
+		), val, sw, val_min, val_max);
+
+		return false;
+	}
+
+	*out = ret;
+	return true;
+}
+
+static unsigned int
+get_online_cpus(void)
+{
+	const long ret = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (ret < (long) BENCH_TP_WORKERS_MIN)
+		return BENCH_TP_WORKERS_MIN;
+
+	return (unsigned int) BENCH_MIN(ret, (long) BENCH_TP_WORKERS_MAX);
+}
+
 static bool
 process_options(int argc, char *argv[])
 {
@@ -256,34 +313,20 @@ process_options(int argc, char *argv[])
 				break;
 
 			case 'g':
-			{
-				errno = 0;
-
-				char *end = NULL;
-				const long double ret = strtold(mowgli_optarg, &end);
-
-				if (! ret || (end && *end) || errno != 0)
-				{
-					(void) bench_print(_(""
-						"'%s' is not a valid value for decimal option '%c'\n"
-						"range of valid values: %LF to %LF (inclusive)\n"
-					), mowgli_optarg, c, BENCH_CLOCKTIME_MIN, BENCH_CLOCKTIME_MAX);
-
+				if (! process_decimal_option(c, mowgli_optarg, &optimal_clocklimit,
+				                             BENCH_CLOCKTIME_MIN, BENCH_CLOCKTIME_MAX))
+					// This function logs error messages on failure
 					return false;
-				}
-				if (ret < BENCH_CLOCKTIME_MIN || ret > BENCH_CLOCKTIME_MAX)
-				{
-					(void) bench_print(_(""
-						"'%s' is not a valid value for decimal option '%c'\n"
-						"range of valid values: %LF to %LF (inclusive)\n"
-					), mowgli_optarg, c, BENCH_CLOCKTIME_MIN, BENCH_CLOCKTIME_MAX);
 
+				break;
+
+			case 'q':
+				if (! process_decimal_option(c, mowgli_optarg, &optimal_throughput,
+				                             BENCH_THROUGHPUT_MIN, BENCH_THROUGHPUT_MAX))
+					// This function logs error messages on failure
 					return false;
-				}
 
-				optimal_clocklimit = ret;
 				break;
-			}
 
 #ifdef HAVE_LIBIDN
 			case 'i':
@@ -450,6 +493,30 @@ process_options(int argc, char *argv[])
 				break;
 			}
 
+			case 'j':
+				if (! string_to_uint(mowgli_optarg, &throughput_workers) ||
+				    throughput_workers > BENCH_TP_WORKERS_MAX)
+				{
+					(void) bench_print(_(""
+						"'%s' is not a valid value for integer option '%c'\n"
+						"range of valid values: %u to %u (inclusive)\n"
+					), mowgli_optarg, c, 0U, BENCH_TP_WORKERS_MAX);
+
+					return false;
+				}
+				if (! throughput_workers)
+					throughput_workers = get_online_cpus();
+
+				break;
+
+			case 'w':
+				if (! process_decimal_option(c, mowgli_optarg, &throughput_duration,
+				                             BENCH_TP_DURATION_MIN, BENCH_TP_DURATION_MAX))
+					// This function logs error messages on failure
+					return false;
+
+				break;
+
 			default:
 				(void) print_usage();
 				return false;
@@ -517,6 +584,12 @@ process_options(int argc, char *argv[])
 		b_pbkdf2_digests_count = BENCH_ARRAY_SIZE(b_pbkdf2_digests_default);
 	}
 
+	// A throughput goal is meaningless without concurrency; saturate the machine
+	if (optimal_throughput > 0L && ! throughput_workers)
+		throughput_workers = get_online_cpus();
+
+	(void) bench_tp_configure(throughput_workers, throughput_duration);
+
 	return true;
 }
 
@@ -529,14 +602,22 @@ do_argon2_benchmarks(void)
 	(void) bench_print("");
 	(void) bench_print(_("Beginning customizable Argon2 benchmark ..."));
 
-	(void) argon2_print_colheaders();
+	struct bench_tp_result tp;
+
+	if (throughput_workers)
+		(void) bench_tp_print_colheaders();
+	else
+		(void) argon2_print_colheaders();
 
 	for (size_t b_argon2_type = 0; b_argon2_type < b_argon2_types_count; b_argon2_type++)
 	  for (size_t b_argon2_memcost = 0; b_argon2_memcost < b_argon2_memcosts_count; b_argon2_memcost++)
 	    for (size_t b_argon2_timecost = 0; b_argon2_timecost < b_argon2_timecosts_count; b_argon2_timecost++)
 	      for (size_t b_argon2_thread = 0; b_argon2_thread < b_argon2_threads_count; b_argon2_thread++)
-	        if (! benchmark_argon2(b_argon2_types[b_argon2_type], b_argon2_memcosts[b_argon2_memcost],
-	                               b_argon2_timecosts[b_argon2_timecost], b_argon2_threads[b_argon2_thread], NULL))
+	        if (! (throughput_workers ?
+	               benchmark_argon2_tp(b_argon2_types[b_argon2_type], b_argon2_memcosts[b_argon2_memcost],
+	                                   b_argon2_timecosts[b_argon2_timecost], b_argon2_threads[b_argon2_thread], &tp) :
+	               benchmark_argon2(b_argon2_types[b_argon2_type], b_argon2_memcosts[b_argon2_memcost],
+	                                b_argon2_timecosts[b_argon2_timecost], b_argon2_threads[b_argon2_thread], NULL)))
 	          // This function logs error messages on failure
 	          return false;
 
@@ -554,11 +635,18 @@ do_scrypt_benchmarks(void)
 	(void) bench_print("");
 	(void) bench_print(_("Beginning customizable scrypt benchmark ..."));
 
-	(void) scrypt_print_colheaders();
+	struct bench_tp_result tp;
+
+	if (throughput_workers)
+		(void) bench_tp_print_colheaders();
+	else
+		(void) scrypt_print_colheaders();
 
 	for (size_t b_scrypt_memlimit = 0; b_scrypt_memlimit < b_scrypt_memlimits_count; b_scrypt_memlimit++)
 	  for (size_t b_scrypt_opslimit = 0; b_scrypt_opslimit < b_scrypt_opslimits_count; b_scrypt_opslimit++)
-	    if (! benchmark_scrypt(b_scrypt_memlimits[b_scrypt_memlimit], b_scrypt_opslimits[b_scrypt_opslimit], NULL))
+	    if (! (throughput_workers ?
+	           benchmark_scrypt_tp(b_scrypt_memlimits[b_scrypt_memlimit], b_scrypt_opslimits[b_scrypt_opslimit], &tp) :
+	           benchmark_scrypt(b_scrypt_memlimits[b_scrypt_memlimit], b_scrypt_opslimits[b_scrypt_opslimit], NULL)))
 	      // This function logs error messages on failure
 	      return false;
 
@@ -574,10 +662,17 @@ do_bcrypt_benchmarks(void)
 	(void) bench_print("");
 	(void) bench_print(_("Beginning customizable bcrypt benchmark ..."));
 
-	(void) bcrypt_print_colheaders();
+	struct bench_tp_result tp;
+
+	if (throughput_workers)
+		(void) bench_tp_print_colheaders();
+	else
+		(void) bcrypt_print_colheaders();
 
 	for (size_t b_bcrypt_cost = 0; b_bcrypt_cost < b_bcrypt_costs_count; b_bcrypt_cost++)
-	  if (! benchmark_bcrypt(b_bcrypt_costs[b_bcrypt_cost], NULL))
+	  if (! (throughput_workers ?
+	         benchmark_bcrypt_tp(b_bcrypt_costs[b_bcrypt_cost], &tp) :
+	         benchmark_bcrypt(b_bcrypt_costs[b_bcrypt_cost], NULL)))
 	    // This function logs error messages on failure
 	    return false;
 
@@ -605,12 +700,20 @@ do_pbkdf2_benchmarks(void)
 		}
 	}
 
-	(void) pbkdf2_print_colheaders();
+	struct bench_tp_result tp;
+
+	if (throughput_workers)
+		(void) bench_tp_print_colheaders();
+	else
+		(void) pbkdf2_print_colheaders();
 
 	for (size_t b_pbkdf2_digest = 0; b_pbkdf2_digest < b_pbkdf2_digests_count; b_pbkdf2_digest++)
 	  for (size_t b_pbkdf2_itercount = 0; b_pbkdf2_itercount < b_pbkdf2_itercounts_count; b_pbkdf2_itercount++)
-	    if (! benchmark_pbkdf2(b_pbkdf2_digests[b_pbkdf2_digest], b_pbkdf2_itercounts[b_pbkdf2_itercount],
-	                           with_sasl_scram, NULL))
+	    if (! (throughput_workers ?
+	           benchmark_pbkdf2_tp(b_pbkdf2_digests[b_pbkdf2_digest], b_pbkdf2_itercounts[b_pbkdf2_itercount],
+	                               with_sasl_scram, &tp) :
+	           benchmark_pbkdf2(b_pbkdf2_digests[b_pbkdf2_digest], b_pbkdf2_itercounts[b_pbkdf2_itercount],
+	                            with_sasl_scram, NULL)))
 	      // This function logs error messages on failure
 	      return false;
 
@@ -644,7 +747,8 @@ main(int argc, char *argv[])
 		return EXIT_SUCCESS;
 
 	if ((run_options & BENCH_RUN_OPTIONS_OPTIMAL) &&
-	    ! do_optimal_benchmarks(optimal_clocklimit, optimal_memlimit, optimal_memlimit_given, with_sasl_scram))
+	    ! do_optimal_benchmarks(optimal_clocklimit, optimal_memlimit, optimal_memlimit_given, with_sasl_scram,
+	                           optimal_throughput))
 		// This function logs error messages on failure
 		return EXIT_FAILURE;
 
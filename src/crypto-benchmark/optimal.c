@@ -26,8 +26,78 @@
 #include "benchmark.h"              // (everything else)
 #include "optimal.h"                // self-declarations
 
+/* When throughput workers are configured (-j), every measurement below is
+ * taken with that many hashes running at once, and is reported back to the
+ * search loops as a single figure comparable against the clock limit: the
+ * p99 latency under load, or the clock limit scaled by how far aggregate
+ * throughput falls short of the goal (-q), whichever is worse. The existing
+ * "raise the cost until it's too slow" searches then need no changes.
+ */
+static long double optimal_tp_clocklimit = 0L;
+static long double optimal_tp_goal = 0L;
+
+static long double
+optimal_tp_elapsed(const struct bench_tp_result *const restrict result)
+{
+	long double elapsed = result->p99;
+
+	if (optimal_tp_goal > 0L)
+	{
+		const long double shortfall = (result->rate > 0L) ? (optimal_tp_goal / result->rate) : 1000.0L;
+
+		elapsed = BENCH_MAX(elapsed, optimal_tp_clocklimit * shortfall);
+	}
+
+	return elapsed;
+}
+
+static void
+optimal_print_colheaders(void (*const single_colheaders)(void))
+{
+	if (bench_tp_workers())
+		(void) bench_tp_print_colheaders();
+	else
+		(void) single_colheaders();
+}
+
+static void
+optimal_print_target(const long double elapsed)
+{
+	if (! bench_tp_workers())
+	{
+		(void) fprintf(stdout, _("\t/* Target: %LFs; Benchmarked: %LFs */\n"), optimal_tp_clocklimit, elapsed);
+		return;
+	}
+
+	(void) fprintf(stdout, _("\t/* Target: %LFs p99 latency with %zu concurrent workers */\n"),
+	                         optimal_tp_clocklimit, bench_tp_workers());
+
+	if (optimal_tp_goal > 0L)
+		(void) fprintf(stdout, _("\t/* Target: %.2LF hashes/s in aggregate */\n"), optimal_tp_goal);
+
+	(void) fprintf(stdout, _("\t/* Benchmarked: %.1LF%% of the limiting target */\n"),
+	                         100.0L * (elapsed / optimal_tp_clocklimit));
+}
+
 #ifdef HAVE_LIBARGON2
 
+static bool ATHEME_FATTR_WUR
+optimal_argon2(const argon2_type type, const size_t memcost, const size_t timecost, const size_t threads,
+               long double *const restrict elapsed)
+{
+	struct bench_tp_result result;
+
+	if (! bench_tp_workers())
+		return benchmark_argon2(type, memcost, timecost, threads, elapsed);
+
+	if (! benchmark_argon2_tp(type, memcost, timecost, threads, &result))
+		// This function logs error messages on failure
+		return false;
+
+	*elapsed = optimal_tp_elapsed(&result);
+	return true;
+}
+
 static bool ATHEME_FATTR_WUR
 do_optimal_argon2_benchmark(const long double optimal_clocklimit, const size_t optimal_memlimit)
 {
@@ -41,7 +111,7 @@ do_optimal_argon2_benchmark(const long double optimal_clocklimit, const size_t o
 		"Use '-a -p' for thread testing."
 	));
 
-	(void) argon2_print_colheaders();
+	(void) optimal_print_colheaders(&argon2_print_colheaders);
 
 	long double elapsed_prev = 0L;
 	long double elapsed = 0L;
@@ -53,7 +123,7 @@ do_optimal_argon2_benchmark(const long double optimal_clocklimit, const size_t o
 	const size_t threads = 1ULL;
 
 	// First try at our memory limit and the minimum time cost
-	if (! benchmark_argon2(type, memcost, timecost, threads, &elapsed))
+	if (! optimal_argon2(type, memcost, timecost, threads, &elapsed))
 		// This function logs error messages on failure
 		return false;
 
@@ -70,7 +140,7 @@ do_optimal_argon2_benchmark(const long double optimal_clocklimit, const size_t o
 
 		memcost--;
 
-		if (! benchmark_argon2(type, memcost, timecost, threads, &elapsed))
+		if (! optimal_argon2(type, memcost, timecost, threads, &elapsed))
 			// This function logs error messages on failure
 			return false;
 	}
@@ -82,7 +152,7 @@ do_optimal_argon2_benchmark(const long double optimal_clocklimit, const size_t o
 		timecost_prev = timecost;
 		timecost++;
 
-		if (! benchmark_argon2(type, memcost, timecost, threads, &elapsed))
+		if (! optimal_argon2(type, memcost, timecost, threads, &elapsed))
 			// This function logs error messages on failure
 			return false;
 	}
@@ -99,7 +169,7 @@ do_optimal_argon2_benchmark(const long double optimal_clocklimit, const size_t o
 	(void) bench_print("");
 
 	(void) fprintf(stdout, "crypto {\n");
-	(void) fprintf(stdout, _("\t/* Target: %LFs; Benchmarked: %LFs */\n"), optimal_clocklimit, elapsed);
+	(void) optimal_print_target(elapsed);
 	(void) fprintf(stdout, "\targon2_type = \"%s\";\n", argon2_type2string(type, 0));
 	(void) fprintf(stdout, "\targon2_memcost = %zu; /* %s */ \n", memcost, memory_power2k_to_str(memcost));
 	(void) fprintf(stdout, "\targon2_timecost = %zu;\n", timecost);
@@ -114,6 +184,22 @@ do_optimal_argon2_benchmark(const long double optimal_clocklimit, const size_t o
 
 #ifdef HAVE_LIBSODIUM_SCRYPT
 
+static bool ATHEME_FATTR_WUR
+optimal_scrypt(const size_t memlimit, const size_t opslimit, long double *const restrict elapsed)
+{
+	struct bench_tp_result result;
+
+	if (! bench_tp_workers())
+		return benchmark_scrypt(memlimit, opslimit, elapsed);
+
+	if (! benchmark_scrypt_tp(memlimit, opslimit, &result))
+		// This function logs error messages on failure
+		return false;
+
+	*elapsed = optimal_tp_elapsed(&result);
+	return true;
+}
+
 static bool ATHEME_FATTR_WUR
 do_optimal_scrypt_benchmark(const long double optimal_clocklimit, const size_t optimal_memlimit)
 {
@@ -121,7 +207,7 @@ do_optimal_scrypt_benchmark(const long double optimal_clocklimit, const size_t o
 	(void) bench_print("");
 	(void) bench_print(_("Beginning automatic optimal scrypt benchmark ..."));
 
-	(void) scrypt_print_colheaders();
+	(void) optimal_print_colheaders(&scrypt_print_colheaders);
 
 	long double elapsed_prev = 0L;
 	long double elapsed = 0L;
@@ -139,7 +225,7 @@ do_optimal_scrypt_benchmark(const long double optimal_clocklimit, const size_t o
 	size_t opslimit = ((1ULL << memlimit) * 32ULL);
 
 	// First try at our memory limit and the corresponding default opslimit
-	if (! benchmark_scrypt(memlimit, opslimit, &elapsed))
+	if (! optimal_scrypt(memlimit, opslimit, &elapsed))
 		// This function logs error messages on failure
 		return false;
 
@@ -157,7 +243,7 @@ do_optimal_scrypt_benchmark(const long double optimal_clocklimit, const size_t o
 		memlimit--;
 		opslimit = ((1ULL << memlimit) * 32ULL);
 
-		if (! benchmark_scrypt(memlimit, opslimit, &elapsed))
+		if (! optimal_scrypt(memlimit, opslimit, &elapsed))
 			// This function logs error messages on failure
 			return false;
 	}
@@ -169,7 +255,7 @@ do_optimal_scrypt_benchmark(const long double optimal_clocklimit, const size_t o
 		opslimit_prev = opslimit;
 		opslimit *= 2U;
 
-		if (! benchmark_scrypt(memlimit, opslimit, &elapsed))
+		if (! optimal_scrypt(memlimit, opslimit, &elapsed))
 			// This function logs error messages on failure
 			return false;
 	}
@@ -186,7 +272,7 @@ do_optimal_scrypt_benchmark(const long double optimal_clocklimit, const size_t o
 	(void) bench_print("");
 
 	(void) fprintf(stdout, "crypto {\n");
-	(void) fprintf(stdout, _("\t/* Target: %LFs; Benchmarked: %LFs */\n"), optimal_clocklimit, elapsed);
+	(void) optimal_print_target(elapsed);
 	(void) fprintf(stdout, "\tscrypt_memlimit = %zu; /* %s */ \n", memlimit, memory_power2k_to_str(memlimit));
 	(void) fprintf(stdout, "\tscrypt_opslimit = %zu;\n", opslimit);
 	(void) fprintf(stdout, "};\n");
@@ -197,6 +283,22 @@ do_optimal_scrypt_benchmark(const long double optimal_clocklimit, const size_t o
 
 #endif /* HAVE_LIBSODIUM_SCRYPT */
 
+static bool ATHEME_FATTR_WUR
+optimal_bcrypt(const unsigned int rounds, long double *const restrict elapsed)
+{
+	struct bench_tp_result result;
+
+	if (! bench_tp_workers())
+		return benchmark_bcrypt(rounds, elapsed);
+
+	if (! benchmark_bcrypt_tp(rounds, &result))
+		// This function logs error messages on failure
+		return false;
+
+	*elapsed = optimal_tp_elapsed(&result);
+	return true;
+}
+
 static bool ATHEME_FATTR_WUR
 do_optimal_bcrypt_benchmark(const long double optimal_clocklimit)
 {
@@ -204,7 +306,7 @@ do_optimal_bcrypt_benchmark(const long double optimal_clocklimit)
 	(void) bench_print("");
 	(void) bench_print(_("Beginning automatic optimal bcrypt benchmark ..."));
 
-	(void) bcrypt_print_colheaders();
+	(void) optimal_print_colheaders(&bcrypt_print_colheaders);
 
 	long double elapsed_prev = 0L;
 	long double elapsed = 0L;
@@ -213,7 +315,7 @@ do_optimal_bcrypt_benchmark(const long double optimal_clocklimit)
 	unsigned int rounds = ATHEME_BCRYPT_ROUNDS_MIN;
 
 	// First try at the minimum rounds
-	if (! benchmark_bcrypt(rounds, &elapsed))
+	if (! optimal_bcrypt(rounds, &elapsed))
 		// This function logs error messages on failure
 		return false;
 
@@ -232,7 +334,7 @@ do_optimal_bcrypt_benchmark(const long double optimal_clocklimit)
 		rounds_prev = rounds;
 		rounds++;
 
-		if (! benchmark_bcrypt(rounds, &elapsed))
+		if (! optimal_bcrypt(rounds, &elapsed))
 			// This function logs error messages on failure
 			return false;
 
@@ -255,7 +357,7 @@ do_optimal_bcrypt_benchmark(const long double optimal_clocklimit)
 	(void) bench_print("");
 
 	(void) fprintf(stdout, "crypto {\n");
-	(void) fprintf(stdout, _("\t/* Target: %LFs; Benchmarked: %LFs */\n"), optimal_clocklimit, elapsed);
+	(void) optimal_print_target(elapsed);
 	(void) fprintf(stdout, "\tbcrypt_cost = %u;\n", rounds);
 	(void) fprintf(stdout, "};\n");
 	(void) fflush(stdout);
@@ -263,6 +365,25 @@ do_optimal_bcrypt_benchmark(const long double optimal_clocklimit)
 	return true;
 }
 
+static bool ATHEME_FATTR_WUR
+optimal_pbkdf2(const enum digest_algorithm md, const size_t iterations, const bool with_sasl_scram,
+               long double *const restrict elapsed)
+{
+	struct bench_tp_result result;
+
+	if (! bench_tp_workers())
+		return benchmark_pbkdf2(md, iterations, with_sasl_scram, elapsed);
+
+	if (! benchmark_pbkdf2_tp(md, iterations, with_sasl_scram, &result))
+		// This function logs error messages on failure
+		return false;
+
+	if (elapsed)
+		*elapsed = optimal_tp_elapsed(&result);
+
+	return true;
+}
+
 static bool ATHEME_FATTR_WUR
 do_optimal_pbkdf2_benchmark(const long double optimal_clocklimit, const bool with_sasl_scram)
 {
@@ -295,7 +416,7 @@ do_optimal_pbkdf2_benchmark(const long double optimal_clocklimit, const bool wit
 	(void) bench_print("");
 	(void) bench_print(_("Selecting iterations starting point: %zu"), initial);
 
-	(void) pbkdf2_print_colheaders();
+	(void) optimal_print_colheaders(&pbkdf2_print_colheaders);
 
 	long double elapsed_sha512 = 0L;
 	long double elapsed_sha256 = 0L;
@@ -303,15 +424,15 @@ do_optimal_pbkdf2_benchmark(const long double optimal_clocklimit, const bool wit
 
 	enum digest_algorithm md;
 
-	if (! benchmark_pbkdf2(DIGALG_SHA1, initial, with_sasl_scram, NULL))
+	if (! optimal_pbkdf2(DIGALG_SHA1, initial, with_sasl_scram, NULL))
 		// This function logs error messages on failure
 		return false;
 
-	if (! benchmark_pbkdf2(DIGALG_SHA2_256, initial, with_sasl_scram, &elapsed_sha256))
+	if (! optimal_pbkdf2(DIGALG_SHA2_256, initial, with_sasl_scram, &elapsed_sha256))
 		// This function logs error messages on failure
 		return false;
 
-	if (! benchmark_pbkdf2(DIGALG_SHA2_512, initial, with_sasl_scram, &elapsed_sha512))
+	if (! optimal_pbkdf2(DIGALG_SHA2_512, initial, with_sasl_scram, &elapsed_sha512))
 		// This function logs error messages on failure
 		return false;
 
@@ -349,9 +470,9 @@ do_optimal_pbkdf2_benchmark(const long double optimal_clocklimit, const bool wit
 	(void) bench_print(_("Selecting optimal algorithm: %s"), mdname);
 
 	if (iterations != initial || elapsed > optimal_clocklimit)
-		(void) pbkdf2_print_colheaders();
+		(void) optimal_print_colheaders(&pbkdf2_print_colheaders);
 
-	if (iterations != initial && ! benchmark_pbkdf2(md, iterations, with_sasl_scram, &elapsed))
+	if (iterations != initial && ! optimal_pbkdf2(md, iterations, with_sasl_scram, &elapsed))
 		// This function logs error messages on failure
 		return false;
 
@@ -368,7 +489,7 @@ do_optimal_pbkdf2_benchmark(const long double optimal_clocklimit, const bool wit
 		// Shave digits after thousands off while reducing by a thousand too
 		iterations -= (1000U + (iterations % 1000U));
 
-		if (! benchmark_pbkdf2(md, iterations, with_sasl_scram, &elapsed))
+		if (! optimal_pbkdf2(md, iterations, with_sasl_scram, &elapsed))
 			// This function logs error messages on failure
 			return false;
 	}
@@ -378,7 +499,7 @@ do_optimal_pbkdf2_benchmark(const long double optimal_clocklimit, const bool wit
 	(void) bench_print("");
 
 	(void) fprintf(stdout, "crypto {\n");
-	(void) fprintf(stdout, _("\t/* Target: %LFs; Benchmarked: %LFs */\n"), optimal_clocklimit, elapsed);
+	(void) optimal_print_target(elapsed);
 	(void) fprintf(stdout, "\tpbkdf2v2_digest = \"%s\";\n", mdname);
 	(void) fprintf(stdout, "\tpbkdf2v2_rounds = %zu;\n", iterations);
 	(void) fprintf(stdout, "};\n");
@@ -389,8 +510,32 @@ do_optimal_pbkdf2_benchmark(const long double optimal_clocklimit, const bool wit
 
 bool ATHEME_FATTR_WUR
 do_optimal_benchmarks(const long double optimal_clocklimit, const size_t ATHEME_VATTR_MAYBE_UNUSED optimal_memlimit,
-                      const bool ATHEME_VATTR_MAYBE_UNUSED optimal_memlimit_given, const bool with_sasl_scram)
+                      const bool ATHEME_VATTR_MAYBE_UNUSED optimal_memlimit_given, const bool with_sasl_scram,
+                      const long double optimal_throughput)
 {
+	optimal_tp_clocklimit = optimal_clocklimit;
+	optimal_tp_goal = optimal_throughput;
+
+	if (bench_tp_workers())
+	{
+		(void) bench_print("");
+		(void) bench_print("");
+		(void) bench_print(_(""
+			"NOTICE: Every measurement runs %zu concurrent workers for the configured\n"
+			"        duration; the clock limit applies to their p99 latency."
+		), bench_tp_workers());
+
+		if (optimal_throughput > 0L)
+			(void) bench_print(_("        Parameters must also sustain %.2LF hashes/s in aggregate."),
+			                   optimal_throughput);
+
+#ifdef HAVE_ANY_MEMORY_HARD_ALGORITHM
+		(void) bench_print(_(""
+			"        The memory limit applies to each worker, not to all of them."
+		));
+#endif
+	}
+
 #ifdef HAVE_ANY_MEMORY_HARD_ALGORITHM
 	if (! optimal_memlimit_given)
 	{
@@ -3,19 +3,299 @@
  * SPDX-URL: https://spdx.org/licenses/ISC.html
  *
  * Copyright (C) 2005-2010 William Pitcock <nenolod@dereferenced.org>
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
  *
- * Initialization stub for libathemecore.
+ * Memory footprint of the network state.
+ *
+ * By default, this multiplies structure sizes by made-up population counts.
+ * With -m it builds a synthetic network using the same calls the protocol
+ * and database code use (user_add(), chanuser_add(), myuser_add(), ...) and
+ * reports the memory that each kind of object actually took, including the
+ * strings, dictionary nodes, list nodes and heap slack that go with it.
  */
 
 #include <atheme.h>
 #include <atheme/libathemecore.h>
+#include <ext/getopt_long.h>
 
-int
-main(int argc, char *argv[])
+#include "synthnet.h"
+
+#define FOOTPRINT_MAX_SERVERS   999U
+#define FOOTPRINT_MAX_COUNT     10000000U
+
+struct footprint_result
 {
-	if (! libathemecore_early_init())
+	const char *    name;
+	unsigned int    count;
+	size_t          bytes;          // resident memory the objects took
+	size_t          heap_bytes;     // ... of which the structures themselves
+};
+
+static struct synthnet net = {
+
+	.servers        = 20,
+	.users          = 50000,
+	.channels       = 10000,
+	.joins          = 4,
+	.accounts       = 30000,
+	.metadata       = 2,
+	.mychans        = 5000,
+	.chanacs        = 5,
+	.seed           = 1,
+};
+
+static void
+footprint_print_usage(const char *const restrict progname)
+{
+	(void) fprintf(stderr,
+		"Usage: %s [-m [options]] [-h]\n"
+		"\n"
+		"Without -m, estimates memory use from structure sizes alone.\n"
+		"\n"
+		"  -m  Build a synthetic network and measure what it takes\n"
+		"  -s  Servers (default %u)\n"
+		"  -u  Users (default %u)\n"
+		"  -c  Channels (default %u)\n"
+		"  -j  Channels each user is in (default %u)\n"
+		"  -a  Accounts, each with a registered nick (default %u)\n"
+		"  -d  Metadata entries on each account (default %u)\n"
+		"  -r  Registered channels (default %u)\n"
+		"  -x  Access entries on each registered channel (default %u)\n"
+		"  -S  Seed for the synthetic network (default %u)\n"
+		"  -o  Write the results to a file, for use with -b later\n"
+		"  -b  Compare the results with ones written by -o before\n"
+		"\n"
+		"Measurements are taken from the resident set size, so use populations\n"
+		"large enough that a few pages either way do not matter.\n", progname,
+		net.servers, net.users, net.channels, net.joins, net.accounts, net.metadata, net.mychans,
+		net.chanacs, net.seed);
+}
+
+static size_t
+footprint_rss(void)
+{
+	unsigned long size, resident;
+	FILE *f;
+
+	if ((f = fopen("/proc/self/statm", "r")) != NULL)
+	{
+		const int ret = fscanf(f, "%lu %lu", &size, &resident);
+
+		(void) fclose(f);
+
+		if (ret == 2)
+			return ((size_t) resident) * (size_t) sysconf(_SC_PAGESIZE);
+	}
+
+#ifndef MOWGLI_OS_WIN
+	// the objects are never freed, so the peak is as good as the current size
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+		return 0;
+
+#ifdef MOWGLI_OS_OSX
+	return (size_t) ru.ru_maxrss;
+#else
+	return ((size_t) ru.ru_maxrss) * 1024U;
+#endif
+#else /* !MOWGLI_OS_WIN */
+	return 0;
+#endif /* MOWGLI_OS_WIN */
+}
+
+static int
+footprint_heap_bytes_cb(const struct sharedheap *const restrict s, void *const restrict privdata)
+{
+	*((size_t *) privdata) += s->objects * s->size;
+
+	return 0;
+}
+
+static size_t
+footprint_heap_bytes(void)
+{
+	size_t bytes = 0;
+
+	(void) sharedheap_foreach(&footprint_heap_bytes_cb, &bytes);
+
+	return bytes;
+}
+
+static void
+footprint_measure(struct footprint_result *const restrict r, const char *const restrict name,
+                  unsigned int (*const build)(struct synthnet *))
+{
+	const size_t rss = footprint_rss();
+	const size_t heap = footprint_heap_bytes();
+
+	r->name = name;
+	r->count = build(&net);
+
+	const size_t rss_after = footprint_rss();
+	const size_t heap_after = footprint_heap_bytes();
+
+	r->bytes = (rss_after > rss) ? (rss_after - rss) : 0;
+	r->heap_bytes = (heap_after > heap) ? (heap_after - heap) : 0;
+}
+
+static const struct footprint_result *
+footprint_baseline_find(const struct footprint_result *const restrict baseline, const size_t count,
+                        const char *const restrict name)
+{
+	for (size_t i = 0; i < count; i++)
+		if (strcmp(baseline[i].name, name) == 0)
+			return &baseline[i];
+
+	return NULL;
+}
+
+// Reads the file written by footprint_write(); returns how many results it holds
+static size_t
+footprint_read(const char *const restrict path, struct footprint_result *const restrict results,
+               const size_t size)
+{
+	char line[BUFSIZE];
+	char name[64];
+	size_t count = 0;
+	FILE *f;
+
+	if (! (f = fopen(path, "r")))
+	{
+		(void) fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+		return 0;
+	}
+
+	while (count < size && fgets(line, sizeof line, f))
+	{
+		unsigned long long bytes, heap_bytes;
+		unsigned int objects;
+
+		if (line[0] == '#' || sscanf(line, "%63s %u %llu %llu", name, &objects, &bytes, &heap_bytes) != 4)
+			continue;
+
+		results[count].name = sstrdup(name);
+		results[count].count = objects;
+		results[count].bytes = (size_t) bytes;
+		results[count].heap_bytes = (size_t) heap_bytes;
+		count++;
+	}
+
+	(void) fclose(f);
+
+	return count;
+}
+
+static bool
+footprint_write(const char *const restrict path, const struct footprint_result *const restrict results,
+                const size_t count)
+{
+	FILE *f;
+
+	if (! (f = fopen(path, "w")))
+	{
+		(void) fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+		return false;
+	}
+
+	(void) fprintf(f, "# footprint for atheme %s (%s)\n", PACKAGE_VERSION, SERNO);
+	(void) fprintf(f, "# class objects bytes structure-bytes\n");
+
+	for (size_t i = 0; i < count; i++)
+		(void) fprintf(f, "%s %u %llu %llu\n", results[i].name, results[i].count,
+		               (unsigned long long) results[i].bytes, (unsigned long long) results[i].heap_bytes);
+
+	return (fclose(f) == 0);
+}
+
+static void
+footprint_report(const struct footprint_result *const restrict results, const size_t count,
+                 const struct footprint_result *const restrict baseline, const size_t baseline_count)
+{
+	size_t total = 0;
+
+	(void) printf("%-12s %10s %12s %10s %10s %10s", "Class", "Objects", "KiB", "B/object", "struct",
+	              "other");
+
+	if (baseline_count)
+		(void) printf(" %10s %8s", "before", "change");
+
+	(void) printf("\n");
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const struct footprint_result *const r = &results[i];
+		const double per_object = r->count ? (((double) r->bytes) / r->count) : 0.0;
+		const double per_struct = r->count ? (((double) r->heap_bytes) / r->count) : 0.0;
+
+		total += r->bytes;
+
+		(void) printf("%-12s %10u %12zu %10.1f %10.1f %10.1f", r->name, r->count, r->bytes / 1024U,
+		              per_object, per_struct, per_object - per_struct);
+
+		const struct footprint_result *const b = footprint_baseline_find(baseline, baseline_count, r->name);
+
+		if (b && b->count)
+		{
+			const double before = ((double) b->bytes) / b->count;
+
+			(void) printf(" %10.1f %+7.1f%%", before, before ? (((per_object - before) * 100.0) / before) : 0.0);
+		}
+
+		(void) printf("\n");
+	}
+
+	(void) printf("\n%-12s %10s %12zu\n", "Total", "", total / 1024U);
+}
+
+static int
+footprint_run_measure(char *const restrict progname, const char *const restrict output,
+                      const char *const restrict baseline_path)
+{
+	struct footprint_result results[8];
+	struct footprint_result baseline[16];
+	size_t count = 0;
+	size_t baseline_count = 0;
+
+	if (! net.servers || ! net.users || ! net.channels || ! net.accounts)
+	{
+		(void) fprintf(stderr, "There must be at least one server, user, channel and account\n");
 		return EXIT_FAILURE;
+	}
+
+	if (baseline_path && ! (baseline_count = footprint_read(baseline_path, baseline, ARRAY_SIZE(baseline))))
+	{
+		(void) fprintf(stderr, "No results in %s\n", baseline_path);
+		return EXIT_FAILURE;
+	}
+
+	// bookkeeping is allocated here, before anything is measured
+	(void) synthnet_init(&net, progname, "footprint");
+
+	(void) footprint_measure(&results[count++], "servers", &synthnet_build_servers);
+	(void) footprint_measure(&results[count++], "accounts", &synthnet_build_accounts);
+	(void) footprint_measure(&results[count++], "metadata", &synthnet_build_metadata);
+	(void) footprint_measure(&results[count++], "users", &synthnet_build_users);
+	(void) footprint_measure(&results[count++], "channels", &synthnet_build_channels);
+	(void) footprint_measure(&results[count++], "chanusers", &synthnet_build_chanusers);
+	(void) footprint_measure(&results[count++], "mychans", &synthnet_build_mychans);
+	(void) footprint_measure(&results[count++], "chanacs", &synthnet_build_chanacs);
+
+	(void) printf("footprint for atheme %s (%s), measured\n\n", PACKAGE_VERSION, SERNO);
+	(void) printf("B/object is everything the objects took; struct is the structures alone, and\n");
+	(void) printf("other is strings, dictionary and list nodes, and allocator overhead.\n\n");
+
+	(void) footprint_report(results, count, baseline, baseline_count);
+
+	if (output && ! footprint_write(output, results, count))
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
 
+static int
+footprint_run_estimate(void)
+{
 	unsigned int usercount = 0, channelcount = 0, membercount = 0,
 		klinecount = 0, qlinecount = 0, xlinecount = 0, regchannelcount = 0,
 		servercount = 0, regusercount = 0;
@@ -78,3 +358,108 @@ main(int argc, char *argv[])
 
 	return EXIT_SUCCESS;
 }
+
+int
+main(int argc, char *argv[])
+{
+	const mowgli_getopt_option_t long_opts[] = {
+		{        "measure",       no_argument, NULL, 'm', 0 },
+		{        "servers", required_argument, NULL, 's', 0 },
+		{          "users", required_argument, NULL, 'u', 0 },
+		{       "channels", required_argument, NULL, 'c', 0 },
+		{          "joins", required_argument, NULL, 'j', 0 },
+		{       "accounts", required_argument, NULL, 'a', 0 },
+		{       "metadata", required_argument, NULL, 'd', 0 },
+		{        "mychans", required_argument, NULL, 'r', 0 },
+		{        "chanacs", required_argument, NULL, 'x', 0 },
+		{           "seed", required_argument, NULL, 'S', 0 },
+		{         "output", required_argument, NULL, 'o', 0 },
+		{       "baseline", required_argument, NULL, 'b', 0 },
+		{           "help",       no_argument, NULL, 'h', 0 },
+		{             NULL,                 0, NULL,  0 , 0 },
+	};
+
+	const char *output = NULL;
+	const char *baseline = NULL;
+	bool measure = false;
+	int r;
+
+	if (! libathemecore_early_init())
+		return EXIT_FAILURE;
+
+	while ((r = mowgli_getopt_long(argc, argv, "ms:u:c:j:a:d:r:x:S:o:b:h", long_opts, NULL)) != -1)
+	{
+		switch (r)
+		{
+			case 'm':
+				measure = true;
+				break;
+
+			case 's':
+				if (! synthnet_option(mowgli_optarg, &net.servers, FOOTPRINT_MAX_SERVERS))
+					return EXIT_FAILURE;
+				break;
+
+			case 'u':
+				if (! synthnet_option(mowgli_optarg, &net.users, FOOTPRINT_MAX_COUNT))
+					return EXIT_FAILURE;
+				break;
+
+			case 'c':
+				if (! synthnet_option(mowgli_optarg, &net.channels, FOOTPRINT_MAX_COUNT))
+					return EXIT_FAILURE;
+				break;
+
+			case 'j':
+				if (! synthnet_option(mowgli_optarg, &net.joins, 100U))
+					return EXIT_FAILURE;
+				break;
+
+			case 'a':
+				if (! synthnet_option(mowgli_optarg, &net.accounts, FOOTPRINT_MAX_COUNT))
+					return EXIT_FAILURE;
+				break;
+
+			case 'd':
+				if (! synthnet_option(mowgli_optarg, &net.metadata, 100U))
+					return EXIT_FAILURE;
+				break;
+
+			case 'r':
+				if (! synthnet_option(mowgli_optarg, &net.mychans, FOOTPRINT_MAX_COUNT))
+					return EXIT_FAILURE;
+				break;
+
+			case 'x':
+				if (! synthnet_option(mowgli_optarg, &net.chanacs, 100U))
+					return EXIT_FAILURE;
+				break;
+
+			case 'S':
+				if (! synthnet_option(mowgli_optarg, &net.seed, UINT_MAX))
+					return EXIT_FAILURE;
+				break;
+
+			case 'o':
+				output = mowgli_optarg;
+				break;
+
+			case 'b':
+				baseline = mowgli_optarg;
+				break;
+
+			case 'h':
+				(void) footprint_print_usage(argv[0]);
+				return EXIT_SUCCESS;
+
+			default:
+				(void) footprint_print_usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (measure)
+		return footprint_run_measure(argv[0], output, baseline);
+
+	return footprint_run_estimate();
+}
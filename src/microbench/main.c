@@ -0,0 +1,832 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Microbenchmarks for the libathemecore primitives that run on every
+ * message: mask matching, case-insensitive comparison, string sharing,
+ * user and channel lookup, access and K-line checks, metadata lookup and
+ * the database row parser.
+ *
+ * The inputs are picked from a synthetic network (see src/common) built
+ * from a fixed seed, so two runs with the same options time the same work.
+ * The results are written as JSON, for comparing one build with another.
+ */
+
+#include <atheme.h>
+#include <atheme/libathemecore.h>
+#include <ext/getopt_long.h>
+
+#include "synthnet.h"
+
+#define MICROBENCH_INPUTS       4096U   // inputs per benchmark; must be a power of two
+#define MICROBENCH_INPUT_MASK   (MICROBENCH_INPUTS - 1U)
+#define MICROBENCH_MAX_COUNT    1000000U
+#define MICROBENCH_MAX_REPS     100U
+#define MICROBENCH_DB_FILE      "microbench.db"
+
+struct microbench
+{
+	const char *    name;
+	const char *    desc;
+
+	// Does the operation 'iterations' times; returns how many operations that was
+	unsigned long long (*run)(unsigned long long iterations);
+};
+
+struct microbench_result
+{
+	const struct microbench *   bench;
+	unsigned long long          ops;            // operations in each repetition
+	double                      ns_min;
+	double                      ns_median;
+	double                      ns_max;
+};
+
+static struct synthnet net = {
+
+	.users          = 20000,
+	.channels       = 5000,
+	.accounts       = 10000,
+	.metadata       = 4,
+	.mychans        = 2000,
+	.chanacs        = 10,
+	.klines         = 500,
+	.seed           = 1,
+};
+
+// The inputs each benchmark cycles through, picked from the network beforehand
+static const char *in_masks[MICROBENCH_INPUTS];
+static const char *in_strings[MICROBENCH_INPUTS];
+static const char *in_names[MICROBENCH_INPUTS];
+static const char *in_other_names[MICROBENCH_INPUTS];
+static const char *in_shared[MICROBENCH_INPUTS];
+static const char *in_channel_names[MICROBENCH_INPUTS];
+static const char *in_metadata_names[MICROBENCH_INPUTS];
+static struct user *in_users[MICROBENCH_INPUTS];
+static struct mychan *in_mychans[MICROBENCH_INPUTS];
+static struct myuser *in_accounts[MICROBENCH_INPUTS];
+
+static unsigned int db_rows = 0;
+static bool db_available = false;
+
+// Results are folded into this, so the compiler cannot drop the calls
+static volatile unsigned long long microbench_sink = 0;
+
+static void
+microbench_print_usage(const char *const restrict progname)
+{
+	(void) fprintf(stderr,
+		"Usage: %s [options] [benchmark ...]\n"
+		"\n"
+		"Times libathemecore primitives on a synthetic network and writes the\n"
+		"results as JSON. Without benchmark names, runs all of them.\n"
+		"\n"
+		"  -u  Users (default %u)\n"
+		"  -c  Channels (default %u)\n"
+		"  -a  Accounts (default %u)\n"
+		"  -d  Metadata entries on each account (default %u)\n"
+		"  -r  Registered channels (default %u)\n"
+		"  -x  Access entries on each registered channel (default %u)\n"
+		"  -k  K-lines (default %u)\n"
+		"  -s  Seed for the synthetic network (default %u)\n"
+		"  -n  Repetitions of each benchmark (default 5)\n"
+		"  -t  Milliseconds each repetition should take (default 200)\n"
+		"  -o  Write the results to a file instead of standard output\n"
+		"  -l  List the benchmarks and exit\n"
+		"  -h  Show this help and exit\n", progname,
+		net.users, net.channels, net.accounts, net.metadata, net.mychans,
+		net.chanacs, net.klines, net.seed);
+}
+
+static void
+microbench_build_inputs(void)
+{
+	char buf[BUFSIZE];
+
+	for (unsigned int i = 0; i < MICROBENCH_INPUTS; i++)
+	{
+		struct user *const u = net.user_list[synthnet_rand(&net, net.users)];
+		struct user *const v = net.user_list[synthnet_rand(&net, net.users)];
+
+		in_users[i] = u;
+
+		// the sorts of masks found in bans, access lists and exemptions
+		switch (i % 6U)
+		{
+			case 0:
+				(void) snprintf(buf, sizeof buf, "*!*@%s", u->host);
+				break;
+			case 1:
+				(void) snprintf(buf, sizeof buf, "*!*@*.pool%u.isp*.example.com", synthnet_rand(&net, 64U));
+				break;
+			case 2:
+				(void) snprintf(buf, sizeof buf, "%.4s*!*%s@*", v->nick, v->user + (*v->user == '~'));
+				break;
+			case 3:
+				(void) snprintf(buf, sizeof buf, "*!*@10.%u.*", synthnet_rand(&net, 200U));
+				break;
+			case 4:
+				(void) snprintf(buf, sizeof buf, "*!*@user/account%u", synthnet_rand(&net, net.users));
+				break;
+			default:
+				(void) snprintf(buf, sizeof buf, "%s!*@*", v->nick);
+				break;
+		}
+
+		in_masks[i] = sstrdup(buf);
+
+		(void) snprintf(buf, sizeof buf, "%s!%s@%s", u->nick, u->user, u->host);
+		in_strings[i] = sstrdup(buf);
+
+		// an exact match in a different case, or a different nick altogether
+		(void) mowgli_strlcpy(buf, u->nick, sizeof buf);
+
+		if (i % 2U)
+			(void) irccasecanon(buf);
+
+		in_names[i] = sstrdup(buf);
+		in_other_names[i] = (i % 2U) ? u->nick : v->nick;
+
+		// lookups by nick, by UID, and of nicks that are not in use
+		if ((i % 4U) == 3U)
+		{
+			(void) snprintf(buf, sizeof buf, "Nobody%u", i);
+			in_shared[i] = sstrdup(buf);
+		}
+		else
+			in_shared[i] = ((i % 4U) == 2U) ? u->uid : u->nick;
+
+		if ((i % 4U) == 3U || ! net.channels)
+		{
+			(void) snprintf(buf, sizeof buf, "#nowhere-%u", i);
+			in_channel_names[i] = sstrdup(buf);
+		}
+		else
+		{
+			// channel names arrive in whatever case the client typed them
+			(void) mowgli_strlcpy(buf, net.channel_list[synthnet_rand(&net, net.channels)]->name, sizeof buf);
+
+			if (i % 2U)
+				(void) irccasecanon(buf);
+
+			in_channel_names[i] = sstrdup(buf);
+		}
+
+		in_mychans[i] = net.mychans ? net.mychan_list[synthnet_rand(&net, net.mychans)] : NULL;
+		in_accounts[i] = net.accounts ? net.account_list[synthnet_rand(&net, net.accounts)] : NULL;
+
+		// mostly names that are set, some that are not
+		if ((i % 5U) == 4U || ! net.metadata)
+			in_metadata_names[i] = "private:doesnotexist";
+		else
+			in_metadata_names[i] = synthnet_metadata_names[synthnet_rand(&net, net.metadata)];
+	}
+}
+
+static unsigned long long
+bench_match(const unsigned long long iterations)
+{
+	unsigned long long acc = 0;
+
+	for (unsigned long long i = 0; i < iterations; i++)
+		acc += (unsigned long long) match(in_masks[i & MICROBENCH_INPUT_MASK],
+		                                  in_strings[(i * 7U) & MICROBENCH_INPUT_MASK]);
+
+	microbench_sink ^= acc;
+
+	return iterations;
+}
+
+static unsigned long long
+bench_irccasecmp(const unsigned long long iterations)
+{
+	unsigned long long acc = 0;
+
+	for (unsigned long long i = 0; i < iterations; i++)
+		acc += (unsigned long long) irccasecmp(in_names[i & MICROBENCH_INPUT_MASK],
+		                                       in_other_names[i & MICROBENCH_INPUT_MASK]);
+
+	microbench_sink ^= acc;
+
+	return iterations;
+}
+
+static unsigned long long
+bench_irccasecanon(const unsigned long long iterations)
+{
+	unsigned long long acc = 0;
+	char buf[NICKLEN + 1];
+
+	for (unsigned long long i = 0; i < iterations; i++)
+	{
+		(void) mowgli_strlcpy(buf, in_other_names[i & MICROBENCH_INPUT_MASK], sizeof buf);
+		(void) irccasecanon(buf);
+
+		acc += (unsigned char) buf[0];
+	}
+
+	microbench_sink ^= acc;
+
+	return iterations;
+}
+
+static unsigned long long
+bench_strshare(const unsigned long long iterations)
+{
+	unsigned long long acc = 0;
+
+	// mostly strings that are already shared, as nicks are; a quarter are new
+	for (unsigned long long i = 0; i < iterations; i++)
+	{
+		const stringref s = strshare_get(in_shared[i & MICROBENCH_INPUT_MASK]);
+
+		acc += (uintptr_t) s;
+
+		(void) strshare_unref(s);
+	}
+
+	microbench_sink ^= acc;
+
+	return iterations;
+}
+
+static unsigned long long
+bench_user_find(const unsigned long long iterations)
+{
+	unsigned long long acc = 0;
+
+	for (unsigned long long i = 0; i < iterations; i++)
+		acc += (uintptr_t) user_find(in_shared[i & MICROBENCH_INPUT_MASK]);
+
+	microbench_sink ^= acc;
+
+	return iterations;
+}
+
+static unsigned long long
+bench_channel_find(const unsigned long long iterations)
+{
+	unsigned long long acc = 0;
+
+	for (unsigned long long i = 0; i < iterations; i++)
+		acc += (uintptr_t) channel_find(in_channel_names[i & MICROBENCH_INPUT_MASK]);
+
+	microbench_sink ^= acc;
+
+	return iterations;
+}
+
+static unsigned long long
+bench_chanacs_user_flags(const unsigned long long iterations)
+{
+	unsigned long long acc = 0;
+
+	if (! net.mychans)
+		return 0;
+
+	for (unsigned long long i = 0; i < iterations; i++)
+		acc += chanacs_user_flags(in_mychans[i & MICROBENCH_INPUT_MASK],
+		                          in_users[(i * 7U) & MICROBENCH_INPUT_MASK]);
+
+	microbench_sink ^= acc;
+
+	return iterations;
+}
+
+static unsigned long long
+bench_mask_matches_user(const unsigned long long iterations)
+{
+	unsigned long long acc = 0;
+
+	for (unsigned long long i = 0; i < iterations; i++)
+		acc += (unsigned long long) generic_mask_matches_user(in_masks[i & MICROBENCH_INPUT_MASK],
+		                                                      in_users[(i * 7U) & MICROBENCH_INPUT_MASK]);
+
+	microbench_sink ^= acc;
+
+	return iterations;
+}
+
+static unsigned long long
+bench_kline_find_user(const unsigned long long iterations)
+{
+	unsigned long long acc = 0;
+
+	for (unsigned long long i = 0; i < iterations; i++)
+		acc += (uintptr_t) kline_find_user(in_users[i & MICROBENCH_INPUT_MASK]);
+
+	microbench_sink ^= acc;
+
+	return iterations;
+}
+
+static unsigned long long
+bench_metadata_find(const unsigned long long iterations)
+{
+	unsigned long long acc = 0;
+
+	if (! net.accounts)
+		return 0;
+
+	for (unsigned long long i = 0; i < iterations; i++)
+		acc += (uintptr_t) metadata_find(in_accounts[i & MICROBENCH_INPUT_MASK],
+		                                 in_metadata_names[(i * 7U) & MICROBENCH_INPUT_MASK]);
+
+	microbench_sink ^= acc;
+
+	return iterations;
+}
+
+/* The row handlers read every field the way the real ones in
+ * backend/corestorage do, but do not create anything, so that only the
+ * parser is timed.
+ */
+static void
+microbench_db_h_mu(struct database_handle *const restrict db, const char ATHEME_VATTR_UNUSED *const restrict type)
+{
+	unsigned long long acc = 0;
+
+	acc += (uintptr_t) db_sread_word(db);   // entity ID
+	acc += (uintptr_t) db_sread_word(db);   // name
+	acc += (uintptr_t) db_sread_word(db);   // password
+	acc += (uintptr_t) db_sread_word(db);   // email
+	acc += (unsigned long long) db_sread_time(db);
+	acc += (unsigned long long) db_sread_time(db);
+	acc += (uintptr_t) db_sread_word(db);   // flags
+	acc += (uintptr_t) db_sread_word(db);   // language
+
+	microbench_sink ^= acc;
+}
+
+static void
+microbench_db_h_md(struct database_handle *const restrict db, const char ATHEME_VATTR_UNUSED *const restrict type)
+{
+	unsigned long long acc = 0;
+
+	acc += (uintptr_t) db_sread_word(db);   // target
+	acc += (uintptr_t) db_sread_word(db);   // name
+	acc += (uintptr_t) db_sread_str(db);    // value
+
+	microbench_sink ^= acc;
+}
+
+static void
+microbench_db_h_mc(struct database_handle *const restrict db, const char ATHEME_VATTR_UNUSED *const restrict type)
+{
+	unsigned long long acc = 0;
+
+	acc += (uintptr_t) db_sread_word(db);   // name
+	acc += (unsigned long long) db_sread_time(db);
+	acc += (unsigned long long) db_sread_time(db);
+	acc += (uintptr_t) db_sread_word(db);   // flags
+	acc += db_sread_uint(db);
+	acc += db_sread_uint(db);
+	acc += db_sread_uint(db);
+
+	microbench_sink ^= acc;
+}
+
+static void
+microbench_db_h_ca(struct database_handle *const restrict db, const char ATHEME_VATTR_UNUSED *const restrict type)
+{
+	unsigned long long acc = 0;
+
+	acc += (uintptr_t) db_sread_word(db);   // channel
+	acc += (uintptr_t) db_sread_word(db);   // target
+	acc += (uintptr_t) db_sread_word(db);   // flags
+	acc += (unsigned long long) db_sread_time(db);
+	acc += (uintptr_t) db_sread_word(db);   // setter
+
+	microbench_sink ^= acc;
+}
+
+// Writes the network's accounts and channels out in the shape backend/corestorage uses
+static bool
+microbench_db_write(void)
+{
+	mowgli_patricia_iteration_state_t state;
+	struct metadata *md;
+	mowgli_node_t *n;
+	char path[BUFSIZE];
+	FILE *f;
+
+	(void) snprintf(path, sizeof path, "%s/%s", datadir, MICROBENCH_DB_FILE);
+
+	if (! (f = fopen(path, "w")))
+	{
+		(void) fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+		return false;
+	}
+
+	db_rows = 0;
+
+	for (unsigned int i = 0; i < net.accounts; i++)
+	{
+		struct myuser *const mu = net.account_list[i];
+
+		(void) fprintf(f, "MU %s %s %s %s %lu %lu +sC default\n", entity(mu)->id, entity(mu)->name, mu->pass,
+		               mu->email, (unsigned long) mu->registered, (unsigned long) mu->lastlogin);
+		db_rows++;
+
+		if (! atheme_object(mu)->metadata)
+			continue;
+
+		MOWGLI_PATRICIA_FOREACH(md, &state, atheme_object(mu)->metadata)
+		{
+			(void) fprintf(f, "MDU %s %s %s\n", entity(mu)->name, md->name, md->value);
+			db_rows++;
+		}
+	}
+
+	for (unsigned int i = 0; i < net.mychans; i++)
+	{
+		struct mychan *const mc = net.mychan_list[i];
+
+		(void) fprintf(f, "MC %s %lu %lu +g 8 0 0 \n", mc->name, (unsigned long) mc->registered,
+		               (unsigned long) mc->used);
+		db_rows++;
+
+		MOWGLI_ITER_FOREACH(n, mc->chanacs.head)
+		{
+			const struct chanacs *const ca = n->data;
+
+			(void) fprintf(f, "CA %s %s %s %lu *\n", mc->name, ca->entity ? ca->entity->name : ca->host,
+			               bitmask_to_flags(ca->level), (unsigned long) ca->tmodified);
+			db_rows++;
+		}
+	}
+
+	if (fclose(f) != 0)
+	{
+		(void) fprintf(stderr, "Cannot write %s: %s\n", path, strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+microbench_db_setup(void)
+{
+	static char dir[] = "/tmp/atheme-microbench.XXXXXX";
+
+	if (! module_load("backend/opensex"))
+		return false;
+
+	if (! mkdtemp(dir))
+	{
+		(void) fprintf(stderr, "Cannot create a temporary directory: %s\n", strerror(errno));
+		return false;
+	}
+
+	datadir = dir;
+
+	if (! microbench_db_write())
+		return false;
+
+	(void) db_register_type_handler("MU", &microbench_db_h_mu);
+	(void) db_register_type_handler("MDU", &microbench_db_h_md);
+	(void) db_register_type_handler("MC", &microbench_db_h_mc);
+	(void) db_register_type_handler("CA", &microbench_db_h_ca);
+
+	return true;
+}
+
+static void
+microbench_db_cleanup(void)
+{
+	char path[BUFSIZE];
+
+	if (! db_available)
+		return;
+
+	(void) snprintf(path, sizeof path, "%s/%s", datadir, MICROBENCH_DB_FILE);
+	(void) unlink(path);
+	(void) rmdir(datadir);
+}
+
+static unsigned long long
+bench_db_parse(const unsigned long long iterations)
+{
+	if (! db_available)
+		return 0;
+
+	for (unsigned long long i = 0; i < iterations; i++)
+	{
+		struct database_handle *const db = db_open(MICROBENCH_DB_FILE, DB_READ);
+
+		if (! db)
+			return 0;
+
+		(void) db_parse(db);
+		(void) db_close(db);
+	}
+
+	// each operation is one row
+	return iterations * db_rows;
+}
+
+static const struct microbench microbenchmarks[] = {
+
+	{ "match",                      "match() of ban-style masks against nick!user@host",    &bench_match },
+	{ "irccasecmp",                 "irccasecmp() of nicks, equal in half of the cases",    &bench_irccasecmp },
+	{ "irccasecanon",               "irccasecanon() of a copied nick",                      &bench_irccasecanon },
+	{ "strshare",                   "strshare_get() and strshare_unref() of shared strings", &bench_strshare },
+	{ "user_find",                  "user_find() by nick or UID, a quarter of them absent", &bench_user_find },
+	{ "channel_find",               "channel_find() in any case, a quarter of them absent", &bench_channel_find },
+	{ "chanacs_user_flags",         "chanacs_user_flags() of a user on a registered channel", &bench_chanacs_user_flags },
+	{ "generic_mask_matches_user",  "generic_mask_matches_user() of ban-style masks",        &bench_mask_matches_user },
+	{ "kline_find_user",            "kline_find_user() over the whole K-line list",         &bench_kline_find_user },
+	{ "metadata_find",              "metadata_find() on accounts, a fifth of them absent",  &bench_metadata_find },
+	{ "db_parse",                   "backend/opensex parsing of a database, per row",       &bench_db_parse },
+};
+
+static unsigned long long
+microbench_time(const struct microbench *const restrict b, const unsigned long long iterations,
+                unsigned long long *const restrict ops)
+{
+#ifdef HAVE_GETTIMEOFDAY
+	struct timeval start, tv;
+
+	(void) s_time(&start);
+
+	*ops = b->run(iterations);
+
+	(void) e_time(start, &tv);
+
+	return tv2us(&tv);
+#else
+	*ops = 0;
+
+	return 0;
+#endif
+}
+
+static int
+microbench_double_cmp(const void *const a, const void *const b)
+{
+	const double da = *((const double *) a);
+	const double db = *((const double *) b);
+
+	return (da > db) - (da < db);
+}
+
+static bool
+microbench_run(const struct microbench *const restrict b, const unsigned int reps, const unsigned int target_ms,
+               struct microbench_result *const restrict r)
+{
+	const unsigned long long target = target_ms * 1000ULL;
+	unsigned long long iterations = 1;
+	unsigned long long ops;
+	unsigned long long usec;
+	double ns[MICROBENCH_MAX_REPS];
+
+	// find an iteration count that takes about as long as the target, starting from a tenth of it
+	while ((usec = microbench_time(b, iterations, &ops)) < (target / 10U))
+	{
+		if (! ops)
+			return false;
+
+		iterations *= (usec < (target / 1000U)) ? 100U : 2U;
+	}
+
+	if (! ops)
+		return false;
+
+	if (usec)
+		iterations = ((iterations * target) / usec) + 1U;
+
+	for (unsigned int i = 0; i < reps; i++)
+	{
+		usec = microbench_time(b, iterations, &ops);
+
+		ns[i] = (((double) usec) * 1000.0) / (double) ops;
+	}
+
+	(void) qsort(ns, reps, sizeof *ns, &microbench_double_cmp);
+
+	r->bench = b;
+	r->ops = ops;
+	r->ns_min = ns[0];
+	r->ns_median = (reps % 2U) ? ns[reps / 2U] : ((ns[(reps / 2U) - 1U] + ns[reps / 2U]) / 2.0);
+	r->ns_max = ns[reps - 1U];
+
+	return true;
+}
+
+static void
+microbench_write_json(FILE *const restrict f, const struct microbench_result *const restrict results,
+                      const size_t count, const unsigned int reps, const unsigned int target_ms)
+{
+	(void) fprintf(f, "{\n");
+	(void) fprintf(f, "  \"program\": \"%s-microbench\",\n", PACKAGE_TARNAME);
+	(void) fprintf(f, "  \"version\": \"%s\",\n", PACKAGE_VERSION);
+	(void) fprintf(f, "  \"serno\": \"%s\",\n", SERNO);
+	(void) fprintf(f, "  \"repetitions\": %u,\n", reps);
+	(void) fprintf(f, "  \"target_ms\": %u,\n", target_ms);
+	(void) fprintf(f, "  \"dataset\": {\n");
+	(void) fprintf(f, "    \"users\": %u,\n", net.users);
+	(void) fprintf(f, "    \"channels\": %u,\n", net.channels);
+	(void) fprintf(f, "    \"accounts\": %u,\n", net.accounts);
+	(void) fprintf(f, "    \"metadata\": %u,\n", net.metadata);
+	(void) fprintf(f, "    \"mychans\": %u,\n", net.mychans);
+	(void) fprintf(f, "    \"chanacs\": %u,\n", net.chanacs);
+	(void) fprintf(f, "    \"klines\": %u,\n", net.klines);
+	(void) fprintf(f, "    \"db_rows\": %u,\n", db_rows);
+	(void) fprintf(f, "    \"seed\": %u\n", net.seed);
+	(void) fprintf(f, "  },\n");
+	(void) fprintf(f, "  \"results\": [");
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const struct microbench_result *const r = &results[i];
+
+		(void) fprintf(f, "%s\n    {\n", i ? "," : "");
+		(void) fprintf(f, "      \"name\": \"%s\",\n", r->bench->name);
+		(void) fprintf(f, "      \"description\": \"%s\",\n", r->bench->desc);
+		(void) fprintf(f, "      \"ops\": %llu,\n", r->ops);
+		(void) fprintf(f, "      \"ns_per_op\": { \"min\": %.3f, \"median\": %.3f, \"max\": %.3f }\n",
+		               r->ns_min, r->ns_median, r->ns_max);
+		(void) fprintf(f, "    }");
+	}
+
+	(void) fprintf(f, "%s]\n}\n", count ? "\n  " : "");
+}
+
+static bool
+microbench_selected(const char *const restrict name, const int argc, char *const argv[])
+{
+	if (mowgli_optind >= argc)
+		return true;
+
+	for (int i = mowgli_optind; i < argc; i++)
+		if (strcmp(argv[i], name) == 0)
+			return true;
+
+	return false;
+}
+
+int
+main(int argc, char *argv[])
+{
+	const mowgli_getopt_option_t long_opts[] = {
+		{          "users", required_argument, NULL, 'u', 0 },
+		{       "channels", required_argument, NULL, 'c', 0 },
+		{       "accounts", required_argument, NULL, 'a', 0 },
+		{       "metadata", required_argument, NULL, 'd', 0 },
+		{        "mychans", required_argument, NULL, 'r', 0 },
+		{        "chanacs", required_argument, NULL, 'x', 0 },
+		{         "klines", required_argument, NULL, 'k', 0 },
+		{           "seed", required_argument, NULL, 's', 0 },
+		{    "repetitions", required_argument, NULL, 'n', 0 },
+		{           "time", required_argument, NULL, 't', 0 },
+		{         "output", required_argument, NULL, 'o', 0 },
+		{           "list",       no_argument, NULL, 'l', 0 },
+		{           "help",       no_argument, NULL, 'h', 0 },
+		{             NULL,                 0, NULL,  0 , 0 },
+	};
+
+	struct microbench_result results[ARRAY_SIZE(microbenchmarks)];
+	unsigned int reps = 5;
+	unsigned int target_ms = 200;
+	const char *output = NULL;
+	size_t count = 0;
+	int r;
+
+	if (! libathemecore_early_init())
+		return EXIT_FAILURE;
+
+	while ((r = mowgli_getopt_long(argc, argv, "u:c:a:d:r:x:k:s:n:t:o:lh", long_opts, NULL)) != -1)
+	{
+		switch (r)
+		{
+			case 'u':
+				if (! synthnet_option(mowgli_optarg, &net.users, MICROBENCH_MAX_COUNT))
+					return EXIT_FAILURE;
+				break;
+
+			case 'c':
+				if (! synthnet_option(mowgli_optarg, &net.channels, MICROBENCH_MAX_COUNT))
+					return EXIT_FAILURE;
+				break;
+
+			case 'a':
+				if (! synthnet_option(mowgli_optarg, &net.accounts, MICROBENCH_MAX_COUNT))
+					return EXIT_FAILURE;
+				break;
+
+			case 'd':
+				if (! synthnet_option(mowgli_optarg, &net.metadata, SYNTHNET_METADATA_NAMES))
+					return EXIT_FAILURE;
+				break;
+
+			case 'r':
+				if (! synthnet_option(mowgli_optarg, &net.mychans, MICROBENCH_MAX_COUNT))
+					return EXIT_FAILURE;
+				break;
+
+			case 'x':
+				if (! synthnet_option(mowgli_optarg, &net.chanacs, 1000U))
+					return EXIT_FAILURE;
+				break;
+
+			case 'k':
+				if (! synthnet_option(mowgli_optarg, &net.klines, MICROBENCH_MAX_COUNT))
+					return EXIT_FAILURE;
+				break;
+
+			case 's':
+				if (! synthnet_option(mowgli_optarg, &net.seed, UINT_MAX))
+					return EXIT_FAILURE;
+				break;
+
+			case 'n':
+				if (! synthnet_option(mowgli_optarg, &reps, MICROBENCH_MAX_REPS) || ! reps)
+					return EXIT_FAILURE;
+				break;
+
+			case 't':
+				if (! synthnet_option(mowgli_optarg, &target_ms, 60000U) || ! target_ms)
+					return EXIT_FAILURE;
+				break;
+
+			case 'o':
+				output = mowgli_optarg;
+				break;
+
+			case 'l':
+				for (size_t i = 0; i < ARRAY_SIZE(microbenchmarks); i++)
+					(void) printf("%-26s %s\n", microbenchmarks[i].name, microbenchmarks[i].desc);
+				return EXIT_SUCCESS;
+
+			case 'h':
+				(void) microbench_print_usage(argv[0]);
+				return EXIT_SUCCESS;
+
+			default:
+				(void) microbench_print_usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+#ifndef HAVE_GETTIMEOFDAY
+	(void) fprintf(stderr, "This program needs gettimeofday(2)\n");
+	return EXIT_FAILURE;
+#endif
+
+	if (! net.users)
+	{
+		(void) fprintf(stderr, "There must be at least one user\n");
+		return EXIT_FAILURE;
+	}
+
+	(void) synthnet_init(&net, argv[0], "microbench");
+
+	(void) fprintf(stderr, "Building the synthetic network...\n");
+
+	(void) synthnet_build(&net);
+	(void) microbench_build_inputs();
+
+	if (microbench_selected("db_parse", argc, argv))
+		db_available = microbench_db_setup();
+
+	for (size_t i = 0; i < ARRAY_SIZE(microbenchmarks); i++)
+	{
+		const struct microbench *const b = &microbenchmarks[i];
+
+		if (! microbench_selected(b->name, argc, argv))
+			continue;
+
+		(void) fprintf(stderr, "Running %s...\n", b->name);
+
+		if (! microbench_run(b, reps, target_ms, &results[count]))
+		{
+			(void) fprintf(stderr, "Skipped %s: nothing to run it on\n", b->name);
+			continue;
+		}
+
+		count++;
+	}
+
+	(void) microbench_db_cleanup();
+
+	FILE *const f = output ? fopen(output, "w") : stdout;
+
+	if (! f)
+	{
+		(void) fprintf(stderr, "Cannot open %s: %s\n", output, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	(void) microbench_write_json(f, results, count, reps, target_ms);
+
+	if (f != stdout && fclose(f) != 0)
+	{
+		(void) fprintf(stderr, "Cannot write %s: %s\n", output, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,468 @@
+/*
+ * SPDX-License-Identifier: ISC
+ * SPDX-URL: https://spdx.org/licenses/ISC.html
+ *
+ * Copyright (C) 2026 Atheme Development Group (https://atheme.github.io/)
+ *
+ * Offline migration of stored PBKDF2 password hashes.
+ *
+ * A PBKDF2 digest cannot be strengthened without the password it was derived
+ * from, so raising the iteration count still happens on login (see the
+ * recrypt logic in modules/crypto/pbkdf2v2). What *can* be done offline is
+ * moving existing digests into better formats without changing the key they
+ * represent:
+ *
+ *   - crypto/pbkdf2 (legacy) hashes are rewritten as equivalent crypto/pbkdf2v2
+ *     HMAC-SHA2-512 hashes, so the legacy module can be unloaded.
+ *
+ *   - crypto/pbkdf2v2 regular PBKDF2-HMAC hashes can be rewritten as the
+ *     corresponding SCRAM hashes (-s), so those accounts can log in with
+ *     SASL SCRAM without first logging in some other way.
+ *
+ * The tool also reports how many accounts are still below a target iteration
+ * count, and can benchmark the batched PBKDF2 implementation at the target
+ * parameters (-b) to help choose that iteration count.
+ */
+
+#include <atheme.h>
+#include <atheme/libathemecore.h>
+
+#include <ext/getopt_long.h>
+
+#define REHASH_BENCH_SECONDS    2.0L
+
+struct rehash_stats
+{
+	unsigned int    accounts;
+	unsigned int    pbkdf2v2;
+	unsigned int    legacy;
+	unsigned int    legacy_converted;
+	unsigned int    scram_converted;
+	unsigned int    below_target;
+	unsigned int    failed;
+};
+
+static bool rehash_scram = false;
+
+static void
+rehash_print_usage(const char *const restrict progname)
+{
+	(void) fprintf(stderr,
+		"Usage: %s [-b] [-c iterations] [-d digest] [-n] [-s] [database]\n"
+		"\n"
+		"  -b             Benchmark batched PBKDF2 at the target parameters and exit\n"
+		"  -c iterations  Target iteration count (default: %u)\n"
+		"  -d digest      Target digest for -b: SHA1, SHA2-256 or SHA2-512 (default: SHA2-512)\n"
+		"  -n             Do not write the database back; only report what would change\n"
+		"  -s             Rewrite regular PBKDF2v2 hashes as SCRAM hashes\n"
+		"\n"
+		"SCRAM hashes are verified against the SASLprep-normalised password, while\n"
+		"regular PBKDF2v2 hashes are verified against the password as given. Only use\n"
+		"-s if your users' passwords are plain ASCII, or some of them will have to\n"
+		"reset their password.\n", progname, PBKDF2_ITERCNT_DEF);
+}
+
+static long double
+rehash_elapsed(const struct timespec *const restrict begin)
+{
+	struct timespec end;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return ((long double) (end.tv_sec - begin->tv_sec)) +
+	       (((long double) (end.tv_nsec - begin->tv_nsec)) / 1000000000.0L);
+}
+
+static bool
+rehash_benchmark(const enum digest_algorithm alg, const unsigned int iter)
+{
+	struct digest_pbkdf2_job jobs[DIGEST_DIRECT_LANES_32];
+	unsigned char salts[DIGEST_DIRECT_LANES_32][PBKDF2_SALTLEN_DEF];
+	unsigned char dks[DIGEST_DIRECT_LANES_32][DIGEST_MDLEN_MAX];
+	struct timespec begin;
+
+	static const char pass[] = "correct horse battery staple";
+
+	const size_t lanes = digest_pbkdf2_batch_lanes(alg);
+	const size_t dkLen = digest_size_alg(alg);
+
+	for (size_t i = 0; i < lanes; i++)
+	{
+		(void) atheme_random_buf(salts[i], sizeof salts[i]);
+
+		jobs[i].pass = pass;
+		jobs[i].passLen = sizeof pass - 1U;
+		jobs[i].salt = salts[i];
+		jobs[i].saltLen = sizeof salts[i];
+		jobs[i].dk = dks[i];
+		jobs[i].dkLen = dkLen;
+	}
+
+	(void) printf("Benchmarking PBKDF2-HMAC (%zu-byte digest) at %u iterations for %.0Lf seconds each ...\n",
+	              dkLen, iter, REHASH_BENCH_SECONDS);
+
+	unsigned long long int keys = 0;
+	long double elapsed;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	do {
+		if (! digest_oneshot_pbkdf2(alg, pass, sizeof pass - 1U, salts[0], sizeof salts[0], iter, dks[0], dkLen))
+			return false;
+
+		keys++;
+
+	} while ((elapsed = rehash_elapsed(&begin)) < REHASH_BENCH_SECONDS);
+
+	const long double single = keys / elapsed;
+
+	(void) printf("  one at a time   : %10.1Lf keys/s per core\n", single);
+
+	keys = 0;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	do {
+		if (! digest_oneshot_pbkdf2_batch(alg, iter, jobs, lanes))
+			return false;
+
+		keys += lanes;
+
+	} while ((elapsed = rehash_elapsed(&begin)) < REHASH_BENCH_SECONDS);
+
+	const long double batched = keys / elapsed;
+
+	(void) printf("  batched (%zu lanes): %8.1Lf keys/s per core (%.2Lfx)\n", lanes, batched, batched / single);
+
+	(void) smemzero(dks, sizeof dks);
+	return true;
+}
+
+static bool
+rehash_prf_params(const unsigned int prf, enum digest_algorithm *const restrict md, size_t *const restrict dl)
+{
+	switch (prf)
+	{
+		case PBKDF2_PRF_HMAC_SHA1:
+			ATHEME_FALLTHROUGH;
+		case PBKDF2_PRF_HMAC_SHA1_S64:
+			*md = DIGALG_SHA1;
+			*dl = DIGEST_MDLEN_SHA1;
+			return true;
+
+		case PBKDF2_PRF_HMAC_SHA2_256:
+			ATHEME_FALLTHROUGH;
+		case PBKDF2_PRF_HMAC_SHA2_256_S64:
+			*md = DIGALG_SHA2_256;
+			*dl = DIGEST_MDLEN_SHA2_256;
+			return true;
+
+		case PBKDF2_PRF_HMAC_SHA2_512:
+			ATHEME_FALLTHROUGH;
+		case PBKDF2_PRF_HMAC_SHA2_512_S64:
+			*md = DIGALG_SHA2_512;
+			*dl = DIGEST_MDLEN_SHA2_512;
+			return true;
+	}
+
+	return false;
+}
+
+static bool
+rehash_legacy(struct myuser *const restrict mu, struct rehash_stats *const restrict stats)
+{
+	unsigned char digest[DIGEST_MDLEN_SHA2_512];
+	char digest64[BASE64_SIZE_STR(DIGEST_MDLEN_SHA2_512)];
+	char salt[PBKDF2_LEGACY_SALTLEN + 1];
+	char res[PASSLEN + 1];
+	bool retval = false;
+
+	if (strlen(mu->pass) != PBKDF2_LEGACY_PARAMLEN)
+		return false;
+
+	for (size_t i = 0; i < PBKDF2_LEGACY_PARAMLEN; i++)
+		if (! isxdigit((unsigned char) mu->pass[i]))
+			return false;
+
+	stats->legacy++;
+
+	(void) mowgli_strlcpy(salt, mu->pass, sizeof salt);
+
+	for (size_t i = 0; i < sizeof digest; i++)
+	{
+		unsigned int byte;
+
+		(void) sscanf(mu->pass + PBKDF2_LEGACY_SALTLEN + (i * 2U), "%2x", &byte);
+
+		digest[i] = (unsigned char) byte;
+	}
+
+	if (base64_encode(digest, sizeof digest, digest64, sizeof digest64) != BASE64_SIZE_RAW(sizeof digest))
+		goto end;
+
+	// The legacy salt was never base64-encoded, so this must use the non-S64 PRF
+	if (snprintf(res, sizeof res, PBKDF2_FN_SAVEHASH, PBKDF2_PRF_HMAC_SHA2_512, PBKDF2_LEGACY_ITERCNT, salt,
+	             digest64) > PASSLEN)
+		goto end;
+
+	(void) mowgli_strlcpy(mu->pass, res, sizeof mu->pass);
+
+	stats->legacy_converted++;
+	retval = true;
+
+end:
+	(void) smemzero(digest, sizeof digest);
+	(void) smemzero(digest64, sizeof digest64);
+	(void) smemzero(res, sizeof res);
+	return retval;
+}
+
+static void
+rehash_pbkdf2v2(struct myuser *const restrict mu, const unsigned int target, struct rehash_stats *const restrict stats)
+{
+	static const char ClientKeyConstant[] = "Client Key";
+	static const char ServerKeyConstant[] = "Server Key";
+
+	unsigned char sdg[DIGEST_MDLEN_MAX];
+	unsigned char ssk[DIGEST_MDLEN_MAX];
+	unsigned char shk[DIGEST_MDLEN_MAX];
+	char salt64[BUFSIZE];
+	char sdg64[BUFSIZE];
+	char ssk64[BUFSIZE];
+	char shk64[BUFSIZE];
+	char res[PASSLEN + 1];
+
+	enum digest_algorithm md;
+	unsigned int prf;
+	unsigned int iter;
+	size_t dl;
+
+	if (sscanf(mu->pass, PBKDF2_FS_LOADHASH, &prf, &iter, salt64, ssk64, shk64) == 5)
+	{
+		stats->pbkdf2v2++;
+
+		if (iter < target)
+			stats->below_target++;
+
+		goto end;
+	}
+
+	if (sscanf(mu->pass, PBKDF2_FN_LOADHASH, &prf, &iter, salt64, sdg64) != 4)
+		goto end;
+
+	stats->pbkdf2v2++;
+
+	if (iter < target)
+		stats->below_target++;
+
+	if (! rehash_scram || ! rehash_prf_params(prf, &md, &dl))
+		goto end;
+
+	if (base64_decode(sdg64, sdg, sizeof sdg) != dl)
+		goto fail;
+
+	if (! digest_oneshot_hmac(md, sdg, dl, ServerKeyConstant, sizeof ServerKeyConstant - 1U, ssk, NULL))
+		goto fail;
+
+	if (! digest_oneshot_hmac(md, sdg, dl, ClientKeyConstant, sizeof ClientKeyConstant - 1U, shk, NULL))
+		goto fail;
+
+	if (! digest_oneshot(md, shk, dl, shk, NULL))
+		goto fail;
+
+	if (base64_encode(ssk, dl, ssk64, sizeof ssk64) != BASE64_SIZE_RAW(dl))
+		goto fail;
+
+	if (base64_encode(shk, dl, shk64, sizeof shk64) != BASE64_SIZE_RAW(dl))
+		goto fail;
+
+	// Every SCRAM PRF ID is its regular counterpart plus 40
+	if (snprintf(res, sizeof res, PBKDF2_FS_SAVEHASH, prf + 40U, iter, salt64, ssk64, shk64) > PASSLEN)
+		goto fail;
+
+	(void) mowgli_strlcpy(mu->pass, res, sizeof mu->pass);
+
+	stats->scram_converted++;
+	goto end;
+
+fail:
+	(void) slog(LG_ERROR, "could not convert the password hash of account '%s'", entity(mu)->name);
+
+	stats->failed++;
+
+end:
+	(void) smemzero(sdg, sizeof sdg);
+	(void) smemzero(ssk, sizeof ssk);
+	(void) smemzero(shk, sizeof shk);
+	(void) smemzero(sdg64, sizeof sdg64);
+	(void) smemzero(res, sizeof res);
+}
+
+static void
+handle_mdep(struct database_handle *db, const char *type)
+{
+	const char *modname = db_sread_word(db);
+
+	if (! module_request(modname))
+		exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const mowgli_getopt_option_t long_opts[] = {
+		{      "benchmark",       no_argument, NULL, 'b', 0 },
+		{     "iterations", required_argument, NULL, 'c', 0 },
+		{         "digest", required_argument, NULL, 'd', 0 },
+		{           "help",       no_argument, NULL, 'h', 0 },
+		{        "dry-run",       no_argument, NULL, 'n', 0 },
+		{          "scram",       no_argument, NULL, 's', 0 },
+		{             NULL,                 0, NULL,  0 , 0 },
+	};
+
+	enum digest_algorithm bench_alg = DIGALG_SHA2_512;
+	unsigned int target = PBKDF2_ITERCNT_DEF;
+	bool benchmark = false;
+	bool dryrun = false;
+	int r;
+
+	if (! libathemecore_early_init())
+		return EXIT_FAILURE;
+
+	while ((r = mowgli_getopt_long(argc, argv, "bc:d:hns", long_opts, NULL)) != -1)
+	{
+		switch (r)
+		{
+			case 'b':
+				benchmark = true;
+				break;
+
+			case 'c':
+				if (! string_to_uint(mowgli_optarg, &target) || target < PBKDF2_ITERCNT_MIN ||
+				    target > PBKDF2_ITERCNT_MAX)
+				{
+					(void) fprintf(stderr, "Iteration count must be between %u and %u\n",
+					               PBKDF2_ITERCNT_MIN, PBKDF2_ITERCNT_MAX);
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'd':
+				if (strcasecmp(mowgli_optarg, "SHA1") == 0)
+					bench_alg = DIGALG_SHA1;
+				else if (strcasecmp(mowgli_optarg, "SHA2-256") == 0)
+					bench_alg = DIGALG_SHA2_256;
+				else if (strcasecmp(mowgli_optarg, "SHA2-512") == 0)
+					bench_alg = DIGALG_SHA2_512;
+				else
+				{
+					(void) rehash_print_usage(argv[0]);
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'n':
+				dryrun = true;
+				break;
+
+			case 's':
+				rehash_scram = true;
+				break;
+
+			case 'h':
+				(void) rehash_print_usage(argv[0]);
+				return EXIT_SUCCESS;
+
+			default:
+				(void) rehash_print_usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (! digest_testsuite_run())
+	{
+		(void) fprintf(stderr, "Digest interface self-test failed\n");
+		return EXIT_FAILURE;
+	}
+
+	if (benchmark)
+		return rehash_benchmark(bench_alg, target) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	atheme_bootstrap();
+	atheme_init(argv[0], LOGDIR "/pbkdf2-rehash.log");
+	atheme_setup();
+
+	runflags = RF_LIVE;
+	datadir = DATADIR;
+	strict_mode = false;
+	offline_mode = true;
+
+	char *const filename = (mowgli_optind < argc) ? argv[mowgli_optind] : "services.db";
+
+	if (! module_load("backend/opensex"))
+		return EXIT_FAILURE;
+
+	db_unregister_type_handler("MDEP");
+	db_register_type_handler("MDEP", handle_mdep);
+
+	runflags &= ~RF_LIVE;
+	db_load(filename);
+	runflags |= RF_LIVE;
+
+	// Only treat bare 144-digit hex strings as legacy PBKDF2 if the database says that module was in use
+	const bool have_legacy = (module_find_published(PBKDF2_LEGACY_MODULE_NAME) != NULL);
+
+	struct rehash_stats stats;
+	struct myentity_iteration_state state;
+	struct myentity *mt;
+	struct timespec begin;
+
+	(void) memset(&stats, 0x00, sizeof stats);
+	(void) clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	MYENTITY_FOREACH_T(mt, &state, ENT_USER)
+	{
+		struct myuser *const mu = user(mt);
+
+		stats.accounts++;
+
+		if (! (mu->flags & MU_CRYPTPASS))
+			continue;
+
+		if (have_legacy && rehash_legacy(mu, &stats))
+		{
+			// Converted hashes are at the legacy iteration count
+			stats.pbkdf2v2++;
+
+			if (PBKDF2_LEGACY_ITERCNT < target)
+				stats.below_target++;
+
+			continue;
+		}
+
+		(void) rehash_pbkdf2v2(mu, target, &stats);
+	}
+
+	const long double elapsed = rehash_elapsed(&begin);
+
+	(void) printf("%u accounts examined in %.3Lf seconds\n", stats.accounts, elapsed);
+	(void) printf("%u legacy crypto/pbkdf2 hashes, %u rewritten for crypto/pbkdf2v2\n", stats.legacy,
+	              stats.legacy_converted);
+	(void) printf("%u crypto/pbkdf2v2 hashes, %u rewritten as SCRAM hashes, %u failed\n", stats.pbkdf2v2,
+	              stats.scram_converted, stats.failed);
+	(void) printf("%u crypto/pbkdf2v2 hashes are below %u iterations and will be rehashed when their users "
+	              "next log in\n", stats.below_target, target);
+
+	if (dryrun || ! (stats.legacy_converted || stats.scram_converted))
+		return EXIT_SUCCESS;
+
+	// Make sure the database records a dependency on the module that now verifies these hashes
+	if (! module_find_published(PBKDF2V2_CRYPTO_MODULE_NAME) && ! module_load(PBKDF2V2_CRYPTO_MODULE_NAME))
+		return EXIT_FAILURE;
+
+	db_save(filename, DB_SAVE_BLOCKING);
+
+	(void) printf("Database '%s' written\n", filename);
+
+	return EXIT_SUCCESS;
+}